@@ -45,7 +45,9 @@ LOCAL_MODULE_TAGS:= optional
 LOCAL_SRC_FILES:= $(IPC_ROOT)/linux/src/api/MultiProc.c \
                   $(IPC_ROOT)/linux/src/api/NameServer.c \
                   $(IPC_ROOT)/linux/src/api/Ipc.c \
-                  $(IPC_ROOT)/linux/src/api/MessageQ.c
+                  $(IPC_ROOT)/linux/src/api/MessageQ.c \
+                  $(IPC_ROOT)/linux/src/api/TransportRpmsg.c \
+                  $(IPC_ROOT)/linux/src/api/TransportShm.c
 
 LOCAL_SHARED_LIBRARIES := \
     liblog libtiipcutils
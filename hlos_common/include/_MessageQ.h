@@ -95,6 +95,51 @@ typedef struct MessageQ_Config_tag {
     /*!< Maximum length for Message queue names */
 } MessageQ_Config;
 
+/*!
+ *  @brief  Parameters for a message pool registered with
+ *          MessageQ_registerHeap() (Linux only).
+ *
+ *  On Linux, MessageQ_alloc() serves messages up to the rpmsg buffer size
+ *  from per-thread, size-classed free lists.  Passing a pointer to this
+ *  structure as the 'heap' argument of MessageQ_registerHeap() gives the
+ *  heapId its own pool and statistics; a NULL heap selects the defaults.
+ *
+ *  Setting sharedBlockSize makes the heapId a shared heap instead: a fixed
+ *  number of message blocks in memory mapped by every process that
+ *  registers the same heapId with the same geometry.  MessageQ_put() of a
+ *  message from a shared heap to a queue of another process on this
+ *  processor sends only a small descriptor; the receiver gets the message
+ *  in place, and its MessageQ_free() returns the block to the heap.
+ *  MessageQ_alloc() returns NULL when all blocks are taken.  Blocks held
+ *  by a process that dies are lost until the heap is recreated.
+ *
+ *  The heap's file is created mode 0660, less the creator's umask, and a
+ *  process only maps one that has its user or group and isn't writable by
+ *  others, so the processes sharing a heap must share a user or group.
+ */
+typedef struct MessageQ_PoolParams_tag {
+    UInt32 cacheDepth;
+    /*!< Max free messages cached per size class in each thread */
+    UInt32 sharedBlockSize;
+    /*!< Largest message of a shared heap, or 0 for a private pool */
+    UInt32 sharedNumBlocks;
+    /*!< Number of messages in a shared heap */
+} MessageQ_PoolParams;
+
+/*!
+ *  @brief  Message pool statistics returned by MessageQ_getPoolStats().
+ */
+typedef struct MessageQ_PoolStats_tag {
+    UInt32 hits;
+    /*!< Allocations served from a per-thread free list */
+    UInt32 misses;
+    /*!< Allocations that had to go to the system allocator */
+    UInt32 inUse;
+    /*!< Messages currently allocated from this pool */
+    UInt32 highWater;
+    /*!< Largest value inUse has reached */
+} MessageQ_PoolStats;
+
 /* =============================================================================
  *  APIs
  * =============================================================================
@@ -164,6 +209,23 @@ Void MessageQ_cleanupOwner(Int pid);
 
 Void MessageQ_msgInit(MessageQ_Msg msg);
 
+/*
+ *  Return a file descriptor that polls readable while messages are waiting
+ *  for the queue, for use with select(), poll() or an epoll set.  Retrieve
+ *  the messages with MessageQ_tryGet().  The descriptor belongs to the
+ *  queue; don't read it or close it.
+ */
+Int MessageQ_getFd(MessageQ_Handle handle);
+
+/* Initialize MessageQ_PoolParams with the default pool settings. */
+Void MessageQ_PoolParams_init(MessageQ_PoolParams *params);
+
+/*
+ *  Retrieve the allocation statistics of the pool serving heapId.
+ *  heapIds that were not registered report the default (heapId 0) pool.
+ */
+Int MessageQ_getPoolStats(UInt16 heapId, MessageQ_PoolStats *stats);
+
 #if defined (__cplusplus)
 }
 #endif /* defined (__cplusplus) */
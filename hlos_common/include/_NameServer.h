@@ -59,6 +59,65 @@ extern "C" {
  */
 #define NAME_SERVER_RPMSG_ADDR 0
 
+/*!
+ *  @brief  Timeout for NameServer_watch() that waits as long as it takes
+ */
+#define NameServer_FOREVER     (~(0))
+
+/*!
+ *  @brief  Longest name, with its terminating NUL, that
+ *          NameServer_enumerate() reports; longer ones are skipped
+ */
+#define NameServer_ENUMNAMELEN (32)
+
+/* =============================================================================
+ * Structures & Enums
+ * =============================================================================
+ */
+
+/*!
+ *  @brief  Counters of an instance's cache of remote lookups
+ *
+ *  A remote lookup is one NameServer_get() makes of a single remote
+ *  processor.  Answers, including "not found", are cached for a while, so
+ *  a name asked for again soon after doesn't go back to the processor.
+ */
+typedef struct NameServer_CacheStats {
+    UInt32 hits;
+    /*!< Remote lookups answered from the cache */
+    UInt32 negativeHits;
+    /*!< Those of the hits whose cached answer was that the name isn't there */
+    UInt32 misses;
+    /*!< Remote lookups that had to ask the remote processor */
+} NameServer_CacheStats;
+
+/*!
+ *  @brief  Function called when a name is added to an instance
+ *
+ *  The name may have been added locally, or announced by the remote
+ *  processor it was added on.  It is called without any NameServer lock
+ *  held, but possibly from NameServer's listener thread.
+ */
+typedef Void (*NameServer_AddFxn)(NameServer_Handle handle, String name);
+
+/*!
+ *  @brief  Function NameServer_enumerate() calls with each name found
+ *
+ *  value is the name's value if that is a UInt32, and 0 otherwise.
+ *  Returning FALSE ends the enumeration.
+ */
+typedef Bool (*NameServer_EnumFxn)(Ptr arg, String name, UInt32 value);
+
+/*!
+ *  @brief  A name and its value, as NameServer_enumerateLocal() returns it
+ */
+typedef struct NameServer_EnumEntry {
+    Char   name[NameServer_ENUMNAMELEN];
+    /*!< The name, NUL-terminated */
+    UInt32 value;
+    /*!< Its value if that is a UInt32, 0 otherwise */
+} NameServer_EnumEntry;
+
 /* =============================================================================
  * APIs
  * =============================================================================
@@ -77,6 +136,105 @@ Int NameServer_setup (Void);
  */
 Int NameServer_destroy (void);
 
+/*!
+ *  @brief      Get the counters of an instance's remote lookup cache.
+ *
+ *  @param      handle  Instance handle
+ *  @param      stats   Filled in with the counters
+ */
+Int NameServer_getCacheStats (NameServer_Handle handle,
+                              NameServer_CacheStats * stats);
+
+/*!
+ *  @brief      Wait for a name to be added, locally or on any processor.
+ *
+ *  Returns as soon as the name is found, with its value in value.  Names
+ *  added on a remote processor are seen as soon as the processor announces
+ *  them; one that doesn't announce is asked again every so often.
+ *
+ *  @param      handle  Instance handle
+ *  @param      name    Name to wait for
+ *  @param      value   Filled in with the name's UInt32 value
+ *  @param      timeout Maximum time to wait in microseconds, or
+ *                      #NameServer_FOREVER
+ *
+ *  @return     #NameServer_S_SUCCESS if the name was found,
+ *              #NameServer_E_TIMEOUT if it wasn't within timeout, or
+ *              #NameServer_E_INVALIDARG if name is too long to be added
+ */
+Int NameServer_watch (NameServer_Handle handle, String name, Ptr value,
+                      UInt timeout);
+
+/*!
+ *  @brief      Set the function called whenever a name is added.
+ *
+ *  For the daemon, which uses it to answer NameServer_watch().  Only one
+ *  function is kept; NULL removes it.
+ */
+Void NameServer_setAddFxn (NameServer_AddFxn fxn);
+
+/*!
+ *  @brief      Tell whether a remote processor announces its names.
+ *
+ *  For the daemon, which only polls for a watched name on the remotes that
+ *  don't.  A remote counts as announcing once its first
+ *  NAMESERVER_ANNOUNCE has arrived.
+ *
+ *  @param      procId  Remote processor's ID
+ *
+ *  @return     TRUE if the remote has announced a name
+ */
+Bool NameServer_announces (UInt16 procId);
+
+/*!
+ *  @brief      Take a reference to an instance.
+ *
+ *  For the daemon, which holds an instance while a worker thread uses it,
+ *  so a NameServer_delete() meanwhile can't free it.  The reference is
+ *  dropped with NameServer_release().
+ *
+ *  @return     TRUE, or FALSE if handle is not an instance
+ */
+Bool NameServer_acquire (NameServer_Handle handle);
+
+/*!
+ *  @brief      Drop a reference taken by NameServer_acquire().
+ *
+ *  The instance is freed as by NameServer_delete() if it was the last.
+ */
+Void NameServer_release (NameServer_Handle handle);
+
+/*!
+ *  @brief      Call fxn with every local name that begins with prefix.
+ *
+ *  Names are passed in strcmp() order, and only names of this processor's
+ *  own table are searched; an empty prefix matches every name.  Names are
+ *  fetched in batches, so ones added or removed while the enumeration is
+ *  going on may or may not be seen, but no name is seen twice.
+ *
+ *  @param      handle  Instance handle
+ *  @param      prefix  Beginning shared by the names wanted
+ *  @param      fxn     Function to call with each name
+ *  @param      arg     Passed to fxn
+ *
+ *  @return     Number of names passed to fxn, or a NameServer error code
+ */
+Int NameServer_enumerate (NameServer_Handle handle, String prefix,
+                          NameServer_EnumFxn fxn, Ptr arg);
+
+/*!
+ *  @brief      Get the next batch of local names that begin with prefix.
+ *
+ *  For the daemon, which answers NameServer_enumerate() with it.  Fills in
+ *  up to max entries with the first names after after, in strcmp() order,
+ *  or the first names of all if after is NULL.
+ *
+ *  @return     Number of entries filled in, or a NameServer error code
+ */
+Int NameServer_enumerateLocal (NameServer_Handle handle, String prefix,
+                               String after, NameServer_EnumEntry entries[],
+                               UInt max);
+
 #if defined (__cplusplus)
 }
 #endif
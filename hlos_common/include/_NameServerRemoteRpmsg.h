@@ -32,6 +32,7 @@
 
 #define NAMESERVER_REQUEST    0
 #define NAMESERVER_RESPONSE   1
+#define NAMESERVER_ANNOUNCE   2  /* name added (requestStatus 1) or removed */
 
 #define NAME_SERVER_RPMSG_ADDR  0
 
@@ -55,4 +56,5 @@ typedef struct NameServerMsg {
     Bits32  name[NAMEARRAYSZIE];
     Bits32  valueLen;              /* len of value                  */
     Bits32  valueBuf[MAXVALUELEN]; /* value buffer                  */
+    Bits32  requestId;          /* echoed in the reply, to match it */
 } NameServerMsg;
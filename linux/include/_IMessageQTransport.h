@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/** ============================================================================
+ *  @file   _IMessageQTransport.h
+ *
+ *  @brief  Transport interface used by the HLOS MessageQ module
+ *
+ *  This is the HLOS counterpart of ti.sdo.ipc.interfaces.IMessageQTransport.
+ *  A transport moves messages between this process and the queues of one or
+ *  more processors, and is registered with MessageQ per processor using
+ *  MessageQ_registerTransport().
+ *
+ *  A receive endpoint is opened on each registered transport for every
+ *  MessageQ created by this process.  Each endpoint hands MessageQ a file
+ *  descriptor that becomes readable when messages may be waiting, so all
+ *  transports are serviced from the single epoll set in MessageQ_get().
+ *  ============================================================================
+ */
+
+
+#ifndef _IMESSAGEQTRANSPORT_H_0X6A3C
+#define _IMESSAGEQTRANSPORT_H_0X6A3C
+
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+
+/*!
+ *  @brief  Handle of a transport instance.
+ */
+typedef struct IMessageQTransport_Object * IMessageQTransport_Handle;
+
+/*!
+ *  @brief  Transport function table.
+ *
+ *  Status returns are MessageQ status codes.
+ */
+typedef struct IMessageQTransport_Fxns {
+    Int (*attach)(IMessageQTransport_Handle handle, UInt16 rprocId);
+    /*!< Open the send path to rprocId; called from MessageQ_attach() */
+    Int (*detach)(IMessageQTransport_Handle handle, UInt16 rprocId);
+    /*!< Close the send path to rprocId; called from MessageQ_detach() */
+    Int (*openEndpoint)(IMessageQTransport_Handle handle,
+            MessageQ_QueueId queueId, UInt16 rprocId, Ptr * endpoint,
+            int * fd);
+    /*!< Open a receive endpoint for queueId, fed by rprocId.  Returns the
+     *   endpoint and the fd MessageQ waits on for it. */
+    Void (*closeEndpoint)(IMessageQTransport_Handle handle, Ptr endpoint);
+    /*!< Close a receive endpoint */
+    Int (*get)(IMessageQTransport_Handle handle, Ptr endpoint,
+            MessageQ_Msg msgs[], UInt maxMsgs);
+    /*!< Take up to maxMsgs waiting messages without blocking.  Returns the
+     *   number of messages taken, which may be 0. */
+    Int (*put)(IMessageQTransport_Handle handle, MessageQ_Msg msgs[],
+            UInt numMsgs, UInt16 dstProcId, UInt timeout);
+    /*!< Send messages, in order, to one queue on dstProcId, waiting up to
+     *   timeout usecs (or MessageQ_FOREVER) for room at the destination.
+     *   Sent messages are freed; returns the number sent, or
+     *   MessageQ_E_TIMEOUT if there was no room for the first in time. */
+} IMessageQTransport_Fxns;
+
+/*!
+ *  @brief  Common header of every transport instance.
+ *
+ *  Transports embed this as the first field of their instance object.
+ */
+typedef struct IMessageQTransport_Object {
+    const IMessageQTransport_Fxns * fxns;
+} IMessageQTransport_Object;
+
+
+/* =============================================================================
+ *  APIs
+ * =============================================================================
+ */
+/*!
+ *  @brief      Register a transport for messages to and from rprocId.
+ *
+ *  @param[in]  handle      Transport instance
+ *  @param[in]  rprocId     Processor served by the transport.  The
+ *                          transport registered for MultiProc_self() carries
+ *                          messages between processes on this processor.
+ *
+ *  @return     TRUE if registered, FALSE if rprocId is invalid or already
+ *              has a transport.
+ */
+Bool MessageQ_registerTransport(IMessageQTransport_Handle handle,
+        UInt16 rprocId);
+
+/*!
+ *  @brief      Unregister the transport for rprocId.
+ *
+ *  @param[in]  rprocId     Processor passed to MessageQ_registerTransport()
+ */
+Void MessageQ_unregisterTransport(UInt16 rprocId);
+
+/*!
+ *  @brief      Get the rpmsg socket transport, which serves remote
+ *              processors.
+ */
+IMessageQTransport_Handle TransportRpmsg_handle(Void);
+
+/*!
+ *  @brief      Get the POSIX shared memory transport, which serves queues
+ *              of other processes on this processor.
+ */
+IMessageQTransport_Handle TransportShm_handle(Void);
+
+
+#if defined (__cplusplus)
+}
+#endif /* defined (__cplusplus) */
+
+
+#endif /* _IMESSAGEQTRANSPORT_H_0X6A3C */
@@ -43,9 +43,11 @@ extern "C" {
 #include <ti/ipc/MessageQ.h>
 #include <_MessageQ.h>
 #include <ti/ipc/NameServer.h>
+#include <_NameServer.h>
 #include <ti/ipc/MultiProc.h>
 #include <_MultiProc.h>
 #include <stdio.h>
+#include <stdint.h>
 
 extern Bool logFile;
 extern FILE *logPtr;
@@ -75,31 +77,73 @@ extern FILE *logPtr;
     if (verbose == TRUE) {  printf(a, b, c, d); }
 
 
-/* LAD commmand FIFO strings: */
+/*
+ * LAD socket: a SOCK_SEQPACKET Unix-domain socket, one connection per
+ * client.  Each command and each response is one packet.
+ */
 #if defined (IPC_BUILDOS_ANDROID)
-#define LAD_COMMANDFIFO         "/data/local/tmp/LAD/LADCMDS"
+#define LAD_SOCKETPATH          "/data/local/tmp/LAD/LADSOCK"
 #define LAD_WORKINGDIR          "/data/local/tmp/LAD/"
 #else
-#define LAD_COMMANDFIFO         "/tmp/LAD/LADCMDS"
+#define LAD_SOCKETPATH          "/tmp/LAD/LADSOCK"
 #define LAD_WORKINGDIR          "/tmp/LAD/"
 #endif
 
-#define LAD_RESPONSEFIFOPATH    LAD_WORKINGDIR
-#define LAD_PROTOCOLVERSION     "03000000"    /*  MMSSRRRR */
+#define LAD_PROTOCOLVERSION     "04060000"    /*  MMSSRRRR */
 
-#define LAD_MAXNUMCLIENTS  32      /* max simultaneous clients */
+#define LAD_MAXNUMCLIENTS  16384   /* max simultaneous clients */
 #define LAD_CONNECTTIMEOUT 5.0  /* LAD connect response timeout (sec) */
 #define LAD_DISCONNECTTIMEOUT   5.0  /* LAD disconnect timeout (sec) */
-#define LAD_MAXLENGTHFIFONAME   128  /* max length client FIFO name */
+#define LAD_MAXLENGTHFIFONAME   128  /* max length client name */
 #define LAD_MAXLENGTHCOMMAND    512  /* size limit for LAD command string */
 #define LAD_MAXLENGTHRESPONSE   512  /* size limit for LAD response string */
 #define LAD_MAXLENGTHPROTOVERS  16   /* size limit for protocol version */
 #define LAD_MAXLOGFILEPATH 256  /* size limit for LAD log file path */
 #define LAD_COMMANDLENGTH       sizeof(struct LAD_CommandObj)
-#define LAD_RESPONSELENGTH      sizeof(union LAD_ResponseObj)
+#define LAD_RESPONSELENGTH      sizeof(struct LAD_ResponseMsg)
 
 #define LAD_MESSAGEQCREATEMAXNAMELEN 32
 
+/* Names per LAD_NAMESERVER_ENUMERATE response */
+#define LAD_NSENUMBATCH         8
+
+/*
+ * The daemon's mirror of the UInt32 entries in its local NameServer tables,
+ * which clients map read-only to answer local lookups without asking LAD.
+ * The daemon makes seq odd while it changes the slots, so a client that
+ * sees seq odd, or changed by the end of its lookup, looks again.
+ */
+#define LAD_NSMIRRORPATH        LAD_WORKINGDIR "NameServerMirror"
+#define LAD_NSMIRRORMAGIC       0x4E534D31    /* "NSM1" */
+#define LAD_NSMIRRORSIZE        4096          /* slots, a power of 2 */
+#define LAD_NSMIRRORNAMELEN     32            /* longer names aren't mirrored */
+
+typedef struct LAD_NSMirrorSlot {
+    volatile UInt32     hash;       /* of handle and name, 0 if empty */
+    volatile UInt32     value;
+    volatile uint64_t   handle;     /* the instance, as clients know it */
+    Char                name[LAD_NSMIRRORNAMELEN];
+} LAD_NSMirrorSlot;
+
+typedef struct LAD_NSMirror {
+    volatile UInt32     magic;
+    volatile UInt32     seq;
+    LAD_NSMirrorSlot    slots[LAD_NSMIRRORSIZE];
+} LAD_NSMirror;
+
+/* The hash a mirror slot is filed under; never 0 */
+static inline UInt32 LAD_nsMirrorHash(uint64_t handle, const char * name)
+{
+    UInt32 hash = 2166136261u ^ (UInt32)(handle ^ (handle >> 32));
+
+    /* FNV-1a, the same in the daemon and every client whatever its CPU */
+    while (*name != '\0') {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+
+    return (hash != 0 ? hash : 1);
+}
+
 
 typedef enum {
     LAD_CONNECT = 0,
@@ -113,6 +157,10 @@ typedef enum {
     LAD_NAMESERVER_GETUINT32,
     LAD_NAMESERVER_REMOVE,
     LAD_NAMESERVER_REMOVEENTRY,
+    LAD_NAMESERVER_GETCACHESTATS,
+    LAD_NAMESERVER_WATCH,
+    LAD_NAMESERVER_MATCH,
+    LAD_NAMESERVER_ENUMERATE,
     LAD_MESSAGEQ_GETCONFIG,
     LAD_MESSAGEQ_SETUP,
     LAD_MESSAGEQ_DESTROY,
@@ -126,6 +174,7 @@ typedef enum {
 struct LAD_CommandObj {
     Int cmd;
     Int clientId;
+    UInt32 requestId;       /* echoed in the response, to match the two */
     union {
         struct {
             Int pid;
@@ -157,6 +206,23 @@ struct LAD_CommandObj {
             NameServer_Handle handle;
             Ptr entryPtr;
         } removeEntry;
+        struct {
+            NameServer_Handle handle;
+        } getCacheStats;
+        struct {
+            NameServer_Handle handle;
+            Char name[NameServer_Params_MAXNAMELEN];
+            UInt32 timeout;     /* usecs, or NameServer_FOREVER */
+        } watch;
+        struct {
+            NameServer_Handle handle;
+            Char name[NameServer_ENUMNAMELEN];
+        } match;
+        struct {
+            NameServer_Handle handle;
+            Char prefix[NameServer_ENUMNAMELEN];
+            Char after[NameServer_ENUMNAMELEN];  /* "" for the first batch */
+        } enumerate;
         struct {
             MessageQ_Config cfg;
         } messageQSetup;
@@ -179,10 +245,24 @@ union LAD_ResponseObj {
        Int status;
        Int assignedId;
     } connect;
+    struct {
+       Int status;
+       Int len;             /* characters matched, 0 if none */
+       UInt32 val;
+    } match;
+    struct {
+       Int status;
+       UInt32 count;        /* fewer than LAD_NSENUMBATCH in the last */
+       NameServer_EnumEntry entries[LAD_NSENUMBATCH];
+    } enumerate;
     struct {
        Int status;
        NameServer_Handle handle;
     } delete;
+    struct {
+       Int status;
+       NameServer_CacheStats stats;
+    } getCacheStats;
     struct {
        Int status;
        NameServer_Handle nameServerHandle;
@@ -213,6 +293,15 @@ union LAD_ResponseObj {
     Int status;
 };
 
+/*
+ * A response as sent by LAD.  Commands from one client may be answered
+ * out of order, so each response carries the requestId of its command.
+ */
+struct LAD_ResponseMsg {
+    UInt32 requestId;
+    union LAD_ResponseObj rsp;
+};
+
 
 #ifdef __cplusplus
 }
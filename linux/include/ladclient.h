@@ -122,6 +122,8 @@ extern LAD_Status LAD_disconnect(LAD_ClientHandle handle);
 extern LAD_ClientHandle LAD_findHandle(Void);
 extern LAD_Status LAD_getResponse(LAD_ClientHandle handle, union LAD_ResponseObj *rsp);
 extern LAD_Status LAD_putCommand(struct LAD_CommandObj *cmd);
+extern LAD_Status LAD_putCommandBatch(struct LAD_CommandObj *cmds,
+    union LAD_ResponseObj *rsps, UInt numCmds);
 
 #ifdef __cplusplus
 }
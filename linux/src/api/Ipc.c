@@ -43,7 +43,16 @@
 /* Standard headers */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <linux/netlink.h>
 
 /* Common IPC headers: */
 #include <ti/ipc/Std.h>
@@ -57,11 +66,42 @@
 #include <ti/ipc/MultiProc.h>
 #include <_MultiProc.h>
 #include <_MessageQ.h>
+#include <_IMessageQTransport.h>
 #include <_NameServer.h>
 
+/*
+ * After the kernel reports an rpmsg device, the remote processors not yet
+ * attached are tried this many times, this many msecs apart, since the
+ * device may be reported before its driver is ready to connect to.
+ */
+#define Ipc_ATTACHRETRIES   10
+#define Ipc_ATTACHRETRYMS   100
+
+/* An attach to one remote processor, run on a thread of its own */
+typedef struct Ipc_AttachJob {
+    UInt16              procId;
+    Int                 status;
+    pthread_t           thread;
+    Bool                started;
+} Ipc_AttachJob;
+
 static LAD_ClientHandle ladHandle;
 
+/* Which processors are attached, and who to tell of late attaches */
+static pthread_mutex_t      Ipc_gate = PTHREAD_MUTEX_INITIALIZER;
+static Bool                 Ipc_attached[MultiProc_MAXPROCESSORS];
+static Ipc_AttachNotifyFxn  Ipc_notifyFxn = NULL;
+static Ptr                  Ipc_notifyArg = NULL;
+
+/* Thread attaching to remote processors that come up after Ipc_start() */
+static pthread_t            Ipc_watcher;
+static int                  Ipc_ueventFd = -1;
+static int                  Ipc_stopFd = -1;
+
 static void cleanup(int arg);
+static Void *attachThread(Void *arg);
+static Void startWatcher(Void);
+static Void stopWatcher(Void);
 
 /** ============================================================================
  *  Functions
@@ -76,6 +116,9 @@ Int Ipc_start (Void)
     LAD_Status        ladStatus;
     UInt16            rprocId;
     Int32             attachedAny = 0;
+    Ipc_AttachJob     jobs[MultiProc_MAXPROCESSORS];
+    Bool              failed;
+    Bool              missing;
 
     /* Catch ctrl-C, and cleanup: */
     (void) signal(SIGINT, cleanup);
@@ -99,29 +142,78 @@ Int Ipc_start (Void)
         MessageQ_getConfig(&msgqCfg);
         MessageQ_setup(&msgqCfg);
 
-        /* Now attach to all remote processors, assuming they are up. */
+        /*
+         * Messages between processes on the host go over shared memory;
+         * everything else goes over rpmsg.
+         */
+        for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
+            MessageQ_registerTransport(rprocId == MultiProc_self() ?
+                    TransportShm_handle() : TransportRpmsg_handle(), rprocId);
+        }
+
+        status = MessageQ_attach(MultiProc_self(), NULL);
+        if (status >= 0) {
+            attachedAny = 1;
+        }
+        else {
+            printf("Ipc_start: MessageQ_attach(%d) failed: %d\n",
+                   MultiProc_self(), status);
+        }
+
+        /*
+         * Now attach to all remote processors at once, so that the ones
+         * that are up don't wait on the connects to the ones that aren't.
+         */
+        for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
+            jobs[rprocId].procId = rprocId;
+            jobs[rprocId].started = FALSE;
+            if (MultiProc_self() == rprocId) {
+                /* Skip host, which was attached above. */
+                continue;
+            }
+            jobs[rprocId].started = (pthread_create(&jobs[rprocId].thread,
+                    NULL, attachThread, &jobs[rprocId]) == 0);
+            if (!jobs[rprocId].started) {
+                attachThread(&jobs[rprocId]);
+            }
+        }
+
+        failed = FALSE;
+        missing = FALSE;
         for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
-            if (0 == rprocId) {
-                /* Skip host, which should always be 0th entry. */
+            if (MultiProc_self() == rprocId) {
                 continue;
             }
-            status = MessageQ_attach(rprocId, NULL);
+            if (jobs[rprocId].started) {
+                pthread_join(jobs[rprocId].thread, NULL);
+            }
+            status = jobs[rprocId].status;
             if (status == MessageQ_E_RESOURCE) {
+                /* not up yet; the watcher attaches it when it is */
+                missing = TRUE;
                 continue;
             }
             if (status < 0) {
                 printf("Ipc_start: MessageQ_attach(%d) failed: %d\n",
                        rprocId, status);
-                status = Ipc_E_FAIL;
-
-                break;
+                failed = TRUE;
             }
             else {
+                pthread_mutex_lock(&Ipc_gate);
+                Ipc_attached[rprocId] = TRUE;
+                pthread_mutex_unlock(&Ipc_gate);
                 attachedAny = 1;
             }
         }
-        if (attachedAny) {
+
+        if (failed) {
+            status = Ipc_E_FAIL;
+        }
+        else if (attachedAny) {
             status = Ipc_S_SUCCESS;
+            if (missing) {
+                startWatcher();
+            }
         }
     }
     else {
@@ -141,14 +233,17 @@ Int Ipc_stop (Void)
     LAD_Status        ladStatus;
     UInt16            rprocId;
 
-    /* Now detach from all remote processors, assuming they are up. */
+    /* No more late attaches */
+    stopWatcher();
+
+    pthread_mutex_lock(&Ipc_gate);
+    memset(Ipc_attached, 0, sizeof(Ipc_attached));
+    pthread_mutex_unlock(&Ipc_gate);
+
+    /* Now detach from all processors, the host included. */
     for (rprocId = 0;
          (rprocId < MultiProc_getNumProcessors()) && (status >= 0);
          rprocId++) {
-        if (0 == rprocId) {
-          /* Skip host, which should always be 0th entry. */
-          continue;
-        }
         status = MessageQ_detach(rprocId);
         if (status < 0) {
             printf("Ipc_stop: MessageQ_detach(%d) failed: %d\n",
@@ -156,6 +251,7 @@ Int Ipc_stop (Void)
             status = Ipc_E_FAIL;
             goto exit;
        }
+        MessageQ_unregisterTransport(rprocId);
     }
 
     status = MessageQ_destroy();
@@ -183,6 +279,215 @@ exit:
     return (status);
 }
 
+/* Function to query whether a remote processor is attached */
+Bool Ipc_isAttached(UInt16 remoteProcId)
+{
+    Bool attached = FALSE;
+
+    if (remoteProcId < MultiProc_MAXPROCESSORS &&
+        remoteProcId != MultiProc_self()) {
+        pthread_mutex_lock(&Ipc_gate);
+        attached = Ipc_attached[remoteProcId];
+        pthread_mutex_unlock(&Ipc_gate);
+    }
+
+    return (attached);
+}
+
+/* Function to set the function called when a processor is attached late */
+Void Ipc_setAttachNotifyFxn(Ipc_AttachNotifyFxn fxn, Ptr arg)
+{
+    pthread_mutex_lock(&Ipc_gate);
+    Ipc_notifyFxn = fxn;
+    Ipc_notifyArg = arg;
+    pthread_mutex_unlock(&Ipc_gate);
+}
+
+/* Attach to one remote processor, for Ipc_start() */
+static Void *attachThread(Void *arg)
+{
+    Ipc_AttachJob *job = (Ipc_AttachJob *)arg;
+
+    job->status = MessageQ_attach(job->procId, NULL);
+
+    return (NULL);
+}
+
+/*
+ * Try to attach to each remote processor not attached yet, and tell the
+ * application of each one that is.  Returns TRUE once all are attached.
+ */
+static Bool attachLate(Void)
+{
+    Ipc_AttachNotifyFxn fxn;
+    Ptr    arg;
+    Bool   done = TRUE;
+    Bool   attached;
+    UInt16 rprocId;
+    Int    status;
+
+    for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
+        if (rprocId == MultiProc_self() || Ipc_isAttached(rprocId)) {
+            continue;
+        }
+
+        status = MessageQ_attach(rprocId, NULL);
+        attached = (status >= 0 || status == MessageQ_E_ALREADYEXISTS);
+        if (!attached) {
+            done = FALSE;
+            continue;
+        }
+
+        pthread_mutex_lock(&Ipc_gate);
+        Ipc_attached[rprocId] = TRUE;
+        fxn = Ipc_notifyFxn;
+        arg = Ipc_notifyArg;
+        pthread_mutex_unlock(&Ipc_gate);
+
+        if (fxn != NULL) {
+            fxn(rprocId, arg);
+        }
+    }
+
+    return (done);
+}
+
+/*
+ * Whether a kernel uevent is about an rpmsg device or a remote processor
+ * appearing.  It's "ACTION@DEVPATH" followed by KEY=VALUE strings, each
+ * NUL-terminated.
+ */
+static Bool isRpmsgEvent(const char *buf, ssize_t len)
+{
+    const char *end = buf + len;
+    const char *s;
+    Bool rpmsg = FALSE;
+
+    for (s = buf; s < end; s += strlen(s) + 1) {
+        if (strcmp(s, "SUBSYSTEM=rpmsg") == 0 ||
+            strcmp(s, "SUBSYSTEM=remoteproc") == 0) {
+            rpmsg = TRUE;
+        }
+        else if (strcmp(s, "ACTION=remove") == 0 ||
+                 strcmp(s, "ACTION=unbind") == 0) {
+            return (FALSE);
+        }
+    }
+
+    return (rpmsg);
+}
+
+/*
+ * Wait for the kernel to report rpmsg devices, and attach to the remote
+ * processors they belong to, until all are attached or Ipc_stop().
+ */
+static Void *watcherThread(Void *arg)
+{
+    struct pollfd fds[2];
+    char    buf[4096];
+    ssize_t len;
+    Int     retries = 0;
+    int     n;
+
+    fds[0].fd = Ipc_ueventFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = Ipc_stopFd;
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        n = poll(fds, 2, retries > 0 ? Ipc_ATTACHRETRYMS : -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[1].revents != 0) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            /* a burst of events needs only one round of attaches */
+            while ((len = recv(Ipc_ueventFd, buf, sizeof(buf) - 1,
+                               MSG_DONTWAIT)) > 0) {
+                buf[len] = '\0';
+                if (isRpmsgEvent(buf, len)) {
+                    retries = Ipc_ATTACHRETRIES;
+                }
+            }
+        }
+
+        if (retries > 0) {
+            retries--;
+            if (attachLate()) {
+                break;
+            }
+        }
+    }
+
+    return (NULL);
+}
+
+/*
+ * Start watching for remote processors coming up.  Without uevents (e.g.
+ * no permission for the netlink socket), those not up at Ipc_start() are
+ * just not attached, as before.
+ */
+static Void startWatcher(Void)
+{
+    struct sockaddr_nl addr;
+
+    Ipc_ueventFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                          NETLINK_KOBJECT_UEVENT);
+    if (Ipc_ueventFd < 0) {
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid = 0;
+    addr.nl_groups = 1;         /* the kernel's own events */
+    if (bind(Ipc_ueventFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        goto fail;
+    }
+
+    Ipc_stopFd = eventfd(0, EFD_CLOEXEC);
+    if (Ipc_stopFd < 0) {
+        goto fail;
+    }
+
+    if (pthread_create(&Ipc_watcher, NULL, watcherThread, NULL) == 0) {
+        return;
+    }
+
+    close(Ipc_stopFd);
+    Ipc_stopFd = -1;
+
+fail:
+    close(Ipc_ueventFd);
+    Ipc_ueventFd = -1;
+}
+
+/* Stop the watcher started by Ipc_start(), if it was */
+static Void stopWatcher(Void)
+{
+    uint64_t buf = 1;
+
+    if (Ipc_stopFd < 0) {
+        return;
+    }
+
+    if (write(Ipc_stopFd, &buf, sizeof(buf)) == sizeof(buf)) {
+        pthread_join(Ipc_watcher, NULL);
+    }
+
+    close(Ipc_stopFd);
+    close(Ipc_ueventFd);
+    Ipc_stopFd = -1;
+    Ipc_ueventFd = -1;
+}
+
 static void cleanup(int arg)
 {
     printf("Ipc: Caught SIGINT, calling Ipc_stop...\n");
@@ -53,14 +53,19 @@
 #include <_MultiProc.h>
 #include <ti/ipc/MessageQ.h>
 #include <_MessageQ.h>
+#include <_IMessageQTransport.h>
 
 /* Socket Headers */
-#include <sys/select.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/eventfd.h>
-#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <stddef.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
@@ -68,12 +73,6 @@
 #include <unistd.h>
 #include <assert.h>
 
-/* Socket Protocol Family */
-#include <net/rpmsg.h>
-
-/* Socket utils: */
-#include <SocketFxns.h>
-
 #include <ladclient.h>
 #include <_lad.h>
 
@@ -87,14 +86,62 @@
  */
 #define MessageQ_NAMESERVER  "MessageQ"
 
-/*!
- *  @brief  Value of an invalid socket ID:
+/* epoll event tag identifying the MessageQ_unblock() eventfd: */
+#define MESSAGEQ_UNBLOCKTAG      0xFFFFFFFF
+
+/* epoll event tag identifying the in-process delivery eventfd: */
+#define MESSAGEQ_LOCALTAG        0xFFFFFFFE
+
+/*
+ * Receive staging lists, as BIOS highList/normalList, and the most
+ * messages taken from one source each time they are refilled:
+ */
+#define MESSAGEQ_STAGEHIGH       0
+#define MESSAGEQ_STAGENORMAL     1
+#define MESSAGEQ_STAGEMAX        32
+
+/*
+ * Message pool: size classes are powers of two from 64 bytes up to the
+ * rpmsg buffer size, so every received message has a class to recycle into.
+ */
+#define MessageQ_POOL_MINSHIFT       6
+#define MessageQ_POOL_NUMCLASSES     4
+#define MessageQ_POOL_MAXHEAPS       8
+#define MessageQ_POOL_NOCLASS        0xFFFF
+#define MessageQ_POOL_SHARED         0xFFFE
+#define MessageQ_POOL_CACHEDEPTH     64
+
+/*
+ * Shared heaps: a file per heapId, mapped by every process using it.  Where
+ * the files live; Android has no /dev/shm.
+ */
+#if defined(IPC_BUILDOS_ANDROID)
+#define MessageQ_SHARED_DIR          LAD_WORKINGDIR
+#else
+#define MessageQ_SHARED_DIR          "/dev/shm/"
+#endif
+#define MessageQ_SHARED_NAMEFMT      "tiipc_heap_%04x"
+#define MessageQ_SHARED_MAGIC        0x54534850  /* 'TSHP' */
+#define MessageQ_SHARED_ALIGN        64
+
+/* Flag of a descriptor sent in place of a message from a shared heap */
+#define MESSAGEQ_DESCFLAG            0x0400
+
+/*
+ * Flags of messages sent by SYS/BIOS MessageQ_putWait() (the low byte of
+ * reserved is the sender's window), and of messages returning credits to
+ * it (the high byte of reserved is how many).  See ti.sdo.ipc.MessageQ.
  */
-#define Transport_INVALIDSOCKET  (0xFFFFFFFF)
+#define MESSAGEQ_CREDITFLAG          0x0200
+#define MESSAGEQ_CREDITSFLAG         0x0100
+#define MESSAGEQ_WINDOWMASK          0x00FF
+#define MESSAGEQ_CREDITSSHIFT        8
 
-/* More magic rpmsg port numbers: */
-#define MESSAGEQ_RPMSG_PORT       61
-#define MESSAGEQ_RPMSG_MAXSIZE   512
+/* Messages turned into descriptors per transport put */
+#define MESSAGEQ_DESCBATCHMAX        32
+
+/* Usecs MessageQ_put() waits for room at a destination that has filled up */
+#define MESSAGEQ_PUTTIMEOUT          1000000
 
 /* Trace flag settings: */
 #define TRACESHIFT    12
@@ -118,12 +165,88 @@ typedef struct MessageQ_ModuleObject {
     /*!< Handle of gate to be used for local thread safety */
     MessageQ_Params     defaultInstParams;
     /*!< Default instance creation parameters */
-    int                 sock[MultiProc_MAXPROCESSORS];
-    /*!< Sockets to for sending to each remote processor */
+    IMessageQTransport_Handle transports[MultiProc_MAXPROCESSORS];
+    /*!< Transport registered for each processor, or NULL */
     int                 seqNum;
     /*!< Process-specific sequence number */
+    struct MessageQ_Object_tag **queues;
+    /*!< Queues created by this process, indexed by queueIndex */
+    UInt32              numQueues;
+    /*!< Number of entries in queues[] */
+    pthread_rwlock_t    queuesLock;
+    /*!< Read-held by local senders, write-held to change queues[] */
 } MessageQ_ModuleObject;
 
+/*
+ *  Hidden prefix in front of every MessageQ_alloc() message, recording the
+ *  pool and size class the block came from.  The message header itself is
+ *  sent over the wire, so it can't carry this.
+ */
+typedef union MessageQ_PoolBlock_tag {
+    struct {
+        union MessageQ_PoolBlock_tag *next;
+        /* Free list link while cached, local queue link while queued */
+        UInt16              heap;
+        /* Index of the owning pool */
+        UInt16              sizeClass;
+        /* Size class, MessageQ_POOL_NOCLASS if malloc'd to size, or
+         * MessageQ_POOL_SHARED if from a shared heap */
+        UInt32              offset;
+        /* Shared heap only: offset of the message from the heap's base */
+    } hdr;
+    uint64_t                align;
+} MessageQ_PoolBlock;
+
+/*
+ *  Start of a shared heap file.  The blocks follow at blocksOffset, each a
+ *  MessageQ_PoolBlock prefix and the message, so messages from a shared
+ *  heap go through the same free and local queue paths as any other.
+ */
+typedef struct MessageQ_SharedHeap_tag {
+    UInt32                  magic;
+    UInt32                  blockSize;
+    /* Largest message a block holds */
+    UInt32                  blockStride;
+    /* Bytes from one block to the next */
+    UInt32                  numBlocks;
+    UInt32                  blocksOffset;
+    /* Offset of the first block from the start of the file */
+    UInt32                  attachCount;
+    /* Processes that registered the heap; changed under flock() */
+    volatile uint64_t       freeHead;
+    /* Free list: ABA tag in the upper half, block index + 1 in the lower */
+    volatile UInt32         freeNext[];
+    /* Free list links, block index + 1, or 0 at the end */
+} MessageQ_SharedHeap;
+
+/*
+ *  Layout of a shared heap, copied from its header once checked when this
+ *  process mapped it.  The header in the file isn't trusted after that.
+ */
+typedef struct MessageQ_SharedGeometry_tag {
+    UInt32                  blockSize;
+    UInt32                  blockStride;
+    UInt32                  numBlocks;
+    UInt32                  blocksOffset;
+} MessageQ_SharedGeometry;
+
+/* Sent in place of a message from a shared heap; see descriptorPut() */
+typedef struct MessageQ_Descriptor_tag {
+    MessageQ_MsgHeader      header;
+    UInt32                  offset;
+    /* Offset of the message from the heap's base */
+    UInt32                  size;
+    /* Size of the message */
+} MessageQ_Descriptor;
+
+/* Receive endpoint of one MessageQ on one transport */
+typedef struct MessageQ_Endpoint_tag {
+    IMessageQTransport_Handle transport;
+    /* Transport the endpoint was opened on, or NULL if none */
+    Ptr                     endpoint;
+    /* Transport-specific endpoint state */
+} MessageQ_Endpoint;
+
 /*!
  *  @brief  Structure for the Handle for the MessageQ.
  */
@@ -132,13 +255,73 @@ typedef struct MessageQ_Object_tag {
     /*! Instance specific creation parameters */
     MessageQ_QueueId        queue;
     /* Unique id */
-    int                     fd[MultiProc_MAXPROCESSORS];
-    /* File Descriptor to block on messages from remote processors. */
+    MessageQ_Endpoint       ep[MultiProc_MAXPROCESSORS];
+    /* Endpoints receiving messages from each processor */
     int                     unblockFd;
-    /* Write this fd to unblock the select() call in MessageQ _get() */
+    /* Write this fd to unblock the epoll_wait() call in MessageQ _get() */
+    Bool                    unblocked;
+    /* Set by MessageQ_unblock(), checked by MessageQ_get() */
+    int                     epollFd;
+    /* Persistent epoll set holding the endpoints, unblockFd and localFd */
+    int                     localFd;
+    /* eventfd signaled when the local queue goes from idle to busy */
+    UInt32                  localSignaled;
+    /* Set while a wakeup is pending on localFd */
+    MessageQ_PoolBlock      *localHead;
+    /* Local queue: consumer end, touched under localGate */
+    MessageQ_PoolBlock      *localTail;
+    /* Local queue: producer end, swapped atomically by senders */
+    MessageQ_PoolBlock      localStub;
+    /* Local queue: stub node, so the queue is never truly empty */
+    pthread_mutex_t         localGate;
+    /* Serializes receivers popping the local queue and the stage lists */
+    MessageQ_PoolBlock      *stageHead[2];
+    /* Received messages sorted by priority, waiting for MessageQ_get() */
+    MessageQ_PoolBlock      *stageTail[2];
+    /* Tails of the stage lists */
+    UInt32                  creditsOwed[MultiProc_MAXPROCESSORS];
+    /* Credits owed to each processor's MessageQ_putWait() */
     void                    *serverHandle;
 } MessageQ_Object;
 
+/* Module-wide state of one message pool */
+typedef struct MessageQ_Pool_tag {
+    Bool                    registered;
+    /* Set when the pool serves its heapId */
+    UInt32                  cacheDepth;
+    /* Max blocks cached per class, per thread */
+    UInt32                  hits;
+    /* Hits folded in from exited threads */
+    UInt32                  misses;
+    /* Misses folded in from exited threads */
+    UInt32                  inUse;
+    /* Outstanding messages (updated atomically) */
+    UInt32                  highWater;
+    /* Max of inUse (updated atomically) */
+    Bool                    shared;
+    /* Set when registered as a shared heap, so alloc draws from it */
+    MessageQ_SharedHeap     *sharedBase;
+    /* Mapping of the shared heap file, also set on receiving a descriptor */
+    SizeT                   sharedSize;
+    /* Size of that mapping */
+    int                     sharedFd;
+    /* Heap file, held open while the heap is registered as shared */
+    MessageQ_SharedGeometry sharedGeom;
+    /* Layout of that mapping */
+} MessageQ_Pool;
+
+/* Per-thread free lists; only ever touched by the owning thread */
+typedef struct MessageQ_PoolCache_tag {
+    MessageQ_PoolBlock      *head[MessageQ_POOL_MAXHEAPS]
+                                 [MessageQ_POOL_NUMCLASSES];
+    UInt32                  depth[MessageQ_POOL_MAXHEAPS]
+                                 [MessageQ_POOL_NUMCLASSES];
+    UInt32                  hits[MessageQ_POOL_MAXHEAPS];
+    UInt32                  misses[MessageQ_POOL_MAXHEAPS];
+    struct MessageQ_PoolCache_tag *next;
+    /* Link in the list of live caches, walked by MessageQ_getPoolStats() */
+} MessageQ_PoolCache;
+
 static Bool verbose = FALSE;
 
 
@@ -150,6 +333,10 @@ static MessageQ_ModuleObject MessageQ_state =
 {
     .refCount               = 0,
     .nameServer             = NULL,
+    .queues                 = NULL,
+    .numQueues              = 0,
+    .queuesLock             = PTHREAD_RWLOCK_INITIALIZER,
+    .gate                   = PTHREAD_MUTEX_INITIALIZER,
 };
 
 /*!
@@ -159,17 +346,65 @@ static MessageQ_ModuleObject MessageQ_state =
  */
 MessageQ_ModuleObject * MessageQ_module = &MessageQ_state;
 
+/* Message pools, indexed by heapId.  Pool 0 is the default. */
+static MessageQ_Pool MessageQ_pools[MessageQ_POOL_MAXHEAPS] = {
+    [0] = {
+        .registered         = TRUE,
+        .cacheDepth         = MessageQ_POOL_CACHEDEPTH,
+    },
+};
+
+/* Guards pool registration and the list of per-thread caches */
+static pthread_mutex_t MessageQ_poolGate = PTHREAD_MUTEX_INITIALIZER;
+static MessageQ_PoolCache * MessageQ_poolCacheList = NULL;
+static pthread_key_t MessageQ_poolKey;
+static pthread_once_t MessageQ_poolOnce = PTHREAD_ONCE_INIT;
+static __thread MessageQ_PoolCache * MessageQ_poolCache = NULL;
+
 
 /* =============================================================================
  * Forward declarations of internal functions
  * =============================================================================
  */
 
-/* This is a helper function to initialize a message. */
-static Int transportCreateEndpoint(int * fd, UInt16 rprocId, UInt16 queueIndex);
-static Int transportCloseEndpoint(int fd);
-static Int transportGet(int sock, MessageQ_Msg * retMsg);
-static Int transportPut(MessageQ_Msg msg, UInt16 dstId, UInt16 dstProcId);
+static Int transportPut(MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId,
+        UInt timeout);
+static Int transportGet(MessageQ_Object * obj, UInt16 rprocId,
+        MessageQ_Msg msgs[], UInt maxMsgs);
+static Void openEndpoints(IMessageQTransport_Handle transport,
+        UInt16 rprocId);
+
+static MessageQ_Msg poolAlloc(UInt16 heapId, UInt32 size);
+static Void poolFree(MessageQ_Msg msg);
+static Void poolInUse(MessageQ_Pool * pool);
+
+static MessageQ_SharedHeap * sharedMap(UInt16 heapId,
+        const MessageQ_PoolParams * params, SizeT * size, int * fd,
+        MessageQ_SharedGeometry * geom);
+static Void sharedUnmap(UInt16 heapId);
+static MessageQ_PoolBlock * sharedAlloc(MessageQ_Pool * pool, UInt32 size);
+static Void sharedFree(MessageQ_Pool * pool, MessageQ_PoolBlock * blk);
+static Int descriptorPut(IMessageQTransport_Handle transport,
+        MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId, UInt timeout);
+static MessageQ_Msg descriptorGet(MessageQ_Descriptor * desc);
+
+static Int localAdd(MessageQ_Object * obj);
+static Void localRemove(MessageQ_Object * obj);
+static Int localPut(UInt16 queueIndex, MessageQ_Msg msgs[], UInt numMsgs);
+static UInt localGet(MessageQ_Object * obj, MessageQ_Msg msgs[], UInt maxMsgs);
+static Void localSignal(MessageQ_Object * obj);
+static Void localAck(MessageQ_Object * obj);
+static Int receive(MessageQ_Object * obj, MessageQ_Msg msgs[], UInt maxMsgs,
+                   UInt timeout);
+static Void stagePut(MessageQ_Object * obj, MessageQ_Msg msgs[],
+                     UInt numMsgs);
+static UInt stageGet(MessageQ_Object * obj, MessageQ_Msg msgs[],
+                     UInt maxMsgs);
+static Void stageFill(MessageQ_Object * obj, struct epoll_event events[],
+                      int numEvents);
+static int waitRemaining(const struct timespec * start, int waitMs);
+static Void creditReturn(MessageQ_Object * obj, MessageQ_Msg msgs[],
+                         UInt numMsgs);
 
 /* =============================================================================
  * APIS
@@ -227,7 +462,6 @@ Int MessageQ_setup(const MessageQ_Config * cfg)
     LAD_ClientHandle handle;
     struct LAD_CommandObj cmd;
     union LAD_ResponseObj rsp;
-    Int i;
 
     handle = LAD_findHandle();
     if (handle == LAD_MAXNUMCLIENTS) {
@@ -261,21 +495,18 @@ Int MessageQ_setup(const MessageQ_Config * cfg)
     MessageQ_module->nameServer = rsp.setup.nameServerHandle;
     MessageQ_module->seqNum = 0;
 
-    /* Create a default local gate. */
-    pthread_mutex_init (&(MessageQ_module->gate), NULL);
-
-    /* Clear sockets array. */
-    for (i = 0; i < MultiProc_MAXPROCESSORS; i++) {
-        MessageQ_module->sock[i] = Transport_INVALIDSOCKET;
-    }
+    /*
+     * The gate is statically initialized, since transports may be
+     * registered before MessageQ_setup().
+     */
 
     return status;
 }
 
 /*
  * Function to destroy the MessageQ module.
- * Destroys socket/protocol maps;  sockets themselves should have been
- * destroyed in MessageQ_delete() and MessageQ_detach() calls.
+ * Endpoints and transport connections should already have been
+ * closed in MessageQ_delete() and MessageQ_detach() calls.
  */
 Int MessageQ_destroy (void)
 {
@@ -327,19 +558,22 @@ Void MessageQ_Params_init (MessageQ_Params * params)
 /*
  *   Function to create a MessageQ object for receiving.
  *
- *   Create a socket and bind the source address (local ProcId/MessageQ ID) in
- *   order to get messages dispatched to this messageQ.
+ *   Open an endpoint on each registered transport, to get messages from
+ *   that processor dispatched to this messageQ.
  */
 MessageQ_Handle MessageQ_create (String name, const MessageQ_Params * params)
 {
     Int                   status;
     MessageQ_Object *     obj    = NULL;
     UInt16                queueIndex = 0u;
-    UInt16                procId;
     UInt16                rprocId;
+    IMessageQTransport_Handle transport;
+    int                   fd;
+    int                   endpointFound = 0;
     LAD_ClientHandle      handle;
     struct LAD_CommandObj cmd;
     union LAD_ResponseObj rsp;
+    struct epoll_event    event;
 
     handle = LAD_findHandle();
     if (handle == LAD_MAXNUMCLIENTS) {
@@ -390,53 +624,99 @@ MessageQ_Handle MessageQ_create (String name, const MessageQ_Params * params)
         memcpy((Ptr) &obj->params, (Ptr)params, sizeof (MessageQ_Params));
     }
 
-    procId = MultiProc_self();
     queueIndex = (MessageQ_QueueIndex)rsp.messageQCreate.queueId;
     obj->queue = rsp.messageQCreate.queueId;
     obj->serverHandle = rsp.messageQCreate.serverHandle;
+    obj->unblocked = FALSE;
+    obj->unblockFd = -1;
+    obj->localFd = -1;
+    obj->localHead = &obj->localStub;
+    obj->localTail = &obj->localStub;
+    pthread_mutex_init(&obj->localGate, NULL);
+
+    /*
+     * Create the epoll set that MessageQ_get() waits on.  The receive
+     * endpoints and the unblock event are added once here, instead of
+     * rebuilding an fd_set on every MessageQ_get() call.
+     */
+    obj->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (obj->epollFd == -1) {
+        printf ("MessageQ_create: epoll_create1 failed: %d, %s\n",
+                   errno, strerror(errno));
+    }
 
     /*
-     * Create a set of communication endpoints (one per each remote proc),
-     * and return the socket as target for MessageQ_put() calls, and as
-     * a file descriptor to close during MessageQ_delete().
+     * Create a set of communication endpoints (one per processor with a
+     * registered transport; for our own processor, that is the transport
+     * to other processes), and add the fd of each to the epoll set.  The
+     * gate guards ep[] against openEndpoints() once the queue is in the
+     * table.
      */
+    pthread_mutex_lock(&MessageQ_module->gate);
     for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
-        obj->fd[rprocId] = Transport_INVALIDSOCKET;
-        if (procId == rprocId) {
-            /* Skip creating an endpoint for ourself. */
+        transport = MessageQ_module->transports[rprocId];
+        if (transport == NULL) {
             continue;
         }
 
         PRINTVERBOSE3("MessageQ_create: creating endpoint for: %s, rprocId: %d, queueIndex: %d\n", name, rprocId, queueIndex)
 
-        status = transportCreateEndpoint(&obj->fd[rprocId], rprocId,
-                                           queueIndex);
-        if (status < 0) {
-           obj->fd[rprocId] = Transport_INVALIDSOCKET;
+        status = transport->fxns->openEndpoint(transport, obj->queue, rprocId,
+                                               &obj->ep[rprocId].endpoint, &fd);
+        if (status >= 0) {
+            obj->ep[rprocId].transport = transport;
+            endpointFound = 1;
+            if (obj->epollFd != -1) {
+                event.events = EPOLLIN;
+                event.data.u32 = rprocId;
+                epoll_ctl(obj->epollFd, EPOLL_CTL_ADD, fd, &event);
+            }
         }
     }
+    pthread_mutex_unlock(&MessageQ_module->gate);
 
     /*
      * Now, to support MessageQ_unblock() functionality, create an event object.
-     * Writing to this event will unblock the select() call in MessageQ_get().
+     * Writing to this event will unblock the epoll_wait() call in
+     * MessageQ_get().
      */
     obj->unblockFd = eventfd(0, 0);
-    if (obj->unblockFd == -1)  {
+    if (obj->unblockFd != -1 && obj->epollFd != -1) {
+        event.events = EPOLLIN;
+        event.data.u32 = MESSAGEQ_UNBLOCKTAG;
+        epoll_ctl(obj->epollFd, EPOLL_CTL_ADD, obj->unblockFd, &event);
+    }
+
+    /*
+     * Senders in this process deliver straight to the local queue, and
+     * signal this event when it goes from idle to busy.  It is edge
+     * triggered, so every write wakes a waiter and the count never needs
+     * to be read back.
+     */
+    obj->localFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (obj->localFd != -1 && obj->epollFd != -1) {
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u32 = MESSAGEQ_LOCALTAG;
+        epoll_ctl(obj->epollFd, EPOLL_CTL_ADD, obj->localFd, &event);
+    }
+
+    if (obj->unblockFd == -1 || obj->epollFd == -1 || obj->localFd == -1)  {
         printf ("MessageQ_create: eventfd creation failed: %d, %s\n",
                    errno, strerror(errno));
         MessageQ_delete((MessageQ_Handle *)&obj);
     }
+    else if (localAdd(obj) < 0) {
+        printf ("MessageQ_create: local queue table full\n");
+        MessageQ_delete((MessageQ_Handle *)&obj);
+    }
     else {
-        int endpointFound = 0;
-
-        for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
-            if (obj->fd[rprocId] != Transport_INVALIDSOCKET) {
-                endpointFound = 1;
-            }
-        }
+        /*
+         * A queue with no remote endpoints is still reachable by senders
+         * in this process, so it is kept.
+         */
         if (!endpointFound) {
-            printf("MessageQ_create: no transport endpoints found, deleting\n");
-            MessageQ_delete((MessageQ_Handle *)&obj);
+            PRINTVERBOSE0("MessageQ_create: no transport endpoints found, "
+                          "queue is local only\n")
         }
     }
 
@@ -446,7 +726,7 @@ MessageQ_Handle MessageQ_create (String name, const MessageQ_Params * params)
 /*
  * Function to delete a MessageQ object for a specific slave processor.
  *
- * Deletes the socket associated with this MessageQ object.
+ * Closes the transport endpoints of this MessageQ object.
  */
 Int MessageQ_delete (MessageQ_Handle * handlePtr)
 {
@@ -489,13 +769,29 @@ Int MessageQ_delete (MessageQ_Handle * handlePtr)
       handle, status)
 
 
-    /* Close the event used for MessageQ_unblock(): */
-    close(obj->unblockFd);
+    /* Stop local delivery, and free anything still queued locally: */
+    localRemove(obj);
+    if (obj->localFd != -1) {
+        close(obj->localFd);
+    }
+    pthread_mutex_destroy(&obj->localGate);
+
+    /* Close the event used for MessageQ_unblock(), and the epoll set: */
+    if (obj->unblockFd != -1) {
+        close(obj->unblockFd);
+    }
+    if (obj->epollFd != -1) {
+        close(obj->epollFd);
+    }
 
-    /* Close the communication endpoint: */
+    /*
+     * Close the communication endpoints.  The queue is out of the table,
+     * so openEndpoints() can't be adding to ep[] any more.
+     */
     for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
-        if (obj->fd[rprocId] != Transport_INVALIDSOCKET) {
-            status = transportCloseEndpoint(obj->fd[rprocId]);
+        if (obj->ep[rprocId].transport != NULL) {
+            obj->ep[rprocId].transport->fxns->closeEndpoint(
+                    obj->ep[rprocId].transport, obj->ep[rprocId].endpoint);
         }
     }
 
@@ -509,9 +805,9 @@ Int MessageQ_delete (MessageQ_Handle * handlePtr)
 /*
  *  Opens an instance of MessageQ for sending.
  *
- *  We need not create a socket here; the sockets for all remote processors
- *  were created during MessageQ_attach(), and will be
- *  retrieved during MessageQ_put().
+ *  We need not create anything here; the transports to all processors
+ *  were attached during MessageQ_attach(), and will be
+ *  used during MessageQ_put().
  */
 Int MessageQ_open (String name, MessageQ_QueueId * queueId)
 {
@@ -544,6 +840,36 @@ Int MessageQ_open (String name, MessageQ_QueueId * queueId)
     return (status);
 }
 
+/*
+ * Opens an instance of MessageQ, waiting for it to be created.  LAD
+ * answers as soon as the name is added, so this doesn't poll.
+ */
+Int MessageQ_openWait(String name, MessageQ_QueueId * queueId, UInt timeout)
+{
+    Int status;
+
+    status = NameServer_watch(MessageQ_module->nameServer, name, queueId,
+                              timeout);
+
+    if (status >= 0) {
+        /* Override with a MessageQ status code. */
+        status = MessageQ_S_SUCCESS;
+    }
+    else {
+        /* Set return queue ID to invalid. */
+        *queueId = MessageQ_INVALIDMESSAGEQ;
+        /* Override with a MessageQ status code. */
+        if (status == NameServer_E_TIMEOUT) {
+            status = MessageQ_E_TIMEOUT;
+        }
+        else {
+            status = MessageQ_E_FAIL;
+        }
+    }
+
+    return (status);
+}
+
 /* Closes previously opened instance of MessageQ module. */
 Int MessageQ_close (MessageQ_QueueId * queueId)
 {
@@ -558,23 +884,34 @@ Int MessageQ_close (MessageQ_QueueId * queueId)
 /*
  * Place a message onto a message queue.
  *
- * Calls TransportShm_put(), which handles the sending of the message using the
- * appropriate kernel interface (socket, device ioctl) call for the remote
- * procId encoded in the queueId argument.
+ * If the destination queue was created by this process, the message pointer
+ * is handed straight to its local queue.  Otherwise, calls transportPut(),
+ * which hands the message to the transport registered for the procId
+ * encoded in the queueId argument.  This is a copy transport, so the
+ * message is freed even if it could not be sent.  A destination that has
+ * filled up holds the put for up to MESSAGEQ_PUTTIMEOUT.
  *
  */
 Int MessageQ_put (MessageQ_QueueId queueId, MessageQ_Msg msg)
 {
-    Int      status;
+    Int      count = -1;
     UInt16   dstProcId  = (UInt16)(queueId >> 16);
     UInt16   queueIndex = (MessageQ_QueueIndex)(queueId & 0x0000ffff);
 
     msg->dstId     = queueIndex;
     msg->dstProc   = dstProcId;
 
-    status = transportPut(msg, queueIndex, dstProcId);
+    if (dstProcId == MultiProc_self()) {
+        count = localPut(queueIndex, &msg, 1);
+    }
+    if (count < 0) {
+        count = transportPut(&msg, 1, dstProcId, MESSAGEQ_PUTTIMEOUT);
+        if (count != 1) {
+            MessageQ_free(msg);
+        }
+    }
 
-    return (status);
+    return ((count == 1) ? MessageQ_S_SUCCESS : MessageQ_E_FAIL);
 }
 
 /*
@@ -583,101 +920,127 @@ Int MessageQ_put (MessageQ_QueueId queueId, MessageQ_Msg msg)
  * waiting for a message to arrive.
  * When a message is returned, it is owned by the caller.
  *
- * We block using select() on the receiving socket's file descriptor, then
- * get the waiting message via the socket API recvfrom().
- * We use the socket stored in the messageQ object via a previous call to
- * MessageQ_create().
- *
+ * Messages are returned by priority, as on BIOS: urgent and high priority
+ * messages before normal and reserved ones, and an urgent message ahead of
+ * everything else.  See receive() for how they are gathered.
  */
 Int MessageQ_get (MessageQ_Handle handle, MessageQ_Msg * msg ,UInt timeout)
 {
-    static int last = 0;
-    Int     status = MessageQ_S_SUCCESS;
-    Int     tmpStatus;
+    Int     status;
     MessageQ_Object * obj = (MessageQ_Object *) handle;
-    int     retval;
-    int     nfds;
-    fd_set  rfds;
-    struct  timeval tv;
-    void    *timevalPtr;
-    UInt16  rprocId;
-    int     maxfd = 0;
-    int     selfId;
-    int     nProcessors;
-
-    /* Wait (with timeout) and retreive message from socket: */
-    FD_ZERO(&rfds);
-    for (rprocId = 0; rprocId < MultiProc_getNumProcessors(); rprocId++) {
-        if (rprocId == MultiProc_self() ||
-            obj->fd[rprocId] == Transport_INVALIDSOCKET) {
-            continue;
-        }
-        maxfd = MAX(maxfd, obj->fd[rprocId]);
-        FD_SET(obj->fd[rprocId], &rfds);
+
+    *msg = NULL;
+
+    status = receive(obj, msg, 1, timeout);
+    if (status == 1) {
+        creditReturn(obj, msg, 1);
     }
 
-    /* Wait also on the event fd, which may be written by MessageQ_unblock(): */
-    FD_SET(obj->unblockFd, &rfds);
+    return ((status == 1) ? MessageQ_S_SUCCESS : status);
+}
 
-    if (timeout == MessageQ_FOREVER) {
-        timevalPtr = NULL;
+/*
+ * Gets a message only if one is already waiting.
+ *
+ * This is MessageQ_get() with no wait: the stage lists are checked, then
+ * the epoll set is polled.  A poll that finds only a stale local wakeup
+ * acknowledges it, so the fd from MessageQ_getFd() stops polling readable
+ * once the queue is drained.
+ */
+Int MessageQ_tryGet (MessageQ_Handle handle, MessageQ_Msg * msg)
+{
+    return (MessageQ_get(handle, msg, 0));
+}
+
+/*
+ * Place a message onto a message queue, waiting for room.
+ *
+ * No credits are taken, as documented in MessageQ.h.  Instead, timeout
+ * bounds the transport's own wait for room: the shared memory ring of
+ * another process's queue is waited on for up to timeout, and a message
+ * still without room is left with the caller.  The rpmsg driver blocks
+ * until the remote processor has a buffer free, whatever the timeout.
+ */
+Int MessageQ_putWait (MessageQ_QueueId queueId, MessageQ_Msg msg,
+                      UInt timeout)
+{
+    Int      count = -1;
+    UInt16   dstProcId  = (UInt16)(queueId >> 16);
+    UInt16   queueIndex = (MessageQ_QueueIndex)(queueId & 0x0000ffff);
+
+    msg->dstId     = queueIndex;
+    msg->dstProc   = dstProcId;
+
+    if (dstProcId == MultiProc_self()) {
+        count = localPut(queueIndex, &msg, 1);
     }
-    else {
-        /* Timeout given in msec: convert:  */
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        timevalPtr = &tv;
+    if (count < 0) {
+        count = transportPut(&msg, 1, dstProcId, timeout);
+        if (count == MessageQ_E_TIMEOUT) {
+            return (MessageQ_E_TIMEOUT);
+        }
+        if (count != 1) {
+            MessageQ_free(msg);
+        }
     }
-    /* Add one to last fd created: */
-    nfds = MAX(maxfd, obj->unblockFd) + 1;
 
-    retval = select(nfds, &rfds, NULL, NULL, timevalPtr);
-    if (retval)  {
-        if (FD_ISSET(obj->unblockFd, &rfds))  {
-            /*
-             * Our event was signalled by MessageQ_unblock().
-             *
-             * This is typically done during a shutdown sequence, where
-             * the intention of the client would be to ignore (i.e. not fetch)
-             * any pending messages in the transport's queue.
-             * Thus, we shall not check for nor return any messages.
-             */
-            *msg = NULL;
-            status = MessageQ_E_UNBLOCKED;
-        }
-        else {
-	    /* start where we last left off */
-	    rprocId = last;
+    return ((count == 1) ? MessageQ_S_SUCCESS : MessageQ_E_FAIL);
+}
+
+/*
+ * Place a burst of messages onto a message queue.
+ *
+ * A burst for a queue in this process is linked onto its local queue with
+ * at most one wakeup.  Otherwise all messages go to the same processor, so
+ * the whole burst is handed to its transport in one call (for rpmsg, one
+ * sendmmsg() per batch instead of one send() each).
+ */
+Int MessageQ_putMany (MessageQ_QueueId queueId, MessageQ_Msg msgs[],
+                      UInt numMsgs)
+{
+    Int      count = -1;
+    UInt     i;
+    UInt16   dstProcId  = (UInt16)(queueId >> 16);
+    UInt16   queueIndex = (MessageQ_QueueIndex)(queueId & 0x0000ffff);
 
-	    selfId = MultiProc_self();
-	    nProcessors = MultiProc_getNumProcessors();
+    for (i = 0; i < numMsgs; i++) {
+        msgs[i]->dstId   = queueIndex;
+        msgs[i]->dstProc = dstProcId;
+    }
 
-	    do {
-                if (rprocId != selfId &&
-                    obj->fd[rprocId] != Transport_INVALIDSOCKET) {
+    if (dstProcId == MultiProc_self()) {
+        count = localPut(queueIndex, msgs, numMsgs);
+    }
+    if (count < 0) {
+        count = transportPut(msgs, numMsgs, dstProcId, MESSAGEQ_PUTTIMEOUT);
+    }
 
-		    if (FD_ISSET(obj->fd[rprocId], &rfds)) {
-			/* Our transport's fd was signalled: Get the message */
-			tmpStatus = transportGet(obj->fd[rprocId], msg);
-			if (tmpStatus < 0) {
-			    printf ("MessageQ_get: tranposrtshm_get failed.");
-			    status = MessageQ_E_FAIL;
-			}
+    return ((count <= 0 && numMsgs > 0) ? MessageQ_E_FAIL : count);
+}
 
-			last = (rprocId + 1) % nProcessors;
-			break;
-		    }
-                }
-		rprocId = (rprocId + 1) % nProcessors;
-            } while (rprocId != last);
-        }
+/*
+ * Gets a burst of messages for a message queue.
+ *
+ * Blocks like MessageQ_get() until at least one message is waiting, then
+ * returns up to maxMsgs of them, highest priority first.  An unblock
+ * event takes precedence over any pending messages, as in MessageQ_get().
+ */
+Int MessageQ_getMany (MessageQ_Handle handle, MessageQ_Msg msgs[],
+                      UInt maxMsgs, UInt timeout)
+{
+    MessageQ_Object * obj = (MessageQ_Object *) handle;
+    Int     count;
+
+    if (maxMsgs == 0) {
+        return (MessageQ_E_FAIL);
     }
-    else if (retval == 0) {
-        *msg = NULL;
-        status = MessageQ_E_TIMEOUT;
+
+    count = receive(obj, msgs, maxMsgs, timeout);
+    if (count > 0) {
+        creditReturn(obj, msgs, (UInt)count);
     }
 
-    return (status);
+    return (count);
 }
 
 /*
@@ -721,6 +1084,9 @@ Void MessageQ_staticMsgInit (MessageQ_Msg msg, UInt32 size)
  * Allocate a message and initialize the needed fields (note some
  * of the fields in the header are set via other APIs or in the
  * MessageQ_put function,
+ *
+ * Messages come from the pool registered for heapId (see poolAlloc()), so
+ * only the header is cleared, not the payload.
  */
 MessageQ_Msg MessageQ_alloc (UInt16 heapId, UInt32 size)
 {
@@ -730,7 +1096,12 @@ MessageQ_Msg MessageQ_alloc (UInt16 heapId, UInt32 size)
      * heapId not used for local alloc (as this is over a copy transport), but
      * we need to send to other side as heapId is used in BIOS transport:
      */
-    msg = (MessageQ_Msg)calloc (1, size);
+    msg = poolAlloc(heapId, size);
+    if (msg == NULL) {
+        return (NULL);
+    }
+
+    memset(msg, 0, sizeof(MessageQ_MsgHeader));
     MessageQ_msgInit (msg);
     msg->msgSize = size;
     msg->heapId  = heapId;
@@ -748,32 +1119,153 @@ Int MessageQ_free (MessageQ_Msg msg)
         status =  MessageQ_E_CANNOTFREESTATICMSG;
     }
     else {
-        free (msg);
+        poolFree(msg);
     }
 
     return status;
 }
 
-/* Register a heap with MessageQ. */
+/* Initialize MessageQ_PoolParams with the default pool settings. */
+Void MessageQ_PoolParams_init (MessageQ_PoolParams * params)
+{
+    params->cacheDepth = MessageQ_POOL_CACHEDEPTH;
+    params->sharedBlockSize = 0;
+    params->sharedNumBlocks = 0;
+}
+
+/*
+ * Register a heap with MessageQ.
+ *
+ * This uses a copy transport, so there is no real heap behind a heapId.
+ * Registering one gives the heapId a dedicated message pool, configured by
+ * the MessageQ_PoolParams pointed to by 'heap' (or defaults if NULL).
+ *
+ * With params->sharedBlockSize set, the heapId is instead a shared heap:
+ * a file mapped by every process that registers the same heapId, created
+ * by the first.  Messages from it are passed to other processes on this
+ * processor as descriptors, without copying.
+ */
 Int MessageQ_registerHeap (Ptr heap, UInt16 heapId)
 {
     Int  status = MessageQ_S_SUCCESS;
+    MessageQ_PoolParams * params = (MessageQ_PoolParams *)heap;
+    MessageQ_SharedHeap * shared;
+    MessageQ_SharedGeometry geom;
+    MessageQ_Pool * pool;
+    SizeT size;
+    int fd;
+
+    if (heapId == 0 || heapId >= MessageQ_POOL_MAXHEAPS) {
+        return (MessageQ_E_INVALIDHEAPID);
+    }
+
+    pthread_mutex_lock(&MessageQ_poolGate);
+
+    pool = &MessageQ_pools[heapId];
+    if (pool->registered) {
+        status = MessageQ_E_ALREADYEXISTS;
+    }
+    else if (params != NULL && params->sharedBlockSize > 0) {
+        shared = sharedMap(heapId, params, &size, &fd, &geom);
+        if (shared == NULL) {
+            status = MessageQ_E_FAIL;
+        }
+        else {
+            /*
+             * Messages received as descriptors may lie in a mapping made
+             * for them.  It is of the same file, so keep it instead.
+             */
+            if (pool->sharedBase != NULL) {
+                munmap(shared, size);
+                shared = pool->sharedBase;
+                size = pool->sharedSize;
+                geom = pool->sharedGeom;
+            }
+            pool->sharedGeom = geom;
+            pool->sharedBase = shared;
+            pool->sharedSize = size;
+            pool->sharedFd = fd;
+            pool->shared = TRUE;
+            pool->registered = TRUE;
+        }
+    }
+    else {
+        pool->cacheDepth = (params != NULL) ? params->cacheDepth :
+                                              MessageQ_POOL_CACHEDEPTH;
+        pool->registered = TRUE;
+    }
 
-    /* Do nothing, as this uses a copy transport: */
+    pthread_mutex_unlock(&MessageQ_poolGate);
 
     return status;
 }
 
-/* Unregister a heap with MessageQ. */
+/*
+ * Unregister a heap with MessageQ.
+ *
+ * Subsequent allocations for heapId come from the default pool.  Messages
+ * still outstanding from the old pool are released to the system allocator
+ * when freed.  A shared heap can't be unregistered while messages from it
+ * are outstanding, since they lie in its mapping; its file is removed once
+ * no process has it registered.
+ */
 Int MessageQ_unregisterHeap (UInt16 heapId)
 {
     Int  status = MessageQ_S_SUCCESS;
 
-    /* Do nothing, as this uses a copy transport: */
+    if (heapId == 0 || heapId >= MessageQ_POOL_MAXHEAPS) {
+        return (MessageQ_E_INVALIDHEAPID);
+    }
+
+    pthread_mutex_lock(&MessageQ_poolGate);
+
+    if (!MessageQ_pools[heapId].registered) {
+        status = MessageQ_E_NOTFOUND;
+    }
+    else if (MessageQ_pools[heapId].shared &&
+             __sync_fetch_and_add(&MessageQ_pools[heapId].inUse, 0) != 0) {
+        status = MessageQ_E_INVALIDSTATE;
+    }
+    else {
+        MessageQ_pools[heapId].registered = FALSE;
+        if (MessageQ_pools[heapId].shared) {
+            sharedUnmap(heapId);
+        }
+    }
+
+    pthread_mutex_unlock(&MessageQ_poolGate);
 
     return status;
 }
 
+/* Retrieve the allocation statistics of the pool serving heapId. */
+Int MessageQ_getPoolStats (UInt16 heapId, MessageQ_PoolStats * stats)
+{
+    MessageQ_Pool * pool;
+    MessageQ_PoolCache * cache;
+
+    if (heapId >= MessageQ_POOL_MAXHEAPS ||
+        !MessageQ_pools[heapId].registered) {
+        heapId = 0;
+    }
+    pool = &MessageQ_pools[heapId];
+
+    pthread_mutex_lock(&MessageQ_poolGate);
+
+    stats->hits = pool->hits;
+    stats->misses = pool->misses;
+    for (cache = MessageQ_poolCacheList; cache != NULL; cache = cache->next) {
+        stats->hits += cache->hits[heapId];
+        stats->misses += cache->misses[heapId];
+    }
+    stats->inUse = __sync_fetch_and_add(&pool->inUse, 0);
+    stats->highWater = __sync_fetch_and_add(&pool->highWater, 0);
+
+    pthread_mutex_unlock(&MessageQ_poolGate);
+
+    return (MessageQ_S_SUCCESS);
+}
+
 /* Unblocks a MessageQ */
 Void MessageQ_unblock (MessageQ_Handle handle)
 {
@@ -781,6 +1273,9 @@ Void MessageQ_unblock (MessageQ_Handle handle)
     uint64_t     buf = 1;
     int          numBytes;
 
+    /* Raise the flag first, so a racing MessageQ_get() sees it: */
+    obj->unblocked = TRUE;
+
     /* Write 8 bytes to awaken any threads blocked on this messageQ: */
     numBytes = write(obj->unblockFd, &buf, sizeof(buf));
 }
@@ -805,6 +1300,20 @@ MessageQ_QueueId MessageQ_getQueueId (MessageQ_Handle handle)
     return queueId;
 }
 
+/*
+ * Returns a fd that polls readable while messages are waiting.
+ *
+ * This is the queue's epoll set, which holds its endpoint on every
+ * transport, the local queue's eventfd and the unblock eventfd, so it
+ * also stays readable once MessageQ_unblock() has been called.
+ */
+Int MessageQ_getFd (MessageQ_Handle handle)
+{
+    MessageQ_Object * obj = (MessageQ_Object *) handle;
+
+    return (obj->epollFd);
+}
+
 /* Sets the tracing of a message */
 Void MessageQ_setMsgTrace (MessageQ_Msg msg, Bool traceFlag)
 {
@@ -827,16 +1336,16 @@ SizeT MessageQ_sharedMemReq (Ptr sharedAddr)
 }
 
 /*
- *  Create a socket for this remote proc, and attempt to connect.
+ *  Attach the transport registered for this processor, e.g. connect the
+ *  socket used to send to a remote proc.
  *
- *  Only creates a socket if one does not already exist for this procId.
- *
- *  Note: remoteProcId may be MultiProc_Self() for loopback case.
+ *  Note: remoteProcId may be MultiProc_Self() for loopback case, where the
+ *  transport carries messages between processes on this processor.
  */
 Int MessageQ_attach (UInt16 remoteProcId, Ptr sharedAddr)
 {
     Int     status = MessageQ_S_SUCCESS;
-    int     sock;
+    IMessageQTransport_Handle transport;
 
     PRINTVERBOSE1("MessageQ_attach: remoteProcId: %d\n", remoteProcId)
 
@@ -846,51 +1355,80 @@ Int MessageQ_attach (UInt16 remoteProcId, Ptr sharedAddr)
     }
 
     pthread_mutex_lock (&(MessageQ_module->gate));
+    transport = MessageQ_module->transports[remoteProcId];
+    pthread_mutex_unlock (&(MessageQ_module->gate));
 
-    /* Only create a socket if one doesn't exist: */
-    if (MessageQ_module->sock[remoteProcId] == Transport_INVALIDSOCKET)  {
-        /* Create the socket for sending messages to the remote proc: */
-        sock = socket(AF_RPMSG, SOCK_SEQPACKET, 0);
-        if (sock < 0) {
-            status = MessageQ_E_FAIL;
-            printf ("MessageQ_attach: socket failed: %d, %s\n",
-                       errno, strerror(errno));
-        }
-        else  {
-            PRINTVERBOSE1("MessageQ_attach: created send socket: %d\n", sock)
-            MessageQ_module->sock[remoteProcId] = sock;
-            /* Attempt to connect: */
-            status = ConnectSocket(sock, remoteProcId, MESSAGEQ_RPMSG_PORT);
-            if (status < 0) {
-                status = MessageQ_E_RESOURCE;
-                /* don't hard-printf since this is no longer fatal */
-                PRINTVERBOSE1("MessageQ_attach: ConnectSocket(remoteProcId:%d) failed\n",
-                       remoteProcId);
-            }
-        }
+    if (transport == NULL) {
+        status = MessageQ_E_FAIL;
+        PRINTVERBOSE1("MessageQ_attach: no transport for remoteProcId: %d\n",
+                      remoteProcId)
     }
     else {
-        status = MessageQ_E_ALREADYEXISTS;
+        status = transport->fxns->attach(transport, remoteProcId);
+        if (status >= 0) {
+            openEndpoints(transport, remoteProcId);
+        }
     }
 
-    pthread_mutex_unlock (&(MessageQ_module->gate));
+exit:
+    return (status);
+}
+
+/*
+ * ======== openEndpoints ========
+ *
+ * Give queues created while rprocId was down their endpoints for it, now
+ * that it has been attached, so that it can reach them too.  The module
+ * gate serializes this with MessageQ_create() opening endpoints, and with
+ * another attach; it is taken before queuesLock.
+ */
+static Void openEndpoints(IMessageQTransport_Handle transport, UInt16 rprocId)
+{
+    MessageQ_Object * obj;
+    struct epoll_event event;
+    Ptr endpoint;
+    UInt32 i;
+    int fd;
+
+    pthread_mutex_lock(&MessageQ_module->gate);
+
+    /* Held for reading, deleting a queue waits until this is done with it */
+    pthread_rwlock_rdlock(&MessageQ_module->queuesLock);
+
+    for (i = 0; i < MessageQ_module->numQueues; i++) {
+        obj = MessageQ_module->queues[i];
+        if (obj == NULL || obj->ep[rprocId].transport != NULL) {
+            continue;
+        }
 
-    if (status == MessageQ_E_RESOURCE) {
-        MessageQ_detach(remoteProcId);
+        if (transport->fxns->openEndpoint(transport, obj->queue, rprocId,
+                                          &endpoint, &fd) < 0) {
+            continue;
+        }
+
+        PRINTVERBOSE2("MessageQ_attach: opened endpoint for queueIndex: %d, rprocId: %d\n", i, rprocId)
+
+        obj->ep[rprocId].endpoint = endpoint;
+        obj->ep[rprocId].transport = transport;
+        if (obj->epollFd != -1) {
+            event.events = EPOLLIN;
+            event.data.u32 = rprocId;
+            epoll_ctl(obj->epollFd, EPOLL_CTL_ADD, fd, &event);
+        }
     }
 
-exit:
-    return (status);
+    pthread_rwlock_unlock(&MessageQ_module->queuesLock);
+    pthread_mutex_unlock(&MessageQ_module->gate);
 }
 
 /*
- *  Close the socket for this remote proc.
+ *  Detach the transport for this processor.
  *
  */
 Int MessageQ_detach (UInt16 remoteProcId)
 {
     Int status = MessageQ_S_SUCCESS;
-    int sock;
+    IMessageQTransport_Handle transport;
 
     if (remoteProcId >= MultiProc_MAXPROCESSORS) {
         status = MessageQ_E_INVALIDPROCID;
@@ -898,48 +1436,74 @@ Int MessageQ_detach (UInt16 remoteProcId)
     }
 
     pthread_mutex_lock (&(MessageQ_module->gate));
+    transport = MessageQ_module->transports[remoteProcId];
+    pthread_mutex_unlock (&(MessageQ_module->gate));
 
-    sock = MessageQ_module->sock[remoteProcId];
-    if (sock != Transport_INVALIDSOCKET) {
-        if (close(sock)) {
-            status = MessageQ_E_OSFAILURE;
-            printf("MessageQ_detach: close failed: %d, %s\n",
-                   errno, strerror(errno));
-        }
-        else {
-            PRINTVERBOSE1("MessageQ_detach: closed socket: %d\n", sock)
-            MessageQ_module->sock[remoteProcId] = Transport_INVALIDSOCKET;
-        }
+    if (transport != NULL) {
+        status = transport->fxns->detach(transport, remoteProcId);
     }
 
-    pthread_mutex_unlock (&(MessageQ_module->gate));
-
 exit:
     return (status);
 }
 
 /*
- * This is a helper function to initialize a message.
+ *  Register the transport used to reach rprocId.  Queues created from now
+ *  on open an endpoint on it.  Fails if one is already registered.
  */
-Void MessageQ_msgInit (MessageQ_Msg msg)
+Bool MessageQ_registerTransport (IMessageQTransport_Handle handle,
+                                 UInt16 rprocId)
 {
-#if 0
-    Int                 status    = MessageQ_S_SUCCESS;
-    LAD_ClientHandle handle;
-    struct LAD_CommandObj cmd;
-    union LAD_ResponseObj rsp;
+    Bool registered = FALSE;
 
-    handle = LAD_findHandle();
-    if (handle == LAD_MAXNUMCLIENTS) {
-        PRINTVERBOSE1(
-          "MessageQ_msgInit: can't find connection to daemon for pid %d\n",
-           getpid())
+    if (rprocId >= MultiProc_MAXPROCESSORS) {
+        return (FALSE);
+    }
 
-        return;
+    pthread_mutex_lock (&(MessageQ_module->gate));
+    if (MessageQ_module->transports[rprocId] == NULL) {
+        MessageQ_module->transports[rprocId] = handle;
+        registered = TRUE;
     }
+    pthread_mutex_unlock (&(MessageQ_module->gate));
 
-    cmd.cmd = LAD_MESSAGEQ_MSGINIT;
-    cmd.clientId = handle;
+    return (registered);
+}
+
+/* Unregister the transport used to reach rprocId. */
+Void MessageQ_unregisterTransport (UInt16 rprocId)
+{
+    if (rprocId >= MultiProc_MAXPROCESSORS) {
+        return;
+    }
+
+    pthread_mutex_lock (&(MessageQ_module->gate));
+    MessageQ_module->transports[rprocId] = NULL;
+    pthread_mutex_unlock (&(MessageQ_module->gate));
+}
+
+/*
+ * This is a helper function to initialize a message.
+ */
+Void MessageQ_msgInit (MessageQ_Msg msg)
+{
+#if 0
+    Int                 status    = MessageQ_S_SUCCESS;
+    LAD_ClientHandle handle;
+    struct LAD_CommandObj cmd;
+    union LAD_ResponseObj rsp;
+
+    handle = LAD_findHandle();
+    if (handle == LAD_MAXNUMCLIENTS) {
+        PRINTVERBOSE1(
+          "MessageQ_msgInit: can't find connection to daemon for pid %d\n",
+           getpid())
+
+        return;
+    }
+
+    cmd.cmd = LAD_MESSAGEQ_MSGINIT;
+    cmd.clientId = handle;
 
     if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
         PRINTVERBOSE1(
@@ -974,157 +1538,1270 @@ Void MessageQ_msgInit (MessageQ_Msg msg)
 
 /*
  * =============================================================================
- * Transport: Fxns kept here until need for a transport layer is realized.
+ * Local delivery: senders and receivers in the same process
  * =============================================================================
  */
 /*
- * ======== transportCreateEndpoint ========
+ * The local queue is an intrusive multi-producer, single-consumer list
+ * linked through the pool block prefix of each message, so a put is one
+ * atomic swap and no copy.  Senders only write localFd when the queue goes
+ * from idle to busy (localSignaled 0 -> 1); the receiver clears the flag in
+ * localAck() before draining, so a message is never left without a wakeup.
+ */
+
+/*
+ * ======== localPush ========
+ */
+static inline Void localPush(MessageQ_Object * obj, MessageQ_PoolBlock * blk)
+{
+    MessageQ_PoolBlock * prev;
+
+    blk->hdr.next = NULL;
+    __sync_synchronize();
+    prev = __sync_lock_test_and_set(&obj->localTail, blk);
+    *(MessageQ_PoolBlock * volatile *)&prev->hdr.next = blk;
+}
+
+/*
+ * ======== localAdd ========
  *
- * Create a communication endpoint to receive messages.
+ * Enter a new queue in the table of queues owned by this process, growing
+ * the table if its index is past the end.
  */
-static Int transportCreateEndpoint(int * fd, UInt16 rprocId, UInt16 queueIndex)
+static Int localAdd(MessageQ_Object * obj)
 {
-    Int          status    = MessageQ_S_SUCCESS;
-    int         err;
+    MessageQ_Object ** queues;
+    UInt32 queueIndex = (MessageQ_QueueIndex)(obj->queue);
+    UInt32 numQueues;
+    Int status = MessageQ_S_SUCCESS;
 
-    /*  Create the socket to receive messages for this messageQ. */
-    *fd = socket(AF_RPMSG, SOCK_SEQPACKET, 0);
-    if (*fd < 0) {
-        status = MessageQ_E_FAIL;
-        printf ("transportCreateEndpoint: socket call failed: %d, %s\n",
-                  errno, strerror(errno));
-        goto exit;
-    }
+    pthread_rwlock_wrlock(&MessageQ_module->queuesLock);
 
-    PRINTVERBOSE1("transportCreateEndpoint: created socket: fd: %d\n", *fd)
+    if (queueIndex >= MessageQ_module->numQueues) {
+        numQueues = MAX(MessageQ_module->numQueues * 2, queueIndex + 1);
+        numQueues = MAX(numQueues, 16);
 
-    err = SocketBindAddr(*fd, rprocId, (UInt32)queueIndex);
-    if (err < 0) {
-        status = MessageQ_E_FAIL;
-        /* don't hard-printf since this is no longer fatal */
-        PRINTVERBOSE2("transportCreateEndpoint: bind failed: %d, %s\n",
-                      errno, strerror(errno));
+        queues = realloc(MessageQ_module->queues,
+                         numQueues * sizeof(MessageQ_Object *));
+        if (queues == NULL) {
+            status = MessageQ_E_MEMORY;
+            goto exit;
+        }
+        memset(&queues[MessageQ_module->numQueues], 0,
+               (numQueues - MessageQ_module->numQueues) *
+               sizeof(MessageQ_Object *));
+
+        MessageQ_module->queues = queues;
+        MessageQ_module->numQueues = numQueues;
     }
 
+    MessageQ_module->queues[queueIndex] = obj;
+
 exit:
+    pthread_rwlock_unlock(&MessageQ_module->queuesLock);
+
     return (status);
 }
 
 /*
- * ======== transportCloseEndpoint ========
+ * ======== localRemove ========
  *
- *  Close the communication endpoint.
+ * Remove a queue from the table, then free whatever is left on its local
+ * queue and stage lists.  Once the write lock is held no sender can still be linking onto
+ * it.
  */
-static Int transportCloseEndpoint(int fd)
+static Void localRemove(MessageQ_Object * obj)
 {
-    Int status = MessageQ_S_SUCCESS;
+    UInt32 queueIndex = (MessageQ_QueueIndex)(obj->queue);
+    MessageQ_Msg msg;
+
+    pthread_rwlock_wrlock(&MessageQ_module->queuesLock);
 
-    PRINTVERBOSE1("transportCloseEndpoint: closing socket: %d\n", fd)
+    if (queueIndex < MessageQ_module->numQueues &&
+        MessageQ_module->queues[queueIndex] == obj) {
+        MessageQ_module->queues[queueIndex] = NULL;
+    }
 
-    /* Stop communication to this socket:  */
-    close(fd);
+    pthread_rwlock_unlock(&MessageQ_module->queuesLock);
 
-    return (status);
+    while (localGet(obj, &msg, 1) == 1) {
+        MessageQ_free(msg);
+    }
+    while (stageGet(obj, &msg, 1) == 1) {
+        MessageQ_free(msg);
+    }
 }
 
 /*
- * ======== transportGet ========
- *  Retrieve a message waiting in the socket's queue.
-*/
-static Int transportGet(int sock, MessageQ_Msg * retMsg)
+ * ======== localPut ========
+ *
+ * Hand messages to a queue owned by this process.  Returns the number of
+ * messages delivered, or -1 if the queue is not in this process and the
+ * caller should use the transport.
+ */
+static Int localPut(UInt16 queueIndex, MessageQ_Msg msgs[], UInt numMsgs)
+{
+    MessageQ_Object * obj = NULL;
+    MessageQ_Msg msg;
+    UInt i;
+
+    pthread_rwlock_rdlock(&MessageQ_module->queuesLock);
+
+    if (queueIndex < MessageQ_module->numQueues) {
+        obj = MessageQ_module->queues[queueIndex];
+    }
+    if (obj == NULL) {
+        pthread_rwlock_unlock(&MessageQ_module->queuesLock);
+        return (-1);
+    }
+
+    for (i = 0; i < numMsgs; i++) {
+        msg = msgs[i];
+
+        /*
+         * A static message stays with the sender, as with a copy
+         * transport, so the receiver gets a pool copy of it.
+         */
+        if (msg->heapId == MessageQ_STATICMSG) {
+            msg = poolAlloc(0, msg->msgSize);
+            if (msg == NULL) {
+                break;
+            }
+            memcpy(msg, msgs[i], msgs[i]->msgSize);
+            msg->heapId = 0;
+        }
+
+        localPush(obj, (MessageQ_PoolBlock *)msg - 1);
+    }
+
+    if (i > 0) {
+        localSignal(obj);
+    }
+
+    pthread_rwlock_unlock(&MessageQ_module->queuesLock);
+
+    return ((Int)i);
+}
+
+/*
+ * ======== localGet ========
+ *
+ * Take up to maxMsgs messages off the local queue without blocking.  A
+ * sender caught between its swap and its link looks like an empty queue;
+ * its wakeup on localFd is still to come.
+ */
+static UInt localGet(MessageQ_Object * obj, MessageQ_Msg msgs[], UInt maxMsgs)
+{
+    MessageQ_PoolBlock * stub = &obj->localStub;
+    MessageQ_PoolBlock * head;
+    MessageQ_PoolBlock * next;
+    UInt count = 0;
+
+    pthread_mutex_lock(&obj->localGate);
+
+    while (count < maxMsgs) {
+        head = obj->localHead;
+        next = *(MessageQ_PoolBlock * volatile *)&head->hdr.next;
+
+        if (head == stub) {
+            if (next == NULL) {
+                break;
+            }
+            obj->localHead = next;
+            head = next;
+            next = *(MessageQ_PoolBlock * volatile *)&head->hdr.next;
+        }
+
+        if (next == NULL) {
+            if (head != *(MessageQ_PoolBlock * volatile *)&obj->localTail) {
+                break;
+            }
+
+            /* head is the last message: put the stub behind it */
+            localPush(obj, stub);
+            next = *(MessageQ_PoolBlock * volatile *)&head->hdr.next;
+            if (next == NULL) {
+                break;
+            }
+        }
+
+        obj->localHead = next;
+        msgs[count++] = (MessageQ_Msg)(head + 1);
+    }
+
+    pthread_mutex_unlock(&obj->localGate);
+
+    if (count > 0) {
+        __sync_synchronize();
+    }
+
+    return (count);
+}
+
+/*
+ * ======== localSignal ========
+ *
+ * Wake the receiver, unless a wakeup is already pending.
+ */
+static Void localSignal(MessageQ_Object * obj)
+{
+    uint64_t one = 1;
+
+    __sync_synchronize();
+    if (__sync_lock_test_and_set(&obj->localSignaled, 1) == 0) {
+        if (write(obj->localFd, &one, sizeof(one)) != sizeof(one)) {
+            printf ("localSignal: eventfd write failed: %d, %s\n",
+                       errno, strerror(errno));
+        }
+    }
+}
+
+/*
+ * ======== localAck ========
+ *
+ * Re-arm the wakeup on localFd before draining the local queue, so a
+ * sender that links after this point signals again.  localFd is edge
+ * triggered, so its count is left as is.
+ */
+static Void localAck(MessageQ_Object * obj)
+{
+    obj->localSignaled = 0;
+    __sync_synchronize();
+}
+
+/*
+ * =============================================================================
+ * Receive: priority staging
+ * =============================================================================
+ */
+/*
+ * A receiver first takes what is already on the stage lists.  When they are
+ * empty it polls the epoll set, takes up to MESSAGEQ_STAGEMAX messages from
+ * the local queue and from each ready endpoint, and sorts them onto the
+ * stage lists by priority.  Each refill visits every ready source once, so
+ * a busy endpoint cannot starve the others, and an urgent message waits
+ * behind at most the one refill that was staged before it arrived.
+ *
+ * The stage lists are linked through the pool block prefix, as the local
+ * queue is; a message is only staged once it is off the local queue.
+ */
+
+/*
+ * ======== receive ========
+ *
+ * Common body of MessageQ_get(), MessageQ_tryGet() and MessageQ_getMany().
+ * Returns the number of messages taken, or a MessageQ_E_* status.
+ */
+static Int receive(MessageQ_Object * obj, MessageQ_Msg msgs[], UInt maxMsgs,
+                   UInt timeout)
 {
-    Int           status    = MessageQ_S_SUCCESS;
-    MessageQ_Msg  msg;
-    struct sockaddr_rpmsg fromAddr;  // [Socket address of sender]
-    unsigned int  len;
-    int           byteCount;
+    struct  epoll_event events[MultiProc_MAXPROCESSORS + 2];
+    struct  timespec start = { 0, 0 };
+    Bool    poll = TRUE;
+    UInt    count;
+    int     retval;
+    int     waitMs;
+    int     i;
+
+    /* A pending unblock wins over staged messages; see below */
+    if (obj->unblocked) {
+        return (MessageQ_E_UNBLOCKED);
+    }
+
+    count = stageGet(obj, msgs, maxMsgs);
+    if (count > 0) {
+        return ((Int)count);
+    }
+
+    if (timeout == MessageQ_FOREVER) {
+        waitMs = -1;
+    }
+    else {
+        /* Timeout given in msec: */
+        waitMs = (int)MIN(timeout, (UInt)0x7FFFFFFF);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
+    for (;;) {
+        /*
+         * The first pass only polls, so messages already waiting are
+         * staged before anything blocks.
+         */
+        retval = epoll_wait(obj->epollFd, events, MultiProc_MAXPROCESSORS + 2,
+                            poll ? 0 : waitRemaining(&start, waitMs));
+        if (retval == -1) {
+            if (errno == EINTR && waitMs == -1) {
+                continue;
+            }
+            return (MessageQ_E_FAIL);
+        }
+
+        for (i = 0; i < retval; i++) {
+            if (obj->unblocked || events[i].data.u32 == MESSAGEQ_UNBLOCKTAG) {
+                /*
+                 * Our event was signalled by MessageQ_unblock().
+                 *
+                 * This is typically done during a shutdown sequence, where
+                 * the intention of the client would be to ignore (i.e. not
+                 * fetch) any pending messages in the transport's queue.
+                 * Thus, we shall not check for nor return any messages.
+                 */
+                return (MessageQ_E_UNBLOCKED);
+            }
+        }
+
+        stageFill(obj, events, retval);
+
+        /*
+         * Another thread may have taken the messages first, or a local
+         * wakeup may have been stale.  Wait again for what is left of the
+         * timeout.
+         */
+        count = stageGet(obj, msgs, maxMsgs);
+        if (count > 0) {
+            return ((Int)count);
+        }
+        if (waitMs != -1 && waitRemaining(&start, waitMs) == 0) {
+            return (MessageQ_E_TIMEOUT);
+        }
+        poll = FALSE;
+    }
+}
+
+/*
+ * ======== creditReturn ========
+ *
+ * A SYS/BIOS sender's MessageQ_putWait() took a credit for each message
+ * got here with MESSAGEQ_CREDITFLAG.  Once half its window is owed, the
+ * credits go back in a message of their own, as on BIOS.  Senders here
+ * take no credits, so the BIOS side has nothing to piggyback them on.
+ */
+static Void creditReturn(MessageQ_Object * obj, MessageQ_Msg msgs[],
+                         UInt numMsgs)
+{
+    MessageQ_Msg credits;
+    UInt16  procId;
+    UInt32  owed;
+    UInt    i;
+
+    for (i = 0; i < numMsgs; i++) {
+        if ((msgs[i]->flags & MESSAGEQ_CREDITFLAG) == 0) {
+            continue;
+        }
+
+        /* The message may be passed on, and must not be counted twice */
+        msgs[i]->flags &= ~MESSAGEQ_CREDITFLAG;
+
+        procId = msgs[i]->srcProc;
+        if (procId >= MultiProc_MAXPROCESSORS || procId == MultiProc_self()) {
+            continue;
+        }
+
+        owed = __sync_add_and_fetch(&obj->creditsOwed[procId], 1);
+        if (owed < (UInt32)(msgs[i]->reserved & MESSAGEQ_WINDOWMASK) / 2) {
+            continue;
+        }
+
+        /* Another receiving thread may have taken them first */
+        owed = __sync_lock_test_and_set(&obj->creditsOwed[procId], 0);
+        if (owed > MESSAGEQ_WINDOWMASK) {
+            __sync_add_and_fetch(&obj->creditsOwed[procId],
+                                 owed - MESSAGEQ_WINDOWMASK);
+            owed = MESSAGEQ_WINDOWMASK;
+        }
+        if (owed == 0) {
+            continue;
+        }
+
+        /* No destination queue: the sender's MessageQ frees it */
+        credits = MessageQ_alloc(0, sizeof(MessageQ_MsgHeader));
+        if (credits != NULL) {
+            credits->flags |= MESSAGEQ_CREDITSFLAG;
+            credits->reserved = (Bits16)(owed << MESSAGEQ_CREDITSSHIFT);
+            MessageQ_setReplyQueue((MessageQ_Handle)obj, credits);
+        }
+        if (credits == NULL ||
+            MessageQ_put(((MessageQ_QueueId)procId << 16) |
+                         MessageQ_INVALIDMESSAGEQ, credits) < 0) {
+            /* Tried again on the next message from procId */
+            __sync_add_and_fetch(&obj->creditsOwed[procId], owed);
+        }
+    }
+}
+
+/*
+ * ======== stagePut ========
+ *
+ * Sort messages onto the stage lists as BIOS MessageQ_put() sorts its
+ * lists: urgent at the head of the high list, high at its tail, and
+ * normal and reserved at the tail of the normal list.
+ */
+static Void stagePut(MessageQ_Object * obj, MessageQ_Msg msgs[],
+                     UInt numMsgs)
+{
+    MessageQ_PoolBlock * blk;
+    UInt priority;
+    UInt list;
+    UInt i;
+
+    pthread_mutex_lock(&obj->localGate);
+
+    for (i = 0; i < numMsgs; i++) {
+        blk = (MessageQ_PoolBlock *)msgs[i] - 1;
+        blk->hdr.next = NULL;
+        priority = MessageQ_getMsgPri(msgs[i]);
+
+        list = (priority == MessageQ_HIGHPRI ||
+                priority == MessageQ_URGENTPRI) ?
+                MESSAGEQ_STAGEHIGH : MESSAGEQ_STAGENORMAL;
+
+        if (obj->stageHead[list] == NULL) {
+            obj->stageHead[list] = blk;
+            obj->stageTail[list] = blk;
+        }
+        else if (priority == MessageQ_URGENTPRI) {
+            blk->hdr.next = obj->stageHead[list];
+            obj->stageHead[list] = blk;
+        }
+        else {
+            obj->stageTail[list]->hdr.next = blk;
+            obj->stageTail[list] = blk;
+        }
+    }
+
+    pthread_mutex_unlock(&obj->localGate);
+}
+
+/*
+ * ======== stageGet ========
+ *
+ * Take up to maxMsgs messages off the stage lists, high list first.  If
+ * any are left, localFd is signaled so the fd from MessageQ_getFd() keeps
+ * polling readable until they are taken.
+ */
+static UInt stageGet(MessageQ_Object * obj, MessageQ_Msg msgs[],
+                     UInt maxMsgs)
+{
+    MessageQ_PoolBlock * blk;
+    UInt count = 0;
+    UInt list;
+    Bool left;
+
+    pthread_mutex_lock(&obj->localGate);
+
+    for (list = MESSAGEQ_STAGEHIGH; list <= MESSAGEQ_STAGENORMAL; list++) {
+        while (count < maxMsgs && obj->stageHead[list] != NULL) {
+            blk = obj->stageHead[list];
+            obj->stageHead[list] = blk->hdr.next;
+            msgs[count++] = (MessageQ_Msg)(blk + 1);
+        }
+    }
+    left = (obj->stageHead[MESSAGEQ_STAGEHIGH] != NULL ||
+            obj->stageHead[MESSAGEQ_STAGENORMAL] != NULL);
+
+    pthread_mutex_unlock(&obj->localGate);
+
+    if (left && count > 0) {
+        localSignal(obj);
+    }
+
+    return (count);
+}
+
+/*
+ * ======== stageFill ========
+ *
+ * Stage what is waiting on the local queue and on each ready endpoint.
+ * The local queue is drained even without a local event, since a refill
+ * capped at MESSAGEQ_STAGEMAX can leave messages whose wakeup was already
+ * taken.
+ */
+static Void stageFill(MessageQ_Object * obj, struct epoll_event events[],
+                      int numEvents)
+{
+    MessageQ_Msg msgs[MESSAGEQ_STAGEMAX];
+    Int count;
+    int i;
+
+    for (i = 0; i < numEvents; i++) {
+        if (events[i].data.u32 == MESSAGEQ_LOCALTAG) {
+            localAck(obj);
+        }
+    }
+
+    count = localGet(obj, msgs, MESSAGEQ_STAGEMAX);
+    if (count > 0) {
+        stagePut(obj, msgs, count);
+    }
+
+    for (i = 0; i < numEvents; i++) {
+        if (events[i].data.u32 != MESSAGEQ_LOCALTAG) {
+            count = transportGet(obj, events[i].data.u32, msgs,
+                                 MESSAGEQ_STAGEMAX);
+            if (count > 0) {
+                stagePut(obj, msgs, count);
+            }
+        }
+    }
+}
+
+/*
+ * ======== waitRemaining ========
+ *
+ * Milliseconds left of a waitMs wait begun at start, or -1 for ever.
+ */
+static int waitRemaining(const struct timespec * start, int waitMs)
+{
+    struct timespec now;
+    long elapsed;
+
+    if (waitMs == -1) {
+        return (-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - start->tv_sec) * 1000 +
+              (now.tv_nsec - start->tv_nsec) / 1000000;
+
+    return ((elapsed >= waitMs) ? 0 : (int)(waitMs - elapsed));
+}
+
+/*
+ * =============================================================================
+ * Message pool
+ * =============================================================================
+ */
+/*
+ * ======== poolCacheDestroy ========
+ *
+ * Thread exit destructor: fold the thread's counters into the pools and
+ * release its cached blocks.
+ */
+static Void poolCacheDestroy(Void * arg)
+{
+    MessageQ_PoolCache * cache = (MessageQ_PoolCache *)arg;
+    MessageQ_PoolCache ** prev;
+    MessageQ_PoolBlock * blk;
+    Int heap;
+    Int sizeClass;
 
     /*
-     * We have no way of peeking to see what message size we'll get, so we
-     * allocate a message of max size to receive contents from the rpmsg socket
-     * (currently, a copy transport)
+     * Another key's destructor may still alloc or free a message on this
+     * thread; it must make a new cache (destroyed on the next destructor
+     * pass), not use this one.
      */
-    msg = MessageQ_alloc (0, MESSAGEQ_RPMSG_MAXSIZE);
-    if (!msg)  {
-        status = MessageQ_E_MEMORY;
-        goto exit;
+    MessageQ_poolCache = NULL;
+    pthread_setspecific(MessageQ_poolKey, NULL);
+
+    pthread_mutex_lock(&MessageQ_poolGate);
+
+    for (prev = &MessageQ_poolCacheList; *prev != NULL;
+         prev = &(*prev)->next) {
+        if (*prev == cache) {
+            *prev = cache->next;
+            break;
+        }
     }
 
-    memset(&fromAddr, 0, sizeof(fromAddr));
-    len = sizeof(fromAddr);
+    for (heap = 0; heap < MessageQ_POOL_MAXHEAPS; heap++) {
+        MessageQ_pools[heap].hits += cache->hits[heap];
+        MessageQ_pools[heap].misses += cache->misses[heap];
+    }
 
-    byteCount = recvfrom(sock, msg, MESSAGEQ_RPMSG_MAXSIZE, 0,
-                      (struct sockaddr *)&fromAddr, &len);
-    if (len != sizeof(fromAddr)) {
-        printf("recvfrom: got bad addr len (%d)\n", len);
-        status = MessageQ_E_FAIL;
-        goto exit;
+    pthread_mutex_unlock(&MessageQ_poolGate);
+
+    for (heap = 0; heap < MessageQ_POOL_MAXHEAPS; heap++) {
+        for (sizeClass = 0; sizeClass < MessageQ_POOL_NUMCLASSES;
+             sizeClass++) {
+            while ((blk = cache->head[heap][sizeClass]) != NULL) {
+                cache->head[heap][sizeClass] = blk->hdr.next;
+                free(blk);
+            }
+        }
     }
-    if (byteCount < 0) {
-        printf("recvfrom failed: %s (%d)\n", strerror(errno), errno);
-        status = MessageQ_E_FAIL;
-        goto exit;
+
+    free(cache);
+}
+
+static Void poolKeyCreate(Void)
+{
+    pthread_key_create(&MessageQ_poolKey, poolCacheDestroy);
+}
+
+/*
+ * ======== poolCacheGet ========
+ *
+ * Return the calling thread's cache, creating it on first use.
+ */
+static inline MessageQ_PoolCache * poolCacheGet(Void)
+{
+    MessageQ_PoolCache * cache = MessageQ_poolCache;
+
+    if (cache == NULL) {
+        pthread_once(&MessageQ_poolOnce, poolKeyCreate);
+
+        cache = (MessageQ_PoolCache *)calloc(1, sizeof(MessageQ_PoolCache));
+        if (cache == NULL) {
+            return (NULL);
+        }
+        pthread_setspecific(MessageQ_poolKey, cache);
+
+        pthread_mutex_lock(&MessageQ_poolGate);
+        cache->next = MessageQ_poolCacheList;
+        MessageQ_poolCacheList = cache;
+        pthread_mutex_unlock(&MessageQ_poolGate);
+
+        MessageQ_poolCache = cache;
+    }
+
+    return (cache);
+}
+
+/*
+ * ======== poolAlloc ========
+ *
+ * Take a block of the right size class from the calling thread's free
+ * list for this heap, falling back to malloc() on an empty list or for
+ * messages bigger than the largest class.  No locks are taken.  A shared
+ * heap hands out its own blocks instead, and returns NULL when empty.
+ */
+static MessageQ_Msg poolAlloc(UInt16 heapId, UInt32 size)
+{
+    MessageQ_PoolCache * cache;
+    MessageQ_PoolBlock * blk = NULL;
+    MessageQ_Pool * pool;
+    UInt32 sizeClass;
+
+    if (heapId >= MessageQ_POOL_MAXHEAPS ||
+        !MessageQ_pools[heapId].registered) {
+        heapId = 0;
+    }
+    pool = &MessageQ_pools[heapId];
+
+    if (pool->shared) {
+        blk = sharedAlloc(pool, size);
+        if (blk == NULL) {
+            return (NULL);
+        }
+        blk->hdr.heap = heapId;
+        blk->hdr.sizeClass = MessageQ_POOL_SHARED;
+        blk->hdr.next = NULL;
+        poolInUse(pool);
+
+        return ((MessageQ_Msg)(blk + 1));
+    }
+
+    for (sizeClass = 0; sizeClass < MessageQ_POOL_NUMCLASSES; sizeClass++) {
+        if (size <= (1u << (MessageQ_POOL_MINSHIFT + sizeClass))) {
+            break;
+        }
+    }
+
+    cache = poolCacheGet();
+
+    if (sizeClass < MessageQ_POOL_NUMCLASSES && cache != NULL &&
+        cache->head[heapId][sizeClass] != NULL) {
+        blk = cache->head[heapId][sizeClass];
+        cache->head[heapId][sizeClass] = blk->hdr.next;
+        cache->depth[heapId][sizeClass]--;
+        cache->hits[heapId]++;
     }
     else {
-         /* Update the allocated message size (even though this may waste space
-          * when the actual message is smaller than the maximum rpmsg size,
-          * the message will be freed soon anyway, and it avoids an extra copy).
-          */
-         msg->msgSize = byteCount;
+        if (sizeClass < MessageQ_POOL_NUMCLASSES) {
+            size = 1u << (MessageQ_POOL_MINSHIFT + sizeClass);
+        }
+        else {
+            sizeClass = MessageQ_POOL_NOCLASS;
+        }
 
-         /*
-          * If the message received was statically allocated, reset the
-          * heapId, so the app can free it.
-          */
-         if (msg->heapId == MessageQ_STATICMSG)  {
-             msg->heapId = 0;  /* for a copy transport, heap id is 0. */
-         }
+        blk = (MessageQ_PoolBlock *)malloc(sizeof(MessageQ_PoolBlock) + size);
+        if (blk == NULL) {
+            return (NULL);
+        }
+
+        if (cache != NULL) {
+            cache->misses[heapId]++;
+        }
+    }
+
+    blk->hdr.heap = heapId;
+    blk->hdr.sizeClass = sizeClass;
+    blk->hdr.next = NULL;
+    poolInUse(pool);
+
+    return ((MessageQ_Msg)(blk + 1));
+}
+
+/*
+ * ======== poolFree ========
+ *
+ * Return a block to the calling thread's free list for its heap and class,
+ * or to the system allocator if that list is full.
+ */
+static Void poolFree(MessageQ_Msg msg)
+{
+    MessageQ_PoolBlock * blk = (MessageQ_PoolBlock *)msg - 1;
+    MessageQ_PoolCache * cache;
+    MessageQ_Pool * pool;
+    UInt16 heap = blk->hdr.heap;
+    UInt16 sizeClass = blk->hdr.sizeClass;
+
+    pool = &MessageQ_pools[heap];
+
+    /* Still counted while it goes back, so the heap can't be unmapped */
+    if (sizeClass == MessageQ_POOL_SHARED) {
+        sharedFree(pool, blk);
+        __sync_sub_and_fetch(&pool->inUse, 1);
+        return;
+    }
+
+    __sync_sub_and_fetch(&pool->inUse, 1);
+
+    cache = poolCacheGet();
+
+    if (sizeClass != MessageQ_POOL_NOCLASS && cache != NULL &&
+        pool->registered &&
+        cache->depth[heap][sizeClass] < pool->cacheDepth) {
+        blk->hdr.next = cache->head[heap][sizeClass];
+        cache->head[heap][sizeClass] = blk;
+        cache->depth[heap][sizeClass]++;
+    }
+    else {
+        free(blk);
+    }
+}
+
+/*
+ * ======== poolInUse ========
+ *
+ * Count a message handed out by the pool, tracking the high-water mark.
+ */
+static Void poolInUse(MessageQ_Pool * pool)
+{
+    UInt32 inUse;
+    UInt32 hwm;
+
+    inUse = __sync_add_and_fetch(&pool->inUse, 1);
+    hwm = pool->highWater;
+    while (inUse > hwm &&
+           !__sync_bool_compare_and_swap(&pool->highWater, hwm, inUse)) {
+        hwm = pool->highWater;
+    }
+}
+
+/*
+ * =============================================================================
+ * Shared heap: message blocks in a file mapped by several processes
+ * =============================================================================
+ */
+/*
+ * ======== sharedMap ========
+ *
+ * Map the file of shared heap heapId.  With params, as when registering,
+ * the file is created if it doesn't exist, must otherwise have the same
+ * geometry, and is left open in *fd with the process counted as a user.
+ * Without params, as when receiving a descriptor, it must already exist.
+ * The layout is checked and returned in *geom.
+ *
+ * Creation, attach and the final unlink are serialized with flock(), so
+ * a file that was unlinked by its last user while we opened it is seen
+ * as such (st_nlink of 0), and we start over.
+ *
+ * Anyone who can write the file can corrupt the memory of every process
+ * using the heap, so it is created 0660, less the umask, and one made by
+ * someone else is only mapped if it has our user or group and isn't
+ * writable by others.
+ */
+static MessageQ_SharedHeap * sharedMap(UInt16 heapId,
+        const MessageQ_PoolParams * params, SizeT * size, int * fd,
+        MessageQ_SharedGeometry * geom)
+{
+    MessageQ_SharedHeap * heap = NULL;
+    struct stat st;
+    uint64_t total = 0;
+    UInt32 stride = 0;
+    UInt32 offset = 0;
+    UInt32 i;
+    char path[64];
+    int file;
+
+    snprintf(path, sizeof(path), MessageQ_SHARED_DIR MessageQ_SHARED_NAMEFMT,
+             heapId);
+
+    if (params != NULL) {
+        stride = sizeof(MessageQ_PoolBlock) + params->sharedBlockSize;
+        stride = (stride + MessageQ_SHARED_ALIGN - 1) &
+                 ~(MessageQ_SHARED_ALIGN - 1);
+        offset = offsetof(MessageQ_SharedHeap, freeNext) +
+                 params->sharedNumBlocks * sizeof(UInt32);
+        offset = (offset + MessageQ_SHARED_ALIGN - 1) &
+                 ~(MessageQ_SHARED_ALIGN - 1);
+        total = offset + (uint64_t)stride * params->sharedNumBlocks;
+
+        /* Descriptors carry 32-bit offsets */
+        if (params->sharedNumBlocks == 0 || total > 0xFFFFFFFF) {
+            printf("MessageQ_registerHeap: bad shared heap size\n");
+            return (NULL);
+        }
     }
 
-    PRINTVERBOSE1("transportGet: recvfrom socket: fd: %d\n", sock)
-    PRINTVERBOSE3("\tReceived a msg: byteCount: %d, rpmsg addr: %d, rpmsg proc: %d\n", byteCount, fromAddr.addr, fromAddr.vproc_id)
-    PRINTVERBOSE2("\tMessage Id: %d, Message size: %d\n", msg->msgId, msg->msgSize)
+    for (;;) {
+        file = open(path, O_RDWR | O_CLOEXEC);
+        if (file < 0 && errno == ENOENT && params != NULL) {
+            file = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+            if (file < 0 && errno == EEXIST) {
+                continue;
+            }
+        }
+        if (file < 0) {
+            PRINTVERBOSE2("sharedMap: can't open %s: %s\n", path,
+                          strerror(errno))
+            return (NULL);
+        }
+
+        flock(file, LOCK_EX);
+        if (fstat(file, &st) < 0) {
+            goto exit;
+        }
+        if (st.st_nlink > 0) {
+            break;
+        }
+        close(file);
+    }
 
-    *retMsg = msg;
+    if ((st.st_uid != geteuid() && st.st_gid != getegid()) ||
+        (st.st_mode & S_IWOTH)) {
+        printf("MessageQ: %s isn't private to this user or group\n", path);
+        goto exit;
+    }
+
+    if (st.st_size == 0 && params != NULL) {
+        /* We created it, or its creator died before setting it up */
+        if (ftruncate(file, total) < 0) {
+            goto exit;
+        }
+        heap = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (heap == MAP_FAILED) {
+            heap = NULL;
+            goto exit;
+        }
+        *size = total;
+
+        heap->blockSize = params->sharedBlockSize;
+        heap->blockStride = stride;
+        heap->numBlocks = params->sharedNumBlocks;
+        heap->blocksOffset = offset;
+        heap->attachCount = 0;
+        for (i = 0; i < heap->numBlocks; i++) {
+            heap->freeNext[i] = (i + 1 < heap->numBlocks) ? i + 2 : 0;
+        }
+        heap->freeHead = 1;
+        __sync_synchronize();
+        heap->magic = MessageQ_SHARED_MAGIC;
+
+        geom->blockSize = params->sharedBlockSize;
+        geom->blockStride = stride;
+        geom->numBlocks = params->sharedNumBlocks;
+        geom->blocksOffset = offset;
+    }
+    else {
+        if (st.st_size < (off_t)sizeof(MessageQ_SharedHeap)) {
+            goto exit;
+        }
+        heap = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    file, 0);
+        if (heap == MAP_FAILED) {
+            heap = NULL;
+            goto exit;
+        }
+        *size = st.st_size;
+
+        /* Read once, so what is checked is what is used */
+        geom->blockSize = heap->blockSize;
+        geom->blockStride = heap->blockStride;
+        geom->numBlocks = heap->numBlocks;
+        geom->blocksOffset = heap->blocksOffset;
+
+        if (heap->magic != MessageQ_SHARED_MAGIC || geom->numBlocks == 0 ||
+            geom->blockStride % MessageQ_SHARED_ALIGN != 0 ||
+            geom->blocksOffset % MessageQ_SHARED_ALIGN != 0 ||
+            geom->blockStride < sizeof(MessageQ_PoolBlock) +
+                                (uint64_t)geom->blockSize ||
+            geom->blocksOffset < offsetof(MessageQ_SharedHeap, freeNext) +
+                                 (uint64_t)geom->numBlocks * sizeof(UInt32) ||
+            geom->blocksOffset + (uint64_t)geom->blockStride *
+                                 geom->numBlocks > (uint64_t)st.st_size ||
+            (params != NULL &&
+             (geom->blockSize != params->sharedBlockSize ||
+              geom->numBlocks != params->sharedNumBlocks))) {
+            printf("MessageQ: shared heap %d doesn't match %s\n", heapId,
+                   path);
+            munmap(heap, st.st_size);
+            heap = NULL;
+            goto exit;
+        }
+    }
+
+    if (params != NULL) {
+        heap->attachCount++;
+        flock(file, LOCK_UN);
+        *fd = file;
+        return (heap);
+    }
 
 exit:
-    return (status);
+    close(file);
+
+    return (heap);
+}
+
+/*
+ * ======== sharedUnmap ========
+ *
+ * Undo the sharedMap() of MessageQ_registerHeap().  The last process to
+ * unregister the heap removes its file.  MessageQ_unregisterHeap() makes
+ * sure this process holds no messages from it.  Called with
+ * MessageQ_poolGate.
+ */
+static Void sharedUnmap(UInt16 heapId)
+{
+    MessageQ_Pool * pool = &MessageQ_pools[heapId];
+    MessageQ_SharedHeap * heap = pool->sharedBase;
+    char path[64];
+
+    flock(pool->sharedFd, LOCK_EX);
+    if (--heap->attachCount == 0) {
+        snprintf(path, sizeof(path),
+                 MessageQ_SHARED_DIR MessageQ_SHARED_NAMEFMT, heapId);
+        unlink(path);
+    }
+    close(pool->sharedFd);
+
+    munmap(heap, pool->sharedSize);
+    pool->sharedBase = NULL;
+    pool->shared = FALSE;
+}
+
+/*
+ * ======== sharedAlloc ========
+ *
+ * Pop a block off the heap's free list.  The list is shared by all
+ * processes, so it is lock-free; the tag in freeHead changes on every
+ * update, so a head that was popped and pushed back meanwhile is noticed.
+ * An index off the end of the heap means the file was corrupted, and the
+ * heap is treated as empty.
+ */
+static MessageQ_PoolBlock * sharedAlloc(MessageQ_Pool * pool, UInt32 size)
+{
+    MessageQ_SharedHeap * heap = pool->sharedBase;
+    MessageQ_SharedGeometry * geom = &pool->sharedGeom;
+    MessageQ_PoolBlock * blk;
+    uint64_t head;
+    uint64_t next;
+    UInt32 index;
+
+    if (size > geom->blockSize) {
+        return (NULL);
+    }
+
+    head = heap->freeHead;
+    for (;;) {
+        index = (UInt32)head;
+        if (index == 0) {
+            return (NULL);
+        }
+        if (index > geom->numBlocks) {
+            printf("MessageQ_alloc: shared heap free list corrupted\n");
+            return (NULL);
+        }
+        next = (((head >> 32) + 1) << 32) | heap->freeNext[index - 1];
+        if (__sync_bool_compare_and_swap(&heap->freeHead, head, next)) {
+            break;
+        }
+        head = heap->freeHead;
+    }
+
+    blk = (MessageQ_PoolBlock *)((UInt8 *)heap + geom->blocksOffset +
+                                 (index - 1) * geom->blockStride);
+    blk->hdr.offset = (UInt8 *)(blk + 1) - (UInt8 *)heap;
+
+    return (blk);
+}
+
+/*
+ * ======== sharedFree ========
+ *
+ * Push a block back on the free list of pool's heap, which stays mapped
+ * while the block is counted in use.  A block that isn't one of the heap's
+ * is dropped rather than put on the list.
+ */
+static Void sharedFree(MessageQ_Pool * pool, MessageQ_PoolBlock * blk)
+{
+    MessageQ_SharedHeap * heap = pool->sharedBase;
+    MessageQ_SharedGeometry * geom = &pool->sharedGeom;
+    uint64_t head;
+    uint64_t next;
+    UInt32 offset;
+    UInt32 index;
+
+    offset = (UInt8 *)blk - (UInt8 *)heap - geom->blocksOffset;
+    index = offset / geom->blockStride;
+    if (heap == NULL || (UInt8 *)blk < (UInt8 *)heap + geom->blocksOffset ||
+        offset % geom->blockStride != 0 || index >= geom->numBlocks) {
+        printf("MessageQ_free: block isn't in shared heap, dropped\n");
+        return;
+    }
+
+    head = heap->freeHead;
+    for (;;) {
+        heap->freeNext[index] = (UInt32)head;
+        next = (((head >> 32) + 1) << 32) | (index + 1);
+        if (__sync_bool_compare_and_swap(&heap->freeHead, head, next)) {
+            break;
+        }
+        head = heap->freeHead;
+    }
+}
+
+/*
+ * ======== descriptorPut ========
+ *
+ * Put a burst to another process on this processor, sending each message
+ * from a shared heap as a descriptor of where it lies in the heap.  A
+ * message whose descriptor was sent now belongs to the receiver, so it is
+ * no longer counted here; the rest are left with the caller, as by the
+ * transport.  Returns the number of messages sent, or MessageQ_E_TIMEOUT
+ * if the transport had no room for the first within timeout.
+ */
+static Int descriptorPut(IMessageQTransport_Handle transport,
+        MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId, UInt timeout)
+{
+    MessageQ_Msg          shared[MESSAGEQ_DESCBATCHMAX];
+    MessageQ_Descriptor * desc;
+    MessageQ_PoolBlock *  blk;
+    UInt                  sent = 0;
+    UInt                  num;
+    UInt                  i;
+    Int                   count;
+    Int                   status = 0;
+
+    while (sent < numMsgs) {
+        num = MIN(numMsgs - sent, MESSAGEQ_DESCBATCHMAX);
+
+        for (i = 0; i < num; i++) {
+            shared[i] = NULL;
+            blk = (MessageQ_PoolBlock *)msgs[sent + i] - 1;
+            if (msgs[sent + i]->heapId == MessageQ_STATICMSG ||
+                blk->hdr.sizeClass != MessageQ_POOL_SHARED) {
+                continue;
+            }
+
+            desc = (MessageQ_Descriptor *)poolAlloc(0, sizeof(*desc));
+            if (desc == NULL) {
+                num = i;
+                break;
+            }
+            desc->header = *msgs[sent + i];
+            desc->header.msgSize = sizeof(*desc);
+            desc->header.flags |= MESSAGEQ_DESCFLAG;
+            desc->offset = blk->hdr.offset;
+            desc->size = msgs[sent + i]->msgSize;
+
+            shared[i] = msgs[sent + i];
+            msgs[sent + i] = (MessageQ_Msg)desc;
+        }
+
+        count = 0;
+        if (num > 0) {
+            count = transport->fxns->put(transport, &msgs[sent], num,
+                                         dstProcId, timeout);
+            if (count < 0) {
+                status = count;
+                count = 0;
+            }
+        }
+
+        for (i = 0; i < num; i++) {
+            if (shared[i] == NULL) {
+                continue;
+            }
+            if (i < (UInt)count) {
+                blk = (MessageQ_PoolBlock *)shared[i] - 1;
+                __sync_sub_and_fetch(&MessageQ_pools[blk->hdr.heap].inUse, 1);
+            }
+            else {
+                poolFree(msgs[sent + i]);
+            }
+            msgs[sent + i] = shared[i];
+        }
+
+        sent += count;
+        if ((UInt)count < num || num == 0) {
+            break;
+        }
+    }
+
+    return ((sent == 0 && status < 0) ? status : (Int)sent);
+}
+
+/*
+ * ======== descriptorGet ========
+ *
+ * Find the message a received descriptor refers to, mapping its shared
+ * heap first if this process hasn't.  The message now belongs to this
+ * process, so MessageQ_free() returns it to the heap.  Returns NULL if the
+ * descriptor doesn't refer to a message of the heap as mapped here, or
+ * its size doesn't fit the heap's blocks or match the message's.
+ */
+static MessageQ_Msg descriptorGet(MessageQ_Descriptor * desc)
+{
+    MessageQ_SharedHeap * heap;
+    MessageQ_SharedGeometry geom;
+    MessageQ_PoolBlock *  blk;
+    MessageQ_Pool *       pool;
+    UInt16                heapId = desc->header.heapId;
+    UInt32                offset;
+    SizeT                 size;
+
+    if (heapId >= MessageQ_POOL_MAXHEAPS) {
+        return (NULL);
+    }
+    pool = &MessageQ_pools[heapId];
+
+    heap = pool->sharedBase;
+    if (heap == NULL) {
+        pthread_mutex_lock(&MessageQ_poolGate);
+        heap = pool->sharedBase;
+        if (heap == NULL) {
+            heap = sharedMap(heapId, NULL, &size, NULL, &geom);
+            if (heap != NULL) {
+                pool->sharedGeom = geom;
+                pool->sharedSize = size;
+                __sync_synchronize();
+                pool->sharedBase = heap;
+            }
+        }
+        pthread_mutex_unlock(&MessageQ_poolGate);
+
+        if (heap == NULL) {
+            printf("MessageQ_get: no shared heap %d, message dropped\n",
+                   heapId);
+            return (NULL);
+        }
+    }
+
+    /* The offset must be that of a block's message */
+    offset = desc->offset - sizeof(MessageQ_PoolBlock);
+    if (desc->offset < sizeof(MessageQ_PoolBlock) ||
+        offset < pool->sharedGeom.blocksOffset ||
+        (offset - pool->sharedGeom.blocksOffset) %
+            pool->sharedGeom.blockStride != 0 ||
+        (offset - pool->sharedGeom.blocksOffset) /
+            pool->sharedGeom.blockStride >= pool->sharedGeom.numBlocks) {
+        printf("MessageQ_get: bad descriptor, message dropped\n");
+        return (NULL);
+    }
+
+    if (desc->size < sizeof(MessageQ_MsgHeader) ||
+        desc->size > pool->sharedGeom.blockSize) {
+        printf("MessageQ_get: bad descriptor size %d, message dropped\n",
+               desc->size);
+        return (NULL);
+    }
+
+    blk = (MessageQ_PoolBlock *)((UInt8 *)heap + offset);
+    if (blk->hdr.sizeClass != MessageQ_POOL_SHARED ||
+        blk->hdr.heap != heapId || blk->hdr.offset != desc->offset ||
+        ((MessageQ_Msg)(blk + 1))->msgSize != desc->size) {
+        printf("MessageQ_get: stale descriptor, message dropped\n");
+        return (NULL);
+    }
+    blk->hdr.next = NULL;
+    poolInUse(pool);
+
+    return ((MessageQ_Msg)(blk + 1));
 }
 
+/*
+ * =============================================================================
+ * Transport: dispatch to the transports registered with MessageQ
+ * =============================================================================
+ */
 /*
  * ======== transportPut ========
  *
- * Calls the socket API sendto() on the socket associated with
- * with this destination procID.
- * Currently, both local and remote messages are sent via the Socket ABI, so
- * no local object lists are maintained here.
-*/
-static Int transportPut(MessageQ_Msg msg, UInt16 dstId, UInt16 dstProcId)
+ * Hand a burst of messages for one destination processor to its transport,
+ * which waits up to timeout for room.  Sent messages are freed; the rest
+ * are left with the caller.  Returns the number of messages sent, or
+ * MessageQ_E_TIMEOUT if none was for lack of room.
+ *
+ * Messages from a shared heap to another process on this processor go as
+ * descriptors, by descriptorPut().  To a remote processor they are copied
+ * like any other.
+ */
+static Int transportPut(MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId,
+        UInt timeout)
 {
-    Int     status    = MessageQ_S_SUCCESS;
-    int     sock;
-    int     err;
+    IMessageQTransport_Handle transport = NULL;
+    UInt i;
 
-    /*
-     * Retrieve the socket for the AF_SYSLINK protocol associated with this
-     * transport.
-     */
-    sock = MessageQ_module->sock[dstProcId];
+    if (dstProcId < MultiProc_MAXPROCESSORS) {
+        transport = MessageQ_module->transports[dstProcId];
+    }
+    if (transport == NULL) {
+        printf ("transportPut: no transport for procId: %d\n", dstProcId);
+        return (0);
+    }
 
-    PRINTVERBOSE2("Sending msgId: %d via sock: %d\n", msg->msgId, sock)
+    if (dstProcId == MultiProc_self()) {
+        for (i = 0; i < numMsgs; i++) {
+            if (msgs[i]->heapId != MessageQ_STATICMSG &&
+                ((MessageQ_PoolBlock *)msgs[i] - 1)->hdr.sizeClass ==
+                    MessageQ_POOL_SHARED) {
+                return (descriptorPut(transport, msgs, numMsgs, dstProcId,
+                                      timeout));
+            }
+        }
+    }
 
-    err = send(sock, msg, msg->msgSize, 0);
-    if (err < 0) {
-        printf ("transportPut: send failed: %d, %s\n",
-                  errno, strerror(errno));
-        status = MessageQ_E_FAIL;
+    return (transport->fxns->put(transport, msgs, numMsgs, dstProcId,
+                                 timeout));
+}
+
+/*
+ * ======== transportGet ========
+ *
+ * Retrieve up to maxMsgs messages waiting at the endpoint for rprocId.
+ * Never blocks; returns 0 if another thread got there first.  Descriptors
+ * from other processes on this processor are replaced by the messages
+ * they refer to.
+ */
+static Int transportGet(MessageQ_Object * obj, UInt16 rprocId,
+        MessageQ_Msg msgs[], UInt maxMsgs)
+{
+    MessageQ_Endpoint * ep = &obj->ep[rprocId];
+    MessageQ_Msg msg;
+    Int count;
+    Int done;
+    Int i;
+
+    count = ep->transport->fxns->get(ep->transport, ep->endpoint, msgs,
+                                     maxMsgs);
+    if (rprocId != MultiProc_self()) {
+        return (count);
     }
 
-    /*
-     * Free the message, as this is a copy transport, we maintain MessageQ
-     * semantics.
-     */
-    MessageQ_free (msg);
+    for (i = 0, done = 0; i < count; i++) {
+        msg = msgs[i];
+        if (msg->flags & MESSAGEQ_DESCFLAG) {
+            msg = descriptorGet((MessageQ_Descriptor *)msgs[i]);
+            poolFree(msgs[i]);
+            if (msg == NULL) {
+                continue;
+            }
+        }
+        msgs[done++] = msg;
+    }
 
-    return (status);
+    return (done);
 }
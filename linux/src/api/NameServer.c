@@ -40,17 +40,124 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <ti/ipc/NameServer.h>
+#include <ti/ipc/MultiProc.h>
 
 #include <ladclient.h>
 #include <_lad.h>
 
 static Bool verbose = FALSE;
 
+/* Times a lookup is retried while LAD keeps changing the mirror */
+#define NameServer_MIRRORTRIES  4
+
+/*
+ * LAD's mirror of its local UInt32 entries, mapped read-only, or NULL if
+ * it couldn't be mapped or IPC_NAMESERVER_NOMIRROR is set in the
+ * environment.  Local names are looked up here first, and LAD is asked
+ * only about the ones that aren't found.
+ */
+static const LAD_NSMirror * NameServer_mirror = NULL;
+
+static Void mirrorMap(Void)
+{
+    struct stat st;
+    Ptr addr;
+    int fd;
+
+    if (NameServer_mirror != NULL || getenv("IPC_NAMESERVER_NOMIRROR")) {
+        return;
+    }
+
+    fd = open(LAD_NSMIRRORPATH, O_RDONLY);
+    if (fd < 0) {
+        PRINTVERBOSE0("NameServer_setup: no mirror, asking LAD for names\n")
+        return;
+    }
+
+    if (fstat(fd, &st) == 0 && st.st_size == sizeof(LAD_NSMirror)) {
+        addr = mmap(NULL, sizeof(LAD_NSMirror), PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            NameServer_mirror = (const LAD_NSMirror *)addr;
+            if (NameServer_mirror->magic != LAD_NSMIRRORMAGIC) {
+                munmap(addr, sizeof(LAD_NSMirror));
+                NameServer_mirror = NULL;
+            }
+        }
+    }
+
+    close(fd);
+}
+
+/*
+ * Look up a local name in the mirror.  Returns TRUE with *val set if it's
+ * there, FALSE if it isn't or LAD was too busy changing the mirror to get
+ * a consistent answer, in which case LAD is asked instead.
+ */
+static Bool mirrorLookup(NameServer_Handle nsHandle, String name, UInt32 * val)
+{
+    const LAD_NSMirror * mirror = NameServer_mirror;
+    const volatile LAD_NSMirrorSlot * slot;
+    uint64_t key = (uint64_t)(uintptr_t)nsHandle;
+    UInt32 mask = LAD_NSMIRRORSIZE - 1;
+    UInt32 hash;
+    UInt32 seq;
+    UInt32 value;
+    Bool found;
+    Int tries;
+    UInt32 i;
+    Int n;
+
+    if (mirror == NULL || strlen(name) >= LAD_NSMIRRORNAMELEN) {
+        return (FALSE);
+    }
+
+    hash = LAD_nsMirrorHash(key, name);
+
+    for (tries = 0; tries < NameServer_MIRRORTRIES; tries++) {
+        seq = mirror->seq;
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+        __sync_synchronize();
+
+        found = FALSE;
+        value = 0;
+        i = hash & mask;
+        for (n = 0; n < LAD_NSMIRRORSIZE; n++, i = (i + 1) & mask) {
+            slot = &mirror->slots[i];
+            if (slot->hash == 0) {
+                break;
+            }
+            if (slot->hash == hash && slot->handle == key &&
+                strncmp((const char *)slot->name, name,
+                        LAD_NSMIRRORNAMELEN) == 0) {
+                value = slot->value;
+                found = TRUE;
+                break;
+            }
+        }
+
+        __sync_synchronize();
+        if (mirror->seq == seq) {
+            if (found) {
+                *val = value;
+            }
+            return (found);
+        }
+    }
+
+    return (FALSE);
+}
+
 
 /*
  * The NameServer_*() APIs are reproduced here.  These versions are just
@@ -93,6 +200,10 @@ Int NameServer_setup(Void)
       "NameServer_setup: got LAD response for client %d, status=%d\n",
       handle, status)
 
+    if (status >= 0) {
+        mirrorMap();
+    }
+
     return status;
 }
 
@@ -105,6 +216,11 @@ Int NameServer_destroy(Void)
 
     PRINTVERBOSE0("NameServer_destroy: entered\n")
 
+    if (NameServer_mirror != NULL) {
+        munmap((Ptr)NameServer_mirror, sizeof(LAD_NSMirror));
+        NameServer_mirror = NULL;
+    }
+
     handle = LAD_findHandle();
     if (handle == LAD_MAXNUMCLIENTS) {
         PRINTVERBOSE1(
@@ -266,6 +382,12 @@ Int NameServer_getUInt32(NameServer_Handle nsHandle, String name, Ptr buf,
     struct LAD_CommandObj cmd;
     union LAD_ResponseObj rsp;
 
+    /* Local names come first; don't bother LAD with the ones it mirrors */
+    if ((procId == NULL || procId[0] == MultiProc_self()) &&
+        mirrorLookup(nsHandle, name, (UInt32 *)buf)) {
+        return NameServer_S_SUCCESS;
+    }
+
     clHandle = LAD_findHandle();
     if (clHandle == LAD_MAXNUMCLIENTS) {
         PRINTVERBOSE1(
@@ -310,6 +432,66 @@ Int NameServer_getUInt32(NameServer_Handle nsHandle, String name, Ptr buf,
     return status;
 }
 
+Int NameServer_watch(NameServer_Handle nsHandle, String name, Ptr buf,
+                     UInt timeout)
+{
+    Int status;
+    LAD_ClientHandle clHandle;
+    UInt32 *val;
+    struct LAD_CommandObj cmd;
+    union LAD_ResponseObj rsp;
+
+    /* no name that long can be added, so it would never turn up */
+    if (strlen(name) >= NameServer_Params_MAXNAMELEN) {
+        PRINTVERBOSE1("NameServer_watch: name '%s' is too long\n", name)
+
+        return NameServer_E_INVALIDARG;
+    }
+
+    if (mirrorLookup(nsHandle, name, (UInt32 *)buf)) {
+        return NameServer_S_SUCCESS;
+    }
+
+    clHandle = LAD_findHandle();
+    if (clHandle == LAD_MAXNUMCLIENTS) {
+        PRINTVERBOSE1(
+          "NameServer_watch: can't find connection to daemon for pid %d\n",
+           getpid())
+
+        return NameServer_E_RESOURCE;
+    }
+
+    cmd.cmd = LAD_NAMESERVER_WATCH;
+    cmd.clientId = clHandle;
+    cmd.args.watch.handle = nsHandle;
+    strncpy(cmd.args.watch.name, name, NameServer_Params_MAXNAMELEN - 1);
+    cmd.args.watch.name[NameServer_Params_MAXNAMELEN - 1] = '\0';
+    cmd.args.watch.timeout = timeout;
+
+    if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
+        PRINTVERBOSE1(
+           "NameServer_watch: sending LAD command failed, status=%d\n",
+            status)
+        return NameServer_E_FAIL;
+    }
+
+    /* LAD answers once the name turns up, or timeout passes */
+    if ((status = LAD_getResponse(clHandle, &rsp)) != LAD_SUCCESS) {
+        PRINTVERBOSE1("NameServer_watch: no LAD response, status=%d\n",
+                       status)
+        return NameServer_E_FAIL;
+    }
+
+    val = (UInt32 *)buf;
+    *val = rsp.getUInt32.val;
+    status = rsp.getUInt32.status;
+
+    PRINTVERBOSE1("NameServer_watch: got LAD response for client %d\n",
+                   clHandle)
+
+    return status;
+}
+
 Int NameServer_remove(NameServer_Handle nsHandle, String name)
 {
     Int status;
@@ -393,6 +575,159 @@ Int NameServer_removeEntry(NameServer_Handle nsHandle, Ptr entry)
     return status;
 }
 
+Int NameServer_getCacheStats(NameServer_Handle nsHandle,
+                             NameServer_CacheStats *stats)
+{
+    Int status;
+    LAD_ClientHandle clHandle;
+    struct LAD_CommandObj cmd;
+    union LAD_ResponseObj rsp;
+
+    clHandle = LAD_findHandle();
+    if (clHandle == LAD_MAXNUMCLIENTS) {
+        PRINTVERBOSE1(
+         "NameServer_getCacheStats: can't find connection to daemon for pid %d\n",
+         getpid())
+
+        return NameServer_E_RESOURCE;
+    }
+
+    cmd.cmd = LAD_NAMESERVER_GETCACHESTATS;
+    cmd.clientId = clHandle;
+    cmd.args.getCacheStats.handle = nsHandle;
+
+    if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
+        PRINTVERBOSE1(
+          "NameServer_getCacheStats: sending LAD command failed, status=%d\n",
+          status)
+        return NameServer_E_FAIL;
+    }
+
+    if ((status = LAD_getResponse(clHandle, &rsp)) != LAD_SUCCESS) {
+        PRINTVERBOSE1("NameServer_getCacheStats: no LAD response, status=%d\n",
+                       status)
+        return NameServer_E_FAIL;
+    }
+
+    status = rsp.getCacheStats.status;
+    *stats = rsp.getCacheStats.stats;
+
+    PRINTVERBOSE1("NameServer_getCacheStats: got LAD response for client %d\n",
+                   clHandle)
+
+    return status;
+}
+
+Int NameServer_match(NameServer_Handle nsHandle, String name, UInt32 *value)
+{
+    Int status;
+    LAD_ClientHandle clHandle;
+    struct LAD_CommandObj cmd;
+    union LAD_ResponseObj rsp;
+
+    clHandle = LAD_findHandle();
+    if (clHandle == LAD_MAXNUMCLIENTS) {
+        PRINTVERBOSE1(
+          "NameServer_match: can't find connection to daemon for pid %d\n",
+           getpid())
+
+        return NameServer_E_RESOURCE;
+    }
+
+    cmd.cmd = LAD_NAMESERVER_MATCH;
+    cmd.clientId = clHandle;
+    cmd.args.match.handle = nsHandle;
+    strncpy(cmd.args.match.name, name, NameServer_ENUMNAMELEN - 1);
+    cmd.args.match.name[NameServer_ENUMNAMELEN - 1] = '\0';
+
+    if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
+        PRINTVERBOSE1(
+           "NameServer_match: sending LAD command failed, status=%d\n",
+            status)
+        return NameServer_E_FAIL;
+    }
+
+    if ((status = LAD_getResponse(clHandle, &rsp)) != LAD_SUCCESS) {
+        PRINTVERBOSE1("NameServer_match: no LAD response, status=%d\n",
+                       status)
+        return NameServer_E_FAIL;
+    }
+
+    if (rsp.match.len > 0) {
+        *value = rsp.match.val;
+    }
+
+    PRINTVERBOSE1("NameServer_match: got LAD response for client %d\n",
+                   clHandle)
+
+    return rsp.match.len;
+}
+
+Int NameServer_enumerate(NameServer_Handle nsHandle, String prefix,
+                         NameServer_EnumFxn fxn, Ptr arg)
+{
+    Int status;
+    Int total = 0;
+    UInt32 i;
+    LAD_ClientHandle clHandle;
+    struct LAD_CommandObj cmd;
+    union LAD_ResponseObj rsp;
+
+    clHandle = LAD_findHandle();
+    if (clHandle == LAD_MAXNUMCLIENTS) {
+        PRINTVERBOSE1(
+          "NameServer_enumerate: can't find connection to daemon for pid %d\n",
+           getpid())
+
+        return NameServer_E_RESOURCE;
+    }
+
+    cmd.cmd = LAD_NAMESERVER_ENUMERATE;
+    cmd.clientId = clHandle;
+    cmd.args.enumerate.handle = nsHandle;
+    strncpy(cmd.args.enumerate.prefix, prefix, NameServer_ENUMNAMELEN - 1);
+    cmd.args.enumerate.prefix[NameServer_ENUMNAMELEN - 1] = '\0';
+    cmd.args.enumerate.after[0] = '\0';
+
+    /* Each batch picks up after the last name of the one before */
+    do {
+        if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
+            PRINTVERBOSE1(
+               "NameServer_enumerate: sending LAD command failed, status=%d\n",
+                status)
+            return NameServer_E_FAIL;
+        }
+
+        if ((status = LAD_getResponse(clHandle, &rsp)) != LAD_SUCCESS) {
+            PRINTVERBOSE1("NameServer_enumerate: no LAD response, status=%d\n",
+                           status)
+            return NameServer_E_FAIL;
+        }
+
+        if (rsp.enumerate.status < 0) {
+            return rsp.enumerate.status;
+        }
+
+        for (i = 0; i < rsp.enumerate.count; i++) {
+            total++;
+            if (!fxn(arg, rsp.enumerate.entries[i].name,
+                     rsp.enumerate.entries[i].value)) {
+                return total;
+            }
+        }
+
+        if (rsp.enumerate.count > 0) {
+            strcpy(cmd.args.enumerate.after,
+                   rsp.enumerate.entries[rsp.enumerate.count - 1].name);
+        }
+    } while (rsp.enumerate.count == LAD_NSENUMBATCH);
+
+    PRINTVERBOSE1("NameServer_enumerate: got LAD responses for client %d\n",
+                   clHandle)
+
+    return total;
+}
+
 Int NameServer_delete(NameServer_Handle *nsHandle)
 {
     Int status;
@@ -0,0 +1,803 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ *  @file   TransportRpmsg.c
+ *
+ *  @brief  MessageQ transport over AF_RPMSG sockets
+ *
+ *  Carries messages between this process and the remote processors.
+ *  MessageQ_attach() opens one connected send socket per remote processor,
+ *  and each MessageQ gets one bound receive socket per remote processor.
+ *  This is a copy transport: sent messages are freed, and received messages
+ *  are copied into buffers from the MessageQ pool.
+ *
+ *  Messages too large for one rpmsg buffer are sent as a train of
+ *  fragments, and put back together before MessageQ sees them.
+ */
+
+
+/* Standard IPC header */
+#include <ti/ipc/Std.h>
+
+/* Linux specific header files, replacing OSAL: */
+#include <pthread.h>
+
+/* Module level headers */
+#include <ti/ipc/MultiProc.h>
+#include <_MultiProc.h>
+#include <ti/ipc/MessageQ.h>
+#include <_MessageQ.h>
+#include <_IMessageQTransport.h>
+
+/* Socket Headers */
+#include <sys/types.h>
+#include <sys/param.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Socket Protocol Family */
+#include <net/rpmsg.h>
+
+/* Socket utils: */
+#include <SocketFxns.h>
+
+#include <_lad.h>
+
+/* =============================================================================
+ * Macros/Constants
+ * =============================================================================
+ */
+
+/*!
+ *  @brief  Value of an invalid socket ID:
+ */
+#define Transport_INVALIDSOCKET  (0xFFFFFFFF)
+
+/* More magic rpmsg port numbers: */
+#define MESSAGEQ_RPMSG_PORT       61
+#define MESSAGEQ_RPMSG_MAXSIZE   512
+
+/* Most messages moved by one sendmmsg()/recvmmsg() call: */
+#define MESSAGEQ_BATCHMAX        32
+
+/*
+ * Fragmentation; must match RPMSG_MESSAGEQ_FRAG* in
+ * packages/ti/ipc/transports/_TransportRpmsg.h.
+ *
+ * Each fragment is a copy of the message header followed by the next
+ * piece of the payload.  The header is marked with FRAGFLAG, and reserved1
+ * carries the sender's tag for the message, the fragment's index and the
+ * number of fragments; msgSize is that of the whole message.  All fragments
+ * but the last carry the same amount of payload.
+ */
+#define TransportRpmsg_FRAGFLAG      0x0800
+#define TransportRpmsg_FRAGSIZE      (MESSAGEQ_RPMSG_MAXSIZE - 16)
+#define TransportRpmsg_FRAGCHUNK     \
+    (TransportRpmsg_FRAGSIZE - sizeof(MessageQ_MsgHeader))
+#define TransportRpmsg_MAXFRAGS      255
+
+#define TransportRpmsg_FRAGHDR(tag, index, count) \
+    (((UInt32)(tag) << 16) | ((UInt32)(index) << 8) | (UInt32)(count))
+#define TransportRpmsg_FRAGTAG(r)    ((UInt16)((r) >> 16))
+#define TransportRpmsg_FRAGINDEX(r)  (((r) >> 8) & 0xFF)
+#define TransportRpmsg_FRAGCOUNT(r)  ((r) & 0xFF)
+
+/* Messages that can be under reassembly at once, across all queues */
+#define TransportRpmsg_NUMREASSEMBLY 8
+
+/* =============================================================================
+ * Structures & Enums
+ * =============================================================================
+ */
+
+/* A message being put back together from its fragments */
+typedef struct TransportRpmsg_Reassembly {
+    MessageQ_Msg        msg;
+    /*!< Message being rebuilt, or NULL if the slot is free */
+    int                 sock;
+    /*!< Receive socket the fragments arrive on */
+    UInt32              srcAddr;
+    /*!< rpmsg address of the sender */
+    UInt32              srcProc;
+    /*!< Processor of the sender */
+    UInt16              tag;
+    /*!< Sender's tag for the message */
+    UInt16              count;
+    /*!< Number of fragments */
+    UInt16              next;
+    /*!< Index of the fragment expected next */
+    UInt32              chunk;
+    /*!< Payload carried by each fragment but the last */
+    UInt32              size;
+    /*!< Message size so far */
+    UInt32              age;
+    /*!< When the slot was taken, to find the oldest */
+} TransportRpmsg_Reassembly;
+
+/* Transport instance; there is only one, shared by all remote processors */
+typedef struct TransportRpmsg_Object {
+    IMessageQTransport_Object base;
+    /*!< Interface header; must be first */
+    pthread_mutex_t     gate;
+    /*!< Guards sock[] */
+    int                 sock[MultiProc_MAXPROCESSORS];
+    /*!< Sockets for sending to each remote processor */
+    UInt16              fragTag;
+    /*!< Tag of the last fragmented message sent (updated atomically) */
+    pthread_mutex_t     fragGate;
+    /*!< Guards reassembly[] and fragAge */
+    TransportRpmsg_Reassembly reassembly[TransportRpmsg_NUMREASSEMBLY];
+    /*!< Bounded pool of messages under reassembly */
+    UInt32              fragAge;
+    /*!< Count of reassembly slots taken */
+} TransportRpmsg_Object;
+
+static Bool verbose = FALSE;
+
+
+/* =============================================================================
+ * Forward declarations of internal functions
+ * =============================================================================
+ */
+static Int TransportRpmsg_attach(IMessageQTransport_Handle handle,
+        UInt16 rprocId);
+static Int TransportRpmsg_detach(IMessageQTransport_Handle handle,
+        UInt16 rprocId);
+static Int TransportRpmsg_openEndpoint(IMessageQTransport_Handle handle,
+        MessageQ_QueueId queueId, UInt16 rprocId, Ptr * endpoint, int * fd);
+static Void TransportRpmsg_closeEndpoint(IMessageQTransport_Handle handle,
+        Ptr endpoint);
+static Int TransportRpmsg_get(IMessageQTransport_Handle handle, Ptr endpoint,
+        MessageQ_Msg msgs[], UInt maxMsgs);
+static Int TransportRpmsg_put(IMessageQTransport_Handle handle,
+        MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId, UInt timeout);
+
+static Bool putFragments(TransportRpmsg_Object * obj, int sock,
+        MessageQ_Msg msg);
+static MessageQ_Msg reassemble(TransportRpmsg_Object * obj, int sock,
+        const struct sockaddr_rpmsg * from, MessageQ_Msg frag, UInt32 len);
+static Void reassemblyDrop(TransportRpmsg_Reassembly * slot);
+
+/* =============================================================================
+ *  Globals
+ * =============================================================================
+ */
+static const IMessageQTransport_Fxns TransportRpmsg_fxns = {
+    .attach             = TransportRpmsg_attach,
+    .detach             = TransportRpmsg_detach,
+    .openEndpoint       = TransportRpmsg_openEndpoint,
+    .closeEndpoint      = TransportRpmsg_closeEndpoint,
+    .get                = TransportRpmsg_get,
+    .put                = TransportRpmsg_put,
+};
+
+static TransportRpmsg_Object TransportRpmsg_state =
+{
+    .base.fxns              = &TransportRpmsg_fxns,
+    .gate                   = PTHREAD_MUTEX_INITIALIZER,
+    .fragGate               = PTHREAD_MUTEX_INITIALIZER,
+    .sock                   = {
+        [0 ... MultiProc_MAXPROCESSORS - 1] = Transport_INVALIDSOCKET
+    },
+};
+
+
+/* =============================================================================
+ * APIS
+ * =============================================================================
+ */
+/* Returns the rpmsg transport instance. */
+IMessageQTransport_Handle TransportRpmsg_handle(Void)
+{
+    return ((IMessageQTransport_Handle)&TransportRpmsg_state);
+}
+
+/*
+ * ======== TransportRpmsg_attach ========
+ *
+ *  Create the socket for sending to this remote proc.
+ *
+ *  Only creates it if one does not already exist for this procId.  The
+ *  connect is made outside the gate, so attaches to several processors
+ *  can go on at once; if two race for the same one, the loser's socket
+ *  is closed.
+ */
+static Int TransportRpmsg_attach(IMessageQTransport_Handle handle,
+        UInt16 rprocId)
+{
+    TransportRpmsg_Object * obj = (TransportRpmsg_Object *)handle;
+    Int     status = MessageQ_S_SUCCESS;
+    int     sock;
+
+    pthread_mutex_lock(&obj->gate);
+    sock = obj->sock[rprocId];
+    pthread_mutex_unlock(&obj->gate);
+
+    /* Only create a socket if one doesn't exist: */
+    if (sock != Transport_INVALIDSOCKET)  {
+        return (MessageQ_E_ALREADYEXISTS);
+    }
+
+    /* Create the socket for sending messages to the remote proc: */
+    sock = socket(AF_RPMSG, SOCK_SEQPACKET, 0);
+    if (sock < 0 && errno == EAFNOSUPPORT) {
+        /* No rpmsg in this kernel; the host may still talk to itself */
+        PRINTVERBOSE1("MessageQ_attach: no rpmsg support for remoteProcId:%d\n",
+               rprocId);
+        return (MessageQ_E_RESOURCE);
+    }
+    else if (sock < 0) {
+        printf ("MessageQ_attach: socket failed: %d, %s\n",
+                   errno, strerror(errno));
+        return (MessageQ_E_FAIL);
+    }
+
+    PRINTVERBOSE1("MessageQ_attach: created send socket: %d\n", sock)
+
+    /* Attempt to connect: */
+    if (ConnectSocket(sock, rprocId, MESSAGEQ_RPMSG_PORT) < 0) {
+        /* don't hard-printf since this is no longer fatal */
+        PRINTVERBOSE1("MessageQ_attach: ConnectSocket(remoteProcId:%d) failed\n",
+               rprocId);
+        close(sock);
+        return (MessageQ_E_RESOURCE);
+    }
+
+    pthread_mutex_lock(&obj->gate);
+    if (obj->sock[rprocId] == Transport_INVALIDSOCKET) {
+        obj->sock[rprocId] = sock;
+    }
+    else {
+        close(sock);
+        status = MessageQ_E_ALREADYEXISTS;
+    }
+    pthread_mutex_unlock(&obj->gate);
+
+    return (status);
+}
+
+/*
+ * ======== TransportRpmsg_detach ========
+ *
+ *  Close the socket for this remote proc.
+ */
+static Int TransportRpmsg_detach(IMessageQTransport_Handle handle,
+        UInt16 rprocId)
+{
+    TransportRpmsg_Object * obj = (TransportRpmsg_Object *)handle;
+    Int status = MessageQ_S_SUCCESS;
+    int sock;
+
+    pthread_mutex_lock(&obj->gate);
+
+    sock = obj->sock[rprocId];
+    if (sock != Transport_INVALIDSOCKET) {
+        if (close(sock)) {
+            status = MessageQ_E_OSFAILURE;
+            printf("MessageQ_detach: close failed: %d, %s\n",
+                   errno, strerror(errno));
+        }
+        else {
+            PRINTVERBOSE1("MessageQ_detach: closed socket: %d\n", sock)
+            obj->sock[rprocId] = Transport_INVALIDSOCKET;
+        }
+    }
+
+    pthread_mutex_unlock(&obj->gate);
+
+    return (status);
+}
+
+/*
+ * ======== TransportRpmsg_openEndpoint ========
+ *
+ * Create a communication endpoint to receive messages.
+ */
+static Int TransportRpmsg_openEndpoint(IMessageQTransport_Handle handle,
+        MessageQ_QueueId queueId, UInt16 rprocId, Ptr * endpoint, int * fd)
+{
+    Int          status    = MessageQ_S_SUCCESS;
+    UInt16       queueIndex = (MessageQ_QueueIndex)(queueId & 0x0000ffff);
+    int          err;
+
+    /*  Create the socket to receive messages for this messageQ. */
+    *fd = socket(AF_RPMSG, SOCK_SEQPACKET, 0);
+    if (*fd < 0) {
+        status = MessageQ_E_FAIL;
+        if (errno == EAFNOSUPPORT) {
+            PRINTVERBOSE0("transportCreateEndpoint: no rpmsg support\n")
+        }
+        else {
+            printf ("transportCreateEndpoint: socket call failed: %d, %s\n",
+                      errno, strerror(errno));
+        }
+        goto exit;
+    }
+
+    PRINTVERBOSE1("transportCreateEndpoint: created socket: fd: %d\n", *fd)
+
+    err = SocketBindAddr(*fd, rprocId, (UInt32)queueIndex);
+    if (err < 0) {
+        status = MessageQ_E_FAIL;
+        /* don't hard-printf since this is no longer fatal */
+        PRINTVERBOSE2("transportCreateEndpoint: bind failed: %d, %s\n",
+                      errno, strerror(errno));
+        close(*fd);
+        goto exit;
+    }
+
+    /* The socket is all the endpoint state there is */
+    *endpoint = (Ptr)(intptr_t)*fd;
+
+exit:
+    return (status);
+}
+
+/*
+ * ======== TransportRpmsg_closeEndpoint ========
+ *
+ *  Close the communication endpoint.
+ */
+static Void TransportRpmsg_closeEndpoint(IMessageQTransport_Handle handle,
+        Ptr endpoint)
+{
+    TransportRpmsg_Object * obj = (TransportRpmsg_Object *)handle;
+    int fd = (int)(intptr_t)endpoint;
+    int i;
+
+    PRINTVERBOSE1("transportCloseEndpoint: closing socket: %d\n", fd)
+
+    /* Drop partly received messages for this queue: */
+    pthread_mutex_lock(&obj->fragGate);
+    for (i = 0; i < TransportRpmsg_NUMREASSEMBLY; i++) {
+        if (obj->reassembly[i].msg != NULL && obj->reassembly[i].sock == fd) {
+            reassemblyDrop(&obj->reassembly[i]);
+        }
+    }
+    pthread_mutex_unlock(&obj->fragGate);
+
+    /* Stop communication to this socket:  */
+    close(fd);
+}
+
+/*
+ * ======== TransportRpmsg_get ========
+ *  Retrieve up to maxMsgs messages waiting in the socket's queue, with one
+ *  recvfrom(), or one recvmmsg() for a burst.  Never blocks; returns the
+ *  number of messages retrieved, which is 0 if the queue was already empty.
+ */
+static Int TransportRpmsg_get(IMessageQTransport_Handle handle, Ptr endpoint,
+        MessageQ_Msg msgs[], UInt maxMsgs)
+{
+    TransportRpmsg_Object * obj = (TransportRpmsg_Object *)handle;
+    struct mmsghdr        vec[MESSAGEQ_BATCHMAX];
+    struct iovec          iov[MESSAGEQ_BATCHMAX];
+    struct sockaddr_rpmsg fromAddr[MESSAGEQ_BATCHMAX];
+    MessageQ_Msg          msg;
+    int                   sock = (int)(intptr_t)endpoint;
+    UInt                  num;
+    UInt                  i;
+    int                   count;
+    int                   done = 0;
+
+    num = MIN(maxMsgs, MESSAGEQ_BATCHMAX);
+
+    /*
+     * We have no way of peeking to see what message size we'll get, so we
+     * allocate messages of max size to receive contents from the rpmsg
+     * socket.  The buffers come from the largest pool size class, so they
+     * are recycled when the app frees the messages.
+     */
+    for (i = 0; i < num; i++) {
+        msgs[i] = MessageQ_alloc(0, MESSAGEQ_RPMSG_MAXSIZE);
+        if (msgs[i] == NULL) {
+            break;
+        }
+        iov[i].iov_base = msgs[i];
+        iov[i].iov_len  = MESSAGEQ_RPMSG_MAXSIZE;
+        memset(&vec[i], 0, sizeof(vec[i]));
+        vec[i].msg_hdr.msg_iov     = &iov[i];
+        vec[i].msg_hdr.msg_iovlen  = 1;
+        vec[i].msg_hdr.msg_name    = &fromAddr[i];
+        vec[i].msg_hdr.msg_namelen = sizeof(fromAddr[i]);
+    }
+    num = i;
+
+    if (num == 1) {
+        count = recvfrom(sock, msgs[0], MESSAGEQ_RPMSG_MAXSIZE, MSG_DONTWAIT,
+                         (struct sockaddr *)&fromAddr[0],
+                         &vec[0].msg_hdr.msg_namelen);
+        if (count >= 0) {
+            vec[0].msg_len = count;
+            count = 1;
+        }
+    }
+    else {
+        count = (num > 0) ? recvmmsg(sock, vec, num, MSG_DONTWAIT, NULL) : 0;
+    }
+
+    if (count < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            printf("recvmmsg failed: %s (%d)\n", strerror(errno), errno);
+        }
+        count = 0;
+    }
+
+    for (i = 0; i < (UInt)count; i++) {
+        msg = msgs[i];
+
+        /*
+         * A fragment is folded into its message, and the message is
+         * returned in its place once the last fragment is in.
+         */
+        if (msg->flags & TransportRpmsg_FRAGFLAG) {
+            msg = reassemble(obj, sock, &fromAddr[i], msg, vec[i].msg_len);
+            msgs[i]->heapId = 0;
+            MessageQ_free(msgs[i]);
+            if (msg != NULL) {
+                msgs[done++] = msg;
+            }
+            continue;
+        }
+
+        /* Update the allocated message size (even though this may waste
+         * space when the actual message is smaller than the maximum rpmsg
+         * size, the message will be freed soon anyway, and it avoids an
+         * extra copy).
+         */
+        msg->msgSize = vec[i].msg_len;
+
+        /*
+         * If the message received was statically allocated, reset the
+         * heapId, so the app can free it.
+         */
+        if (msg->heapId == MessageQ_STATICMSG)  {
+            msg->heapId = 0;  /* for a copy transport, heap id is 0. */
+        }
+
+        PRINTVERBOSE3("\tReceived a msg: byteCount: %d, rpmsg addr: %d, rpmsg proc: %d\n", vec[i].msg_len, fromAddr[i].addr, fromAddr[i].vproc_id)
+        PRINTVERBOSE2("\tMessage Id: %d, Message size: %d\n", msg->msgId, msg->msgSize)
+
+        msgs[done++] = msg;
+    }
+
+    /* Return the buffers that were not filled */
+    for (i = count; i < num; i++) {
+        MessageQ_free(msgs[i]);
+    }
+
+    PRINTVERBOSE2("transportGet: recv socket: fd: %d, count: %d\n",
+                  sock, done)
+
+    return (done);
+}
+
+/*
+ * ======== TransportRpmsg_put ========
+ *
+ * Calls send(), or sendmmsg() for a burst, on the socket associated with
+ * this destination procID, MESSAGEQ_BATCHMAX messages at a time.  Messages
+ * too large for one rpmsg buffer are sent as fragments, by putFragments().
+ * As this is a copy transport, messages that were sent are freed; the rest
+ * are left with the caller.  Returns the number of messages sent.
+ *
+ * timeout is ignored: the rpmsg driver blocks the sender until the remote
+ * processor has a buffer free.
+ */
+static Int TransportRpmsg_put(IMessageQTransport_Handle handle,
+        MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId, UInt timeout)
+{
+    TransportRpmsg_Object * obj = (TransportRpmsg_Object *)handle;
+    struct mmsghdr vec[MESSAGEQ_BATCHMAX];
+    struct iovec   iov[MESSAGEQ_BATCHMAX];
+    UInt           sent = 0;
+    UInt           num;
+    UInt           i;
+    int            sock;
+    int            count;
+
+    sock = obj->sock[dstProcId];
+
+    while (sent < numMsgs) {
+        if (msgs[sent]->msgSize > TransportRpmsg_FRAGSIZE) {
+            if (!putFragments(obj, sock, msgs[sent])) {
+                break;
+            }
+            MessageQ_free(msgs[sent]);
+            sent++;
+            continue;
+        }
+
+        /* Batch up the messages that fit in one buffer each */
+        num = 1;
+        while (num < MIN(numMsgs - sent, MESSAGEQ_BATCHMAX) &&
+               msgs[sent + num]->msgSize <= TransportRpmsg_FRAGSIZE) {
+            num++;
+        }
+
+        PRINTVERBOSE2("Sending %d msgs via sock: %d\n", num, sock)
+
+        if (num == 1) {
+            count = send(sock, msgs[sent], msgs[sent]->msgSize, 0);
+            if (count >= 0) {
+                count = 1;
+            }
+        }
+        else {
+            memset(vec, 0, num * sizeof(vec[0]));
+            for (i = 0; i < num; i++) {
+                iov[i].iov_base = msgs[sent + i];
+                iov[i].iov_len  = msgs[sent + i]->msgSize;
+                vec[i].msg_hdr.msg_iov    = &iov[i];
+                vec[i].msg_hdr.msg_iovlen = 1;
+            }
+            count = sendmmsg(sock, vec, num, 0);
+        }
+
+        if (count < 0) {
+            printf ("transportPut: send failed: %d, %s\n",
+                      errno, strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < (UInt)count; i++) {
+            MessageQ_free(msgs[sent + i]);
+        }
+        sent += count;
+
+        if ((UInt)count < num) {
+            break;
+        }
+    }
+
+    return ((Int)sent);
+}
+
+
+/* =============================================================================
+ * Internal functions
+ * =============================================================================
+ */
+
+/*
+ * ======== putFragments ========
+ *
+ * Send a large message as a train of fragments.  All fragments are handed
+ * to the kernel back to back, MESSAGEQ_BATCHMAX per sendmmsg(), without
+ * waiting on the receiver.  Each fragment is gathered from a copy of the
+ * header and a piece of the message in place, so the payload isn't copied
+ * here.  Returns FALSE if the train could not be sent in full; any
+ * fragments already sent are discarded by the receiver.
+ */
+static Bool putFragments(TransportRpmsg_Object * obj, int sock,
+        MessageQ_Msg msg)
+{
+    MessageQ_MsgHeader hdr[MESSAGEQ_BATCHMAX];
+    struct mmsghdr     vec[MESSAGEQ_BATCHMAX];
+    struct iovec       iov[MESSAGEQ_BATCHMAX][2];
+    UInt8 *            payload = (UInt8 *)(msg + 1);
+    UInt32             payloadSize;
+    UInt32             offset;
+    UInt32             len;
+    UInt16             tag;
+    UInt               count;
+    UInt               index = 0;
+    UInt               num;
+    UInt               i;
+    int                ret;
+
+    payloadSize = msg->msgSize - sizeof(MessageQ_MsgHeader);
+    count = (payloadSize + TransportRpmsg_FRAGCHUNK - 1) /
+            TransportRpmsg_FRAGCHUNK;
+    if (count > TransportRpmsg_MAXFRAGS) {
+        printf("transportPut: message too large: %d\n", msg->msgSize);
+        return (FALSE);
+    }
+
+    tag = __sync_add_and_fetch(&obj->fragTag, 1);
+
+    PRINTVERBOSE3("Sending msg of size %d in %d fragments, tag %d\n",
+                  msg->msgSize, count, tag)
+
+    while (index < count) {
+        num = MIN(count - index, MESSAGEQ_BATCHMAX);
+        memset(vec, 0, num * sizeof(vec[0]));
+
+        for (i = 0; i < num; i++) {
+            offset = (index + i) * TransportRpmsg_FRAGCHUNK;
+            len = MIN(payloadSize - offset, TransportRpmsg_FRAGCHUNK);
+
+            hdr[i] = *msg;
+            hdr[i].flags    |= TransportRpmsg_FRAGFLAG;
+            hdr[i].reserved1 = TransportRpmsg_FRAGHDR(tag, index + i, count);
+
+            iov[i][0].iov_base = &hdr[i];
+            iov[i][0].iov_len  = sizeof(MessageQ_MsgHeader);
+            iov[i][1].iov_base = payload + offset;
+            iov[i][1].iov_len  = len;
+            vec[i].msg_hdr.msg_iov    = iov[i];
+            vec[i].msg_hdr.msg_iovlen = 2;
+        }
+
+        ret = sendmmsg(sock, vec, num, 0);
+        if (ret < 0) {
+            printf ("transportPut: send failed: %d, %s\n",
+                      errno, strerror(errno));
+            return (FALSE);
+        }
+        index += ret;
+        if ((UInt)ret < num) {
+            return (FALSE);
+        }
+    }
+
+    return (TRUE);
+}
+
+/*
+ * ======== reassemble ========
+ *
+ * Fold a received fragment into its message.  Returns the message once its
+ * last fragment is in, NULL otherwise.  The caller still owns frag.
+ *
+ * Fragments of one message arrive in order, but those of messages from
+ * different senders may interleave, so the message is found by its sender
+ * and tag.  Slots come from a fixed pool; if all are taken, the oldest
+ * message under reassembly is dropped to make room.  A message with a
+ * missing fragment is dropped too.
+ */
+static MessageQ_Msg reassemble(TransportRpmsg_Object * obj, int sock,
+        const struct sockaddr_rpmsg * from, MessageQ_Msg frag, UInt32 len)
+{
+    TransportRpmsg_Reassembly * slot = NULL;
+    TransportRpmsg_Reassembly * cur;
+    MessageQ_Msg                msg = NULL;
+    UInt32                      hdr = frag->reserved1;
+    UInt32                      chunk;
+    int                         i;
+
+    if (len < sizeof(MessageQ_MsgHeader)) {
+        return (NULL);
+    }
+    chunk = len - sizeof(MessageQ_MsgHeader);
+
+    pthread_mutex_lock(&obj->fragGate);
+
+    for (i = 0; i < TransportRpmsg_NUMREASSEMBLY; i++) {
+        cur = &obj->reassembly[i];
+        if (cur->msg != NULL && cur->sock == sock &&
+            cur->srcAddr == from->addr && cur->srcProc == from->vproc_id &&
+            cur->tag == TransportRpmsg_FRAGTAG(hdr)) {
+            slot = cur;
+            break;
+        }
+    }
+
+    if (TransportRpmsg_FRAGINDEX(hdr) == 0) {
+        /* First fragment; restarts a message that never completed */
+        if (slot != NULL) {
+            reassemblyDrop(slot);
+        }
+        else {
+            slot = &obj->reassembly[0];
+            for (i = 0; i < TransportRpmsg_NUMREASSEMBLY; i++) {
+                cur = &obj->reassembly[i];
+                if (cur->msg == NULL) {
+                    slot = cur;
+                    break;
+                }
+                if (cur->age < slot->age) {
+                    slot = cur;
+                }
+            }
+            if (slot->msg != NULL) {
+                PRINTVERBOSE1("reassemble: pool full, dropping tag %d\n",
+                              slot->tag)
+                reassemblyDrop(slot);
+            }
+        }
+
+        /* Every fragment but the last is full, so the sizes must agree */
+        slot->count = TransportRpmsg_FRAGCOUNT(hdr);
+        if (chunk == 0 || chunk > TransportRpmsg_FRAGCHUNK ||
+            frag->msgSize <= sizeof(MessageQ_MsgHeader) +
+                             (slot->count - 1) * chunk ||
+            frag->msgSize > sizeof(MessageQ_MsgHeader) +
+                            slot->count * chunk) {
+            PRINTVERBOSE1("reassemble: bad first fragment of tag %d, "
+                          "dropped\n", TransportRpmsg_FRAGTAG(hdr))
+            goto exit;
+        }
+
+        slot->msg = MessageQ_alloc(0, frag->msgSize);
+        if (slot->msg == NULL) {
+            printf("reassemble: out of memory, message dropped\n");
+            goto exit;
+        }
+        memcpy(slot->msg, frag, sizeof(MessageQ_MsgHeader));
+        slot->sock    = sock;
+        slot->srcAddr = from->addr;
+        slot->srcProc = from->vproc_id;
+        slot->tag     = TransportRpmsg_FRAGTAG(hdr);
+        slot->next    = 0;
+        slot->chunk   = chunk;
+        slot->size    = sizeof(MessageQ_MsgHeader);
+        slot->age     = ++obj->fragAge;
+    }
+    else if (slot == NULL) {
+        /* The rest of a message already dropped */
+        goto exit;
+    }
+
+    if (TransportRpmsg_FRAGINDEX(hdr) != slot->next ||
+        TransportRpmsg_FRAGCOUNT(hdr) != slot->count || chunk > slot->chunk ||
+        (slot->next + 1 < slot->count ? chunk < slot->chunk :
+         slot->size + chunk != slot->msg->msgSize)) {
+        PRINTVERBOSE2("reassemble: bad fragment %d of tag %d, dropped\n",
+                      TransportRpmsg_FRAGINDEX(hdr), slot->tag)
+        reassemblyDrop(slot);
+        goto exit;
+    }
+
+    memcpy((UInt8 *)slot->msg + slot->size, frag + 1, chunk);
+    slot->size += chunk;
+
+    if (++slot->next == slot->count) {
+        msg = slot->msg;
+        slot->msg = NULL;
+
+        msg->flags    &= ~TransportRpmsg_FRAGFLAG;
+        msg->reserved1 = 0;
+
+        /* As for a whole message, see TransportRpmsg_get() */
+        if (msg->heapId == MessageQ_STATICMSG)  {
+            msg->heapId = 0;
+        }
+    }
+
+exit:
+    pthread_mutex_unlock(&obj->fragGate);
+
+    return (msg);
+}
+
+/* Free a reassembly slot, and the partial message in it */
+static Void reassemblyDrop(TransportRpmsg_Reassembly * slot)
+{
+    MessageQ_free(slot->msg);
+    slot->msg = NULL;
+}
@@ -0,0 +1,907 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ *  @file   TransportShm.c
+ *
+ *  @brief  MessageQ transport between processes on the host processor
+ *
+ *  Each MessageQ owns a ring of fixed-size slots in a file mapped by the
+ *  owner and by every process sending to it.  Senders claim slots with a
+ *  compare-and-swap on the ring's enqueue position and copy the message in,
+ *  so no kernel round trip is needed per message.
+ *
+ *  A futex word in the ring throttles senders while it is full.  A futex
+ *  can't be waited on with epoll, though, so the receiver is woken through a
+ *  "doorbell": an abstract AF_UNIX datagram socket bound by the owner, which
+ *  senders ring only when the ring goes from idle to busy.
+ *
+ *  Ring files are created mode 0660, less the creator's umask, so only
+ *  processes sharing the owner's user or group can send to its queues.
+ *  The receiver checks every slot it takes, since any of them could have
+ *  written it.
+ *
+ *  A sender that dies after claiming a slot and before filling it would
+ *  stop the ring at that slot, so each claimed slot records the sender's
+ *  pid, and the receiver skips a slot stuck behind a sender that is gone.
+ *  The pid is only recorded just after the claim, so a sender dying in
+ *  between the two still stops the ring until its file is recreated (the
+ *  queue is deleted and created again).  Processes sharing a ring must
+ *  also share a pid namespace.
+ */
+
+
+/* Standard IPC header */
+#include <ti/ipc/Std.h>
+
+/* Linux specific header files, replacing OSAL: */
+#include <pthread.h>
+
+/* Module level headers */
+#include <ti/ipc/MultiProc.h>
+#include <_MultiProc.h>
+#include <ti/ipc/MessageQ.h>
+#include <_MessageQ.h>
+#include <_IMessageQTransport.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <_lad.h>
+
+/* =============================================================================
+ * Macros/Constants
+ * =============================================================================
+ */
+
+/* Where the ring files live; Android has no /dev/shm */
+#if defined(IPC_BUILDOS_ANDROID)
+#define TRANSPORTSHM_DIR         LAD_WORKINGDIR
+#else
+#define TRANSPORTSHM_DIR         "/dev/shm/"
+#endif
+
+#define TRANSPORTSHM_MAGIC       0x54534D52  /* 'TSMR' */
+
+/* Ring geometry; NUMSLOTS must be a power of 2 */
+#define TRANSPORTSHM_NUMSLOTS    256
+#define TRANSPORTSHM_MAXSIZE     512
+#define TRANSPORTSHM_CACHELINE   64
+
+/* Name of the ring file, and of the doorbell in the abstract namespace */
+#define TRANSPORTSHM_NAMEFMT     "tiipc_mq_%08x"
+#define TRANSPORTSHM_NAMELEN     32
+
+/* =============================================================================
+ * Structures & Enums
+ * =============================================================================
+ */
+
+/* One message slot.  seq tells producers and consumers whose turn it is. */
+typedef struct TransportShm_Slot {
+    volatile UInt32     seq;
+    UInt32              size;
+    volatile UInt32     owner;
+    /*!< pid of the sender that last claimed the slot */
+    volatile UInt32     ownerPos;
+    /*!< Position it claimed the slot for */
+    UInt8               data[TRANSPORTSHM_MAXSIZE];
+} TransportShm_Slot;
+
+/* Layout of a ring file; the positions sit on their own cache lines */
+typedef struct TransportShm_Ring {
+    UInt32              magic;
+    volatile UInt32     closed;
+    /*!< Set by the owner when the queue is deleted */
+    volatile UInt32     signaled;
+    /*!< Set while a doorbell byte is pending */
+    volatile int        spaceSeq;
+    /*!< Futex word, bumped when a full ring gets space */
+    volatile UInt32     waiters;
+    /*!< Number of senders waiting on spaceSeq */
+    UInt8               pad0[TRANSPORTSHM_CACHELINE - 5 * sizeof(UInt32)];
+    volatile UInt32     enqueuePos;
+    UInt8               pad1[TRANSPORTSHM_CACHELINE - sizeof(UInt32)];
+    volatile UInt32     dequeuePos;
+    UInt8               pad2[TRANSPORTSHM_CACHELINE - sizeof(UInt32)];
+    TransportShm_Slot   slots[TRANSPORTSHM_NUMSLOTS];
+} TransportShm_Ring;
+
+/* Receive endpoint, owned by the process that created the MessageQ */
+typedef struct TransportShm_Endpoint {
+    TransportShm_Ring * ring;
+    int                 bell;
+    /*!< Doorbell socket, also the fd MessageQ waits on */
+    char                path[sizeof(TRANSPORTSHM_DIR) + TRANSPORTSHM_NAMELEN];
+} TransportShm_Endpoint;
+
+/* Sender's mapping of another process's ring */
+typedef struct TransportShm_Peer {
+    TransportShm_Ring * ring;
+    int                 bell;
+    /*!< Socket connected to the owner's doorbell */
+    volatile UInt32     refCount;
+    /*!< One for peers[], plus one per put using it */
+} TransportShm_Peer;
+
+/* Transport instance; there is only one, for the host processor */
+typedef struct TransportShm_Object {
+    IMessageQTransport_Object base;
+    /*!< Interface header; must be first */
+    pthread_rwlock_t    peersLock;
+    /*!< Read-held to look up peers[], write-held to change it */
+    TransportShm_Peer ** peers;
+    /*!< Rings mapped for sending, indexed by queueIndex */
+    UInt32              numPeers;
+    /*!< Number of entries in peers[] */
+    Bool                attached;
+    /*!< Set between attach and detach */
+    volatile UInt32     numErrors;
+    /*!< Malformed slots dropped by the receiver */
+    UInt32              pid;
+    /*!< This process, recorded in the slots it claims */
+} TransportShm_Object;
+
+static Bool verbose = FALSE;
+
+
+/* =============================================================================
+ * Forward declarations of internal functions
+ * =============================================================================
+ */
+static Int TransportShm_attach(IMessageQTransport_Handle handle,
+        UInt16 rprocId);
+static Int TransportShm_detach(IMessageQTransport_Handle handle,
+        UInt16 rprocId);
+static Int TransportShm_openEndpoint(IMessageQTransport_Handle handle,
+        MessageQ_QueueId queueId, UInt16 rprocId, Ptr * endpoint, int * fd);
+static Void TransportShm_closeEndpoint(IMessageQTransport_Handle handle,
+        Ptr endpoint);
+static Int TransportShm_get(IMessageQTransport_Handle handle, Ptr endpoint,
+        MessageQ_Msg msgs[], UInt maxMsgs);
+static Int TransportShm_put(IMessageQTransport_Handle handle,
+        MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId, UInt timeout);
+
+static TransportShm_Ring * ringMap(const char * path, int flags);
+static Void ringName(char * buf, MessageQ_QueueId queueId, Bool abstract,
+        socklen_t * len);
+static Bool ringEnqueue(TransportShm_Ring * ring, MessageQ_Msg msg);
+static MessageQ_Msg ringDequeue(TransportShm_Ring * ring);
+static Bool ringAbandoned(TransportShm_Ring * ring, TransportShm_Slot * slot,
+        UInt32 pos);
+static Bool ringEmpty(TransportShm_Ring * ring);
+static Bool ringWait(TransportShm_Ring * ring, const struct timespec * start,
+        UInt timeout);
+static TransportShm_Peer * peerGet(TransportShm_Object * obj,
+        MessageQ_QueueId queueId, Bool remap);
+static Void peerRelease(TransportShm_Peer * peer);
+
+/* =============================================================================
+ *  Globals
+ * =============================================================================
+ */
+static const IMessageQTransport_Fxns TransportShm_fxns = {
+    .attach             = TransportShm_attach,
+    .detach             = TransportShm_detach,
+    .openEndpoint       = TransportShm_openEndpoint,
+    .closeEndpoint      = TransportShm_closeEndpoint,
+    .get                = TransportShm_get,
+    .put                = TransportShm_put,
+};
+
+static TransportShm_Object TransportShm_state =
+{
+    .base.fxns              = &TransportShm_fxns,
+    .peersLock              = PTHREAD_RWLOCK_INITIALIZER,
+    .peers                  = NULL,
+    .numPeers               = 0,
+    .attached               = FALSE,
+    .numErrors              = 0,
+    .pid                    = 0,
+};
+
+
+/* =============================================================================
+ * APIS
+ * =============================================================================
+ */
+/* Returns the shared memory transport instance. */
+IMessageQTransport_Handle TransportShm_handle(Void)
+{
+    return ((IMessageQTransport_Handle)&TransportShm_state);
+}
+
+/*
+ * ======== TransportShm_attach ========
+ *
+ *  Enable sending to other processes' queues.  Their rings are mapped on
+ *  first use, in TransportShm_put().
+ */
+static Int TransportShm_attach(IMessageQTransport_Handle handle,
+        UInt16 rprocId)
+{
+    TransportShm_Object * obj = (TransportShm_Object *)handle;
+    Int status = MessageQ_S_SUCCESS;
+
+    pthread_rwlock_wrlock(&obj->peersLock);
+
+    if (obj->attached) {
+        status = MessageQ_E_ALREADYEXISTS;
+    }
+    else {
+        obj->pid = getpid();
+        obj->attached = TRUE;
+    }
+
+    pthread_rwlock_unlock(&obj->peersLock);
+
+    return (status);
+}
+
+/*
+ * ======== TransportShm_detach ========
+ *
+ *  Unmap all rings mapped for sending, and close their doorbell sockets.
+ */
+static Int TransportShm_detach(IMessageQTransport_Handle handle,
+        UInt16 rprocId)
+{
+    TransportShm_Object * obj = (TransportShm_Object *)handle;
+    UInt32 i;
+
+    pthread_rwlock_wrlock(&obj->peersLock);
+
+    /* Puts still using a peer unmap it when they finish */
+    for (i = 0; i < obj->numPeers; i++) {
+        if (obj->peers[i] != NULL) {
+            peerRelease(obj->peers[i]);
+        }
+    }
+    free(obj->peers);
+    obj->peers = NULL;
+    obj->numPeers = 0;
+    obj->attached = FALSE;
+
+    pthread_rwlock_unlock(&obj->peersLock);
+
+    return (MessageQ_S_SUCCESS);
+}
+
+/*
+ * ======== TransportShm_openEndpoint ========
+ *
+ *  Create the ring file and doorbell for a new queue.  A file left behind
+ *  by a process that died with this queueId is replaced.
+ */
+static Int TransportShm_openEndpoint(IMessageQTransport_Handle handle,
+        MessageQ_QueueId queueId, UInt16 rprocId, Ptr * endpoint, int * fd)
+{
+    TransportShm_Endpoint * ep;
+    struct sockaddr_un      addr;
+    socklen_t               addrLen;
+    char                    name[TRANSPORTSHM_NAMELEN];
+
+    ep = (TransportShm_Endpoint *)calloc(1, sizeof(TransportShm_Endpoint));
+    if (ep == NULL) {
+        return (MessageQ_E_MEMORY);
+    }
+
+    /* Bind the doorbell first; it fails if the queueId is still in use */
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    ringName(addr.sun_path, queueId, TRUE, &addrLen);
+
+    ep->bell = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ep->bell < 0 || bind(ep->bell, (struct sockaddr *)&addr, addrLen)) {
+        PRINTVERBOSE2("TransportShm_openEndpoint: doorbell failed: %d, %s\n",
+                      errno, strerror(errno));
+        goto fail;
+    }
+
+    ringName(name, queueId, FALSE, NULL);
+    snprintf(ep->path, sizeof(ep->path), "%s%s", TRANSPORTSHM_DIR, name);
+    unlink(ep->path);
+
+    ep->ring = ringMap(ep->path, O_RDWR | O_CREAT | O_EXCL);
+    if (ep->ring == NULL) {
+        printf("TransportShm_openEndpoint: can't create %s: %d, %s\n",
+               ep->path, errno, strerror(errno));
+        goto fail;
+    }
+
+    PRINTVERBOSE2("TransportShm_openEndpoint: created %s, doorbell fd: %d\n",
+                  ep->path, ep->bell)
+
+    *endpoint = ep;
+    *fd = ep->bell;
+
+    return (MessageQ_S_SUCCESS);
+
+fail:
+    if (ep->bell >= 0) {
+        close(ep->bell);
+    }
+    free(ep);
+
+    return (MessageQ_E_FAIL);
+}
+
+/*
+ * ======== TransportShm_closeEndpoint ========
+ *
+ *  Mark the ring closed so cached senders let go of it, then remove it.
+ *  Messages still in the ring are dropped.
+ */
+static Void TransportShm_closeEndpoint(IMessageQTransport_Handle handle,
+        Ptr endpoint)
+{
+    TransportShm_Endpoint * ep = (TransportShm_Endpoint *)endpoint;
+
+    ep->ring->closed = 1;
+    __sync_synchronize();
+
+    /* Release any sender blocked on a full ring: */
+    __sync_fetch_and_add(&ep->ring->spaceSeq, 1);
+    syscall(SYS_futex, &ep->ring->spaceSeq, FUTEX_WAKE, 0x7FFFFFFF,
+            NULL, NULL, 0);
+
+    unlink(ep->path);
+    munmap(ep->ring, sizeof(TransportShm_Ring));
+    close(ep->bell);
+    free(ep);
+}
+
+/*
+ * ======== TransportShm_get ========
+ *
+ *  Copy up to maxMsgs messages out of the ring.  Never blocks.
+ *
+ *  The doorbell is only drained once the ring is seen empty, so it stays
+ *  readable while messages remain.  Clearing 'signaled' re-arms senders;
+ *  anything that slipped in just before that is caught by the second look
+ *  at the ring, and the doorbell is rung again on the senders' behalf.
+ */
+static Int TransportShm_get(IMessageQTransport_Handle handle, Ptr endpoint,
+        MessageQ_Msg msgs[], UInt maxMsgs)
+{
+    TransportShm_Endpoint * ep = (TransportShm_Endpoint *)endpoint;
+    TransportShm_Ring *     ring = ep->ring;
+    struct sockaddr_un      addr;
+    socklen_t               addrLen;
+    char                    byte;
+    UInt                    count = 0;
+
+    while (count < maxMsgs && (msgs[count] = ringDequeue(ring)) != NULL) {
+        count++;
+    }
+
+    /* Let senders waiting for space retry */
+    if (count > 0 && ring->waiters > 0) {
+        __sync_fetch_and_add(&ring->spaceSeq, 1);
+        syscall(SYS_futex, &ring->spaceSeq, FUTEX_WAKE, 0x7FFFFFFF,
+                NULL, NULL, 0);
+    }
+
+    if (ringEmpty(ring)) {
+        /*
+         * 'signaled' lets only one doorbell byte be pending, so one recv()
+         * is enough.  A stray byte from a sender that lost a race with
+         * this drain just causes one spurious wakeup later.
+         */
+        recv(ep->bell, &byte, sizeof(byte), MSG_DONTWAIT);
+        ring->signaled = 0;
+        __sync_synchronize();
+
+        if (!ringEmpty(ring) &&
+            __sync_lock_test_and_set(&ring->signaled, 1) == 0) {
+            addrLen = sizeof(addr);
+            getsockname(ep->bell, (struct sockaddr *)&addr, &addrLen);
+            sendto(ep->bell, &byte, 1, 0, (struct sockaddr *)&addr, addrLen);
+        }
+    }
+
+    PRINTVERBOSE2("TransportShm_get: %s, count: %d\n", ep->path, count)
+
+    return ((Int)count);
+}
+
+/*
+ * ======== TransportShm_put ========
+ *
+ *  Copy messages into the destination queue's ring, and ring its doorbell
+ *  if the receiver isn't already signaled.  Sent messages are freed; if
+ *  the ring stays full for timeout usecs, the rest are left with the
+ *  caller.  Returns the number of messages sent, or MessageQ_E_TIMEOUT if
+ *  that happened before any was.
+ *
+ *  peersLock is only held to find the peer and take a reference on it, so
+ *  a put waiting on a full ring doesn't hold up attach, detach or puts
+ *  that need to map a ring.
+ */
+static Int TransportShm_put(IMessageQTransport_Handle handle,
+        MessageQ_Msg msgs[], UInt numMsgs, UInt16 dstProcId, UInt timeout)
+{
+    TransportShm_Object * obj = (TransportShm_Object *)handle;
+    TransportShm_Peer *   peer;
+    TransportShm_Ring *   ring;
+    struct timespec       start = { 0, 0 };
+    MessageQ_QueueId      queueId;
+    UInt                  sent = 0;
+    Bool                  timedOut = FALSE;
+    char                  byte = 0;
+
+    if (numMsgs == 0) {
+        return (0);
+    }
+
+    queueId = ((MessageQ_QueueId)dstProcId << 16) | msgs[0]->dstId;
+
+    pthread_rwlock_rdlock(&obj->peersLock);
+
+    peer = peerGet(obj, queueId, FALSE);
+    if (peer == NULL || peer->ring->closed) {
+        /* Not mapped yet, or the queueIndex has since been reused */
+        pthread_rwlock_unlock(&obj->peersLock);
+        pthread_rwlock_wrlock(&obj->peersLock);
+        peer = peerGet(obj, queueId, TRUE);
+    }
+    if (peer == NULL) {
+        PRINTVERBOSE1("TransportShm_put: no queue 0x%x\n", queueId)
+        pthread_rwlock_unlock(&obj->peersLock);
+        return (0);
+    }
+    __sync_fetch_and_add(&peer->refCount, 1);
+
+    pthread_rwlock_unlock(&obj->peersLock);
+
+    ring = peer->ring;
+
+    while (sent < numMsgs && !ring->closed) {
+        if (msgs[sent]->msgSize > TRANSPORTSHM_MAXSIZE) {
+            printf("TransportShm_put: message too large: %d\n",
+                   msgs[sent]->msgSize);
+            break;
+        }
+        if (ringEnqueue(ring, msgs[sent])) {
+            MessageQ_free(msgs[sent]);
+            sent++;
+            continue;
+        }
+
+        /* Ring is full; wake the receiver before waiting on it */
+        if (sent > 0 && __sync_lock_test_and_set(&ring->signaled, 1) == 0) {
+            send(peer->bell, &byte, 1, 0);
+        }
+        if (start.tv_sec == 0 && start.tv_nsec == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+        if (!ringWait(ring, &start, timeout)) {
+            PRINTVERBOSE1("TransportShm_put: queue 0x%x is full\n", queueId)
+            timedOut = TRUE;
+            break;
+        }
+    }
+
+    __sync_synchronize();
+    if (sent > 0 && __sync_lock_test_and_set(&ring->signaled, 1) == 0) {
+        send(peer->bell, &byte, 1, 0);
+    }
+
+    peerRelease(peer);
+
+    return ((sent == 0 && timedOut) ? MessageQ_E_TIMEOUT : (Int)sent);
+}
+
+
+/* =============================================================================
+ * Internal functions
+ * =============================================================================
+ */
+
+/* Build the ring file name, or the doorbell's abstract socket name */
+static Void ringName(char * buf, MessageQ_QueueId queueId, Bool abstract,
+        socklen_t * len)
+{
+    int n;
+
+    if (abstract) {
+        /* Leading NUL puts the name in the abstract namespace */
+        buf[0] = '\0';
+        n = snprintf(buf + 1, TRANSPORTSHM_NAMELEN - 1, TRANSPORTSHM_NAMEFMT,
+                     queueId);
+        *len = offsetof(struct sockaddr_un, sun_path) + 1 + n;
+    }
+    else {
+        snprintf(buf, TRANSPORTSHM_NAMELEN, TRANSPORTSHM_NAMEFMT, queueId);
+    }
+}
+
+/*
+ *  Map a ring file.  With O_CREAT the file is sized and the ring
+ *  initialized; otherwise the file must already hold a valid ring.
+ */
+static TransportShm_Ring * ringMap(const char * path, int flags)
+{
+    TransportShm_Ring * ring;
+    struct stat         st;
+    UInt32              i;
+    int                 fd;
+
+    /* Senders must share the owner's user or group; see the file header */
+    fd = open(path, flags | O_CLOEXEC, 0660);
+    if (fd < 0) {
+        return (NULL);
+    }
+
+    if (flags & O_CREAT) {
+        if (ftruncate(fd, sizeof(TransportShm_Ring))) {
+            close(fd);
+            return (NULL);
+        }
+    }
+    else if (fstat(fd, &st) || st.st_size < (off_t)sizeof(TransportShm_Ring)) {
+        close(fd);
+        return (NULL);
+    }
+
+    ring = mmap(NULL, sizeof(TransportShm_Ring), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return (NULL);
+    }
+
+    if (flags & O_CREAT) {
+        for (i = 0; i < TRANSPORTSHM_NUMSLOTS; i++) {
+            ring->slots[i].seq = i;
+        }
+        __sync_synchronize();
+        ring->magic = TRANSPORTSHM_MAGIC;
+    }
+    else if (ring->magic != TRANSPORTSHM_MAGIC) {
+        munmap(ring, sizeof(TransportShm_Ring));
+        return (NULL);
+    }
+
+    return (ring);
+}
+
+/*
+ *  Claim the next free slot and copy msg into it.  A slot is free for
+ *  position pos when its seq equals pos, and holds a message for the
+ *  consumer when its seq equals pos + 1.  Returns FALSE if the ring is full.
+ */
+static Bool ringEnqueue(TransportShm_Ring * ring, MessageQ_Msg msg)
+{
+    TransportShm_Slot * slot;
+    UInt32              pos;
+    Int32               diff;
+
+    pos = ring->enqueuePos;
+    for (;;) {
+        slot = &ring->slots[pos & (TRANSPORTSHM_NUMSLOTS - 1)];
+        diff = (Int32)(slot->seq - pos);
+        if (diff == 0) {
+            if (__sync_bool_compare_and_swap(&ring->enqueuePos, pos,
+                                             pos + 1)) {
+                break;
+            }
+            pos = ring->enqueuePos;
+        }
+        else if (diff < 0) {
+            return (FALSE);
+        }
+        else {
+            pos = ring->enqueuePos;
+        }
+    }
+
+    /* So the receiver can tell if we die before filling the slot */
+    slot->owner = TransportShm_state.pid;
+    slot->ownerPos = pos;
+
+    memcpy(slot->data, msg, msg->msgSize);
+    slot->size = msg->msgSize;
+    __sync_synchronize();
+    slot->seq = pos + 1;
+
+    return (TRUE);
+}
+
+/*
+ *  Take the oldest message out of the ring; NULL if it is empty.  A slot
+ *  whose size doesn't fit the slot or match its message header is dropped
+ *  and counted in numErrors, as is one its sender died before filling.
+ */
+static MessageQ_Msg ringDequeue(TransportShm_Ring * ring)
+{
+    TransportShm_Slot * slot;
+    MessageQ_Msg        msg;
+    UInt32              pos;
+    UInt32              size;
+    Int32               diff;
+
+    pos = ring->dequeuePos;
+    for (;;) {
+        slot = &ring->slots[pos & (TRANSPORTSHM_NUMSLOTS - 1)];
+        diff = (Int32)(slot->seq - (pos + 1));
+        if (diff == 0) {
+            if (__sync_bool_compare_and_swap(&ring->dequeuePos, pos,
+                                             pos + 1)) {
+                break;
+            }
+            pos = ring->dequeuePos;
+        }
+        else if (diff < 0) {
+            if (!ringAbandoned(ring, slot, pos)) {
+                return (NULL);
+            }
+            if (__sync_bool_compare_and_swap(&ring->dequeuePos, pos,
+                                             pos + 1)) {
+                printf("TransportShm_get: sender %d died filling a slot, "
+                       "slot skipped\n", slot->owner);
+                __sync_fetch_and_add(&TransportShm_state.numErrors, 1);
+                __sync_synchronize();
+                slot->seq = pos + TRANSPORTSHM_NUMSLOTS;
+            }
+            pos = ring->dequeuePos;
+        }
+        else {
+            pos = ring->dequeuePos;
+        }
+    }
+
+    __sync_synchronize();
+
+    /*
+     * As with the rpmsg transport, the copy lands in a max size buffer from
+     * the largest pool size class.  If that fails, the message is dropped
+     * so the slot can't be lost.
+     */
+    size = slot->size;
+    if (size < sizeof(MessageQ_MsgHeader) || size > TRANSPORTSHM_MAXSIZE) {
+        printf("TransportShm_get: bad message size %d, message dropped\n",
+               size);
+        __sync_fetch_and_add(&TransportShm_state.numErrors, 1);
+        msg = NULL;
+    }
+    else if ((msg = MessageQ_alloc(0, TRANSPORTSHM_MAXSIZE)) != NULL) {
+        memcpy(msg, slot->data, size);
+
+        /* Checked on our copy, which the sender can't change any more */
+        if (msg->msgSize != size) {
+            printf("TransportShm_get: size %d doesn't match header's %d, "
+                   "message dropped\n", size, msg->msgSize);
+            __sync_fetch_and_add(&TransportShm_state.numErrors, 1);
+            msg->heapId = 0;
+            MessageQ_free(msg);
+            msg = NULL;
+        }
+        /* A static message on the sender's side is ours to free here */
+        else if (msg->heapId == MessageQ_STATICMSG) {
+            msg->heapId = 0;
+        }
+    }
+    else {
+        printf("TransportShm_get: out of memory, message dropped\n");
+    }
+
+    __sync_synchronize();
+    slot->seq = pos + TRANSPORTSHM_NUMSLOTS;
+
+    return (msg);
+}
+
+/*
+ *  Whether the slot at pos, which isn't filled yet, was claimed by a sender
+ *  that has since died.  Only checked once the position is claimed, which
+ *  a live sender fills right away.
+ */
+static Bool ringAbandoned(TransportShm_Ring * ring, TransportShm_Slot * slot,
+        UInt32 pos)
+{
+    if ((Int32)(ring->enqueuePos - pos) <= 0 || slot->ownerPos != pos ||
+        slot->owner == 0) {
+        return (FALSE);
+    }
+
+    /* EPERM is a live process of another user */
+    return (kill((pid_t)slot->owner, 0) == -1 && errno == ESRCH);
+}
+
+/* Whether the consumer would find nothing at the current dequeue position */
+static Bool ringEmpty(TransportShm_Ring * ring)
+{
+    UInt32 pos = ring->dequeuePos;
+
+    return (ring->slots[pos & (TRANSPORTSHM_NUMSLOTS - 1)].seq != pos + 1);
+}
+
+/*
+ *  Wait for the consumer to make space in a full ring.  Returns FALSE once
+ *  timeout usecs have passed since start; MessageQ_FOREVER never passes.
+ */
+static Bool ringWait(TransportShm_Ring * ring, const struct timespec * start,
+        UInt timeout)
+{
+    struct timespec   now;
+    struct timespec   rel;
+    struct timespec * relp = NULL;
+    int64_t           elapsedUs;
+    int64_t           leftUs;
+    UInt32            pos;
+    int               seq;
+
+    if (timeout != MessageQ_FOREVER) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsedUs = (int64_t)(now.tv_sec - start->tv_sec) * 1000000 +
+                    (now.tv_nsec - start->tv_nsec) / 1000;
+        leftUs = (int64_t)timeout - elapsedUs;
+        if (leftUs <= 0) {
+            return (FALSE);
+        }
+        rel.tv_sec = leftUs / 1000000;
+        rel.tv_nsec = (leftUs % 1000000) * 1000;
+        relp = &rel;
+    }
+
+    /* Register before re-checking, so the consumer can't miss us */
+    seq = ring->spaceSeq;
+    __sync_fetch_and_add(&ring->waiters, 1);
+    pos = ring->enqueuePos;
+    if (ring->slots[pos & (TRANSPORTSHM_NUMSLOTS - 1)].seq != pos &&
+        !ring->closed) {
+        /* Not shared-private: the consumer is another process */
+        syscall(SYS_futex, &ring->spaceSeq, FUTEX_WAIT, seq, relp, NULL, 0);
+    }
+    __sync_fetch_and_sub(&ring->waiters, 1);
+
+    return (TRUE);
+}
+
+/*
+ *  Find the mapping of queueId's ring.  With remap (peersLock write-held)
+ *  a missing or closed ring is mapped again; the peer table grows by
+ *  doubling, as MessageQ's local queue table does.
+ */
+static TransportShm_Peer * peerGet(TransportShm_Object * obj,
+        MessageQ_QueueId queueId, Bool remap)
+{
+    UInt16               queueIndex = (MessageQ_QueueIndex)queueId;
+    TransportShm_Peer ** peers;
+    TransportShm_Peer *  peer;
+    TransportShm_Ring *  ring;
+    struct sockaddr_un   addr;
+    socklen_t            addrLen;
+    UInt32               num;
+    int                  bell;
+    char                 name[TRANSPORTSHM_NAMELEN];
+    char                 path[sizeof(TRANSPORTSHM_DIR) + TRANSPORTSHM_NAMELEN];
+
+    if (!obj->attached) {
+        return (NULL);
+    }
+
+    if (!remap) {
+        if (queueIndex < obj->numPeers) {
+            return (obj->peers[queueIndex]);
+        }
+        return (NULL);
+    }
+
+    if (queueIndex >= obj->numPeers) {
+        num = MAX(obj->numPeers * 2, 16);
+        while (num <= queueIndex) {
+            num *= 2;
+        }
+        peers = realloc(obj->peers, num * sizeof(TransportShm_Peer *));
+        if (peers == NULL) {
+            return (NULL);
+        }
+        memset(&peers[obj->numPeers], 0,
+               (num - obj->numPeers) * sizeof(TransportShm_Peer *));
+        obj->peers = peers;
+        obj->numPeers = num;
+    }
+    else if (obj->peers[queueIndex] != NULL) {
+        if (!obj->peers[queueIndex]->ring->closed) {
+            /* Another sender remapped it first */
+            return (obj->peers[queueIndex]);
+        }
+        /* Puts still using the closed ring unmap it when they finish */
+        peerRelease(obj->peers[queueIndex]);
+        obj->peers[queueIndex] = NULL;
+    }
+
+    peer = (TransportShm_Peer *)malloc(sizeof(TransportShm_Peer));
+    if (peer == NULL) {
+        return (NULL);
+    }
+
+    ringName(name, queueId, FALSE, NULL);
+    snprintf(path, sizeof(path), "%s%s", TRANSPORTSHM_DIR, name);
+    ring = ringMap(path, O_RDWR);
+    if (ring == NULL) {
+        free(peer);
+        return (NULL);
+    }
+
+    /*
+     * Connect once, so ringing the doorbell needn't look the name up.  It
+     * is non-blocking, since a full doorbell means a wakeup is pending.
+     */
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    ringName(addr.sun_path, queueId, TRUE, &addrLen);
+    bell = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (bell < 0 || connect(bell, (struct sockaddr *)&addr, addrLen)) {
+        PRINTVERBOSE2("TransportShm_put: can't connect to doorbell: %d, %s\n",
+                      errno, strerror(errno));
+        if (bell >= 0) {
+            close(bell);
+        }
+        munmap(ring, sizeof(TransportShm_Ring));
+        free(peer);
+        return (NULL);
+    }
+
+    peer->ring = ring;
+    peer->bell = bell;
+    peer->refCount = 1;
+    obj->peers[queueIndex] = peer;
+
+    return (peer);
+}
+
+/* Drop a reference to a peer, unmapping its ring with the last one */
+static Void peerRelease(TransportShm_Peer * peer)
+{
+    if (__sync_sub_and_fetch(&peer->refCount, 1) == 0) {
+        munmap(peer->ring, sizeof(TransportShm_Ring));
+        close(peer->bell);
+        free(peer);
+    }
+}
@@ -49,10 +49,15 @@
 #include <sys/param.h>
 #include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <assert.h>
 
@@ -78,6 +83,34 @@
 
 #define INVALIDSOCKET     (-1)
 
+/*
+ * Each instance starts with this many slots in its tables, and doubles
+ * them whenever they would get more than 3/4 full.  Must be a power of 2.
+ */
+#define NameServer_INITTABLESIZE  16u
+
+/*
+ * Remote lookup cache: slots per instance (a power of 2), and how long an
+ * answer is kept, in msecs, unless overridden in LAD's environment by
+ * LAD_NAMESERVER_CACHETTL and LAD_NAMESERVER_NEGCACHETTL.  "Not found" and
+ * timeouts are kept only briefly, since the name may be added any moment.
+ * A TTL of 0 turns that kind of caching off.
+ */
+#define NameServer_CACHESIZE      64u
+#define NameServer_CACHETTL       1000u
+#define NameServer_NEGCACHETTL    10u
+
+/* CRC32C instructions, where the target has them */
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define NameServer_crc32cWord(crc, w)  _mm_crc32_u32((crc), (w))
+#define NameServer_crc32cByte(crc, b)  _mm_crc32_u8((crc), (b))
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define NameServer_crc32cWord(crc, w)  __crc32cw((crc), (w))
+#define NameServer_crc32cByte(crc, b)  __crc32cb((crc), (b))
+#endif
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
@@ -90,8 +123,6 @@ extern "C" {
 
 /* Structure of entry in Name/Value table */
 typedef struct NameServer_TableEntry_tag {
-    CIRCLEQ_ENTRY(NameServer_TableEntry_tag) elem;
-    /* List element */
     UInt32                    hash;
     /* Hash value */
     String                    name;
@@ -100,21 +131,86 @@ typedef struct NameServer_TableEntry_tag {
     /* Length of the value field. */
     Ptr                       value;
     /* Value portion of the name/value entry. */
-    Bool                      collide;
-    /* Does the hash collide? */
-    struct NameServer_TableEntry_tag * next;
-    /* Pointer to the next entry, used incase of collision only */
 } NameServer_TableEntry;
 
+/*
+ * Slot in one of an instance's open-addressing tables.  The hash is kept
+ * beside the entry pointer so a probe only touches an entry whose hash
+ * matches.  An empty slot has a NULL entry.
+ */
+typedef struct NameServer_Slot_tag {
+    UInt32                    hash;
+    /* Hash of the key the slot is filed under */
+    NameServer_TableEntry *   entry;
+    /* The entry, or NULL if the slot is empty */
+} NameServer_Slot;
+
+/*
+ * Internal node of an instance's name index, a crit-bit tree with the
+ * newest entry of each name at its leaves.  The names in child[1] have
+ * the bit of byte that otherBits leaves out set, those in child[0] don't,
+ * and all agree up to there, so the leaves are in strcmp() order.  A
+ * child pointer with bit 0 set is a node, otherwise it's an entry.
+ */
+typedef struct NameServer_IndexNode_tag {
+    Ptr                       child[2];
+    /* The two subtrees */
+    UInt32                    byte;
+    /* Offset of the first byte the subtrees' names differ in */
+    UInt8                     otherBits;
+    /* Every bit of that byte but the one they differ in */
+} NameServer_IndexNode;
+
+#define Index_isNode(p)     (((uintptr_t)(p) & 1) != 0)
+#define Index_node(p)       ((NameServer_IndexNode *)((uintptr_t)(p) - 1))
+#define Index_tag(node)     ((Ptr)((uintptr_t)(node) + 1))
+#define Index_dir(node, c)  ((1 + ((node)->otherBits | (c))) >> 8)
+
+/* A remote processor's answer for a name, kept until it expires */
+typedef struct NameServer_CacheEntry_tag {
+    uint64_t                  expiry;
+    /* CLOCK_MONOTONIC nsecs when the answer goes stale, 0 if unused */
+    Int                       status;
+    /* What NameServer_getRemote() returned */
+    UInt32                    value;
+    /* The value, if status says it was found */
+    UInt16                    procId;
+    /* Processor that answered */
+    Char                      name[MAXNAMEINCHAR];
+    /* Name that was looked up */
+} NameServer_CacheEntry;
+
+/* A NameServer_getRemote() call waiting for its reply */
+typedef struct NameServer_Pending_tag {
+    struct NameServer_Pending_tag * next;
+    /* Next request waiting */
+    UInt16                    procId;
+    /* Processor the request went to */
+    UInt32                    requestId;
+    /* Sent in the request, and echoed in its reply */
+    NameServerMsg *           msg;
+    /* The request, overwritten by its reply */
+    Bool                      done;
+    /* Set once the reply is in msg */
+} NameServer_Pending;
+
 /* Structure defining object for the NameServer */
 struct NameServer_Object {
     CIRCLEQ_ENTRY(NameServer_Object) elem;
-    CIRCLEQ_HEAD(dummy2, NameServer_TableEntry_tag) nameList;
+    NameServer_Slot *  names;           /* entries filed by name */
+    NameServer_Slot *  entries;         /* entries filed by address */
+    UInt32             tableSize;       /* slots in each table, power of 2 */
+    Ptr                index;           /* names in order, for prefixes */
     String             name;            /* name of the instance */
     NameServer_Params  params;          /* the parameter structure */
     UInt32             count;           /* count of entries */
     UInt32             refCount;        /* reference count to this object */
     pthread_mutex_t    gate;            /* crit sect gate */
+    NameServer_CacheEntry * cache;      /* remote answers, made on demand */
+    uint64_t           cacheTtl;        /* nsecs to keep a found name */
+    uint64_t           negCacheTtl;     /* nsecs to keep a missing one */
+    UInt32             cacheEpoch;      /* bumped when the cache is flushed */
+    NameServer_CacheStats cacheStats;   /* cache hit and miss counters */
 } NameServer_Object;
 
 /* structure for NameServer module state */
@@ -129,12 +225,30 @@ typedef struct NameServer_ModuleObject {
     /* Listener thread for NameServer replies and requests. */
     int                 unblockFd;
     /* Event to post to exit listener. */
-    int                 waitFd;
-    /* Event to post to NameServer_get. */
-    NameServerMsg       nsMsg;
-    /* NameServer Message cache. */
+    NameServer_Pending * pending;
+    /* Remote requests waiting for replies, matched by processor and ID */
+    pthread_mutex_t     pendingGate;
+    /* Protects pending */
+    pthread_cond_t      replyCond;
+    /* Broadcast by the listener when it completes a pending request */
+    UInt32              nextRequestId;
+    /* ID for the next remote request; protected by pendingGate */
     NameServer_Params   defInstParams;
     /* Default instance paramters */
+    UInt32              cacheTtl;
+    /* Msecs new instances keep a remote processor's answer */
+    UInt32              negCacheTtl;
+    /* Msecs new instances keep a "not found" or timeout from a remote */
+    NameServer_AddFxn   addFxn;
+    /* Called with each name added, locally or by a remote's announcement */
+    volatile Bool       announces[MultiProc_MAXPROCESSORS];
+    /* Remotes that have sent a NAMESERVER_ANNOUNCE since setup */
+    LAD_NSMirror *      mirror;
+    /* Clients' read-only copy of the UInt32 entries, NULL if not mapped */
+    UInt32              mirrorCount;
+    /* Slots in use in the mirror */
+    pthread_mutex_t     mirrorGate;
+    /* Serializes writers of the mirror; taken inside an instance's gate */
     pthread_mutex_t     modGate;
 } NameServer_ModuleObject;
 
@@ -174,6 +288,11 @@ static NameServer_ModuleObject NameServer_state = {
 // only _NP (non-portable) type available in CG tools which we're using
     .modGate                         = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,
 #endif
+    .pending                         = NULL,
+    .pendingGate                     = PTHREAD_MUTEX_INITIALIZER,
+    .replyCond                       = PTHREAD_COND_INITIALIZER,
+    .mirror                          = NULL,
+    .mirrorGate                      = PTHREAD_MUTEX_INITIALIZER,
     .refCount                        = 0
 };
 
@@ -225,26 +344,661 @@ static const UInt32 stringCrcTab[256u] = {
   0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 };
 
+/*
+ * Hash a name.  This uses the CRC32C instructions when the daemon is built
+ * for a target that has them (e.g. -msse4.2, or -march=armv8-a+crc), and a
+ * table-driven CRC-32 otherwise.  The hashes never leave the daemon, so
+ * the two don't need to agree.
+ */
 static UInt32 stringHash(String s)
 {
-    UInt32 hash = strlen(s);
+    UInt32 hash = 0xffffffff;
+#if defined(NameServer_crc32cWord)
+    size_t len = strlen(s);
+    UInt32 word;
+
+    for (; len >= sizeof(word); len -= sizeof(word), s += sizeof(word)) {
+        memcpy(&word, s, sizeof(word));
+        hash = NameServer_crc32cWord(hash, word);
+    }
+    for (; len > 0; len--, s++) {
+        hash = NameServer_crc32cByte(hash, (UInt8)*s);
+    }
+#else
+    for (; *s != '\0'; s++) {
+        hash = (hash >> 8u) ^ stringCrcTab[(hash ^ (UInt8)*s) & 0xff];
+    }
+#endif
+
+    return (~hash);
+}
+
+/* Hash an entry's address, for the table NameServer_removeEntry() uses */
+static inline UInt32 entryHash(NameServer_TableEntry * entry)
+{
+    UInt32 hash = (UInt32)((uintptr_t)entry >> 4) * 0x9e3779b1u;
+
+    return (hash ^ (hash >> 16));
+}
+
+/*
+ * Find the slot holding the entry named name, or return -1.  If there are
+ * duplicates of the name, the newest one is found first.
+ */
+static Int findName(NameServer_Handle handle, String name, UInt32 hash)
+{
+    UInt32 mask = handle->tableSize - 1;
+    UInt32 i;
+
+    for (i = hash & mask; handle->names[i].entry != NULL; i = (i + 1) & mask) {
+        if (handle->names[i].hash == hash &&
+            strcmp(handle->names[i].entry->name, name) == 0) {
+            return ((Int)i);
+        }
+    }
+
+    return (-1);
+}
+
+/* Find the slot in table holding entry, or return -1 */
+static Int findEntry(NameServer_Slot * table, UInt32 size, UInt32 hash,
+                     NameServer_TableEntry * entry)
+{
+    UInt32 mask = size - 1;
+    UInt32 i;
+
+    for (i = hash & mask; table[i].entry != NULL; i = (i + 1) & mask) {
+        if (table[i].entry == entry) {
+            return ((Int)i);
+        }
+    }
+
+    return (-1);
+}
+
+/* File entry under hash in the first free slot of its probe sequence */
+static UInt32 insertSlot(NameServer_Slot * table, UInt32 size, UInt32 hash,
+                         NameServer_TableEntry * entry)
+{
+    UInt32 mask = size - 1;
+    UInt32 i;
+
+    for (i = hash & mask; table[i].entry != NULL; i = (i + 1) & mask) {
+    }
+    table[i].hash = hash;
+    table[i].entry = entry;
+
+    return (i);
+}
+
+/*
+ * Empty slot i, then move later entries of the run back over the hole
+ * wherever that brings them no further than their home slot, so that no
+ * probe sequence is broken and no tombstones are needed.
+ */
+static void removeSlot(NameServer_Slot * table, UInt32 size, UInt32 i)
+{
+    UInt32 mask = size - 1;
+    UInt32 j = i;
+    UInt32 home;
+
+    for (;;) {
+        table[i].entry = NULL;
+        do {
+            j = (j + 1) & mask;
+            if (table[j].entry == NULL) {
+                return;
+            }
+            home = table[j].hash & mask;
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+        table[i] = table[j];
+        i = j;
+    }
+}
+
+/* Refile every entry of an instance into tables of newSize slots */
+static Int resizeTables(NameServer_Handle handle, UInt32 newSize)
+{
+    NameServer_Slot * names;
+    NameServer_Slot * entries;
+    NameServer_TableEntry * entry;
+    UInt32 mask = handle->tableSize - 1;
+    UInt32 start;
+    UInt32 i;
+
+    names = (NameServer_Slot *)calloc(newSize, sizeof(NameServer_Slot));
+    entries = (NameServer_Slot *)calloc(newSize, sizeof(NameServer_Slot));
+    if (names == NULL || entries == NULL) {
+        free(names);
+        free(entries);
+        return (NameServer_E_MEMORY);
+    }
+
+    for (i = 0; i < handle->tableSize; i++) {
+        entry = handle->entries[i].entry;
+        if (entry != NULL) {
+            insertSlot(entries, newSize, handle->entries[i].hash, entry);
+        }
+    }
+
+    /*
+     * Walk the names in probe order, starting after an empty slot, so
+     * that duplicate names are refiled in the order they're found in.
+     */
+    for (start = 0; handle->names[start].entry != NULL; start++) {
+    }
+    for (i = (start + 1) & mask; i != start; i = (i + 1) & mask) {
+        entry = handle->names[i].entry;
+        if (entry != NULL) {
+            insertSlot(names, newSize, entry->hash, entry);
+        }
+    }
+
+    free(handle->names);
+    free(handle->entries);
+    handle->names = names;
+    handle->entries = entries;
+    handle->tableSize = newSize;
+
+    return (NameServer_S_SUCCESS);
+}
+
+/*
+ * Find where the index keeps the first len characters of name, as a name
+ * of its own, or return NULL if they aren't there.
+ */
+static Ptr * indexFind(NameServer_Handle handle, String name, UInt32 len)
+{
+    const UInt8 * key = (const UInt8 *)name;
+    NameServer_IndexNode * node;
+    NameServer_TableEntry * entry;
+    Ptr * where = &handle->index;
+
+    if (*where == NULL) {
+        return (NULL);
+    }
+
+    while (Index_isNode(*where)) {
+        node = Index_node(*where);
+        where = &node->child[Index_dir(node,
+                                       node->byte < len ? key[node->byte] : 0)];
+    }
+
+    entry = (NameServer_TableEntry *)*where;
+    if (strncmp(entry->name, name, len) != 0 || entry->name[len] != '\0') {
+        return (NULL);
+    }
+
+    return (where);
+}
+
+/*
+ * Put entry in the index as the newest of its name.  Fails, changing
+ * nothing, only if a node can't be allocated.
+ */
+static Int indexInsert(NameServer_Handle handle, NameServer_TableEntry * entry)
+{
+    const UInt8 * key = (const UInt8 *)entry->name;
+    const UInt8 * other;
+    NameServer_IndexNode * node;
+    NameServer_IndexNode * q;
+    Ptr * where;
+    Ptr p = handle->index;
+    UInt32 len = strlen(entry->name);
+    UInt32 newByte;
+    UInt32 newOtherBits;
+    UInt32 dir;
+
+    if (p == NULL) {
+        handle->index = entry;
+        return (NameServer_S_SUCCESS);
+    }
+
+    /* Find the name that shares the longest beginning with this one */
+    while (Index_isNode(p)) {
+        node = Index_node(p);
+        p = node->child[Index_dir(node, node->byte < len ? key[node->byte] : 0)];
+    }
+    other = (const UInt8 *)((NameServer_TableEntry *)p)->name;
+
+    for (newByte = 0; newByte < len && other[newByte] == key[newByte];
+         newByte++) {
+    }
+    newOtherBits = other[newByte] ^ key[newByte];
+
+    if (newOtherBits == 0) {
+        /* the name is there already; this entry hides the older ones */
+        *indexFind(handle, entry->name, len) = entry;
+        return (NameServer_S_SUCCESS);
+    }
+
+    /* Keep only the highest bit they differ in, and invert */
+    while ((newOtherBits & (newOtherBits - 1)) != 0) {
+        newOtherBits &= newOtherBits - 1;
+    }
+    newOtherBits ^= 0xFF;
+    dir = (1 + (newOtherBits | other[newByte])) >> 8;
+
+    node = (NameServer_IndexNode *)malloc(sizeof(NameServer_IndexNode));
+    if (node == NULL) {
+        return (NameServer_E_MEMORY);
+    }
+    node->byte = newByte;
+    node->otherBits = (UInt8)newOtherBits;
+    node->child[1 - dir] = entry;
+
+    /* Nodes are ordered by the bit they test, so hang it where it fits */
+    where = &handle->index;
+    while (Index_isNode(*where)) {
+        q = Index_node(*where);
+        if (q->byte > newByte ||
+            (q->byte == newByte && q->otherBits > newOtherBits)) {
+            break;
+        }
+        where = &q->child[Index_dir(q, q->byte < len ? key[q->byte] : 0)];
+    }
+
+    node->child[dir] = *where;
+    *where = Index_tag(node);
+
+    return (NameServer_S_SUCCESS);
+}
+
+/*
+ * Bring the index up to date for name once an entry of it is removed from
+ * the tables: the newest entry left takes its place, if there is one.
+ */
+static Void indexUpdate(NameServer_Handle handle, String name, UInt32 hash)
+{
+    const UInt8 * key = (const UInt8 *)name;
+    NameServer_IndexNode * node = NULL;
+    Ptr * parent = NULL;
+    Ptr * where = &handle->index;
+    UInt32 len = strlen(name);
+    UInt32 dir = 0;
+    Int i;
+
+    i = findName(handle, name, hash);
+    if (i >= 0) {
+        where = indexFind(handle, name, len);
+        assert(where != NULL);
+        *where = handle->names[i].entry;
+        return;
+    }
+
+    /* That was the last of it, so take the leaf out, and its parent node */
+    if (*where == NULL) {
+        return;
+    }
+    while (Index_isNode(*where)) {
+        parent = where;
+        node = Index_node(*where);
+        dir = Index_dir(node, node->byte < len ? key[node->byte] : 0);
+        where = &node->child[dir];
+    }
+
+    if (strcmp(((NameServer_TableEntry *)*where)->name, name) != 0) {
+        return;
+    }
+
+    if (parent == NULL) {
+        handle->index = NULL;
+    }
+    else {
+        *parent = node->child[1 - dir];
+        free(node);
+    }
+}
+
+/* The entry of the subtree p whose name comes first, or last */
+static NameServer_TableEntry * indexEnd(Ptr p, UInt32 dir)
+{
+    while (Index_isNode(p)) {
+        p = Index_node(p)->child[dir];
+    }
+
+    return ((NameServer_TableEntry *)p);
+}
+
+/*
+ * Copy the names of subtree p that come after after (all of them if after
+ * is NULL) into entries, in order, until there are max; return how many
+ * there are.  Subtrees wholly before after aren't walked.
+ */
+static UInt32 indexCollect(Ptr p, String after, NameServer_EnumEntry entries[],
+                           UInt32 count, UInt32 max)
+{
+    NameServer_TableEntry * entry;
+    Ptr child;
+    String from;
+    UInt32 dir;
+
+    if (!Index_isNode(p)) {
+        entry = (NameServer_TableEntry *)p;
+        if ((after == NULL || strcmp(entry->name, after) > 0) &&
+            strlen(entry->name) < NameServer_ENUMNAMELEN) {
+            strcpy(entries[count].name, entry->name);
+            entries[count].value = (entry->len == sizeof(UInt32)) ?
+                                   *(UInt32 *)entry->value : 0;
+            count++;
+        }
+        return (count);
+    }
+
+    for (dir = 0; dir < 2 && count < max; dir++) {
+        child = Index_node(p)->child[dir];
+        from = after;
+        if (from != NULL) {
+            if (strcmp(indexEnd(child, 1)->name, from) <= 0) {
+                continue;
+            }
+            if (strcmp(indexEnd(child, 0)->name, from) > 0) {
+                from = NULL;
+            }
+        }
+        count = indexCollect(child, from, entries, count, max);
+    }
+
+    return (count);
+}
+
+/* Create the mirror file and map it, leaving it empty */
+static Void mirrorCreate(Void)
+{
+    LAD_NSMirror * mirror;
+    int fd;
+
+    unlink(LAD_NSMIRRORPATH);
+    fd = open(LAD_NSMIRRORPATH, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        LOG1("mirrorCreate: can't create mirror: %s\n", strerror(errno))
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(LAD_NSMirror)) < 0) {
+        LOG1("mirrorCreate: can't size mirror: %s\n", strerror(errno))
+        close(fd);
+        unlink(LAD_NSMIRRORPATH);
+        return;
+    }
+
+    mirror = mmap(NULL, sizeof(LAD_NSMirror), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+    close(fd);
+    if (mirror == MAP_FAILED) {
+        LOG1("mirrorCreate: can't map mirror: %s\n", strerror(errno))
+        unlink(LAD_NSMIRRORPATH);
+        return;
+    }
+
+    /* a new file is all zeroes: every slot empty, and seq even */
+    mirror->magic = LAD_NSMIRRORMAGIC;
+    NameServer_module->mirror = mirror;
+    NameServer_module->mirrorCount = 0;
+}
+
+/* Unmap the mirror and remove its file, so no new client maps it */
+static Void mirrorDestroy(Void)
+{
+    if (NameServer_module->mirror != NULL) {
+        unlink(LAD_NSMIRRORPATH);
+        munmap(NameServer_module->mirror, sizeof(LAD_NSMirror));
+        NameServer_module->mirror = NULL;
+    }
+}
+
+/*
+ * Bring the mirror's slot for name in handle up to date with the tables:
+ * it holds the value of the newest entry of that name if the value is a
+ * UInt32, and is empty otherwise.  Called with the instance's gate held,
+ * after the tables have been changed.
+ */
+static Void mirrorUpdate(NameServer_Handle handle, String name, UInt32 hash)
+{
+    LAD_NSMirror * mirror = NameServer_module->mirror;
+    LAD_NSMirrorSlot * slot;
+    NameServer_TableEntry * entry = NULL;
+    uint64_t key = (uint64_t)(uintptr_t)handle;
+    UInt32 mask = LAD_NSMIRRORSIZE - 1;
+    UInt32 mhash;
+    UInt32 home;
+    UInt32 i;
+    UInt32 j;
+    Int k;
+
+    if (mirror == NULL || strlen(name) >= LAD_NSMIRRORNAMELEN) {
+        return;
+    }
+
+    k = findName(handle, name, hash);
+    if (k >= 0 && handle->names[k].entry->len == sizeof(UInt32)) {
+        entry = handle->names[k].entry;
+    }
+
+    mhash = LAD_nsMirrorHash(key, name);
+
+    pthread_mutex_lock(&NameServer_module->mirrorGate);
+
+    for (i = mhash & mask; mirror->slots[i].hash != 0; i = (i + 1) & mask) {
+        slot = &mirror->slots[i];
+        if (slot->hash == mhash && slot->handle == key &&
+            strcmp(slot->name, name) == 0) {
+            break;
+        }
+    }
+    slot = &mirror->slots[i];
+
+    if (entry == NULL && slot->hash == 0) {
+        goto exit;
+    }
+
+    /* Past 3/4 full a name is left for clients to ask LAD about */
+    if (entry != NULL && slot->hash == 0 &&
+        (NameServer_module->mirrorCount + 1) * 4 > LAD_NSMIRRORSIZE * 3) {
+        LOG1("mirrorUpdate: mirror full, not mirroring '%s'\n", name)
+        goto exit;
+    }
+
+    /* readers retry a lookup that overlaps with this */
+    mirror->seq++;
+    __sync_synchronize();
+
+    if (entry != NULL) {
+        if (slot->hash == 0) {
+            slot->handle = key;
+            strcpy(slot->name, name);
+            slot->hash = mhash;
+            NameServer_module->mirrorCount++;
+        }
+        slot->value = *(UInt32 *)entry->value;
+    }
+    else {
+        /* empty the slot, moving back entries like removeSlot() does */
+        j = i;
+        for (;;) {
+            mirror->slots[i].hash = 0;
+            do {
+                j = (j + 1) & mask;
+                if (mirror->slots[j].hash == 0) {
+                    goto removed;
+                }
+                home = mirror->slots[j].hash & mask;
+            } while (i <= j ? (i < home && home <= j) :
+                     (i < home || home <= j));
+            memcpy((Ptr)&mirror->slots[i], (Ptr)&mirror->slots[j],
+                   sizeof(LAD_NSMirrorSlot));
+            i = j;
+        }
+removed:
+        NameServer_module->mirrorCount--;
+    }
+
+    __sync_synchronize();
+    mirror->seq++;
+
+exit:
+    pthread_mutex_unlock(&NameServer_module->mirrorGate);
+}
+
+/* The time, in nsecs, for stamping cache entries */
+static uint64_t cacheTime(Void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000u + now.tv_nsec);
+}
+
+/* The slot in an instance's cache for name as answered by procId */
+static NameServer_CacheEntry * cacheSlot(NameServer_Handle handle,
+                                         String name, UInt16 procId)
+{
+    UInt32 i = (stringHash(name) + procId * 0x9e3779b1u) &
+               (NameServer_CACHESIZE - 1);
+
+    return (&handle->cache[i]);
+}
+
+/*
+ * Look for procId's answer for name in the cache.  If there is one that
+ * hasn't expired, return its status and put any value in value.  Otherwise
+ * return NameServer_E_NOTFOUND with *found FALSE.  Called with the
+ * instance's gate held.
+ */
+static Int cacheLookup(NameServer_Handle handle, String name, UInt16 procId,
+                       UInt32 * value, Bool * found)
+{
+    NameServer_CacheEntry * entry;
+
+    *found = FALSE;
+    if (handle->cache == NULL) {
+        return (NameServer_E_NOTFOUND);
+    }
+
+    entry = cacheSlot(handle, name, procId);
+    if (entry->expiry == 0 || entry->procId != procId ||
+        strncmp(entry->name, name, MAXNAMEINCHAR) != 0) {
+        return (NameServer_E_NOTFOUND);
+    }
+    if (entry->expiry <= cacheTime()) {
+        entry->expiry = 0;
+        return (NameServer_E_NOTFOUND);
+    }
+
+    *found = TRUE;
+    if (entry->status >= 0) {
+        *value = entry->value;
+    }
+
+    return (entry->status);
+}
+
+/* Keep procId's answer for name, if it's the kind that is cached */
+static Void cacheStore(NameServer_Handle handle, String name, UInt16 procId,
+                       Int status, UInt32 value)
+{
+    NameServer_CacheEntry * entry;
+    uint64_t ttl;
+
+    if (status >= 0) {
+        ttl = handle->cacheTtl;
+    }
+    else if (status == NameServer_E_NOTFOUND ||
+             status == NameServer_E_TIMEOUT) {
+        ttl = handle->negCacheTtl;
+    }
+    else {
+        ttl = 0;
+    }
+
+    if (ttl == 0) {
+        return;
+    }
+
+    if (handle->cache == NULL) {
+        handle->cache = (NameServer_CacheEntry *)calloc(NameServer_CACHESIZE,
+            sizeof(NameServer_CacheEntry));
+        if (handle->cache == NULL) {
+            return;
+        }
+    }
+
+    entry = cacheSlot(handle, name, procId);
+    entry->expiry = cacheTime() + ttl;
+    entry->status = status;
+    entry->value = value;
+    entry->procId = procId;
+    strncpy(entry->name, name, MAXNAMEINCHAR - 1);
+    entry->name[MAXNAMEINCHAR - 1] = '\0';
+}
+
+/*
+ * Drop every processor's cached answer for name, or, if name is NULL,
+ * everything procId answered.  Lookups already in flight don't cache
+ * their answers.  Called with the instance's gate held.
+ */
+static Void cacheFlush(NameServer_Handle handle, String name, UInt16 procId)
+{
     UInt32 i;
 
-    for (i = 0; i < strlen(s); i++) {
-        hash = (hash >> 8u) ^ stringCrcTab[(hash & 0xff)] ^ s[i];
+    handle->cacheEpoch++;
+
+    if (handle->cache == NULL) {
+        return;
+    }
+
+    for (i = 0; i < NameServer_CACHESIZE; i++) {
+        if (name != NULL ?
+            strncmp(handle->cache[i].name, name, MAXNAMEINCHAR) == 0 :
+            handle->cache[i].procId == procId) {
+            handle->cache[i].expiry = 0;
+        }
+    }
+}
+
+/*
+ * Forget what procId has told any instance.  Called when communication
+ * with it fails, as it does when it is stopped or crashes, since a new
+ * image may not have the same names or queues.
+ */
+static Void cacheFlushProc(UInt16 procId)
+{
+    struct NameServer_Object * elem;
+
+    LOG1("NameServer: flushing names cached from procId %d\n", procId)
+
+    pthread_mutex_lock(&NameServer_module->modGate);
+
+    CIRCLEQ_traverse(elem, &NameServer_module->objList, NameServer_Object) {
+        pthread_mutex_lock(&elem->gate);
+        cacheFlush(elem, NULL, procId);
+        pthread_mutex_unlock(&elem->gate);
     }
 
-    return (hash);
+    pthread_mutex_unlock(&NameServer_module->modGate);
 }
 
-static void NameServerRemote_processMessage(NameServerMsg * msg, UInt16 procId)
+/* Read a cache TTL, in msecs, from LAD's environment */
+static UInt32 cacheTtlEnv(const char * var, UInt32 dflt)
+{
+    char * str = getenv(var);
+
+    if (str == NULL || *str == '\0') {
+        return (dflt);
+    }
+
+    return ((UInt32)strtoul(str, NULL, 0));
+}
+
+static void NameServerRemote_processMessage(NameServerMsg * msg, UInt16 procId,
+                                            Bool hasId)
 {
     NameServer_Handle handle;
     Int               status = NameServer_E_FAIL;
     int               err;
-    uint64_t          buf = 1;
-    int               numBytes;
-    int               waitFd = NameServer_module->waitFd;
+    NameServer_Pending * pending;
+    NameServer_Pending * match;
 
     if (msg->request == NAMESERVER_REQUEST) {
         LOG2("NameServer Request: instanceName: %s, name: %s\n",
@@ -286,16 +1040,81 @@ static void NameServerRemote_processMessage(NameServerMsg * msg, UInt16 procId)
             LOG2("NameServer: send failed: %d, %s\n", errno, strerror(errno))
         }
     }
+    else if (msg->request == NAMESERVER_ANNOUNCE) {
+        LOG2("NameServer Announce: instanceName: %s, name: %s",
+             (String)msg->instanceName, (String)msg->name)
+        LOG1(" %s\n", msg->requestStatus ? "added" : "removed")
+
+        /* its names needn't be polled for any more */
+        NameServer_module->announces[procId] = TRUE;
+
+        /* no instance here means nobody has asked about the name */
+        handle = NameServer_getHandle((String)msg->instanceName);
+        if (handle == NULL) {
+            return;
+        }
+
+        /*
+         * Whatever was cached for the name is now out of date, and so is
+         * the answer of any lookup in flight.  An added UInt32 value is
+         * as good as a reply from the remote.
+         */
+        pthread_mutex_lock(&handle->gate);
+        cacheFlush(handle, (String)msg->name, procId);
+        if (msg->requestStatus && msg->valueLen <= sizeof(Bits32)) {
+            cacheStore(handle, (String)msg->name, procId,
+                       NameServer_S_SUCCESS, msg->value);
+        }
+        pthread_mutex_unlock(&handle->gate);
+
+        if (msg->requestStatus && NameServer_module->addFxn != NULL) {
+            NameServer_module->addFxn(handle, (String)msg->name);
+        }
+    }
     else {
         LOG2("NameServer Reply: instanceName: %s, name: %s",
              (String)msg->instanceName, (String)msg->name)
         LOG1(", value: 0x%x\n", msg->value)
 
-        /* Save the response message.  */
-        memcpy(&NameServer_module->nsMsg, msg, sizeof(NameServerMsg));
+        /*
+         * Hand the reply to the request it answers.  The remote echoes the
+         * whole request, requestId and all.  A remote built before there
+         * was a requestId echoes a shorter message; it answers in order,
+         * so its reply goes to the oldest request for the same names.
+         */
+        pthread_mutex_lock(&NameServer_module->pendingGate);
 
-        /* Post the eventfd upon which NameServer_get() is waiting */
-        numBytes = write(waitFd, &buf, sizeof(uint64_t));
+        match = NULL;
+        for (pending = NameServer_module->pending; pending != NULL;
+             pending = pending->next) {
+            if (pending->done || pending->procId != procId) {
+                continue;
+            }
+            if (hasId) {
+                if (pending->requestId == msg->requestId) {
+                    match = pending;
+                    break;
+                }
+            }
+            else if (strncmp((char *)pending->msg->instanceName,
+                             (char *)msg->instanceName, MAXNAMEINCHAR) == 0 &&
+                     strncmp((char *)pending->msg->name, (char *)msg->name,
+                             MAXNAMEINCHAR) == 0) {
+                /* newest first, so keep going */
+                match = pending;
+            }
+        }
+
+        if (match != NULL) {
+            memcpy(match->msg, msg, sizeof(NameServerMsg));
+            match->done = TRUE;
+            pthread_cond_broadcast(&NameServer_module->replyCond);
+        }
+        else {
+            LOG0("NameServer: no request waiting for reply, dropped\n")
+        }
+
+        pthread_mutex_unlock(&NameServer_module->pendingGate);
     }
 }
 
@@ -360,6 +1179,7 @@ static void *listener_cb(void *arg)
                 }
                 if (byteCount < 0) {
                     LOG2("recvfrom failed: %s (%d)\n", strerror(errno), errno)
+                    cacheFlushProc(procId);
                     break;
                 }
                 else {
@@ -367,7 +1187,8 @@ static void *listener_cb(void *arg)
                     LOG2("\tReceived ns msg: byteCount: %d, from addr: %d, ",
                          byteCount, fromAddr.addr)
                     LOG1("from vproc: %d\n", fromAddr.vproc_id)
-                    NameServerRemote_processMessage(&msg, procId);
+                    NameServerRemote_processMessage(&msg, procId,
+                        byteCount >= (int)sizeof(NameServerMsg));
                 }
             }
         }
@@ -395,6 +1216,7 @@ Int NameServer_setup(Void)
     int    ret;
     UInt16 procId;
     UInt16 numProcs;
+    Bool   noRpmsg = FALSE;
 
     pthread_mutex_lock(&NameServer_module->modGate);
 
@@ -410,23 +1232,24 @@ Int NameServer_setup(Void)
 
     numProcs = MultiProc_getNumProcessors();
 
+    NameServer_module->cacheTtl = cacheTtlEnv("LAD_NAMESERVER_CACHETTL",
+                                              NameServer_CACHETTL);
+    NameServer_module->negCacheTtl = cacheTtlEnv("LAD_NAMESERVER_NEGCACHETTL",
+                                                 NameServer_NEGCACHETTL);
+    LOG2("NameServer_setup: cache TTL %d msecs, %d msecs if not found\n",
+         NameServer_module->cacheTtl, NameServer_module->negCacheTtl)
+
     NameServer_module->unblockFd = eventfd(0, 0);
     if (NameServer_module->unblockFd < 0) {
         status = NameServer_E_FAIL;
-        LOG0("NameServer_setup: failed to create unblockFd.\n")
-        goto exit;
-    }
-
-    NameServer_module->waitFd = eventfd(0, 0);
-    if (NameServer_module->waitFd < 0) {
-        status = NameServer_E_FAIL;
-        LOG0("NameServer_setup: failed to create waitFd.\n")
+        LOG0("NameServer_setup: failed to create unblockFd.\n")
         goto exit;
     }
 
     for (procId = 0; procId < numProcs; procId++) {
         NameServer_module->sendSock[procId] = INVALIDSOCKET;
         NameServer_module->recvSock[procId] = INVALIDSOCKET;
+        NameServer_module->announces[procId] = FALSE;
 
         /* Only support NameServer to remote procs: */
         if (procId == MultiProc_self()) {
@@ -437,6 +1260,7 @@ Int NameServer_setup(Void)
         sock = socket(AF_RPMSG, SOCK_SEQPACKET, 0);
         if (sock < 0) {
             status = NameServer_E_FAIL;
+            noRpmsg = (errno == EAFNOSUPPORT);
             LOG2("NameServer_setup: socket failed: %d, %s\n",
                  errno, strerror(errno))
         }
@@ -460,6 +1284,7 @@ Int NameServer_setup(Void)
         sock = socket(AF_RPMSG, SOCK_SEQPACKET, 0);
         if (sock < 0) {
             status = NameServer_E_FAIL;
+            noRpmsg = (errno == EAFNOSUPPORT);
             LOG2("NameServer_setup: socket failed: %d, %s\n",
                  errno, strerror(errno))
         }
@@ -484,6 +1309,9 @@ Int NameServer_setup(Void)
     /* Construct the list object */
     CIRCLEQ_INIT(&NameServer_module->objList);
 
+    /* Let clients look up local names without asking */
+    mirrorCreate();
+
     /* Create the listener thread: */
     LOG0("NameServer_setup: creating listener thread\n")
     ret = pthread_create(&NameServer_module->listener, NULL, listener_cb, NULL);
@@ -503,6 +1331,15 @@ Int NameServer_setup(Void)
                 break;
             }
         }
+
+        /*
+         * Without rpmsg in the kernel there are no remote procs to talk to,
+         * but names local to the host still work, so don't fail for that.
+         */
+        if (status < 0 && noRpmsg) {
+            LOG0("NameServer_setup: no rpmsg support, serving local names only\n")
+            status = NameServer_S_SUCCESS;
+        }
     }
 
 exit:
@@ -569,7 +1406,8 @@ Int NameServer_destroy(void)
     pthread_join(NameServer_module->listener, NULL);
 
     close(NameServer_module->unblockFd);
-    close(NameServer_module->waitFd);
+
+    mirrorDestroy();
 
 exit:
     LOG1("NameServer_destroy: exiting, refCount=%d\n", NameServer_module->refCount)
@@ -669,8 +1507,20 @@ NameServer_Handle NameServer_create(String name,
         handle->params.maxValueLen = params->maxValueLen;
     }
 
-    CIRCLEQ_INIT(&handle->nameList);
+    handle->tableSize = NameServer_INITTABLESIZE;
+    handle->names = (NameServer_Slot *)calloc(handle->tableSize,
+                                              sizeof(NameServer_Slot));
+    handle->entries = (NameServer_Slot *)calloc(handle->tableSize,
+                                                sizeof(NameServer_Slot));
+    if (!handle->names || !handle->entries) {
+        LOG0("NameServer_create: table alloc failed\n")
+        goto cleanup;
+    }
     handle->count = 0u;
+    handle->index = NULL;
+
+    handle->cacheTtl = (uint64_t)NameServer_module->cacheTtl * 1000000u;
+    handle->negCacheTtl = (uint64_t)NameServer_module->negCacheTtl * 1000000u;
 
     /* Put in the local list */
     CIRCLEQ_elemClear(&handle->elem);
@@ -686,6 +1536,9 @@ NameServer_Handle NameServer_create(String name,
     goto leave;
 
 cleanup:
+    free(handle->names);
+    free(handle->entries);
+    free(handle->name);
     free(handle);
     handle = NULL;
 
@@ -703,11 +1556,11 @@ Int NameServer_delete(NameServer_Handle * handle)
 
     assert(handle != NULL);
     assert(*handle != NULL);
-    assert((*handle)->count == 0);
     assert(NameServer_module->refCount != 0);
 
     pthread_mutex_lock(&NameServer_module->modGate);
 
+    /* other users of the instance may still have entries in it */
     (*handle)->refCount--;
     if ((*handle)->refCount != 0) {
         goto leave;
@@ -721,7 +1574,9 @@ Int NameServer_delete(NameServer_Handle * handle)
             (*handle)->name = NULL;
         }
 
-        CIRCLEQ_destruct(&(*handle)->nameList);
+        free((*handle)->names);
+        free((*handle)->entries);
+        free((*handle)->cache);
 
         free((*handle));
         (*handle) = NULL;
@@ -733,14 +1588,45 @@ leave:
     return (status);
 }
 
+/* Take a reference to an instance, if it is one. */
+Bool NameServer_acquire(NameServer_Handle handle)
+{
+    struct NameServer_Object * elem;
+    Bool found = FALSE;
+
+    assert(NameServer_module->refCount != 0);
+
+    pthread_mutex_lock(&NameServer_module->modGate);
+
+    CIRCLEQ_traverse(elem, &NameServer_module->objList, NameServer_Object) {
+        if (elem == handle) {
+            handle->refCount++;
+            found = TRUE;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&NameServer_module->modGate);
+
+    return (found);
+}
+
+/* Drop a reference taken by NameServer_acquire(). */
+Void NameServer_release(NameServer_Handle handle)
+{
+    NameServer_delete(&handle);
+}
+
 /* Adds a variable length value into the local NameServer table */
 Ptr NameServer_add(NameServer_Handle handle, String name, Ptr buf, UInt len)
 {
     Int                 status = NameServer_S_SUCCESS;
-    NameServer_TableEntry * node = NULL;
     NameServer_TableEntry * new_node = NULL;
-    Bool                found = FALSE;
+    NameServer_TableEntry * carry;
+    NameServer_TableEntry * temp;
     UInt32              hash;
+    UInt32              mask;
+    UInt32              i;
 
     assert(handle != NULL);
     assert(name     != NULL);
@@ -753,30 +1639,23 @@ Ptr NameServer_add(NameServer_Handle handle, String name, Ptr buf, UInt len)
 
     pthread_mutex_lock(&handle->gate);
 
-    /* Traverse the list to find duplicate check */
-    CIRCLEQ_traverse(node, &handle->nameList, NameServer_TableEntry_tag) {
-        /* Hash matches */
-        if (node->hash == hash) {
-            /* If the name matches, incase hash is duplicate */
-            if (strcmp(node->name, name) == 0) {
-                if (handle->params.checkExisting == TRUE) {
-                    status = NameServer_E_INVALIDARG;
-                    LOG1("NameServer_add: '%s' - duplicate entry found!\n", name)
-                    break;
-                }
-            }
-            else {
-                found = TRUE;
-                break;
-            } /* name does not match */
-        } /* hash does not match */
-    } /* CIRCLEQ_traverse */
-
-    if (status != NameServer_S_SUCCESS) {
-        new_node = NULL;
+    /* Duplicate check */
+    if (handle->params.checkExisting == TRUE &&
+        findName(handle, name, hash) >= 0) {
+        status = NameServer_E_INVALIDARG;
+        LOG1("NameServer_add: '%s' - duplicate entry found!\n", name)
         goto exit;
     }
 
+    /* Keep the tables no more than 3/4 full */
+    if ((handle->count + 1) * 4 > handle->tableSize * 3) {
+        status = resizeTables(handle, handle->tableSize * 2);
+        if (status != NameServer_S_SUCCESS) {
+            LOG1("NameServer_add: %d - growing tables failed!\n", status)
+            goto exit;
+        }
+    }
+
     /* Now add the new entry. */
     new_node = (NameServer_TableEntry *)malloc(sizeof(NameServer_TableEntry));
     if (new_node == NULL) {
@@ -787,34 +1666,57 @@ Ptr NameServer_add(NameServer_Handle handle, String name, Ptr buf, UInt len)
     }
 
     new_node->hash    = hash;
-    new_node->collide = found; /* Indicate if there is a collision*/
     new_node->len     = len;
-    new_node->next    = NULL;
     new_node->name = (String)malloc(strlen(name) + 1u);
     new_node->value  = (Ptr)malloc(len);
     strncpy(new_node->name, name, strlen(name) + 1u);
     memcpy((Ptr)new_node->value, (Ptr)buf, len);
 
-    if (found == TRUE) {
-        /* If hash is found, need to stitch the list to link the
-         * new node to the existing node with the same hash.
-         */
-        new_node->next = node->next;
-        node->next = new_node;
+    status = indexInsert(handle, new_node);
+    if (status != NameServer_S_SUCCESS) {
+        LOG1("NameServer_add: %d - indexing new_node failed!\n", status)
+        free(new_node->value);
+        free(new_node->name);
+        free(new_node);
+        new_node = NULL;
+
+        goto exit;
     }
-    else {
-        /* put the new node into the list */
-        CIRCLEQ_INSERT_HEAD(&handle->nameList, new_node, elem);
+
+    /*
+     * File it under its name.  Any duplicates of the name each move one
+     * place down the probe sequence, so the newest is found first.
+     */
+    mask = handle->tableSize - 1;
+    carry = new_node;
+    for (i = hash & mask; handle->names[i].entry != NULL; i = (i + 1) & mask) {
+        temp = handle->names[i].entry;
+        if (handle->names[i].hash == hash && strcmp(temp->name, name) == 0) {
+            handle->names[i].entry = carry;
+            carry = temp;
+        }
     }
+    handle->names[i].hash = hash;
+    handle->names[i].entry = carry;
+
+    /* and under its address, for NameServer_removeEntry() */
+    insertSlot(handle->entries, handle->tableSize, entryHash(new_node),
+               new_node);
 
     handle->count++;
 
+    mirrorUpdate(handle, name, hash);
+
     LOG2("NameServer_add: Entered key: '%s', data: 0x%x\n",
          name, *(UInt32 *)buf)
 
 exit:
     pthread_mutex_unlock(&handle->gate);
 
+    if (new_node != NULL && NameServer_module->addFxn != NULL) {
+        NameServer_module->addFxn(handle, name);
+    }
+
     return (new_node);
 }
 
@@ -837,10 +1739,7 @@ Ptr NameServer_addUInt32(NameServer_Handle handle, String name, UInt32 value)
 Int NameServer_remove(NameServer_Handle handle, String name)
 {
     Int                 status = NameServer_S_SUCCESS;
-    NameServer_TableEntry *prev = NULL;
-    NameServer_TableEntry *temp = NULL;
-    NameServer_TableEntry *node = NULL;
-    Bool                done   = FALSE;
+    Int                 i;
     UInt32              hash;
 
     assert(handle != NULL);
@@ -852,50 +1751,11 @@ Int NameServer_remove(NameServer_Handle handle, String name)
 
     pthread_mutex_lock(&handle->gate);
 
-    /* Traverse the list to find duplicate check */
-    CIRCLEQ_traverse(node, &handle->nameList, NameServer_TableEntry_tag) {
-        /* Hash matchs */
-        if (node->hash == hash) {
-            if (node->collide == TRUE) {
-                if (strcmp(node->name, name) == 0){
-                    free(node->value);
-                    free(node->name);
-                    memcpy((Ptr)node, (Ptr) node->next,
-                           sizeof(NameServer_TableEntry));
-                    node->next = node->next->next;
-                    free(node->next);
-                    handle->count--;
-                    done = TRUE;
-                    break;
-                }
-                else {
-                    prev = node;
-                    temp = node->next;
-                    while (temp) {
-                        if (strcmp(temp->name, name) == 0){
-                            free(temp->value);
-                            free(temp->name);
-                            prev->next = temp->next;
-                            free(temp);
-                            handle->count--;
-                            done = TRUE;
-                            break;
-                        }
-                        temp = temp->next;
-                    }
-                    break;
-                }
-            }
-            else {
-                NameServer_removeEntry(handle, (Ptr)node);
-
-                done = TRUE;
-                break;
-            }
-        }
+    i = findName(handle, name, hash);
+    if (i >= 0) {
+        NameServer_removeEntry(handle, (Ptr)handle->names[i].entry);
     }
-
-    if (done == FALSE) {
+    else {
         status = NameServer_E_INVALIDARG;
         LOG1("NameServer_remove %d Entry not found!\n", status)
     }
@@ -905,11 +1765,18 @@ Int NameServer_remove(NameServer_Handle handle, String name)
     return (status);
 }
 
-/* Function to remove a name/value pair from a name server. */
+/*
+ * Function to remove a name/value pair from a name server.
+ *
+ * The entry comes from a client, so it's looked up by address before
+ * anything is done with it; one that isn't in the instance (e.g. already
+ * removed) is refused instead of being freed again.
+ */
 Int NameServer_removeEntry(NameServer_Handle handle, Ptr entry)
 {
     Int  status = NameServer_S_SUCCESS;
     NameServer_TableEntry * node;
+    Int  i;
 
     assert(handle != NULL);
     assert(entry  != NULL);
@@ -919,18 +1786,61 @@ Int NameServer_removeEntry(NameServer_Handle handle, Ptr entry)
 
     node = (NameServer_TableEntry *)entry;
 
+    i = findEntry(handle->entries, handle->tableSize, entryHash(node), node);
+    if (i < 0) {
+        status = NameServer_E_INVALIDARG;
+        LOG1("NameServer_removeEntry: %p not found!\n", entry)
+        goto exit;
+    }
+    removeSlot(handle->entries, handle->tableSize, (UInt32)i);
+
+    i = findEntry(handle->names, handle->tableSize, node->hash, node);
+    assert(i >= 0);
+    removeSlot(handle->names, handle->tableSize, (UInt32)i);
+
+    /* a duplicate of the name, if any, is what clients see now */
+    indexUpdate(handle, node->name, node->hash);
+    mirrorUpdate(handle, node->name, node->hash);
+
+    /* whatever the remotes said about the name may be out of date too */
+    cacheFlush(handle, node->name, 0);
+
     free(node->value);
     free(node->name);
-    CIRCLEQ_REMOVE(&handle->nameList, node, elem);
     free(node);
     handle->count--;
 
+    /* Give back most of the tables once most of the entries are gone */
+    if (handle->tableSize > NameServer_INITTABLESIZE &&
+        handle->count * 8 < handle->tableSize) {
+        resizeTables(handle, handle->tableSize / 2);
+    }
+
+exit:
     pthread_mutex_unlock(&handle->gate);
 
     return (status);
 }
 
 
+/* Function to set the function called with each name added. */
+Void NameServer_setAddFxn(NameServer_AddFxn fxn)
+{
+    NameServer_module->addFxn = fxn;
+}
+
+
+/* Function to tell whether a remote announces the names it adds. */
+Bool NameServer_announces(UInt16 procId)
+{
+    if (procId >= MultiProc_MAXPROCESSORS) {
+        return (FALSE);
+    }
+
+    return (NameServer_module->announces[procId]);
+}
+
+
 /* Initialize this config-params structure with supplier-specified
  * defaults before instance creation.
  */
@@ -943,107 +1853,263 @@ Void NameServer_Params_init(NameServer_Params * params)
 }
 
 
-Int NameServer_getRemote(NameServer_Handle handle,
-                     String            name,
-                     Ptr               value,
-                     UInt32 *          len,
-                     UInt16            procId)
+/*
+ * Look name up on the numProcs processors in procIds[] all at once.
+ * Answers still in the cache are used as they are; the other processors
+ * are each sent a request, and the first to reply that it has the name
+ * wins.  If none has it, the result is the first failure, in procIds[]
+ * order, other than "not found" or "no connection"; then "not found" if
+ * any processor said so.
+ */
+static Int getRemotes(NameServer_Handle handle, String name, Ptr value,
+                      UInt32 * len, UInt16 procIds[], UInt16 numProcs)
 {
-    Int status = NameServer_S_SUCCESS;
     struct NameServer_Object *obj = (struct NameServer_Object *)(handle);
-    NameServerMsg nsMsg;
-    NameServerMsg *replyMsg;
-    fd_set rfds;
-    int ret = 0, sock, maxfd, waitFd;
-    struct timeval tv;
-    uint64_t buf = 1;
-    int numBytes;
-    int err;
+    NameServer_Pending pending[MultiProc_MAXPROCESSORS];
+    NameServerMsg msg[MultiProc_MAXPROCESSORS];
+    Int status[MultiProc_MAXPROCESSORS];
+    Bool asked[MultiProc_MAXPROCESSORS];
+    NameServer_Pending **prev;
+    struct timespec deadline;
+    Int found = -1;
+    Int result;
+    UInt16 numWaiting;
+    UInt16 numAsked = 0;
+    UInt16 procId;
+    UInt16 i;
+    UInt32 epoch;
+    UInt32 val = 0;
+    Bool cached;
+    int ret = 0;
+    int sock;
+
+    assert(numProcs <= MultiProc_MAXPROCESSORS);
+
+    /* Recent answers will do */
+    pthread_mutex_lock(&obj->gate);
+
+    for (i = 0; i < numProcs && found < 0; i++) {
+        procId = procIds[i];
+        asked[i] = FALSE;
+
+        if (NameServer_module->sendSock[procId] == INVALIDSOCKET) {
+            LOG1("NameServer_getRemote: no socket connection to processor %d\n",
+                 procId);
+            status[i] = NameServer_E_RESOURCE;
+            continue;
+        }
 
-    /* Set Timeout to wait: */
-    tv.tv_sec = 0;
-    tv.tv_usec = NAMESERVER_GET_TIMEOUT;
-
-    /* Create request message and send to remote: */
-    sock = NameServer_module->sendSock[procId];
-    if (sock == INVALIDSOCKET) {
-        LOG1("NameServer_getRemote: no socket connection to processor %d\n",
-             procId);
-        status = NameServer_E_RESOURCE;
-        goto exit;
+        status[i] = cacheLookup(obj, name, procId, &val, &cached);
+        if (!cached) {
+            asked[i] = TRUE;
+            numAsked++;
+            continue;
+        }
+
+        LOG2("NameServer_getRemote: cached answer from procId %d for %s\n",
+             procId, name)
+        obj->cacheStats.hits++;
+        if (status[i] < 0) {
+            obj->cacheStats.negativeHits++;
+        }
+        else {
+            found = i;
+        }
+    }
+
+    /* one that's known to have the name means no one need be asked */
+    if (found >= 0) {
+        numAsked = 0;
+        numProcs = i;
+        for (i = 0; i < numProcs; i++) {
+            asked[i] = FALSE;
+        }
     }
+    obj->cacheStats.misses += numAsked;
+    epoch = obj->cacheEpoch;
 
-    LOG1("NameServer_getRemote: Sending request via sock: %d\n", sock)
+    pthread_mutex_unlock(&obj->gate);
 
-    /* Create request message and send to remote processor: */
-    nsMsg.reserved = NAMESERVER_MSG_TOKEN;
-    nsMsg.request = NAMESERVER_REQUEST;
-    nsMsg.requestStatus = 0;
-    nsMsg.valueLen = *len;
+    if (numAsked == 0) {
+        goto done;
+    }
 
-    strncpy((char *)nsMsg.instanceName, obj->name, strlen(obj->name) + 1);
-    strncpy((char *)nsMsg.name, name, strlen(name) + 1);
+    /*
+     * Enter a pending entry for each request before sending any, in case
+     * a reply beats us back.  Any number of threads can have requests
+     * out at once; each reply is matched to its request by requestId.
+     */
+    pthread_mutex_lock(&NameServer_module->pendingGate);
 
-    LOG2("NameServer_getRemote: Requesting from procId %d, %s:",
-           procId, (String)nsMsg.instanceName)
-    LOG1("%s...\n", (String)nsMsg.name)
+    for (i = 0; i < numProcs; i++) {
+        if (!asked[i]) {
+            continue;
+        }
 
-    err = send(sock, &nsMsg, sizeof(NameServerMsg), 0);
-    if (err < 0) {
-        LOG2("NameServer_getRemote: send failed: %d, %s\n",
-             errno, strerror(errno))
-        status = NameServer_E_FAIL;
-        goto exit;
+        msg[i].reserved = NAMESERVER_MSG_TOKEN;
+        msg[i].request = NAMESERVER_REQUEST;
+        msg[i].requestStatus = 0;
+        msg[i].valueLen = *len;
+        msg[i].requestId = NameServer_module->nextRequestId++;
+        strncpy((char *)msg[i].instanceName, obj->name, MAXNAMEINCHAR - 1);
+        ((char *)msg[i].instanceName)[MAXNAMEINCHAR - 1] = '\0';
+        strncpy((char *)msg[i].name, name, MAXNAMEINCHAR - 1);
+        ((char *)msg[i].name)[MAXNAMEINCHAR - 1] = '\0';
+
+        pending[i].procId = procIds[i];
+        pending[i].requestId = msg[i].requestId;
+        pending[i].msg = &msg[i];
+        pending[i].done = FALSE;
+        pending[i].next = NameServer_module->pending;
+        NameServer_module->pending = &pending[i];
     }
 
-    /* Block on waitFd for signal from listener thread: */
-    waitFd = NameServer_module->waitFd;
-    FD_ZERO(&rfds);
-    FD_SET(waitFd, &rfds);
-    maxfd = waitFd + 1;
-    LOG1("NameServer_getRemote: pending on waitFd: %d\n", waitFd)
-    ret = select(maxfd, &rfds, NULL, NULL, &tv);
-    if (ret == -1) {
-        LOG0("NameServer_getRemote: select failed.")
-        status = NameServer_E_FAIL;
-        goto exit;
+    pthread_mutex_unlock(&NameServer_module->pendingGate);
+
+    for (i = 0; i < numProcs; i++) {
+        if (!asked[i]) {
+            continue;
+        }
+
+        sock = NameServer_module->sendSock[procIds[i]];
+
+        LOG2("NameServer_getRemote: Requesting from procId %d, %s:",
+               procIds[i], (String)msg[i].instanceName)
+        LOG2("%s, requestId %d...\n", (String)msg[i].name, msg[i].requestId)
+
+        if (send(sock, &msg[i], sizeof(NameServerMsg), 0) < 0) {
+            LOG2("NameServer_getRemote: send failed: %d, %s\n",
+                 errno, strerror(errno))
+            status[i] = NameServer_E_FAIL;
+            cacheFlushProc(procIds[i]);
+        }
     }
-    else if (!ret) {
-        LOG0("NameServer_getRemote: select timed out.\n")
-        status = NameServer_E_TIMEOUT;
-        goto exit;
+
+    /* Set Timeout to wait: */
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += NAMESERVER_GET_TIMEOUT * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&NameServer_module->pendingGate);
+
+    LOG0("NameServer_getRemote: pending on replies\n")
+    for (;;) {
+        numWaiting = 0;
+        for (i = 0; i < numProcs && found < 0; i++) {
+            if (!asked[i] || status[i] == NameServer_E_FAIL) {
+                continue;
+            }
+            if (!pending[i].done) {
+                numWaiting++;
+            }
+            else if (msg[i].requestStatus) {
+                found = i;
+            }
+        }
+
+        if (found >= 0 || numWaiting == 0 || ret != 0) {
+            break;
+        }
+
+        ret = pthread_cond_timedwait(&NameServer_module->replyCond,
+                                     &NameServer_module->pendingGate,
+                                     &deadline);
     }
 
-    if (FD_ISSET(waitFd, &rfds)) {
-        /* Read, just to balance the write: */
-        numBytes = read(waitFd, &buf, sizeof(uint64_t));
+    for (i = 0; i < numProcs; i++) {
+        if (!asked[i]) {
+            continue;
+        }
+        for (prev = &NameServer_module->pending; *prev != &pending[i];
+             prev = &(*prev)->next) {
+        }
+        *prev = pending[i].next;
+    }
 
-        /* Process response: */
-        replyMsg = &NameServer_module->nsMsg;
+    pthread_mutex_unlock(&NameServer_module->pendingGate);
 
-        if (replyMsg->requestStatus) {
-            /* name is found */
-            /* set the contents of value */
-            *(UInt32 *)value = (UInt32)replyMsg->value;
+    /* Process responses, keeping those that are final */
+    pthread_mutex_lock(&obj->gate);
 
+    for (i = 0; i < numProcs; i++) {
+        if (!asked[i] || status[i] == NameServer_E_FAIL) {
+            continue;
+        }
+
+        if (pending[i].done) {
+            status[i] = msg[i].requestStatus ? NameServer_S_SUCCESS :
+                                               NameServer_E_NOTFOUND;
             LOG2("NameServer_getRemote: Reply from: %d, %s:",
-                 procId, (String)replyMsg->instanceName)
-            LOG2("%s, value: 0x%x...\n",
-                 (String)replyMsg->name, *(UInt32 *)value)
-            goto exit;
+                 procIds[i], (String)msg[i].instanceName)
+            LOG2("%s, found: %d\n", (String)msg[i].name, msg[i].requestStatus)
+        }
+        else if (found < 0) {
+            LOG1("NameServer_getRemote: procId %d timed out.\n", procIds[i])
+            status[i] = NameServer_E_TIMEOUT;
         }
         else {
-            /* name is not found */
-            LOG2("NameServer_getRemote: value for %s:%s not found.\n",
-                 (String)replyMsg->instanceName, (String)replyMsg->name)
+            /* still out when another processor answered: nothing to keep */
+            continue;
+        }
 
-            /* set status to not found */
-            status = NameServer_E_NOTFOUND;
+        if (obj->cacheEpoch == epoch) {
+            cacheStore(obj, name, procIds[i], status[i], msg[i].value);
         }
     }
 
-exit:
-    return (status);
+    pthread_mutex_unlock(&obj->gate);
+
+    if (found >= 0) {
+        val = msg[found].value;
+    }
+
+done:
+    if (found >= 0) {
+        *(UInt32 *)value = val;
+        LOG2("NameServer_getRemote: %s found on procId %d", name,
+             procIds[found])
+        LOG1(", value: 0x%x\n", val)
+        return (NameServer_S_SUCCESS);
+    }
+
+    result = NameServer_E_RESOURCE;
+    for (i = 0; i < numProcs; i++) {
+        if (status[i] == NameServer_E_NOTFOUND) {
+            result = NameServer_E_NOTFOUND;
+        }
+        else if (status[i] != NameServer_E_RESOURCE) {
+            return (status[i]);
+        }
+    }
+
+    return (result);
+}
+
+Int NameServer_getRemote(NameServer_Handle handle,
+                     String            name,
+                     Ptr               value,
+                     UInt32 *          len,
+                     UInt16            procId)
+{
+    return (getRemotes(handle, name, value, len, &procId, 1));
+}
+
+/* Get the counters of an instance's remote lookup cache */
+Int NameServer_getCacheStats(NameServer_Handle handle,
+                             NameServer_CacheStats * stats)
+{
+    assert(handle != NULL);
+    assert(stats  != NULL);
+    assert(NameServer_module->refCount != 0);
+
+    pthread_mutex_lock(&handle->gate);
+    *stats = handle->cacheStats;
+    pthread_mutex_unlock(&handle->gate);
+
+    return (NameServer_S_SUCCESS);
 }
 
 /* Function to retrieve the value portion of a name/value pair from
@@ -1057,30 +2123,28 @@ Int NameServer_get(NameServer_Handle handle,
 {
     Int status = NameServer_S_SUCCESS;
     UInt16 numProcs = MultiProc_getNumProcessors();
+    UInt16 remotes[MultiProc_MAXPROCESSORS];
+    UInt16 numRemotes = 0;
     UInt32 i;
 
     /*
-     * BIOS side uses a gate (mutex) to protect NameServer_module->nsMsg, but
-     * since this goes in a daemon, it will not be necessary.
+     * LAD runs remote lookups on its worker threads, so several may be in
+     * getRemotes() at once; each waits on its own pending entries.
      */
 
     if (procId == NULL) {
         status = NameServer_getLocal(handle, name, value, len);
         if (status == NameServer_E_NOTFOUND) {
+            /* ask every remote at once, rather than one after another */
             for (i = 0; i < numProcs; i++) {
                 /* getLocal call already covers "self", keep going */
-                if (i == MultiProc_self()) {
-                    continue;
-                }
-
-                status = NameServer_getRemote(handle, name, value, len, i);
-
-                if ((status >= 0) ||
-                    ((status < 0) && (status != NameServer_E_NOTFOUND) &&
-                                     (status != NameServer_E_RESOURCE))) {
-                    break;
+                if (i != MultiProc_self()) {
+                    remotes[numRemotes++] = i;
                 }
             }
+
+            status = getRemotes(handle, name, value, len, remotes,
+                                numRemotes);
         }
     }
     else {
@@ -1094,7 +2158,8 @@ Int NameServer_get(NameServer_Handle handle,
                 status = NameServer_getLocal(handle, name, value, len);
             }
             else {
-                status = NameServer_getRemote(handle, name, value, len, i);
+                status = NameServer_getRemote(handle, name, value, len,
+                                              procId[i]);
             }
 
             if ((status >= 0) ||
@@ -1143,10 +2208,9 @@ Int NameServer_getLocal(NameServer_Handle handle,
 {
     Int status = NameServer_E_NOTFOUND;
     NameServer_TableEntry * node = NULL;
-    NameServer_TableEntry * temp = NULL;
-    Bool done   = FALSE;
     UInt32 length;
     UInt32 hash;
+    Int i;
 
     assert(handle != NULL);
     assert(name   != NULL);
@@ -1161,53 +2225,27 @@ Int NameServer_getLocal(NameServer_Handle handle,
 
     pthread_mutex_lock(&handle->gate);
 
-    /* Traverse the list to find duplicate check */
-    CIRCLEQ_traverse(node, &handle->nameList, NameServer_TableEntry_tag) {
-        if (node->hash == hash) {
-            if (node->collide == TRUE) {
-                temp = node;
-                while (temp) {
-                    if (strcmp(temp->name, name) == 0u){
-                        if (length <= node->len) {
-                            memcpy(value, node->value, length);
-                            *len = length;
-                        }
-                        else {
-                            memcpy(value, node->value, node->len);
-                            *len = node->len;
-                        }
-                        done = TRUE;
-                        break;
-                    }
-                    temp = temp->next;
-                }
-                break;
-            }
-            else {
-                if (length <= node->len) {
-                    memcpy(value, node->value, length);
-                    *len = length;
-                }
-                else {
-                    memcpy(value, node->value, node->len);
-                    *len = node->len;
-                }
-                done = TRUE;
-                break;
-            }
+    i = findName(handle, name, hash);
+    if (i >= 0) {
+        node = handle->names[i].entry;
+        if (length <= node->len) {
+            memcpy(value, node->value, length);
+            *len = length;
+        }
+        else {
+            memcpy(value, node->value, node->len);
+            *len = node->len;
         }
+        status = NameServer_S_SUCCESS;
+        LOG2("NameServer_getLocal: Found entry key: '%s', data: 0x%x\n",
+             node->name, (UInt32)node->value)
     }
 
     pthread_mutex_unlock(&handle->gate);
 
-    if (done == FALSE) {
+    if (status == NameServer_E_NOTFOUND) {
         LOG1("NameServer_getLocal: entry key: '%s' not found!\n", name)
     }
-    else {
-        LOG2("NameServer_getLocal: Found entry key: '%s', data: 0x%x\n",
-             node->name, (UInt32)node->value)
-        status = NameServer_S_SUCCESS;
-    }
 
     return (status);
 }
@@ -1241,6 +2279,92 @@ Int NameServer_getLocalUInt32(NameServer_Handle handle, String name, Ptr value)
     return (status);
 }
 
+/*
+ * Match the name with the longest local entry that it begins with, as
+ * the BIOS NameServer does.  Only entries with UInt32 values are matched.
+ */
+Int NameServer_match(NameServer_Handle handle, String name, UInt32 * value)
+{
+    NameServer_TableEntry * entry;
+    Ptr *  where;
+    UInt32 len;
+    Int    foundLen = 0;
+
+    assert(handle != NULL);
+    assert(name   != NULL);
+    assert(value  != NULL);
+    assert(NameServer_module->refCount != 0);
+
+    pthread_mutex_lock(&handle->gate);
+
+    /* Try each beginning of the name in the index, longest first */
+    for (len = strlen(name); len > 0; len--) {
+        where = indexFind(handle, name, len);
+        if (where != NULL) {
+            entry = (NameServer_TableEntry *)*where;
+            if (entry->len == sizeof(UInt32)) {
+                *value = *(UInt32 *)entry->value;
+                foundLen = (Int)len;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&handle->gate);
+
+    LOG2("NameServer_match: '%s' matched %d characters\n", name, foundLen)
+
+    return (foundLen);
+}
+
+/* Fill in the next batch of local names that begin with prefix */
+Int NameServer_enumerateLocal(NameServer_Handle handle, String prefix,
+                              String after, NameServer_EnumEntry entries[],
+                              UInt max)
+{
+    const UInt8 * key = (const UInt8 *)prefix;
+    NameServer_IndexNode * node;
+    Ptr    top;
+    Ptr    p;
+    UInt32 len = strlen(prefix);
+    UInt32 count = 0;
+
+    assert(handle  != NULL);
+    assert(prefix  != NULL);
+    assert(entries != NULL);
+    assert(NameServer_module->refCount != 0);
+
+    pthread_mutex_lock(&handle->gate);
+
+    p = handle->index;
+    if (p == NULL) {
+        goto exit;
+    }
+
+    /*
+     * Follow the prefix down the index.  The first node that tests a bit
+     * past its end heads the subtree of names that may begin with it, and
+     * they all do if the leaf the walk ends at does.
+     */
+    top = p;
+    while (Index_isNode(p)) {
+        node = Index_node(p);
+        p = node->child[Index_dir(node, node->byte < len ? key[node->byte] : 0)];
+        if (node->byte < len) {
+            top = p;
+        }
+    }
+
+    if (strncmp(((NameServer_TableEntry *)p)->name, prefix, len) == 0) {
+        count = indexCollect(top, after, entries, 0, max);
+    }
+
+exit:
+    pthread_mutex_unlock(&handle->gate);
+
+    return ((Int)count);
+}
+
 
 #if defined (__cplusplus)
 }
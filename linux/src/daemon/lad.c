@@ -40,10 +40,17 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <ti/ipc/MessageQ.h>
 #include <_MessageQ.h>
@@ -55,25 +62,159 @@
 
 #define DAEMON        1           /* 1 = run as a daemon; 0 = run as app */
 
+/*
+ * epoll event tags: the listening socket, the worker completion event, the
+ * name added event, and refused connections, which carry their socket in
+ * the low bits; all others are clientIds
+ */
+#define LAD_LISTENTAG       0xFFFFFFFF
+#define LAD_COMPLETETAG     0xFFFFFFFE
+#define LAD_ADDEDTAG        0xFFFFFFFD
+#define LAD_REFUSEDTAG      0x80000000
+
+#define LAD_MAXEVENTS       16    /* events taken per epoll_wait() */
+#define LAD_LISTENBACKLOG   64    /* connections queued for accept() */
+#define LAD_NUMWORKERS      4     /* threads running remote lookups */
+#define LAD_NUMWATCHWORKERS 1     /* threads running watches' lookups */
+#define LAD_INITNUMCLIENTS  32    /* client slots before the table grows */
+#define LAD_PIDHASHSIZE     256   /* buckets in the PID hash */
+#define LAD_WATCHPOLL       100   /* msecs before a watch's first poll */
+#define LAD_WATCHPOLLMAX    2000  /* msecs between polls grow up to this */
+
+/* A response that didn't fit in its client's socket, held until it does */
+typedef struct LAD_Held {
+    struct LAD_Held *       next;
+    struct LAD_ResponseMsg  msg;
+} LAD_Held;
+
+/*
+ * A client slot; clientIds index the table of these.  A free slot is on
+ * the free list, and a connected one is in its PID's hash bucket; next
+ * links whichever list the slot is on.
+ */
+typedef struct LAD_Client {
+    Bool    connected;    /* TRUE once LAD_CONNECT is answered */
+    UInt    PID;          /* client's process ID */
+    int     sock;         /* connection to the client, -1 if slot is free */
+    UInt32  serial;       /* counts connections made in this slot */
+    Int     next;         /* next slot on the list, or -1 */
+    LAD_Held * heldHead;  /* responses waiting for room in sock */
+    LAD_Held * heldTail;
+} LAD_Client;
+
+/*
+ * A LAD_NAMESERVER_WATCH waiting for its name.  The name is looked up when
+ * it is added, locally or by a remote's announcement.  The remotes that
+ * have never announced are polled as well, first after LAD_WATCHPOLL
+ * msecs and then twice as long each time, up to LAD_WATCHPOLLMAX.
+ */
+typedef struct LAD_Watch {
+    struct LAD_Watch *      next;
+    Int                     clientId;
+    UInt32                  serial;     /* connection the command came in on */
+    UInt32                  requestId;
+    NameServer_Handle       handle;
+    Char                    name[NameServer_Params_MAXNAMELEN];
+    uint64_t                deadline;   /* msecs when the wait times out */
+    uint64_t                nextLookup; /* msecs when to poll again */
+    UInt32                  pollWait;   /* msecs from a lookup to a poll */
+    Bool                    running;    /* a lookup is on a worker */
+    Bool                    again;      /* the name was added while it was */
+} LAD_Watch;
+
+/* A name added, for the main loop to check against the watches */
+typedef struct LAD_Added {
+    struct LAD_Added *      next;
+    NameServer_Handle       handle;
+    Char                    name[NameServer_Params_MAXNAMELEN];
+} LAD_Added;
+
+/* A command handed to a worker thread, and then its response */
+typedef struct LAD_Job {
+    struct LAD_Job *        next;
+    Int                     clientId;
+    UInt32                  serial;   /* connection the command came in on */
+    LAD_Watch *             watch;    /* the watch a lookup is for, or NULL */
+    Bool                    poll;     /* a watch's lookup asks only procId */
+    UInt16                  procId[MultiProc_MAXPROCESSORS + 1];
+    struct LAD_CommandObj   cmd;
+    union LAD_ResponseObj   rsp;
+} LAD_Job;
+
+/*
+ * Jobs waiting for the workers of one pool.  Watches poll on a pool of
+ * their own, so however many there are they can't hold up GETUINT32s.
+ */
+typedef struct LAD_JobQueue {
+    LAD_Job *               head;
+    LAD_Job *               tail;
+    pthread_cond_t          cond;     /* signaled when a job is queued */
+    Int                     numWorkers;
+} LAD_JobQueue;
+
 Bool logFile = FALSE;
 FILE *logPtr = NULL;
 
-static String commandFIFOFile = LAD_COMMANDFIFO;
-static FILE *commandFIFOFilePtr = NULL;
+static String socketFile = LAD_SOCKETPATH;
+static int listenSocket = -1;
+static int epollFd = -1;
 static String serverDir;
 
 /* LAD client info arrays */
-static Bool clientConnected[LAD_MAXNUMCLIENTS];
-static UInt clientPID[LAD_MAXNUMCLIENTS];
-static Char clientFIFOName[LAD_MAXNUMCLIENTS][LAD_MAXLENGTHFIFONAME];
-static FILE * responseFIFOFilePtr[LAD_MAXNUMCLIENTS];
+
+/* client table, grown as needed up to LAD_MAXNUMCLIENTS slots */
+static LAD_Client * clients = NULL;
+static Int numClientSlots = 0;
+static Int freeClientId = -1;
+static Int pidHash[LAD_PIDHASHSIZE];
+
+/* worker pools: jobs waiting for a worker, and jobs waiting to be answered */
+static LAD_JobQueue commandJobs = { NULL, NULL, PTHREAD_COND_INITIALIZER, 0 };
+static LAD_JobQueue watchJobs = { NULL, NULL, PTHREAD_COND_INITIALIZER, 0 };
+static LAD_Job * doneHead = NULL;
+static pthread_mutex_t jobGate = PTHREAD_MUTEX_INITIALIZER;
+static int doneFd = -1;
+
+/* watches waiting for names, and names added since they were checked */
+static LAD_Watch * watchHead = NULL;
+static LAD_Added * addedHead = NULL;    /* protected by jobGate */
+static int addedFd = -1;
 
 /* local internal routines */
 static LAD_ClientHandle assignClientId(Void);
-static Void cleanupDepartedClients(Void);
-static Int connectToLAD(String clientName, Int pid, String clientProto, Int *clientIdPtr);
+static Void releaseClientId(Int clientId);
+static Void hashClient(Int clientId);
+static Void unhashClient(Int clientId);
+static Bool isPIDConnected(UInt pid);
+static Void raiseFileLimit(Void);
+static Void acceptClient(Void);
+static Int getCommand(Void);
+static Void sendResponse(Int clientId, UInt32 requestId);
+static ssize_t sendTo(int sock, UInt32 requestId);
+static Void holdResponse(Int clientId, UInt32 requestId);
+static Void sendHeld(Int clientId);
+static Void freeHeld(Int clientId);
+static Void departClient(Int clientId);
+static Int connectToLAD(Int clientId, Int pid, String clientProto);
 static Void disconnectFromLAD(Int clientId);
 static Void doDisconnect(Int clientId);
+static Void startWorkers(Void);
+static Bool dispatchCommand(Int clientId);
+static Int startPool(LAD_JobQueue * queue, Int numWorkers);
+static Bool queueJob(LAD_JobQueue * queue, LAD_Job * job);
+static Void *workerThread(Void *arg);
+static Void completeJobs(Void);
+static Void startWatches(Void);
+static Bool startWatch(Int clientId);
+static Void lookWatch(LAD_Watch * watch, Bool poll);
+static Void watchLooked(LAD_Watch * watch, union LAD_ResponseObj *r);
+static Void endWatch(LAD_Watch * watch, Int status, UInt32 val);
+static int serviceWatches(Void);
+static Void nameAdded(NameServer_Handle handle, String name);
+static Void checkAdded(Void);
+static uint64_t watchTime(Void);
+static Bool isLocalLookup(struct LAD_CommandObj *c);
+static Void getUInt32(struct LAD_CommandObj *c, union LAD_ResponseObj *r);
 
 struct LAD_CommandObj cmd;
 union LAD_ResponseObj rsp;
@@ -86,13 +227,14 @@ union LAD_ResponseObj rsp;
 int main(int argc, char * argv[])
 {
     MessageQ_Handle handle;
-    UInt16 *procIdPtr;
-    Int statusIO;
+    struct sockaddr_un addr;
+    struct epoll_event event;
+    Bool dispatched;
     Int clientId;
     Int command;
     Int flags;
+    Int status = EXIT_SUCCESS;
     Int i;
-    Int n;
 #if DAEMON
     pid_t pid;
     pid_t sid;
@@ -192,59 +334,71 @@ int main(int argc, char * argv[])
 
     /* TODO:L make sure LAD is not already running? */
 
-    /* initialize client info arrays */
-    for (i = 0; i < LAD_MAXNUMCLIENTS; i++) {
-        clientConnected[i] = FALSE;
-        responseFIFOFilePtr[i] = NULL;
+    /* no clients yet; the client table is allocated on first connect */
+    for (i = 0; i < LAD_PIDHASHSIZE; i++) {
+        pidHash[i] = -1;
     }
 
-    /* if command FIFO exists from previous LAD session delete it now */
-    unlink(commandFIFOFile);
+    /* each client holds a descriptor */
+    raiseFileLimit();
 
-    /* create command FIFO */
-    statusIO = mkfifo(commandFIFOFile, 0777);
-    if (statusIO != 0) {
-        LOG2("\nERROR: unable to create %s, errno = %x\n", commandFIFOFile,
-            errno)
+    /* if the socket exists from previous LAD session delete it now */
+    unlink(socketFile);
+
+    /* create the listening socket */
+    listenSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenSocket == -1) {
+        LOG1("\nERROR: unable to create socket, errno = %x\n", errno)
         return(0);
     }
 
-    /* set FIFO permissions to read/write */
-    chmod(commandFIFOFile, 0666);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketFile, sizeof(addr.sun_path) - 1);
+
+    if (bind(listenSocket, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(listenSocket, LAD_LISTENBACKLOG) == -1) {
+        LOG2("\nERROR: unable to bind %s, errno = %x\n", socketFile, errno)
+        close(listenSocket);
+        return(0);
+    }
 
-opencommandFIFO:
+    /* set socket permissions to read/write */
+    chmod(socketFile, 0666);
 
-    /* now open file for FIFO - will block until writer arrives... */
-    LOG1("\n    opening FIFO: %s\n", commandFIFOFile)
-    commandFIFOFilePtr = fopen(commandFIFOFile, "r");
-    if (commandFIFOFilePtr == NULL) {
-        LOG0("\nERROR: unable to open command FIFO\n")
-        unlink(commandFIFOFile);
+    /* all clients, and new connections, are served from one epoll set */
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        LOG1("\nERROR: unable to create epoll set, errno = %x\n", errno)
+        close(listenSocket);
+        unlink(socketFile);
         return(0);
     }
 
+    event.events = EPOLLIN;
+    event.data.u32 = LAD_LISTENTAG;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &event);
+
+    LOG1("\n    listening on socket: %s\n", socketFile)
+
+    startWorkers();
+    startWatches();
+
     /* COMMAND PROCESSING LOOP */
     while (1) {
         LOG0("Retrieving command...\n")
 
-        /* read the next command packet */
-        n = fread(&cmd, LAD_COMMANDLENGTH, 1, commandFIFOFilePtr);
-
         /*
-         * if last client closes FIFO then it must be closed and reopened ...
+         * wait for the next command from any client; new connections and
+         * departed clients are handled along the way
          */
-        if (!n) {
-            LOG1("    EOF detected on FIFO, closing FIFO: %s\n", commandFIFOFile)
-            fclose(commandFIFOFilePtr);
-
-            goto opencommandFIFO;
+        clientId = getCommand();
+        if (clientId == -1) {
+            status = EXIT_FAILURE;
+            goto exitNow;
         }
-
-        /* cleanup for any connected/started clients that have departed */
-        cleanupDepartedClients();
-
         command = cmd.cmd;
-        clientId = cmd.clientId;
+        dispatched = FALSE;
 
         /* process individual commands */
         switch (command) {
@@ -254,11 +408,11 @@ opencommandFIFO:
            * (either saved in separate variables or passed to a function).
            *
            * cmd.cmd has already been saved in 'command'
-           * cmd.clientId has already been saved in 'clientId'
+           * 'clientId' is the client whose socket the command came in on
            */
           case LAD_CONNECT:
-            connectToLAD(cmd.args.connect.name, cmd.args.connect.pid,
-                         cmd.args.connect.protocol, NULL);
+            connectToLAD(clientId, cmd.args.connect.pid,
+                         cmd.args.connect.protocol);
 
             break;
 
@@ -335,17 +489,19 @@ opencommandFIFO:
           case LAD_NAMESERVER_GETUINT32:
             LOG2("LAD_NAMESERVER_GETUINT32: calling NameServer_getUInt32(%p, '%s')...\n", cmd.args.getUInt32.handle, cmd.args.getUInt32.name)
 
-            if (cmd.args.getUInt32.procId[0] == (UInt16)-1) {
-                procIdPtr = NULL;
-            }
-            else {
-                procIdPtr = cmd.args.getUInt32.procId;
+            /*
+             * A lookup that has to ask the remote processors can block for
+             * NAMESERVER_GET_TIMEOUT per processor, so it goes to a worker
+             * and is answered when it completes.  One answered from the
+             * local table is done right here.
+             */
+            if (!isLocalLookup(&cmd) && dispatchCommand(clientId)) {
+                LOG0("    dispatched to worker\n")
+                dispatched = TRUE;
+                break;
             }
-            rsp.status = NameServer_getUInt32(
-                cmd.args.getUInt32.handle,
-                cmd.args.getUInt32.name,
-                &rsp.getUInt32.val,
-                procIdPtr);
+
+            getUInt32(&cmd, &rsp);
 
             LOG1("    value = 0x%x\n", rsp.getUInt32.val)
             LOG1("    status = %d\n", rsp.status)
@@ -376,6 +532,67 @@ opencommandFIFO:
 
             break;
 
+          case LAD_NAMESERVER_GETCACHESTATS:
+            LOG1("LAD_NAMESERVER_GETCACHESTATS: calling NameServer_getCacheStats(%p)...\n", cmd.args.getCacheStats.handle)
+
+            rsp.getCacheStats.status = NameServer_getCacheStats(
+                cmd.args.getCacheStats.handle, &rsp.getCacheStats.stats);
+
+            LOG1("    status = %d\n", rsp.status)
+            LOG0("DONE\n")
+
+            break;
+
+          case LAD_NAMESERVER_MATCH:
+            cmd.args.match.name[NameServer_ENUMNAMELEN - 1] = '\0';
+            LOG2("LAD_NAMESERVER_MATCH: calling NameServer_match(%p, '%s')...\n", cmd.args.match.handle, cmd.args.match.name)
+
+            rsp.match.len = NameServer_match(cmd.args.match.handle,
+                cmd.args.match.name, &rsp.match.val);
+            rsp.match.status = NameServer_S_SUCCESS;
+
+            LOG1("    len = %d\n", rsp.match.len)
+            LOG0("DONE\n")
+
+            break;
+
+          case LAD_NAMESERVER_ENUMERATE:
+            cmd.args.enumerate.prefix[NameServer_ENUMNAMELEN - 1] = '\0';
+            cmd.args.enumerate.after[NameServer_ENUMNAMELEN - 1] = '\0';
+            LOG2("LAD_NAMESERVER_ENUMERATE: calling NameServer_enumerateLocal(%p, '%s')...\n", cmd.args.enumerate.handle, cmd.args.enumerate.prefix)
+
+            rsp.enumerate.status = NameServer_enumerateLocal(
+                cmd.args.enumerate.handle, cmd.args.enumerate.prefix,
+                cmd.args.enumerate.after[0] != '\0' ?
+                    cmd.args.enumerate.after : NULL,
+                rsp.enumerate.entries, LAD_NSENUMBATCH);
+            rsp.enumerate.count = rsp.enumerate.status < 0 ? 0 :
+                (UInt32)rsp.enumerate.status;
+
+            LOG1("    count = %d\n", rsp.enumerate.count)
+            LOG0("DONE\n")
+
+            break;
+
+          case LAD_NAMESERVER_WATCH:
+            LOG2("LAD_NAMESERVER_WATCH: watching for '%s' in %p...\n", cmd.args.watch.name, cmd.args.watch.handle)
+
+            /*
+             * A name that isn't here yet is answered once it turns up, or
+             * the wait times out, without holding up other commands.
+             */
+            if (startWatch(clientId)) {
+                LOG0("    waiting\n")
+                dispatched = TRUE;
+                break;
+            }
+
+            LOG1("    value = 0x%x\n", rsp.getUInt32.val)
+            LOG1("    status = %d\n", rsp.status)
+            LOG0("DONE\n")
+
+            break;
+
           case LAD_MESSAGEQ_GETCONFIG:
             LOG0("LAD_MESSAGEQ_GETCONFIG: calling MessageQ_getConfig()...\n")
 
@@ -417,7 +634,7 @@ opencommandFIFO:
 
             if (handle) {
                 rsp.messageQCreate.queueId = MessageQ_getQueueId(handle);
-                MessageQ_setQueueOwner(handle, clientPID[clientId]);
+                MessageQ_setQueueOwner(handle, clients[clientId].PID);
                 rsp.messageQCreate.status = 0;
             }
             else {
@@ -473,6 +690,11 @@ opencommandFIFO:
             break;
         }
 
+        /* a dispatched command is answered by completeJobs() */
+        if (dispatched) {
+            continue;
+        }
+
         switch (command) {
           case LAD_CONNECT:
           case LAD_DISCONNECT:
@@ -487,6 +709,10 @@ opencommandFIFO:
           case LAD_NAMESERVER_GETUINT32:
           case LAD_NAMESERVER_REMOVE:
           case LAD_NAMESERVER_REMOVEENTRY:
+          case LAD_NAMESERVER_GETCACHESTATS:
+          case LAD_NAMESERVER_WATCH:
+          case LAD_NAMESERVER_MATCH:
+          case LAD_NAMESERVER_ENUMERATE:
           case LAD_MESSAGEQ_GETCONFIG:
           case LAD_MESSAGEQ_SETUP:
           case LAD_MESSAGEQ_DESTROY:
@@ -496,8 +722,7 @@ opencommandFIFO:
           case LAD_MULTIPROC_GETCONFIG:
             LOG0("Sending response...\n");
 
-            fwrite(&rsp, LAD_RESPONSELENGTH, 1, responseFIFOFilePtr[clientId]);
-            fflush(responseFIFOFilePtr[clientId]);
+            sendResponse(clientId, cmd.requestId);
 
             break;
 
@@ -511,199 +736,537 @@ exitNow:
         LOG0("\n\nLAD IS SELF TERMINATING...\n\n")
         fclose(logPtr);
     }
-    unlink(commandFIFOFile);
+    close(epollFd);
+    close(listenSocket);
+    unlink(socketFile);
 
-    return(0);
+    return(status);
 
 }
 
 
 /*
  *  ======== assignClientId ========
+ *
+ *  Take a slot from the free list, doubling the client table when it is
+ *  empty.  Returns -1 if the table is at LAD_MAXNUMCLIENTS, or can't grow.
  */
 static LAD_ClientHandle assignClientId(Void)
 {
-    Int clientId = -1;
+    LAD_Client * table;
+    Int clientId;
+    Int size;
     Int i;
 
-    /* scan connection status flags to acquire a clientId */
-    for (i = 0; i < LAD_MAXNUMCLIENTS; i++) {
-        /* if slot open then provisionally select this clientId */
-        if (clientConnected[i] == FALSE) {
-             clientId = i;
-             break;
+    if (freeClientId == -1) {
+        size = (numClientSlots == 0) ? LAD_INITNUMCLIENTS : numClientSlots * 2;
+        if (size > LAD_MAXNUMCLIENTS) {
+            size = LAD_MAXNUMCLIENTS;
+        }
+        if (size == numClientSlots) {
+            return(-1);
+        }
+
+        /* clientIds are indices, so existing clients keep theirs */
+        table = realloc(clients, size * sizeof(LAD_Client));
+        if (table == NULL) {
+            LOG1("\nERROR: unable to grow client table to %d\n", size)
+            return(-1);
+        }
+        clients = table;
+
+        /* push the new slots so the lowest is handed out first */
+        for (i = size - 1; i >= numClientSlots; i--) {
+            clients[i].connected = FALSE;
+            clients[i].PID = 0;
+            clients[i].sock = -1;
+            clients[i].serial = 0;
+            clients[i].heldHead = NULL;
+            clients[i].heldTail = NULL;
+            clients[i].next = freeClientId;
+            freeClientId = i;
         }
+
+        LOG2("\nLAD: client table grown from %d to %d slots\n",
+            numClientSlots, size)
+        numClientSlots = size;
     }
 
+    clientId = freeClientId;
+    freeClientId = clients[clientId].next;
+    clients[clientId].next = -1;
+
     return(clientId);
 }
 
 
 /*
- *  ======== cleanupDepartedClients ========
+ *  ======== releaseClientId ========
+ */
+static Void releaseClientId(Int clientId)
+{
+    clients[clientId].PID = 0;
+    clients[clientId].next = freeClientId;
+    freeClientId = clientId;
+}
+
+
+/*
+ *  ======== hashClient ========
+ *
+ *  Add a newly connected client to its PID's hash bucket.
+ */
+static Void hashClient(Int clientId)
+{
+    Int bucket = clients[clientId].PID % LAD_PIDHASHSIZE;
+
+    clients[clientId].next = pidHash[bucket];
+    pidHash[bucket] = clientId;
+}
+
+
+/*
+ *  ======== unhashClient ========
+ */
+static Void unhashClient(Int clientId)
+{
+    Int *link = &pidHash[clients[clientId].PID % LAD_PIDHASHSIZE];
+
+    while (*link != -1) {
+        if (*link == clientId) {
+            *link = clients[clientId].next;
+            break;
+        }
+        link = &clients[*link].next;
+    }
+
+    clients[clientId].next = -1;
+}
+
+
+/*
+ *  ======== isPIDConnected ========
+ *
+ *  Return TRUE if any client of process pid is still connected.
  */
-static Void cleanupDepartedClients(Void)
+static Bool isPIDConnected(UInt pid)
 {
-    Int killStat;
     Int i;
 
-    /* scan all connections to verify client processes still exist... */
-    for (i = 0; i < LAD_MAXNUMCLIENTS; i++) {
+    for (i = pidHash[pid % LAD_PIDHASHSIZE]; i != -1; i = clients[i].next) {
+        if (clients[i].PID == pid) {
+            return(TRUE);
+        }
+    }
 
-        /* if connected... */
-        if (clientConnected[i] == TRUE) {
+    return(FALSE);
+}
 
-            /* check if the client process (PID) still exists */
-            /*
-             * NOTE - calling kill with signal value of 0 will perform
-             * error checking, but not actually send a signal.  Will use this
-             * error check to see if PID still exists.  An alternative was
-             * to call getpgid.  This worked, but is apparently limited to
-             * USE_XOPEN_EXTENDED configurations.
-             */
-            killStat = kill(clientPID[i], 0);
-            if ((killStat == -1) && (errno == ESRCH)) {
 
-                LOG1("\nDETECTED CONNECTED CLIENT #%d HAS DEPARTED!", i)
+/*
+ *  ======== raiseFileLimit ========
+ *
+ *  Lift the soft limit on open descriptors to the hard limit, since LAD
+ *  holds one for each client.
+ */
+static Void raiseFileLimit(Void)
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+        limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+            LOG1("\nERROR: unable to raise open file limit, errno = %x\n",
+                errno)
+        }
+    }
+}
+
+
+/*
+ *  ======== acceptClient ========
+ *
+ *  Accept a new connection, and give it a client slot.  The client is
+ *  only "connected" once its LAD_CONNECT has been answered.
+ */
+static Void acceptClient(Void)
+{
+    struct epoll_event event;
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    Int clientId;
+    int sock;
+
+    sock = accept4(listenSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (sock == -1) {
+        LOG1("\nERROR: accept failed, errno = %x\n", errno)
+        return;
+    }
+
+    /* determine this client's ID */
+    clientId = assignClientId();
+
+    /*
+     * if failed to acquire an ID then refuse the connection.  The socket is
+     * only closed once the client's LAD_CONNECT is read; closing it with
+     * the command unread would reset the connection before the client
+     * sees why.
+     */
+    if (clientId == -1) {
+        LOG0("\nLAD: no free handle; too many connections!\n")
+        rsp.connect.assignedId = -1;
+        rsp.connect.status = LAD_ACCESSDENIED;
+        sendTo(sock, 0);
+
+        event.events = EPOLLIN;
+        event.data.u32 = LAD_REFUSEDTAG | sock;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &event) == -1) {
+            close(sock);
+        }
+        return;
+    }
+
+    event.events = EPOLLIN;
+    event.data.u32 = clientId;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &event) == -1) {
+        LOG1("\nERROR: epoll_ctl failed, errno = %x\n", errno)
+        releaseClientId(clientId);
+        close(sock);
+        return;
+    }
+
+    /* the kernel vouches for the client's PID */
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0) {
+        clients[clientId].PID = cred.pid;
+    }
+
+    clients[clientId].sock = sock;
+    clients[clientId].serial++;
+
+    LOG2("\nLAD: accepted client %d, PID %d\n", clientId,
+        clients[clientId].PID)
+}
+
+
+/*
+ *  ======== getCommand ========
+ *
+ *  Return the clientId of the next client with a command, read into cmd.
+ *  Each ready client gives up one command per pass over the ready list,
+ *  so a busy client can't hold off the others, and a client that stops
+ *  reading its responses can't block LAD.  Returns -1 if epoll_wait()
+ *  fails, which leaves LAD nothing to wait on.
+ */
+static Int getCommand(Void)
+{
+    static struct epoll_event events[LAD_MAXEVENTS];
+    static Int numEvents = 0;
+    static Int next = 0;
+    uint32_t revents;
+    Int clientId;
+    ssize_t n;
+    int sock;
+
+    while (1) {
+        if (next == numEvents) {
+            next = 0;
+            numEvents = epoll_wait(epollFd, events, LAD_MAXEVENTS,
+                                   serviceWatches());
+            if (numEvents == -1 && errno != EINTR) {
+                LOG1("\nERROR: epoll_wait failed, errno = %x\n", errno)
+                numEvents = 0;
+                return(-1);
+            }
+            if (numEvents <= 0) {
+                /* a timeout is a watch that needs service */
+                numEvents = 0;
+                continue;
+            }
+        }
+
+        if (events[next].data.u32 == LAD_LISTENTAG) {
+            next++;
+            acceptClient();
+            continue;
+        }
+
+        if (events[next].data.u32 == LAD_COMPLETETAG) {
+            next++;
+            completeJobs();
+            continue;
+        }
+
+        if (events[next].data.u32 == LAD_ADDEDTAG) {
+            next++;
+            checkAdded();
+            continue;
+        }
+
+        /* a refused client has had its say, or has gone */
+        if (events[next].data.u32 & LAD_REFUSEDTAG) {
+            sock = events[next++].data.u32 & ~LAD_REFUSEDTAG;
+            while (recv(sock, &cmd, LAD_COMMANDLENGTH, MSG_DONTWAIT) > 0) {
+            }
+            close(sock);
+            continue;
+        }
 
-                /* will always need to do the disconnect... */
-                LOG0("\nDoing DISCONNECT on behalf of client...")
-                doDisconnect(i);
+        clientId = events[next].data.u32;
+        revents = events[next++].events;
 
-                MessageQ_cleanupOwner(clientPID[i]);
-//                NameServer_cleanupOwner(clientPID[i]);
+        /* skip a client that departed earlier in this batch */
+        if (clients[clientId].sock == -1) {
+            continue;
+        }
 
-                LOG0("DONE\n")
+        /*
+         * a client with responses held isn't read from until there's room
+         * for them, so one that doesn't keep up gets no further ahead
+         */
+        if (clients[clientId].heldHead != NULL) {
+            if (revents & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                sendHeld(clientId);
             }
+            continue;
+        }
+
+        n = recv(clients[clientId].sock, &cmd, LAD_COMMANDLENGTH,
+                 MSG_DONTWAIT);
+        if (n == LAD_COMMANDLENGTH &&
+            (clients[clientId].connected || cmd.cmd == LAD_CONNECT)) {
+            return(clientId);
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
         }
+
+        /*
+         * end of file, a malformed command, or a command before
+         * LAD_CONNECT: the client is gone
+         */
+        departClient(clientId);
     }
 }
 
 
 /*
- *  ======== connectToLAD ========
+ *  ======== sendResponse ========
+ *
+ *  Send rsp as the answer to the client's command requestId.
  */
-static Int connectToLAD(String clientName, Int pid, String clientProto, Int *clientIdPtr)
+static Void sendResponse(Int clientId, UInt32 requestId)
 {
-    Int clientId = -1;
-    Bool connectDenied = FALSE;
-    Int status = LAD_SUCCESS;
-    FILE * filePtr;
-    Int statusIO;
+    ssize_t n;
+
+    if (clients[clientId].sock == -1) {
+        return;
+    }
+
+    /* responses go out in order behind any that are held */
+    if (clients[clientId].heldHead != NULL) {
+        holdResponse(clientId, requestId);
+        return;
+    }
 
     /*
-     * TODO:L here, and everywhere parse FIFO strings: should
-     * add full error checking for incomplete or corrupted
-     * strings? Since LAD to ladclient comms are "closed", and
-     * tested, the likelihood of problems seems very low.
-     * But should still consider doing full error checking
-     * and, hopefully, recovery.
+     * never wait on a client: if its socket is full, hold the response
+     * until there's room
      */
-    LOG0("\nLAD_CONNECT: \n")
-    LOG1("    client FIFO name = %s\n", clientName)
-    LOG1("    client PID = %d\n", pid)
+    n = sendTo(clients[clientId].sock, requestId);
+    if (n == -1 && errno == EAGAIN) {
+        LOG1("\nLAD: client %d not keeping up, holding response\n", clientId)
+        holdResponse(clientId, requestId);
+        return;
+    }
+    if (n != LAD_RESPONSELENGTH) {
+        LOG2("\nERROR: response to client %d failed, errno = %x\n",
+            clientId, errno)
+        departClient(clientId);
+    }
+}
 
-    /* first check for proper communication protocol */
-    if (strcmp(clientProto, LAD_PROTOCOLVERSION) != 0) {
 
-        /* if no match then reject the request */
-        LOG0("    ERROR: mismatch in communication protocol!\n")
-        LOG1("        LAD protocol = %s\n", LAD_PROTOCOLVERSION)
-        LOG1("        client protocol = %s\n", clientProto)
-        status = LAD_INVALIDVERSION;
+/*
+ *  ======== sendTo ========
+ */
+static ssize_t sendTo(int sock, UInt32 requestId)
+{
+    static struct LAD_ResponseMsg msg;
+
+    msg.requestId = requestId;
+    memcpy(&msg.rsp, &rsp, sizeof(rsp));
+
+    return(send(sock, &msg, LAD_RESPONSELENGTH, MSG_DONTWAIT | MSG_NOSIGNAL));
+}
 
-        /* set flag so know to close FIFO after response */
-        connectDenied = TRUE;
 
-        /* now jump forward a bit to send response */
-        goto openResponseFIFO;
+/*
+ *  ======== holdResponse ========
+ *
+ *  Keep rsp to send once the client's socket has room, and watch for that
+ *  room instead of for more commands.
+ */
+static Void holdResponse(Int clientId, UInt32 requestId)
+{
+    struct epoll_event event;
+    LAD_Held * held;
+
+    held = malloc(sizeof(LAD_Held));
+    if (held == NULL) {
+        LOG1("\nERROR: unable to hold response to client %d\n", clientId)
+        departClient(clientId);
+        return;
     }
 
-    /* determine this client's ID */
-    clientId = assignClientId();
+    held->next = NULL;
+    held->msg.requestId = requestId;
+    memcpy(&held->msg.rsp, &rsp, sizeof(rsp));
 
-    /* if failed to acquire an ID then exit early */
-    if (clientId == -1) {
-        LOG0("    no free handle; too many connections!\n")
-        status = LAD_ACCESSDENIED;
+    if (clients[clientId].heldHead == NULL) {
+        clients[clientId].heldHead = held;
 
-        /* set flag so know to close FIFO after response */
-        connectDenied = TRUE;
+        event.events = EPOLLOUT;
+        event.data.u32 = clientId;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, clients[clientId].sock, &event);
     }
     else {
-        LOG1("    assigned client handle = %d\n", clientId)
-
-        /* save the client's FIFO name for when disconnect */
-        strcpy(clientFIFOName[clientId], clientName);
+        clients[clientId].heldTail->next = held;
     }
+    clients[clientId].heldTail = held;
+}
+
 
-openResponseFIFO:
+/*
+ *  ======== sendHeld ========
+ *
+ *  Send what held responses now fit, and once all are sent go back to
+ *  reading the client's commands.
+ */
+static Void sendHeld(Int clientId)
+{
+    struct epoll_event event;
+    LAD_Held * held;
+    ssize_t n;
+
+    while ((held = clients[clientId].heldHead) != NULL) {
+        n = send(clients[clientId].sock, &held->msg, LAD_RESPONSELENGTH,
+                 MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == -1 && errno == EAGAIN) {
+            return;
+        }
+        if (n != LAD_RESPONSELENGTH) {
+            LOG2("\nERROR: response to client %d failed, errno = %x\n",
+                clientId, errno)
+            departClient(clientId);
+            return;
+        }
+
+        clients[clientId].heldHead = held->next;
+        free(held);
+    }
 
-    /* create the dedicated response FIFO to the client */
-    statusIO = mkfifo(clientName, 0777);
-    if (statusIO != 0) {
+    event.events = EPOLLIN;
+    event.data.u32 = clientId;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, clients[clientId].sock, &event);
+}
 
-        LOG2("\nERROR: unable to mkfifo %s, errno = %x\n", clientName, errno)
 
-        status = LAD_IOFAILURE;
+/*
+ *  ======== freeHeld ========
+ */
+static Void freeHeld(Int clientId)
+{
+    LAD_Held * held;
 
-        /* send no response; connection request will timeout */
-        goto doneconnect;
+    while ((held = clients[clientId].heldHead) != NULL) {
+        clients[clientId].heldHead = held->next;
+        free(held);
     }
+}
+
+
+/*
+ *  ======== departClient ========
+ *
+ *  Clean up after a client whose connection closed, or failed, without a
+ *  LAD_DISCONNECT.
+ */
+static Void departClient(Int clientId)
+{
+    Bool cleanup = clients[clientId].connected;
+    UInt pid = clients[clientId].PID;
+
+    LOG1("\nDETECTED CONNECTED CLIENT #%d HAS DEPARTED!", clientId)
 
-    LOG1("    FIFO %s created\n", clientName)
+    /* will always need to do the disconnect... */
+    LOG0("\nDoing DISCONNECT on behalf of client...")
+    doDisconnect(clientId);
 
-    /* set FIFO permissions to read/write */
-    chmod(clientName, 0666);
+    /* ...but the process may still own resources through another client */
+    if (cleanup == TRUE && !isPIDConnected(pid)) {
+        MessageQ_cleanupOwner(pid);
+//        NameServer_cleanupOwner(pid);
+    }
 
-    filePtr = fopen(clientName, "w");
-    if (filePtr == NULL) {
-        LOG1("\nERROR: unable to open response FIFO %s\n", clientName)
+    LOG0("DONE\n")
+}
 
-        /* if failed open, still need to delete the FIFO */
-        unlink(clientName);
 
-        status = LAD_IOFAILURE;
+/*
+ *  ======== connectToLAD ========
+ */
+static Int connectToLAD(Int clientId, Int pid, String clientProto)
+{
+    Int status = LAD_SUCCESS;
 
-        /* send no response; connection request will timeout */
-        goto doneconnect;
+    /* without SO_PEERCRED, take the client's word for its PID */
+    if (clients[clientId].PID == 0) {
+        clients[clientId].PID = pid;
     }
 
-    LOG1("    FIFO %s opened for writing\n", clientName)
+    LOG0("\nLAD_CONNECT: \n")
+    LOG1("    client handle = %d\n", clientId)
+    LOG1("    client PID = %d\n", clients[clientId].PID)
+
+    /* first check for proper communication protocol */
+    if (strncmp(clientProto, LAD_PROTOCOLVERSION,
+                LAD_MAXLENGTHPROTOVERS) != 0) {
+
+        /* if no match then reject the request */
+        LOG0("    ERROR: mismatch in communication protocol!\n")
+        LOG1("        LAD protocol = %s\n", LAD_PROTOCOLVERSION)
+        status = LAD_INVALIDVERSION;
+    }
+    else if (clients[clientId].connected) {
+        LOG0("    ERROR: already connected!\n")
+        status = LAD_ACCESSDENIED;
+    }
 
     /*
      * set "this client is connected" flag; this client ID is now "owned", and
      * is no longer provisional
      */
-    if (connectDenied == FALSE) {
-        responseFIFOFilePtr[clientId] = filePtr;
-        clientPID[clientId] = pid;
-        clientConnected[clientId] = TRUE;
+    if (status == LAD_SUCCESS) {
+        clients[clientId].connected = TRUE;
+        hashClient(clientId);
     }
 
     rsp.connect.assignedId = clientId;
-    rsp.status = status;
+    rsp.connect.status = status;
 
-    /* put response to FIFO */
-    fwrite(&rsp, LAD_RESPONSELENGTH, 1, filePtr);
-    fflush(filePtr);
+    sendResponse(clientId, cmd.requestId);
 
     LOG0("    sent response\n")
 
-    /* if connection was denied, must now close FIFO */
-    if (connectDenied == TRUE) {
-        LOG1("    connect denied; closing FIFO %s\n", clientName)
-        fclose(filePtr);
-        unlink(clientName);
+    /* if connection was denied, must now close the socket */
+    if (status != LAD_SUCCESS && !clients[clientId].connected) {
+        LOG0("    connect denied; closing socket\n")
+        doDisconnect(clientId);
     }
 
     LOG0("DONE\n")
 
-doneconnect:
-    if (clientIdPtr != NULL) {
-        *clientIdPtr = clientId;
-    }
-
     return(status);
 }
 
@@ -726,17 +1289,680 @@ static Void disconnectFromLAD(Int clientId)
 
 /*
  *  ======== doDisconnect ========
+ *
+ *  Closing the socket is the client's acknowledgement of LAD_DISCONNECT.
+ *  The slot is then free for the next connection.
  */
 static Void doDisconnect(Int clientId)
 {
+    if (clients[clientId].sock == -1) {
+        return;
+    }
+
     /* set "this client is not connected" flag */
-    clientConnected[clientId] = FALSE;
+    if (clients[clientId].connected) {
+        clients[clientId].connected = FALSE;
+        unhashClient(clientId);
+    }
+
+    /* close the client's socket, which also drops it from the epoll set */
+    LOG2("\n    closing socket %d of client %d\n", clients[clientId].sock,
+        clientId)
+    close(clients[clientId].sock);
+    clients[clientId].sock = -1;
+    freeHeld(clientId);
+
+    releaseClientId(clientId);
+}
+
+
+/*
+ *  ======== startWorkers ========
+ *
+ *  Start the threads that run commands which may block, and those that run
+ *  watches' lookups, and add the event they signal on completion to the
+ *  epoll set.
+ */
+static Void startWorkers(Void)
+{
+    struct epoll_event event;
+
+    doneFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (doneFd == -1) {
+        LOG1("\nERROR: unable to create eventfd, errno = %x\n", errno)
+        return;
+    }
+
+    event.events = EPOLLIN;
+    event.data.u32 = LAD_COMPLETETAG;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, doneFd, &event);
+
+    /* without workers, dispatchCommand() declines and all runs inline */
+    if (startPool(&commandJobs, LAD_NUMWORKERS) == 0) {
+        LOG0("\nERROR: unable to start worker threads\n")
+        close(doneFd);
+        doneFd = -1;
+        return;
+    }
+
+    /* without one, watches are looked up inline */
+    if (startPool(&watchJobs, LAD_NUMWATCHWORKERS) == 0) {
+        LOG0("\nERROR: unable to start watch worker threads\n")
+    }
+}
+
+
+/*
+ *  ======== startPool ========
+ *
+ *  Start numWorkers threads taking jobs from queue.  Returns how many
+ *  started.
+ */
+static Int startPool(LAD_JobQueue * queue, Int numWorkers)
+{
+    pthread_t thread;
+    Int i;
+
+    for (i = 0; i < numWorkers; i++) {
+        if (pthread_create(&thread, NULL, workerThread, queue) == 0) {
+            pthread_detach(thread);
+            queue->numWorkers++;
+        }
+    }
+
+    return(queue->numWorkers);
+}
+
+
+/*
+ *  ======== dispatchCommand ========
+ *
+ *  Queue the LAD_NAMESERVER_GETUINT32 in cmd for a worker.  Returns FALSE
+ *  if it can't be, and the caller runs the command itself.  The job holds
+ *  a reference to the instance until it completes, so a
+ *  LAD_NAMESERVER_DELETE meanwhile can't free it under the worker.
+ */
+static Bool dispatchCommand(Int clientId)
+{
+    LAD_Job * job;
+
+    if (doneFd == -1) {
+        return(FALSE);
+    }
+
+    job = malloc(sizeof(LAD_Job));
+    if (job == NULL) {
+        return(FALSE);
+    }
+
+    job->clientId = clientId;
+    job->serial = clients[clientId].serial;
+    job->watch = NULL;
+    memcpy(&job->cmd, &cmd, sizeof(cmd));
+
+    if (!NameServer_acquire(job->cmd.args.getUInt32.handle)) {
+        free(job);
+        return(FALSE);
+    }
+
+    if (!queueJob(&commandJobs, job)) {
+        NameServer_release(job->cmd.args.getUInt32.handle);
+        free(job);
+        return(FALSE);
+    }
+
+    return(TRUE);
+}
+
+
+/*
+ *  ======== queueJob ========
+ *
+ *  Hand job to a worker of queue's pool.  Returns FALSE if there are no
+ *  workers.
+ */
+static Bool queueJob(LAD_JobQueue * queue, LAD_Job * job)
+{
+    if (doneFd == -1 || queue->numWorkers == 0) {
+        return(FALSE);
+    }
+
+    job->next = NULL;
+
+    pthread_mutex_lock(&jobGate);
+    if (queue->tail == NULL) {
+        queue->head = job;
+    }
+    else {
+        queue->tail->next = job;
+    }
+    queue->tail = job;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&jobGate);
+
+    return(TRUE);
+}
+
+
+/*
+ *  ======== workerThread ========
+ *
+ *  Run the commands queued on arg, the LAD_JobQueue of this worker's pool,
+ *  and hand each response back to the main loop, which owns the client
+ *  sockets.
+ */
+static Void *workerThread(Void *arg)
+{
+    LAD_JobQueue * queue = (LAD_JobQueue *)arg;
+    uint64_t one = 1;
+    LAD_Job * job;
+
+    while (1) {
+        pthread_mutex_lock(&jobGate);
+        while (queue->head == NULL) {
+            pthread_cond_wait(&queue->cond, &jobGate);
+        }
+        job = queue->head;
+        queue->head = job->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        pthread_mutex_unlock(&jobGate);
+
+        switch (job->cmd.cmd) {
+          case LAD_NAMESERVER_GETUINT32:
+            getUInt32(&job->cmd, &job->rsp);
+
+            LOG2("LAD_NAMESERVER_GETUINT32: worker done for client %d, "
+                "status = %d\n", job->clientId, job->rsp.status)
+
+            break;
+
+          case LAD_NAMESERVER_WATCH:
+            job->rsp.getUInt32.status = NameServer_getUInt32(
+                job->cmd.args.watch.handle, job->cmd.args.watch.name,
+                &job->rsp.getUInt32.val, job->poll ? job->procId : NULL);
+
+            break;
+
+          default:
+            job->rsp.status = -1;
+
+            break;
+        }
+
+        pthread_mutex_lock(&jobGate);
+        job->next = doneHead;
+        doneHead = job;
+        pthread_mutex_unlock(&jobGate);
+
+        if (write(doneFd, &one, sizeof(one)) != sizeof(one)) {
+            LOG1("\nERROR: eventfd write failed, errno = %x\n", errno)
+        }
+    }
+
+    return(NULL);
+}
+
+
+/*
+ *  ======== completeJobs ========
+ *
+ *  Send the responses of finished jobs.  A response is dropped if its
+ *  client departed while the job ran, even if the clientId is now in use
+ *  by a new connection.
+ */
+static Void completeJobs(Void)
+{
+    uint64_t count;
+    LAD_Job * job;
+    LAD_Job * next;
+
+    if (read(doneFd, &count, sizeof(count)) != sizeof(count)) {
+        return;
+    }
+
+    pthread_mutex_lock(&jobGate);
+    job = doneHead;
+    doneHead = NULL;
+    pthread_mutex_unlock(&jobGate);
+
+    for (; job != NULL; job = next) {
+        next = job->next;
+
+        if (job->watch != NULL) {
+            watchLooked(job->watch, &job->rsp);
+            free(job);
+            continue;
+        }
+
+        NameServer_release(job->cmd.args.getUInt32.handle);
+
+        if (clients[job->clientId].sock != -1 &&
+            clients[job->clientId].serial == job->serial) {
+            LOG1("Sending response to client %d...\n", job->clientId)
+            memcpy(&rsp, &job->rsp, sizeof(rsp));
+            sendResponse(job->clientId, job->cmd.requestId);
+        }
+
+        free(job);
+    }
+}
+
+
+/*
+ *  ======== isLocalLookup ========
+ *
+ *  Return TRUE if a LAD_NAMESERVER_GETUINT32 is answered without asking a
+ *  remote processor: it is found in the local table before any remote is
+ *  searched, or no remote is to be searched at all.
+ */
+static Bool isLocalLookup(struct LAD_CommandObj *c)
+{
+    UInt16 *procId = c->args.getUInt32.procId;
+    UInt16 self = MultiProc_self();
+    UInt32 val;
+    Int i;
+
+    if (procId[0] == (UInt16)-1) {
+        return(MultiProc_getNumProcessors() == 1 ||
+               NameServer_getLocalUInt32(c->args.getUInt32.handle,
+                   c->args.getUInt32.name, &val) >= 0);
+    }
+
+    if (procId[0] == self &&
+        NameServer_getLocalUInt32(c->args.getUInt32.handle,
+            c->args.getUInt32.name, &val) >= 0) {
+        return(TRUE);
+    }
+
+    for (i = 0; i < MultiProc_MAXPROCESSORS && procId[i] != (UInt16)-1; i++) {
+        if (procId[i] != self) {
+            return(FALSE);
+        }
+    }
+
+    return(TRUE);
+}
+
+
+/*
+ *  ======== getUInt32 ========
+ */
+static Void getUInt32(struct LAD_CommandObj *c, union LAD_ResponseObj *r)
+{
+    UInt16 *procIdPtr;
+
+    if (c->args.getUInt32.procId[0] == (UInt16)-1) {
+        procIdPtr = NULL;
+    }
+    else {
+        procIdPtr = c->args.getUInt32.procId;
+    }
+    r->status = NameServer_getUInt32(
+        c->args.getUInt32.handle,
+        c->args.getUInt32.name,
+        &r->getUInt32.val,
+        procIdPtr);
+}
+
+
+/*
+ *  ======== startWatches ========
+ *
+ *  Have NameServer report the names added, so watches for them are
+ *  answered right away.  Without that, watches still find their names by
+ *  polling, though only as often as LAD_WATCHPOLLMAX msecs once they've
+ *  waited a while.
+ */
+static Void startWatches(Void)
+{
+    struct epoll_event event;
+
+    addedFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (addedFd == -1) {
+        LOG1("\nERROR: unable to create eventfd, errno = %x\n", errno)
+        return;
+    }
+
+    event.events = EPOLLIN;
+    event.data.u32 = LAD_ADDEDTAG;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, addedFd, &event);
+
+    NameServer_setAddFxn(nameAdded);
+}
+
+
+/*
+ *  ======== startWatch ========
+ *
+ *  Start waiting for the name in the LAD_NAMESERVER_WATCH in cmd.  Returns
+ *  FALSE if the command is answered now, with the response in rsp.
+ */
+static Bool startWatch(Int clientId)
+{
+    UInt32 timeout = cmd.args.watch.timeout;
+    LAD_Watch * watch;
+    UInt32 val;
+
+    /* held until the watch ends, as its lookups run on a worker */
+    if (!NameServer_acquire(cmd.args.watch.handle)) {
+        rsp.getUInt32.status = NameServer_E_INVALIDARG;
+        return(FALSE);
+    }
+
+    /* a name that's here already needn't wait for anything */
+    if (NameServer_getLocalUInt32(cmd.args.watch.handle,
+            cmd.args.watch.name, &val) >= 0) {
+        NameServer_release(cmd.args.watch.handle);
+        rsp.getUInt32.status = NameServer_S_SUCCESS;
+        rsp.getUInt32.val = val;
+        return(FALSE);
+    }
+
+    watch = malloc(sizeof(LAD_Watch));
+    if (watch == NULL) {
+        NameServer_release(cmd.args.watch.handle);
+        rsp.getUInt32.status = NameServer_E_MEMORY;
+        return(FALSE);
+    }
+
+    watch->clientId = clientId;
+    watch->serial = clients[clientId].serial;
+    watch->requestId = cmd.requestId;
+    watch->handle = cmd.args.watch.handle;
+    strncpy(watch->name, cmd.args.watch.name,
+            NameServer_Params_MAXNAMELEN - 1);
+    watch->name[NameServer_Params_MAXNAMELEN - 1] = '\0';
+    if (timeout == (UInt32)NameServer_FOREVER) {
+        watch->deadline = UINT64_MAX;
+    }
+    else {
+        watch->deadline = watchTime() + (timeout + 999) / 1000;
+    }
+    watch->nextLookup = 0;
+    watch->pollWait = LAD_WATCHPOLL;
+    watch->running = FALSE;
+    watch->again = FALSE;
+
+    watch->next = watchHead;
+    watchHead = watch;
+
+    /* the remotes are asked by a worker, since it can take a while */
+    lookWatch(watch, FALSE);
+
+    return(TRUE);
+}
+
+
+/*
+ *  ======== lookWatch ========
+ *
+ *  Look up a watch's name on every processor, or if poll is TRUE, on just
+ *  the remotes that don't announce their names.  The lookup goes to a
+ *  watch worker, or if it can't, is done here and watch may be gone on
+ *  return.
+ */
+static Void lookWatch(LAD_Watch * watch, Bool poll)
+{
+    union LAD_ResponseObj r;
+    UInt16 procId[MultiProc_MAXPROCESSORS + 1];
+    UInt16 numProcs = MultiProc_getNumProcessors();
+    UInt16 num = 0;
+    UInt16 i;
+    LAD_Job * job;
+
+    if (poll) {
+        for (i = 0; i < numProcs; i++) {
+            if (i != MultiProc_self() && !NameServer_announces(i)) {
+                procId[num++] = i;
+            }
+        }
+        procId[num] = MultiProc_INVALIDID;
+
+        /* every remote announces, so there's nothing to ask */
+        if (num == 0) {
+            r.getUInt32.status = NameServer_E_NOTFOUND;
+            watchLooked(watch, &r);
+            return;
+        }
+    }
+
+    job = malloc(sizeof(LAD_Job));
+    if (job != NULL) {
+        job->clientId = watch->clientId;
+        job->serial = watch->serial;
+        job->watch = watch;
+        job->poll = poll;
+        if (poll) {
+            memcpy(job->procId, procId, sizeof(procId));
+        }
+        job->cmd.cmd = LAD_NAMESERVER_WATCH;
+        job->cmd.requestId = watch->requestId;
+        job->cmd.args.watch.handle = watch->handle;
+        memcpy(job->cmd.args.watch.name, watch->name,
+               NameServer_Params_MAXNAMELEN);
+
+        if (queueJob(&watchJobs, job)) {
+            watch->running = TRUE;
+            return;
+        }
+
+        free(job);
+    }
+
+    r.getUInt32.status = NameServer_getUInt32(watch->handle, watch->name,
+                                              &r.getUInt32.val,
+                                              poll ? procId : NULL);
+    watchLooked(watch, &r);
+}
+
+
+/*
+ *  ======== watchLooked ========
+ *
+ *  Act on the result of a watch's lookup: answer the watch if the name
+ *  was found or can't be, otherwise keep waiting.
+ */
+static Void watchLooked(LAD_Watch * watch, union LAD_ResponseObj *r)
+{
+    Int status = r->getUInt32.status;
+
+    watch->running = FALSE;
+
+    /* NOTFOUND, and remotes that didn't answer or aren't up, may change */
+    if (status >= 0 || (status != NameServer_E_NOTFOUND &&
+                        status != NameServer_E_TIMEOUT &&
+                        status != NameServer_E_RESOURCE)) {
+        endWatch(watch, status, r->getUInt32.val);
+    }
+    else if (watch->again) {
+        watch->again = FALSE;
+        lookWatch(watch, FALSE);
+    }
+    else if (watch->deadline <= watchTime()) {
+        endWatch(watch, NameServer_E_TIMEOUT, 0);
+    }
+    else {
+        watch->nextLookup = watchTime() + watch->pollWait;
+    }
+}
+
+
+/*
+ *  ======== endWatch ========
+ *
+ *  Answer a watch, unless its client has departed, and free it.
+ */
+static Void endWatch(LAD_Watch * watch, Int status, UInt32 val)
+{
+    LAD_Watch ** prev;
+
+    for (prev = &watchHead; *prev != watch; prev = &(*prev)->next) {
+    }
+    *prev = watch->next;
+
+    if (clients[watch->clientId].sock != -1 &&
+        clients[watch->clientId].serial == watch->serial) {
+        LOG2("LAD_NAMESERVER_WATCH: '%s' done, status = %d\n", watch->name,
+            status)
+        rsp.getUInt32.status = status;
+        rsp.getUInt32.val = val;
+        sendResponse(watch->clientId, watch->requestId);
+    }
+
+    NameServer_release(watch->handle);
+    free(watch);
+}
+
+
+/*
+ *  ======== serviceWatches ========
+ *
+ *  Time out the watches that are due to, drop those whose clients have
+ *  departed, and look again for the names of those that haven't seen them
+ *  in a while.  Returns the msecs until this is next needed, or -1 for
+ *  never, for epoll_wait().
+ */
+static int serviceWatches(Void)
+{
+    LAD_Watch * watch;
+    LAD_Watch * next;
+    uint64_t now;
+    uint64_t due;
+    uint64_t wait = UINT64_MAX;
+
+    if (watchHead == NULL) {
+        return(-1);
+    }
+
+    now = watchTime();
+
+    for (watch = watchHead; watch != NULL; watch = next) {
+        next = watch->next;
+
+        /* one with a lookup running is dealt with when it's done */
+        if (watch->running) {
+            continue;
+        }
+
+        if (clients[watch->clientId].sock == -1 ||
+            clients[watch->clientId].serial != watch->serial ||
+            watch->deadline <= now) {
+            endWatch(watch, NameServer_E_TIMEOUT, 0);
+            continue;
+        }
+
+        if (watch->nextLookup <= now) {
+            /* a remote that hasn't announced yet likely never will */
+            watch->pollWait *= 2;
+            if (watch->pollWait > LAD_WATCHPOLLMAX) {
+                watch->pollWait = LAD_WATCHPOLLMAX;
+            }
+            lookWatch(watch, TRUE);
+            continue;
+        }
+
+        due = watch->nextLookup < watch->deadline ?
+              watch->nextLookup : watch->deadline;
+        if (due - now < wait) {
+            wait = due - now;
+        }
+    }
+
+    return(wait == UINT64_MAX ? -1 : (int)wait);
+}
+
+
+/*
+ *  ======== nameAdded ========
+ *
+ *  NameServer's report of a name added.  It can come from NameServer's
+ *  listener thread, so it's passed on to the main loop.
+ */
+static Void nameAdded(NameServer_Handle handle, String name)
+{
+    uint64_t one = 1;
+    LAD_Added * added;
+
+    added = malloc(sizeof(LAD_Added));
+    if (added == NULL) {
+        return;
+    }
+
+    added->handle = handle;
+    strncpy(added->name, name, NameServer_Params_MAXNAMELEN - 1);
+    added->name[NameServer_Params_MAXNAMELEN - 1] = '\0';
+
+    pthread_mutex_lock(&jobGate);
+    added->next = addedHead;
+    addedHead = added;
+    pthread_mutex_unlock(&jobGate);
+
+    if (write(addedFd, &one, sizeof(one)) != sizeof(one)) {
+        LOG1("\nERROR: eventfd write failed, errno = %x\n", errno)
+    }
+}
+
+
+/*
+ *  ======== checkAdded ========
+ *
+ *  Look up the names of the watches waiting for the names just added.
+ */
+static Void checkAdded(Void)
+{
+    uint64_t count;
+    LAD_Added * added;
+    LAD_Added * nextAdded;
+    LAD_Watch * watch;
+    LAD_Watch * next;
+
+    if (read(addedFd, &count, sizeof(count)) != sizeof(count)) {
+        return;
+    }
+
+    pthread_mutex_lock(&jobGate);
+    added = addedHead;
+    addedHead = NULL;
+    pthread_mutex_unlock(&jobGate);
+
+    for (; added != NULL; added = nextAdded) {
+        nextAdded = added->next;
+
+        for (watch = watchHead; watch != NULL; watch = next) {
+            next = watch->next;
+
+            if (watch->handle != added->handle ||
+                strncmp(watch->name, added->name,
+                        NameServer_Params_MAXNAMELEN) != 0) {
+                continue;
+            }
+
+            /* a lookup already running may have missed it */
+            if (watch->running) {
+                watch->again = TRUE;
+            }
+            else {
+                lookWatch(watch, FALSE);
+            }
+        }
+
+        free(added);
+    }
+}
+
+
+/*
+ *  ======== watchTime ========
+ *
+ *  The time, in msecs, for watch deadlines.
+ */
+static uint64_t watchTime(Void)
+{
+    struct timespec now;
 
-    /* close and remove the response FIFO */
-    LOG2("\n    closing FIFO %s (filePtr=%p)\n",
-        clientFIFOName[clientId], responseFIFOFilePtr[clientId])
-    fclose(responseFIFOFilePtr[clientId]);
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    LOG1("    done, unlinking %s\n", clientFIFOName[clientId]);
-    unlink(clientFIFOName[clientId]);
+    return((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
 }
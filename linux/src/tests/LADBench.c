@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   LADBench.c
+ *
+ *  @brief  Benchmark of LAD connect and command latency
+ *
+ *  Times LAD_connect() followed by LAD_disconnect(), which every Ipc_start()
+ *  and Ipc_stop() pays, then a command round trip to LAD.  Last, the same
+ *  command is sent from several client processes at once, to show how LAD
+ *  holds up when it serves them concurrently.  All of those clients are
+ *  connected before any command is sent, so a large numClients also checks
+ *  that LAD takes that many connections.  Then numClients threads share
+ *  one client's connection, each with its own command in flight.  Last,
+ *  one thread sends its commands with LAD_putCommandBatch(), and then
+ *  numClients threads, at least BATCH_THREADS_MIN, do at once on one
+ *  connection, which checks that
+ *  senders finding the socket full read the responses LAD is holding
+ *  instead of waiting on it forever.  Needs LAD, but no remote cores.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ladclient.h>
+#include <_lad.h>
+
+#define NUM_LOOPS_DFLT      10000   /* Connects, and commands, per client */
+#define NUM_CLIENTS_DFLT    8       /* Client processes, and threads */
+#define BATCH_SIZE          64      /* Commands per LAD_putCommandBatch() */
+#define BATCH_THREADS_MIN   64      /* Enough batches to fill the socket */
+
+/* What each thread of benchThreads() does */
+typedef struct {
+    LAD_ClientHandle    handle;
+    UInt32              numLoops;
+    int                 failed;
+} ThreadArgs;
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+/* Connect and disconnect numLoops times; returns avg nsecs, or -1 */
+static long benchConnect(UInt32 numLoops)
+{
+    LAD_ClientHandle handle;
+    struct timespec  start, end;
+    LAD_Status       status;
+    UInt32           i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < numLoops; i++) {
+        if ((status = LAD_connect(&handle)) != LAD_SUCCESS) {
+            printf("Error in LAD_connect: %d\n", status);
+            return (-1);
+        }
+        if ((status = LAD_disconnect(handle)) != LAD_SUCCESS) {
+            printf("Error in LAD_disconnect: %d\n", status);
+            return (-1);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (diff(start, end) / numLoops);
+}
+
+/*
+ *  Connect, say so on ready, and once go is closed send numLoops commands,
+ *  each waiting for its response; 0 on success
+ */
+static int runCommands(UInt32 numLoops, int ready, int go)
+{
+    LAD_ClientHandle        handle;
+    struct LAD_CommandObj   cmd;
+    union LAD_ResponseObj   rsp;
+    LAD_Status              status;
+    UInt32                  i;
+    char                    c = 0;
+
+    status = LAD_connect(&handle);
+    if (status != LAD_SUCCESS) {
+        printf("Error in LAD_connect: %d\n", status);
+    }
+
+    /* report even a failure, so the parent doesn't wait on this client */
+    if (write(ready, &c, 1) != 1 || status != LAD_SUCCESS) {
+        return (1);
+    }
+    read(go, &c, 1);
+
+    for (i = 0; i < numLoops; i++) {
+        cmd.cmd = LAD_MULTIPROC_GETCONFIG;
+        cmd.clientId = handle;
+
+        if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS ||
+            (status = LAD_getResponse(handle, &rsp)) != LAD_SUCCESS) {
+            printf("Error in LAD command: %d\n", status);
+            break;
+        }
+        if (rsp.multiprocGetConfig.status != 0) {
+            printf("Error in LAD_MULTIPROC_GETCONFIG: %d\n",
+                   rsp.multiprocGetConfig.status);
+            break;
+        }
+    }
+
+    LAD_disconnect(handle);
+
+    return ((i == numLoops) ? 0 : 1);
+}
+
+/*
+ *  Run numLoops commands in each of numClients processes at once; returns
+ *  the avg nsecs per command over all of them, or -1.
+ */
+static long benchCommands(UInt32 numLoops, UInt32 numClients)
+{
+    struct timespec  start, end;
+    pid_t            pid;
+    UInt32           i;
+    UInt32           numForked = 0;
+    int              ready[2];
+    int              go[2];
+    int              status;
+    int              failed = 0;
+    char             c;
+
+    if (pipe(ready) == -1 || pipe(go) == -1) {
+        printf("Error in pipe\n");
+        return (-1);
+    }
+
+    for (i = 0; i < numClients; i++) {
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            close(ready[0]);
+            close(go[1]);
+            exit(runCommands(numLoops, ready[1], go[0]));
+        }
+        if (pid < 0) {
+            printf("Error in fork\n");
+            failed = 1;
+            break;
+        }
+        numForked++;
+    }
+
+    close(ready[1]);
+    close(go[0]);
+
+    /* wait for every client to connect, then start them all */
+    for (i = 0; i < numForked; i++) {
+        if (read(ready[0], &c, 1) != 1) {
+            failed = 1;
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    close(go[1]);
+    close(ready[0]);
+
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (failed ? -1 : diff(start, end) / ((long)numLoops * numClients));
+}
+
+/* Send numLoops commands on args->handle, each waiting for its response */
+static void * commandThread(void * arg)
+{
+    ThreadArgs *            args = (ThreadArgs *)arg;
+    struct LAD_CommandObj   cmd;
+    union LAD_ResponseObj   rsp;
+    LAD_Status              status;
+    UInt32                  i;
+
+    for (i = 0; i < args->numLoops; i++) {
+        cmd.cmd = LAD_MULTIPROC_GETCONFIG;
+        cmd.clientId = args->handle;
+
+        if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS ||
+            (status = LAD_getResponse(args->handle, &rsp)) != LAD_SUCCESS ||
+            rsp.multiprocGetConfig.status != 0) {
+            printf("Error in LAD command: %d\n", status);
+            args->failed = 1;
+            break;
+        }
+    }
+
+    return (NULL);
+}
+
+/*
+ *  Send numLoops commands on args->handle in batches of BATCH_SIZE, with
+ *  LAD_putCommandBatch()
+ */
+static void * batchThread(void * arg)
+{
+    ThreadArgs *            args = (ThreadArgs *)arg;
+    struct LAD_CommandObj   cmds[BATCH_SIZE];
+    union LAD_ResponseObj   rsps[BATCH_SIZE];
+    LAD_Status              status = LAD_SUCCESS;
+    UInt32                  i;
+    UInt32                  num;
+    UInt32                  j;
+
+    for (i = 0; i < args->numLoops && status == LAD_SUCCESS; i += num) {
+        num = (args->numLoops - i < BATCH_SIZE) ? args->numLoops - i :
+                                                  BATCH_SIZE;
+        for (j = 0; j < num; j++) {
+            cmds[j].cmd = LAD_MULTIPROC_GETCONFIG;
+            cmds[j].clientId = args->handle;
+        }
+
+        status = LAD_putCommandBatch(cmds, rsps, num);
+        for (j = 0; j < num && status == LAD_SUCCESS; j++) {
+            if (rsps[j].multiprocGetConfig.status != 0) {
+                status = LAD_FAILURE;
+            }
+        }
+    }
+
+    if (status != LAD_SUCCESS) {
+        printf("Error in LAD_putCommandBatch: %d\n", status);
+        args->failed = 1;
+    }
+
+    return (NULL);
+}
+
+/*
+ *  Run numLoops commands, with fxn, in each of numThreads threads of one
+ *  client at once; returns the avg nsecs per command over all of them, or
+ *  -1.
+ */
+static long benchThreads(UInt32 numLoops, UInt32 numThreads,
+                         void * (*fxn)(void *))
+{
+    LAD_ClientHandle handle;
+    struct timespec  start, end;
+    pthread_t *      threads;
+    ThreadArgs *     args;
+    LAD_Status       status;
+    UInt32           i;
+    int              failed = 0;
+
+    threads = malloc(numThreads * sizeof(pthread_t));
+    args = malloc(numThreads * sizeof(ThreadArgs));
+    if (threads == NULL || args == NULL) {
+        printf("Error in malloc\n");
+        free(threads);
+        free(args);
+        return (-1);
+    }
+
+    if ((status = LAD_connect(&handle)) != LAD_SUCCESS) {
+        printf("Error in LAD_connect: %d\n", status);
+        free(threads);
+        free(args);
+        return (-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < numThreads; i++) {
+        args[i].handle = handle;
+        args[i].numLoops = numLoops;
+        args[i].failed = 0;
+        if (pthread_create(&threads[i], NULL, fxn, &args[i]) != 0) {
+            printf("Error in pthread_create\n");
+            numThreads = i;
+            failed = 1;
+            break;
+        }
+    }
+
+    for (i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+        failed |= args[i].failed;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    LAD_disconnect(handle);
+    free(threads);
+    free(args);
+
+    return (failed ? -1 : diff(start, end) / ((long)numLoops * numThreads));
+}
+
+int main (int argc, char * argv[])
+{
+    UInt32  numLoops = NUM_LOOPS_DFLT;
+    UInt32  numClients = NUM_CLIENTS_DFLT;
+    long    connect;
+    long    single;
+    long    multi;
+    long    threads;
+    long    batch;
+    long    batchThreads;
+    UInt32  numBatchThreads;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numLoops = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        numClients = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3 || numLoops == 0 || numClients == 0) {
+        printf("Usage: %s [<numLoops>] [<numClients>]\n", argv[0]);
+        printf("\tDefaults: numLoops: %d; numClients: %d\n",
+                   NUM_LOOPS_DFLT, NUM_CLIENTS_DFLT);
+        exit(0);
+    }
+
+    printf("Using numLoops: %d; numClients: %d\n", numLoops, numClients);
+
+    connect = benchConnect(numLoops);
+    single = benchCommands(numLoops, 1);
+    multi = benchCommands(numLoops, numClients);
+    threads = benchThreads(numLoops, numClients, commandThread);
+    batch = benchThreads(numLoops, 1, batchThread);
+    numBatchThreads = (numClients > BATCH_THREADS_MIN) ? numClients :
+                                                         BATCH_THREADS_MIN;
+    batchThreads = benchThreads(numLoops, numBatchThreads, batchThread);
+
+    if (connect >= 0) {
+        printf("LAD connect+disconnect:  Avg time: %ld nsecs\n", connect);
+    }
+    if (single >= 0) {
+        printf("LAD command, 1 client:   Avg round trip time: %ld nsecs\n",
+               single);
+    }
+    if (multi >= 0) {
+        printf("LAD command, %d clients: Avg time per command: %ld nsecs\n",
+               numClients, multi);
+    }
+
+    if (threads >= 0) {
+        printf("LAD command, %d threads: Avg time per command: %ld nsecs\n",
+               numClients, threads);
+    }
+    if (batch >= 0) {
+        printf("LAD command, batch of %d: Avg time per command: %ld nsecs\n",
+               BATCH_SIZE, batch);
+    }
+    if (batchThreads >= 0) {
+        printf("LAD command, %d threads batching: Avg time per command: "
+               "%ld nsecs\n", numBatchThreads, batchThreads);
+    }
+
+    return ((connect < 0 || single < 0 || multi < 0 || threads < 0 ||
+             batch < 0 || batchThreads < 0) ? 1 : 0);
+}
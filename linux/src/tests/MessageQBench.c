@@ -108,11 +108,8 @@ Int MessageQApp_execute(UInt32 numLoops, UInt32 payloadSize, UInt16 procId)
     sprintf(remoteQueueName, "%s_%s", SLAVE_MESSAGEQNAME,
              MultiProc_getName(procId));
 
-    /* Poll until remote side has its messageQ created before we send: */
-    do {
-        status = MessageQ_open(remoteQueueName, &queueId);
-        sleep (1);
-    } while (status == MessageQ_E_NOTFOUND);
+    /* Wait for remote side to have its messageQ created before we send: */
+    status = MessageQ_openWait(remoteQueueName, &queueId, MessageQ_FOREVER);
 
     if (status < 0) {
         printf("Error in MessageQ_open [%d]\n", status);
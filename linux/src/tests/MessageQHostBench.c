@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   MessageQHostBench.c
+ *
+ *  @brief  Benchmark of MessageQ round trips between two host processes
+ *
+ *  A child process echoes every message back to its reply queue, so each
+ *  round trip crosses the host's shared memory transport twice.  Then the
+ *  same number of messages is streamed one way in MessageQ_putMany()
+ *  bursts, with only the last one echoed.  For comparison, both are run
+ *  between two processes over a SOCK_SEQPACKET socketpair as well.  Needs
+ *  LAD, but no remote cores.
+ *
+ *  Messages too large for the shared memory transport are allocated from a
+ *  shared heap, so only descriptors cross it and the payload is never
+ *  copied, where the socketpair copies all of it twice per message.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sched.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/MessageQ.h>
+#include <_MessageQ.h>
+
+#define MINPAYLOADSIZE      (2 * sizeof(UInt32))
+
+#define HEAPID              0u
+#define SHAREDHEAPID        1u
+#define MAXCOPYSIZE         512     /* Largest message the transport copies */
+#define SHAREDBLOCKS        (4 * BURST)
+#define PING_MESSAGEQNAME   "HOST_PING"
+#define PONG_MESSAGEQNAME   "HOST_PONG"
+
+#define NUM_LOOPS_DFLT      100000  /* Number of round trips per path */
+#define OPEN_TIMEOUT        1000000 /* Usecs to wait for the pong queue */
+#define BURST               32      /* Messages per MessageQ_putMany() */
+
+typedef struct SyncMsg {
+    MessageQ_MsgHeader header;
+    UInt32 numLoops;  /* also used for msgId */
+    UInt32 print;     /* here, set to have the message echoed */
+} SyncMsg ;
+
+/* Round trip and per-message streaming times, in nsecs */
+typedef struct BenchTimes {
+    long roundTrip;
+    long stream;
+} BenchTimes;
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+/* Allocate a message, waiting for the child to free one if heap is empty */
+static MessageQ_Msg allocMsg(UInt16 heapId, UInt32 msgSize)
+{
+    MessageQ_Msg msg;
+
+    while ((msg = MessageQ_alloc(heapId, msgSize)) == NULL &&
+           heapId == SHAREDHEAPID) {
+        sched_yield();
+    }
+
+    return (msg);
+}
+
+/*
+ *  Child: echo the messages marked for it, and the last one streamed.
+ *  It needn't register the shared heap; receiving from it maps it.
+ */
+static int pongMessageQ(UInt32 numLoops)
+{
+    MessageQ_Params  msgParams;
+    MessageQ_Handle  handle;
+    MessageQ_Msg     msgs[BURST];
+    MessageQ_QueueId replyQueue;
+    SyncMsg *        msg;
+    UInt32           i;
+    Int              count;
+    Int              j;
+
+    if (Ipc_start() < 0) {
+        printf("pong: Ipc_start failed\n");
+        return (1);
+    }
+
+    MessageQ_Params_init(&msgParams);
+    handle = MessageQ_create(PONG_MESSAGEQNAME, &msgParams);
+    if (handle == NULL) {
+        printf("pong: Error in MessageQ_create\n");
+        Ipc_stop();
+        return (1);
+    }
+
+    for (i = 0; i < 2 * numLoops; i += count) {
+        count = MessageQ_getMany(handle, msgs, BURST, MessageQ_FOREVER);
+        if (count < 0) {
+            printf("pong: Error in MessageQ_getMany\n");
+            break;
+        }
+        for (j = 0; j < count; j++) {
+            msg = (SyncMsg *)msgs[j];
+            if (!msg->print && msg->numLoops != numLoops) {
+                MessageQ_free(msgs[j]);
+                continue;
+            }
+            replyQueue = MessageQ_getReplyQueue(msgs[j]);
+            if (MessageQ_put(replyQueue, msgs[j]) < 0) {
+                printf("pong: Error in MessageQ_put\n");
+            }
+        }
+    }
+
+    MessageQ_delete(&handle);
+    Ipc_stop();
+
+    return (0);
+}
+
+/* Child: echo datagrams back on the same socket, as pongMessageQ() does */
+static int pongSocket(int sock, UInt32 numLoops, UInt32 msgSize)
+{
+    SyncMsg *  buf;
+    UInt32     i;
+    ssize_t    len;
+
+    buf = malloc(msgSize);
+
+    for (i = 0; i < 2 * numLoops; i++) {
+        len = recv(sock, buf, msgSize, 0);
+        if (len <= 0) {
+            printf("pong: socket recv failed\n");
+            break;
+        }
+        if (!buf->print && buf->numLoops != numLoops) {
+            continue;
+        }
+        if (send(sock, buf, len, 0) != len) {
+            printf("pong: socket echo failed\n");
+            break;
+        }
+    }
+
+    free(buf);
+
+    return (0);
+}
+
+static void benchMessageQ(UInt32 numLoops, UInt32 msgSize, UInt16 heapId,
+        BenchTimes * t)
+{
+    MessageQ_PoolParams poolParams;
+    MessageQ_Params  msgParams;
+    MessageQ_Handle  pingHandle = NULL;
+    MessageQ_QueueId pongQueue;
+    MessageQ_Msg     msg = NULL;
+    MessageQ_Msg     msgs[BURST];
+    struct timespec  start, end;
+    pid_t            pid;
+    UInt32           i;
+    UInt32           j;
+    UInt32           num;
+
+    t->roundTrip = -1;
+    t->stream = -1;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        exit(pongMessageQ(numLoops));
+    }
+
+    if (Ipc_start() < 0) {
+        printf("Ipc_start failed\n");
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    if (heapId == SHAREDHEAPID) {
+        MessageQ_PoolParams_init(&poolParams);
+        poolParams.sharedBlockSize = msgSize;
+        poolParams.sharedNumBlocks = SHAREDBLOCKS;
+        if (MessageQ_registerHeap(&poolParams, heapId) < 0) {
+            printf("Error in MessageQ_registerHeap\n");
+            heapId = HEAPID;
+            goto cleanup;
+        }
+    }
+
+    MessageQ_Params_init(&msgParams);
+    pingHandle = MessageQ_create(PING_MESSAGEQNAME, &msgParams);
+    if (pingHandle == NULL) {
+        printf("Error in MessageQ_create\n");
+        goto cleanup;
+    }
+
+    /* Wait for the child to create its queue */
+    if (MessageQ_openWait(PONG_MESSAGEQNAME, &pongQueue, OPEN_TIMEOUT) !=
+        MessageQ_S_SUCCESS) {
+        printf("Error in MessageQ_open\n");
+        goto cleanup;
+    }
+
+    msg = allocMsg(heapId, msgSize);
+    if (msg == NULL) {
+        printf("Error in MessageQ_alloc\n");
+        goto cleanup;
+    }
+    MessageQ_setReplyQueue(pingHandle, msg);
+    ((SyncMsg *)msg)->print = TRUE;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 1; i <= numLoops; i++) {
+        ((SyncMsg *)msg)->numLoops = i;
+
+        if (MessageQ_put(pongQueue, msg) < 0) {
+            printf("Error in MessageQ_put\n");
+            msg = NULL;
+            break;
+        }
+        if (MessageQ_get(pingHandle, &msg, MessageQ_FOREVER) < 0) {
+            printf("Error in MessageQ_get\n");
+            break;
+        }
+        if (((SyncMsg *)msg)->numLoops != i) {
+            printf("Data integrity failure!\n"
+                    "    Expected %d\n"
+                    "    Received %d\n",
+                    i, ((SyncMsg *)msg)->numLoops);
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (i <= numLoops) {
+        goto cleanup;
+    }
+    t->roundTrip = diff(start, end) / numLoops;
+    MessageQ_free(msg);
+    msg = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 1; i <= numLoops; i += num) {
+        num = MIN(BURST, numLoops - i + 1);
+        for (j = 0; j < num; j++) {
+            msgs[j] = allocMsg(heapId, msgSize);
+            MessageQ_setReplyQueue(pingHandle, msgs[j]);
+            ((SyncMsg *)msgs[j])->numLoops = i + j;
+            ((SyncMsg *)msgs[j])->print = FALSE;
+        }
+        if (MessageQ_putMany(pongQueue, msgs, num) != (Int)num) {
+            printf("Error in MessageQ_putMany\n");
+            goto cleanup;
+        }
+    }
+
+    /* The last one comes back once the child has drained the rest */
+    if (MessageQ_get(pingHandle, &msg, MessageQ_FOREVER) < 0) {
+        printf("Error in MessageQ_get\n");
+        goto cleanup;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    t->stream = diff(start, end) / numLoops;
+
+cleanup:
+    if (msg != NULL) {
+        MessageQ_free(msg);
+    }
+    if (t->stream < 0) {
+        kill(pid, SIGTERM);
+    }
+    waitpid(pid, NULL, 0);
+    if (pingHandle != NULL) {
+        MessageQ_delete(&pingHandle);
+    }
+    if (heapId == SHAREDHEAPID) {
+        MessageQ_unregisterHeap(heapId);
+    }
+    Ipc_stop();
+}
+
+static void benchSocket(UInt32 numLoops, UInt32 msgSize, BenchTimes * t)
+{
+    int              sv[2];
+    SyncMsg *        buf;
+    struct timespec  start, end;
+    pid_t            pid;
+    UInt32           i;
+
+    t->roundTrip = -1;
+    t->stream = -1;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        printf("Error in socketpair\n");
+        return;
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        exit(pongSocket(sv[1], numLoops, msgSize));
+    }
+    close(sv[1]);
+
+    buf = calloc(1, msgSize);
+    buf->print = TRUE;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 1; i <= numLoops; i++) {
+        buf->numLoops = i;
+        if (send(sv[0], buf, msgSize, 0) != (ssize_t)msgSize ||
+            recv(sv[0], buf, msgSize, 0) != (ssize_t)msgSize) {
+            printf("Error in socket ping\n");
+            goto cleanup;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    t->roundTrip = diff(start, end) / numLoops;
+    buf->print = FALSE;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 1; i <= numLoops; i++) {
+        buf->numLoops = i;
+        if (send(sv[0], buf, msgSize, 0) != (ssize_t)msgSize) {
+            printf("Error in socket stream\n");
+            goto cleanup;
+        }
+    }
+    if (recv(sv[0], buf, msgSize, 0) != (ssize_t)msgSize) {
+        printf("Error in socket stream\n");
+        goto cleanup;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    t->stream = diff(start, end) / numLoops;
+
+cleanup:
+    close(sv[0]);
+    if (t->stream < 0) {
+        kill(pid, SIGTERM);
+    }
+    waitpid(pid, NULL, 0);
+    free(buf);
+}
+
+int main (int argc, char * argv[])
+{
+    UInt32     numLoops = NUM_LOOPS_DFLT;
+    UInt32     payloadSize = MINPAYLOADSIZE;
+    UInt32     msgSize;
+    BenchTimes host;
+    BenchTimes sock;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numLoops = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        payloadSize = MAX(strtoul(argv[2], NULL, 0), MINPAYLOADSIZE);
+    }
+
+    if (argc > 3 || numLoops == 0) {
+        printf("Usage: %s [<numLoops>] [<payloadSize>]\n", argv[0]);
+        printf("\tDefaults: numLoops: %d; payloadSize: %d\n",
+                   NUM_LOOPS_DFLT, (int)MINPAYLOADSIZE);
+        exit(0);
+    }
+
+    msgSize = sizeof(SyncMsg) + payloadSize;
+
+    printf("Using numLoops: %d; payloadSize: %d\n", numLoops, payloadSize);
+
+    /* Each process starts Ipc for itself, after the fork */
+    benchMessageQ(numLoops, msgSize,
+                  (msgSize > MAXCOPYSIZE) ? SHAREDHEAPID : HEAPID, &host);
+    benchSocket(numLoops, msgSize, &sock);
+
+    if (host.roundTrip >= 0) {
+        printf("MessageQ host: Avg round trip time: %ld nsecs\n",
+               host.roundTrip);
+    }
+    if (host.stream >= 0) {
+        printf("MessageQ host: Avg streamed message time: %ld nsecs\n",
+               host.stream);
+    }
+    if (sock.roundTrip >= 0) {
+        printf("socketpair:    Avg round trip time: %ld nsecs\n",
+               sock.roundTrip);
+    }
+    if (sock.stream >= 0) {
+        printf("socketpair:    Avg streamed message time: %ld nsecs\n",
+               sock.stream);
+    }
+
+    return ((host.stream < 0) ? 1 : 0);
+}
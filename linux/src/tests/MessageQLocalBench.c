@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   MessageQLocalBench.c
+ *
+ *  @brief  Benchmark of MessageQ round trips within one Linux process
+ *
+ *  Two threads bounce a message between two MessageQs created by this
+ *  process, which MessageQ_put() delivers through the in-process local
+ *  queue.  For comparison, the same ping-pong is then run over a
+ *  SOCK_SEQPACKET socketpair with send()/recv(), which is the cost of one
+ *  kernel socket round trip and two copies per hop.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/MessageQ.h>
+
+#define MINPAYLOADSIZE      (2 * sizeof(UInt32))
+
+#define HEAPID              0u
+#define PING_MESSAGEQNAME   "LOCAL_PING"
+#define PONG_MESSAGEQNAME   "LOCAL_PONG"
+
+#define NUM_LOOPS_DFLT      100000  /* Number of round trips per path */
+
+typedef struct SyncMsg {
+    MessageQ_MsgHeader header;
+    UInt32 numLoops;  /* also used for msgId */
+    UInt32 print;
+} SyncMsg ;
+
+typedef struct PongArgs {
+    MessageQ_Handle handle;
+    int sock;
+    UInt32 numLoops;
+    UInt32 msgSize;
+} PongArgs;
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+/* Echo every message back to its reply queue */
+static void * pongMessageQ(void * arg)
+{
+    PongArgs *       args = (PongArgs *)arg;
+    MessageQ_Msg     msg;
+    MessageQ_QueueId replyQueue;
+    UInt32           i;
+
+    for (i = 0; i < args->numLoops; i++) {
+        if (MessageQ_get(args->handle, &msg, MessageQ_FOREVER) < 0) {
+            printf("pong: Error in MessageQ_get\n");
+            break;
+        }
+        replyQueue = MessageQ_getReplyQueue(msg);
+        if (MessageQ_put(replyQueue, msg) < 0) {
+            printf("pong: Error in MessageQ_put\n");
+            break;
+        }
+    }
+
+    return (NULL);
+}
+
+/* Echo every datagram back on the same socket */
+static void * pongSocket(void * arg)
+{
+    PongArgs * args = (PongArgs *)arg;
+    char *     buf;
+    UInt32     i;
+    ssize_t    len;
+
+    buf = malloc(args->msgSize);
+
+    for (i = 0; i < args->numLoops; i++) {
+        len = recv(args->sock, buf, args->msgSize, 0);
+        if (len <= 0 || send(args->sock, buf, len, 0) != len) {
+            printf("pong: socket echo failed\n");
+            break;
+        }
+    }
+
+    free(buf);
+
+    return (NULL);
+}
+
+static long benchMessageQ(UInt32 numLoops, UInt32 msgSize)
+{
+    MessageQ_Params  msgParams;
+    MessageQ_Handle  pingHandle;
+    MessageQ_Handle  pongHandle;
+    MessageQ_QueueId pongQueue;
+    MessageQ_Msg     msg;
+    PongArgs         args;
+    pthread_t        thread;
+    struct timespec  start, end;
+    long             elapsed = -1;
+    UInt32           i;
+
+    MessageQ_Params_init(&msgParams);
+    pingHandle = MessageQ_create(PING_MESSAGEQNAME, &msgParams);
+    pongHandle = MessageQ_create(PONG_MESSAGEQNAME, &msgParams);
+    if (pingHandle == NULL || pongHandle == NULL) {
+        printf("Error in MessageQ_create\n");
+        goto cleanup;
+    }
+    pongQueue = MessageQ_getQueueId(pongHandle);
+
+    msg = MessageQ_alloc(HEAPID, msgSize);
+    if (msg == NULL) {
+        printf("Error in MessageQ_alloc\n");
+        goto cleanup;
+    }
+    MessageQ_setReplyQueue(pingHandle, msg);
+
+    args.handle = pongHandle;
+    args.numLoops = numLoops;
+    pthread_create(&thread, NULL, pongMessageQ, &args);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 1; i <= numLoops; i++) {
+        ((SyncMsg *)msg)->numLoops = i;
+
+        if (MessageQ_put(pongQueue, msg) < 0) {
+            printf("Error in MessageQ_put\n");
+            break;
+        }
+        if (MessageQ_get(pingHandle, &msg, MessageQ_FOREVER) < 0) {
+            printf("Error in MessageQ_get\n");
+            break;
+        }
+        if (((SyncMsg *)msg)->numLoops != i) {
+            printf("Data integrity failure!\n"
+                    "    Expected %d\n"
+                    "    Received %d\n",
+                    i, ((SyncMsg *)msg)->numLoops);
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_join(thread, NULL);
+    MessageQ_free(msg);
+
+    if (i > numLoops) {
+        elapsed = diff(start, end);
+    }
+
+cleanup:
+    if (pongHandle != NULL) {
+        MessageQ_delete(&pongHandle);
+    }
+    if (pingHandle != NULL) {
+        MessageQ_delete(&pingHandle);
+    }
+
+    return (elapsed);
+}
+
+static long benchSocket(UInt32 numLoops, UInt32 msgSize)
+{
+    int              sv[2];
+    char *           buf;
+    PongArgs         args;
+    pthread_t        thread;
+    struct timespec  start, end;
+    UInt32           i;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        printf("Error in socketpair\n");
+        return (-1);
+    }
+    buf = calloc(1, msgSize);
+
+    args.sock = sv[1];
+    args.numLoops = numLoops;
+    args.msgSize = msgSize;
+    pthread_create(&thread, NULL, pongSocket, &args);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 1; i <= numLoops; i++) {
+        ((SyncMsg *)buf)->numLoops = i;
+        if (send(sv[0], buf, msgSize, 0) != (ssize_t)msgSize ||
+            recv(sv[0], buf, msgSize, 0) != (ssize_t)msgSize) {
+            printf("Error in socket ping\n");
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_join(thread, NULL);
+    free(buf);
+    close(sv[0]);
+    close(sv[1]);
+
+    return ((i > numLoops) ? diff(start, end) : -1);
+}
+
+int main (int argc, char * argv[])
+{
+    Int32  status = 0;
+    UInt32 numLoops = NUM_LOOPS_DFLT;
+    UInt32 payloadSize = MINPAYLOADSIZE;
+    UInt32 msgSize;
+    long   localNs;
+    long   sockNs;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numLoops = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        payloadSize = MAX(strtoul(argv[2], NULL, 0), MINPAYLOADSIZE);
+    }
+
+    if (argc > 3 || numLoops == 0) {
+        printf("Usage: %s [<numLoops>] [<payloadSize>]\n", argv[0]);
+        printf("\tDefaults: numLoops: %d; payloadSize: %d\n",
+                   NUM_LOOPS_DFLT, (int)MINPAYLOADSIZE);
+        exit(0);
+    }
+
+    msgSize = sizeof(SyncMsg) + payloadSize;
+
+    status = Ipc_start();
+    if (status < 0) {
+        printf("Ipc_start failed: status = %d\n", status);
+        return (status);
+    }
+
+    printf("Using numLoops: %d; payloadSize: %d\n", numLoops, payloadSize);
+
+    localNs = benchMessageQ(numLoops, msgSize);
+    sockNs = benchSocket(numLoops, msgSize);
+
+    if (localNs >= 0) {
+        printf("MessageQ local: Avg round trip time: %ld nsecs\n",
+               localNs / numLoops);
+    }
+    if (sockNs >= 0) {
+        printf("socketpair:     Avg round trip time: %ld nsecs\n",
+               sockNs / numLoops);
+    }
+
+    Ipc_stop();
+
+    return (status);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   MessageQOpenBench.c
+ *
+ *  @brief  Benchmark of MessageQ_open() on queues local to the host
+ *
+ *  Creates numQueues queues and times opening them, first with the
+ *  NameServer client looking names up in LAD's shared mirror of its local
+ *  table, then again with IPC_NAMESERVER_NOMIRROR set so that every
+ *  open() is a round trip to LAD, as it was before the mirror.  Each pass
+ *  also times opening a queue after it's deleted, which the mirror must
+ *  not answer.  Needs LAD, but no remote cores.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/MessageQ.h>
+
+#define NUM_LOOPS_DFLT      100000  /* Opens per pass */
+#define NUM_QUEUES_DFLT     16      /* Queues opened in turn */
+#define MAX_QUEUES          256
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+/* One pass, with or without the mirror; returns the number of errors */
+static int pass(Bool mirror, UInt32 numLoops, UInt32 numQueues)
+{
+    MessageQ_Handle  queue[MAX_QUEUES];
+    MessageQ_QueueId id;
+    struct timespec  start, end;
+    char             name[32];
+    UInt32           i;
+    int              errors = 0;
+    long             hit;
+    long             gone;
+
+    /* The NameServer client decides in Ipc_start() */
+    if (mirror) {
+        unsetenv("IPC_NAMESERVER_NOMIRROR");
+    }
+    else {
+        setenv("IPC_NAMESERVER_NOMIRROR", "1", 1);
+    }
+
+    if (Ipc_start() < 0) {
+        printf("Ipc_start failed\n");
+        return (1);
+    }
+
+    for (i = 0; i < numQueues; i++) {
+        snprintf(name, sizeof(name), "OpenBench%d", (int)i);
+        queue[i] = MessageQ_create(name, NULL);
+        if (queue[i] == NULL) {
+            printf("Error in MessageQ_create\n");
+            numQueues = i;
+            errors++;
+            goto exit;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < numLoops; i++) {
+        snprintf(name, sizeof(name), "OpenBench%d", (int)(i % numQueues));
+        if (MessageQ_open(name, &id) < 0 ||
+            id != MessageQ_getQueueId(queue[i % numQueues])) {
+            errors++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    hit = diff(start, end) / numLoops;
+
+    /* A deleted queue must not be found, mirror or no mirror */
+    MessageQ_delete(&queue[numQueues - 1]);
+    snprintf(name, sizeof(name), "OpenBench%d", (int)(numQueues - 1));
+    numQueues--;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (MessageQ_open(name, &id) != MessageQ_E_NOTFOUND) {
+        errors++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    gone = diff(start, end);
+
+    printf("%s: open %ld nsecs, open after delete %ld nsecs\n",
+           mirror ? "mirror" : "LAD   ", hit, gone);
+
+exit:
+    for (i = 0; i < numQueues; i++) {
+        MessageQ_delete(&queue[i]);
+    }
+
+    Ipc_stop();
+
+    return (errors);
+}
+
+int main (int argc, char * argv[])
+{
+    UInt32  numLoops = NUM_LOOPS_DFLT;
+    UInt32  numQueues = NUM_QUEUES_DFLT;
+    int     errors;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numLoops = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        numQueues = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3 || numLoops == 0 || numQueues == 0 ||
+        numQueues > MAX_QUEUES) {
+        printf("Usage: %s [<numLoops>] [<numQueues>]\n", argv[0]);
+        printf("\tDefaults: numLoops: %d; numQueues: %d (max %d)\n",
+                   NUM_LOOPS_DFLT, NUM_QUEUES_DFLT, MAX_QUEUES);
+        exit(0);
+    }
+
+    printf("Using numLoops: %d; numQueues: %d\n", numLoops, numQueues);
+
+    errors = pass(FALSE, numLoops, numQueues);
+    errors += pass(TRUE, numLoops, numQueues);
+
+    if (errors) {
+        printf("%d opens got the wrong answer\n", errors);
+    }
+
+    return (errors != 0);
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   MessageQWaitBench.c
+ *
+ *  @brief  Benchmark of the MessageQ_get() wait/dispatch path
+ *
+ *  Compares the original select() based receive path (rebuild an fd_set
+ *  over every remote processor, select(), then scan for the ready fd)
+ *  against the persistent epoll set now used by MessageQ_get().
+ *
+ *  A loopback endpoint is emulated with one SOCK_SEQPACKET socketpair per
+ *  "remote processor" plus an eventfd for MessageQ_unblock(), so this
+ *  runs on any Linux host without remote cores or LAD.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ti/ipc/MultiProc.h>
+#include <_MultiProc.h>
+
+#define NUM_LOOPS_DFLT      100000  /* Number of messages per path */
+#define NUM_PROCS_DFLT      5       /* Number of emulated processors */
+#define MSG_SIZE            64
+
+#define UNBLOCKTAG          0xFFFFFFFF
+
+typedef struct Endpoint {
+    int sendFd[MultiProc_MAXPROCESSORS];    /* "remote" side */
+    int recvFd[MultiProc_MAXPROCESSORS];    /* MessageQ_Object.fd[] */
+    int unblockFd;
+    int epollFd;
+    int numProcs;
+} Endpoint;
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+/*
+ *  ======== getSelect ========
+ *  Receive one message the way MessageQ_get() used to.
+ */
+static Int getSelect(Endpoint *ep, char *buf)
+{
+    static int last = 0;
+    fd_set rfds;
+    int maxfd = 0;
+    int rprocId;
+    int retval;
+
+    FD_ZERO(&rfds);
+    for (rprocId = 0; rprocId < ep->numProcs; rprocId++) {
+        maxfd = MAX(maxfd, ep->recvFd[rprocId]);
+        FD_SET(ep->recvFd[rprocId], &rfds);
+    }
+    FD_SET(ep->unblockFd, &rfds);
+
+    retval = select(MAX(maxfd, ep->unblockFd) + 1, &rfds, NULL, NULL, NULL);
+    if (retval <= 0 || FD_ISSET(ep->unblockFd, &rfds)) {
+        return (-1);
+    }
+
+    rprocId = last;
+    do {
+        if (FD_ISSET(ep->recvFd[rprocId], &rfds)) {
+            last = (rprocId + 1) % ep->numProcs;
+            return (recv(ep->recvFd[rprocId], buf, MSG_SIZE, 0));
+        }
+        rprocId = (rprocId + 1) % ep->numProcs;
+    } while (rprocId != last);
+
+    return (-1);
+}
+
+/*
+ *  ======== getEpoll ========
+ *  Receive one message the way MessageQ_get() does now.
+ */
+static Int getEpoll(Endpoint *ep, char *buf)
+{
+    struct epoll_event event;
+
+    if (epoll_wait(ep->epollFd, &event, 1, -1) != 1 ||
+        event.data.u32 == UNBLOCKTAG) {
+        return (-1);
+    }
+
+    return (recv(ep->recvFd[event.data.u32], buf, MSG_SIZE, 0));
+}
+
+static Int runLoop(Endpoint *ep, UInt32 numLoops,
+                   Int (*getFxn)(Endpoint *, char *))
+{
+    char buf[MSG_SIZE];
+    UInt32 i;
+    int proc;
+
+    memset(buf, 0, sizeof(buf));
+
+    for (i = 0; i < numLoops; i++) {
+        /* round robin the sender, so every endpoint sees traffic */
+        proc = i % ep->numProcs;
+        if (send(ep->sendFd[proc], buf, MSG_SIZE, 0) != MSG_SIZE) {
+            printf("send failed on endpoint %d\n", proc);
+            return (-1);
+        }
+        if (getFxn(ep, buf) != MSG_SIZE) {
+            printf("receive failed at loop %d\n", i);
+            return (-1);
+        }
+    }
+
+    return (0);
+}
+
+int main(int argc, char * argv[])
+{
+    Endpoint ep;
+    UInt32 numLoops = NUM_LOOPS_DFLT;
+    struct epoll_event event;
+    struct timespec start, end;
+    long selectNs, epollNs;
+    int sv[2];
+    int i;
+
+    ep.numProcs = NUM_PROCS_DFLT;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numLoops = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        ep.numProcs = MIN(MAX(atoi(argv[2]), 1), MultiProc_MAXPROCESSORS);
+    }
+
+    if (argc > 3 || numLoops == 0) {
+        printf("Usage: %s [<numLoops>] [<numProcs>]\n", argv[0]);
+        printf("\tDefaults: numLoops: %d; numProcs: %d\n",
+                   NUM_LOOPS_DFLT, NUM_PROCS_DFLT);
+        exit(0);
+    }
+
+    ep.unblockFd = eventfd(0, 0);
+    ep.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (ep.unblockFd < 0 || ep.epollFd < 0) {
+        printf("eventfd/epoll_create1 failed\n");
+        exit(1);
+    }
+
+    for (i = 0; i < ep.numProcs; i++) {
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+            printf("socketpair failed\n");
+            exit(1);
+        }
+        ep.sendFd[i] = sv[0];
+        ep.recvFd[i] = sv[1];
+
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(ep.epollFd, EPOLL_CTL_ADD, ep.recvFd[i], &event);
+    }
+
+    event.events = EPOLLIN;
+    event.data.u32 = UNBLOCKTAG;
+    epoll_ctl(ep.epollFd, EPOLL_CTL_ADD, ep.unblockFd, &event);
+
+    printf("Using numLoops: %d; numProcs: %d\n", numLoops, ep.numProcs);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (runLoop(&ep, numLoops, getSelect) < 0) {
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    selectNs = diff(start, end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (runLoop(&ep, numLoops, getEpoll) < 0) {
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    epollNs = diff(start, end);
+
+    printf("select(): avg put/get time: %ld nsecs\n", selectNs / numLoops);
+    printf("epoll():  avg put/get time: %ld nsecs\n", epollNs / numLoops);
+
+    for (i = 0; i < ep.numProcs; i++) {
+        close(ep.sendFd[i]);
+        close(ep.recvFd[i]);
+    }
+    close(ep.unblockFd);
+    close(ep.epollFd);
+
+    return (0);
+}
@@ -223,14 +223,9 @@ int Main_main(Void)
         procName = MultiProc_getName(procId);
         sprintf(queueName, "%s_%s", SLAVE_MSGQNAME, procName);
 
-        /* open the remote message queue, loop until queue is available */
-        do {
-            status = MessageQ_open(queueName, &Main_msgQueAry[p]);
-
-            if (status == MessageQ_E_NOTFOUND) {
-                sleep(1);
-            }
-        } while (status == MessageQ_E_NOTFOUND);
+        /* open the remote message queue, waiting until it is available */
+        status = MessageQ_openWait(queueName, &Main_msgQueAry[p],
+                                   MessageQ_FOREVER);
 
         if (status < 0) {
             printf("Error: MessageQ_open(\"%s\") failed, status=%d\n",
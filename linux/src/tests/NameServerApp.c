@@ -41,6 +41,7 @@
 
 /* Standard headers */
 #include <stdio.h>
+#include <string.h>
 
 /* IPC Standard header */
 #include <ti/ipc/Std.h>
@@ -66,12 +67,31 @@
  *  ============================================================================
  */
 
+/* Check that names come in order and with the values they were added with */
+static Bool enumFxn(Ptr arg, String name, UInt32 value)
+{
+    Int *count = (Int *)arg;
+    char key[24];
+
+    sprintf(key, "foobar%d", *count);
+    if (strcmp(name, key) != 0 || value != 0x0badc0de + *count) {
+        printf("NameServer_enumerate() gave %s, 0x%x, expected %s, 0x%x\n",
+               name, value, key, 0x0badc0de + *count);
+        *count = -100;
+        return FALSE;
+    }
+    (*count)++;
+
+    return TRUE;
+}
+
 Int testNS(NameServer_Handle nsHandle, String name)
 {
     Int32 status = 0;
     Ptr ptr;
     UInt32 val;
     char key[16];
+    Int count;
     Int i;
 
     ptr = NameServer_addUInt32(nsHandle, name, 0xdeadbeef);
@@ -167,6 +187,24 @@ Int testNS(NameServer_Handle nsHandle, String name)
         }
     }
 
+    count = 0;
+    status = NameServer_enumerate(nsHandle, "foo", enumFxn, &count);
+    printf("NameServer_enumerate(foo) returned %d, %d in order\n", status,
+           count);
+    if (status != 10 || count != 10) {
+        printf("Error: NameServer_enumerate() failed\n");
+        return -1;
+    }
+
+    val = 0x00c0ffee;
+    status = NameServer_match(nsHandle, "foobar3andmore", &val);
+    printf("NameServer_match(foobar3andmore) returned %d, val=0x%x\n",
+           status, val);
+    if (status != 7 || val != 0x0badc0de + 3) {
+        printf("Error: NameServer_match() failed\n");
+        return -1;
+    }
+
     for (i = 0; i < 10; i++) {
         sprintf(key, "foobar%d", i);
 
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   NameServerBench.c
+ *
+ *  @brief  Benchmark of NameServer lookups in LAD's local table
+ *
+ *  Fills one NameServer instance in steps of 10 up to maxNames entries,
+ *  and at each size times looking up names that are there and names that
+ *  aren't.  The lookups only ask the local processor, so a miss doesn't
+ *  go out to the remote cores.  A hit is answered from LAD's shared
+ *  mirror of the table until the mirror fills, and by a round trip to LAD
+ *  after that; a miss always costs the round trip.  Either should stay
+ *  flat as the table grows.  Last, every name is removed.  Needs LAD, but
+ *  no remote cores.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/MultiProc.h>
+#include <ti/ipc/NameServer.h>
+#include <_MultiProc.h>
+
+#define NSNAME              "BenchNS"
+#define MIN_NAMES           10      /* Table size of the first step */
+
+#define NUM_LOOPS_DFLT      10000   /* Lookups of each kind per step */
+#define MAX_NAMES_DFLT      100000  /* Table size of the last step */
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+/* Look up numLoops names, present ones or missing ones; return nsecs each */
+static long lookups(NameServer_Handle handle, UInt16 procId[],
+                    UInt32 numNames, UInt32 numLoops, Bool present,
+                    int * errors)
+{
+    struct timespec start, end;
+    char            name[32];
+    UInt32          val;
+    UInt32          n;
+    UInt32          i;
+    Int             status;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < numLoops; i++) {
+        n = (UInt32)rand() % numNames;
+        snprintf(name, sizeof(name), "%s%d", present ? "name" : "missing",
+                 (int)n);
+
+        status = NameServer_getUInt32(handle, name, &val, procId);
+
+        if (present) {
+            *errors += (status < 0 || val != n);
+        }
+        else {
+            *errors += (status >= 0);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (diff(start, end) / numLoops);
+}
+
+int main (int argc, char * argv[])
+{
+    NameServer_Params params;
+    NameServer_Handle handle;
+    struct timespec start, end;
+    UInt16  procId[MultiProc_MAXPROCESSORS];
+    UInt32  numLoops = NUM_LOOPS_DFLT;
+    UInt32  maxNames = MAX_NAMES_DFLT;
+    UInt32  numNames = 0;
+    UInt32  size;
+    UInt32  i;
+    long    addTime = 0;
+    long    hit;
+    long    miss;
+    char    name[32];
+    int     errors = 0;
+    int     failed = 0;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numLoops = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        maxNames = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3 || numLoops == 0 || maxNames < MIN_NAMES) {
+        printf("Usage: %s [<numLoops>] [<maxNames>]\n", argv[0]);
+        printf("\tDefaults: numLoops: %d; maxNames: %d\n",
+                   NUM_LOOPS_DFLT, MAX_NAMES_DFLT);
+        exit(0);
+    }
+
+    printf("Using numLoops: %d; maxNames: %d\n", numLoops, maxNames);
+
+    if (Ipc_start() < 0) {
+        printf("Ipc_start failed\n");
+        return (1);
+    }
+
+    NameServer_Params_init(&params);
+    params.maxValueLen = sizeof(UInt32);
+    handle = NameServer_create(NSNAME, &params);
+    if (handle == NULL) {
+        printf("Error in NameServer_create\n");
+        Ipc_stop();
+        return (1);
+    }
+
+    /* Only ask the local table */
+    procId[0] = MultiProc_self();
+    for (i = 1; i < MultiProc_MAXPROCESSORS; i++) {
+        procId[i] = MultiProc_INVALIDID;
+    }
+
+    for (size = MIN_NAMES; !failed && size <= maxNames; size *= 10) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (; numNames < size; numNames++) {
+            snprintf(name, sizeof(name), "name%d", (int)numNames);
+            if (NameServer_addUInt32(handle, name, numNames) == NULL) {
+                printf("Error in NameServer_addUInt32\n");
+                failed = 1;
+                break;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        addTime += diff(start, end);
+
+        if (failed) {
+            break;
+        }
+
+        hit = lookups(handle, procId, numNames, numLoops, TRUE, &errors);
+        miss = lookups(handle, procId, numNames, numLoops, FALSE, &errors);
+
+        printf("%6d names: add %ld, hit %ld, miss %ld nsecs\n", numNames,
+               addTime / numNames, hit, miss);
+    }
+
+    if (errors) {
+        printf("%d lookups got the wrong answer\n", errors);
+        failed = 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < numNames; i++) {
+        snprintf(name, sizeof(name), "name%d", (int)i);
+        if (NameServer_remove(handle, name) < 0) {
+            printf("Error in NameServer_remove\n");
+            failed = 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (numNames > 0) {
+        printf("remove %d names: %ld nsecs each\n", numNames,
+               diff(start, end) / numNames);
+    }
+
+    NameServer_delete(&handle);
+    Ipc_stop();
+
+    return (failed);
+}
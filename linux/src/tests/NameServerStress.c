@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2014, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* =============================================================================
+ *  @file   NameServerStress.c
+ *
+ *  @brief  Stress test of LAD serving NameServer lookups to many clients
+ *
+ *  Several client processes look up names through LAD at once.  Most
+ *  lookups hit LAD's local table; every REMOTE_EVERY'th asks for a name
+ *  that isn't there, so LAD has to ask each remote processor, which can
+ *  take up to NAMESERVER_GET_TIMEOUT apiece.  The latency of each kind of
+ *  lookup is reported at the median and in the tail, to show whether the
+ *  local lookups wait behind the remote ones.  Needs LAD; without remote
+ *  cores, the remote lookups fail fast.
+ *
+ *  ============================================================================
+ */
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* IPC Headers */
+#include <ti/ipc/Std.h>
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/NameServer.h>
+
+#define NSNAME              "StressNS"
+#define NUMNAMES            64      /* Names registered in NSNAME */
+#define REMOTE_EVERY        4       /* One lookup in this many misses */
+
+#define NUM_LOOPS_DFLT      1000    /* Lookups per client */
+#define NUM_CLIENTS_DFLT    8       /* Client processes */
+
+static long diff(struct timespec start, struct timespec end)
+{
+    struct timespec temp;
+
+    if ((end.tv_nsec - start.tv_nsec) < 0) {
+        temp.tv_sec = end.tv_sec - start.tv_sec-1;
+        temp.tv_nsec = 1000000000UL + end.tv_nsec - start.tv_nsec;
+    } else {
+        temp.tv_sec = end.tv_sec - start.tv_sec;
+        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+    }
+
+    return (temp.tv_sec * 1000000000UL + temp.tv_nsec);
+}
+
+static int compareLong(const void * a, const void * b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+
+    return ((x > y) - (x < y));
+}
+
+/* Client: wait for the names to be registered, then look them up */
+static int runClient(int go, UInt32 numLoops, long * lat)
+{
+    NameServer_Params params;
+    NameServer_Handle handle;
+    struct timespec   start, end;
+    char              name[32];
+    char              c;
+    UInt32            val;
+    UInt32            i;
+    Int               status;
+    int               errors = 0;
+
+    if (read(go, &c, 1) != 1) {
+        return (1);
+    }
+
+    if (Ipc_start() < 0) {
+        printf("client: Ipc_start failed\n");
+        return (1);
+    }
+
+    /* Same params as the parent's, so this opens its instance */
+    NameServer_Params_init(&params);
+    params.maxValueLen = sizeof(UInt32);
+    handle = NameServer_create(NSNAME, &params);
+    if (handle == NULL) {
+        printf("client: Error in NameServer_create\n");
+        Ipc_stop();
+        return (1);
+    }
+
+    for (i = 0; i < numLoops; i++) {
+        if (i % REMOTE_EVERY == REMOTE_EVERY - 1) {
+            snprintf(name, sizeof(name), "missing%d", (int)(i % NUMNAMES));
+        }
+        else {
+            snprintf(name, sizeof(name), "name%d", (int)(i % NUMNAMES));
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        status = NameServer_getUInt32(handle, name, &val, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        lat[i] = diff(start, end);
+
+        if (i % REMOTE_EVERY == REMOTE_EVERY - 1) {
+            errors += (status >= 0);
+        }
+        else {
+            errors += (status < 0 || val != i % NUMNAMES);
+        }
+    }
+
+    if (errors) {
+        printf("client: %d lookups got the wrong answer\n", errors);
+    }
+
+    NameServer_delete(&handle);
+    Ipc_stop();
+
+    return (errors ? 1 : 0);
+}
+
+/* Sort a kind of lookup's latencies and print its percentiles */
+static void report(const char * kind, long * lat, UInt32 num)
+{
+    if (num == 0) {
+        return;
+    }
+
+    qsort(lat, num, sizeof(long), compareLong);
+
+    printf("%s lookups (%d): p50 %ld p99 %ld p99.9 %ld max %ld nsecs\n",
+           kind, num, lat[num / 2], lat[(num * 99) / 100],
+           lat[(num * 999) / 1000], lat[num - 1]);
+}
+
+int main (int argc, char * argv[])
+{
+    NameServer_Params params;
+    NameServer_Handle handle = NULL;
+    UInt32  numLoops = NUM_LOOPS_DFLT;
+    UInt32  numClients = NUM_CLIENTS_DFLT;
+    UInt32  numLocal = 0;
+    UInt32  numRemote = 0;
+    UInt32  i;
+    long *  lat;
+    long *  local;
+    long *  remote;
+    char    name[32];
+    int     go[2];
+    int     status;
+    int     failed = 0;
+    Bool    started;
+    pid_t   pid;
+
+    /* Parse args: */
+    if (argc > 1) {
+        numClients = strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        numLoops = strtoul(argv[2], NULL, 0);
+    }
+
+    if (argc > 3 || numLoops == 0 || numClients == 0) {
+        printf("Usage: %s [<numClients>] [<numLoops>]\n", argv[0]);
+        printf("\tDefaults: numClients: %d; numLoops: %d\n",
+                   NUM_CLIENTS_DFLT, NUM_LOOPS_DFLT);
+        exit(0);
+    }
+
+    printf("Using numClients: %d; numLoops: %d\n", numClients, numLoops);
+
+    /* Every client's latencies, written by the clients */
+    lat = mmap(NULL, numClients * numLoops * sizeof(long),
+               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (lat == MAP_FAILED || pipe(go) < 0) {
+        printf("Error allocating test state\n");
+        return (1);
+    }
+
+    /* Each process starts Ipc for itself, after the fork */
+    for (i = 0; i < numClients; i++) {
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            close(go[1]);
+            exit(runClient(go[0], numLoops, &lat[i * numLoops]));
+        }
+        if (pid < 0) {
+            printf("Error in fork\n");
+            numClients = i;
+            break;
+        }
+    }
+    close(go[0]);
+
+    started = (Ipc_start() >= 0);
+    if (!started) {
+        printf("Ipc_start failed\n");
+        failed = 1;
+    }
+    else {
+        NameServer_Params_init(&params);
+        params.maxValueLen = sizeof(UInt32);
+        handle = NameServer_create(NSNAME, &params);
+        if (handle == NULL) {
+            printf("Error in NameServer_create\n");
+            failed = 1;
+        }
+        for (i = 0; handle != NULL && i < NUMNAMES; i++) {
+            snprintf(name, sizeof(name), "name%d", (int)i);
+            if (NameServer_addUInt32(handle, name, i) == NULL) {
+                printf("Error in NameServer_addUInt32\n");
+                failed = 1;
+                break;
+            }
+        }
+    }
+
+    /* Start the clients, or let them see EOF and give up */
+    for (i = 0; !failed && i < numClients; i++) {
+        if (write(go[1], "g", 1) != 1) {
+            break;
+        }
+    }
+    close(go[1]);
+
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = 1;
+        }
+    }
+
+    if (!failed) {
+        /* Split the latencies by kind of lookup */
+        local = malloc(numClients * numLoops * sizeof(long));
+        remote = malloc(numClients * numLoops * sizeof(long));
+        for (i = 0; i < numClients * numLoops; i++) {
+            if ((i % numLoops) % REMOTE_EVERY == REMOTE_EVERY - 1) {
+                remote[numRemote++] = lat[i];
+            }
+            else {
+                local[numLocal++] = lat[i];
+            }
+        }
+
+        report("Local", local, numLocal);
+        report("Remote", remote, numRemote);
+
+        free(local);
+        free(remote);
+    }
+
+    if (handle != NULL) {
+        for (i = 0; i < NUMNAMES; i++) {
+            snprintf(name, sizeof(name), "name%d", (int)i);
+            NameServer_remove(handle, name);
+        }
+        NameServer_delete(&handle);
+    }
+    if (started) {
+        Ipc_stop();
+    }
+    munmap(lat, numClients * numLoops * sizeof(long));
+
+    return (failed);
+}
@@ -38,10 +38,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <sys/stat.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
-#include <time.h>
 #include <pthread.h>
 
 #include <ladclient.h>
@@ -49,20 +50,75 @@
 
 static Bool verbose = FALSE;
 
+/* wait between attempts to connect while LAD is starting up (usec) */
+#define LAD_CONNECTRETRYWAIT    1000
+
+/* buckets in each of the client info hashes */
+#define LAD_CLIENTHASHSIZE      64
+
+/*
+ * commands a batch has in flight.  A sender that finds the socket full
+ * reads responses meanwhile (see startRequest()), so this only bounds the
+ * requests a batch keeps pending.
+ */
+#define LAD_BATCHWINDOW         32
+
+/* msecs a sender waits for room before checking again whether to read */
+#define LAD_SENDRETRYWAIT       10
+
+/* A command waiting for its response */
+typedef struct _LAD_Request {
+    struct _LAD_Request * next;                   /* next pending request */
+    UInt32 requestId;                             /* matches the response */
+    Bool done;                                    /* rsp and status are set */
+    Bool waiting;                                 /* a thread is on cond */
+    pthread_cond_t cond;                          /* signalled when done */
+    LAD_Status status;
+    union LAD_ResponseObj rsp;
+} _LAD_Request;
+
+/*
+ * A connection to LAD, kept in two hashes: by PID, to find the caller's
+ * handle, and by handle, to find its socket.  An entry is only present
+ * while connected.
+ *
+ * Any number of threads may have commands in flight on the connection.
+ * One of the threads waiting reads the socket, and hands each response to
+ * the request with its requestId, waking only that request's thread.
+ * When its own request is done, it wakes another to take over.
+ */
 typedef struct _LAD_ClientInfo {
-    Bool connectedToLAD;               /* connection status */
+    struct _LAD_ClientInfo * pidNext;             /* next in PID bucket */
+    struct _LAD_ClientInfo * handleNext;          /* next in handle bucket */
+    LAD_ClientHandle handle;                      /* clientId LAD assigned */
     UInt PID;                                     /* client's process ID */
-    Char responseFIFOName[LAD_MAXLENGTHFIFONAME]; /* response FIFO name */
-    FILE *responseFIFOFilePtr;                    /* FIFO file pointer */
+    int sock;                                     /* connection to LAD */
+    pthread_mutex_t gate;                         /* guards the fields below */
+    _LAD_Request * pending;                       /* unanswered requests */
+    UInt32 nextRequestId;
+    Bool reading;                                 /* a thread is in recv() */
+    Bool failed;                                  /* the connection is lost */
 } _LAD_ClientInfo;
 
-static Bool initialized = FALSE;
-static String commandFIFOFileName = LAD_COMMANDFIFO;
-static FILE *commandFIFOFilePtr = NULL;
-static _LAD_ClientInfo clientInfo[LAD_MAXNUMCLIENTS];
-
-static LAD_Status initWrappers(Void);
-static Bool openCommandFIFO(Void);
+static _LAD_ClientInfo * pidHash[LAD_CLIENTHASHSIZE];
+static _LAD_ClientInfo * handleHash[LAD_CLIENTHASHSIZE];
+
+/* each thread's request for LAD_putCommand() and LAD_getResponse() */
+static pthread_key_t requestKey;
+static pthread_once_t requestOnce = PTHREAD_ONCE_INIT;
+
+static _LAD_ClientInfo * findInfo(LAD_ClientHandle handle);
+static Void removeInfo(_LAD_ClientInfo * info);
+static _LAD_Request * threadRequest(Void);
+static Void createRequestKey(Void);
+static Void freeRequest(Void * arg);
+static LAD_Status startRequest(_LAD_ClientInfo * info, _LAD_Request * req,
+    struct LAD_CommandObj *cmd);
+static Void awaitRequest(_LAD_ClientInfo * info, _LAD_Request * req);
+static Void readResponse(_LAD_ClientInfo * info);
+static Void wakeReader(_LAD_ClientInfo * info);
+static int openSocket(Void);
+static Bool waitSocket(int sock, double timeout);
 
 #if defined(IPC_BUILDOS_ANDROID)
 static pthread_mutex_t modGate  = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
@@ -75,8 +131,8 @@ static pthread_mutex_t modGate  = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
 /*
  * LAD_findHandle() - finds the LAD_ClientHandle for the calling pid (process ID).
  *
- * Assumes that there is only one client per process, which has to be the
- * case since the pid is used to construct the responseFIFOFileName.
+ * Assumes that there is only one client per process, since LAD tells its
+ * clients apart by connection and the connection is made per pid.
  *
  * Multiple threads within a process can all connect since each thread gets
  * its own pid (which might be an OS-specific thing, some OSes (even some
@@ -88,115 +144,126 @@ static pthread_mutex_t modGate  = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
  */
 LAD_ClientHandle LAD_findHandle(Void)
 {
-    Int i;
-    Int pid;
+    LAD_ClientHandle handle = LAD_MAXNUMCLIENTS;
+    _LAD_ClientInfo * info;
+    UInt pid;
 
     pid = getpid();
 
-    for (i = 0; i < LAD_MAXNUMCLIENTS; i++) {
-        if (clientInfo[i].PID == pid &&
-            clientInfo[i].connectedToLAD == TRUE) {
+    pthread_mutex_lock(&modGate);
+
+    for (info = pidHash[pid % LAD_CLIENTHASHSIZE]; info != NULL;
+         info = info->pidNext) {
+        if (info->PID == pid) {
+            handle = info->handle;
             break;
         }
     }
 
-    return i;
+    pthread_mutex_unlock(&modGate);
+
+    return handle;
 }
 
 /*
  *  ======== LAD_connect ========
+ *
+ *  Each client has its own socket connection to LAD, so the response to
+ *  the connect request comes straight back on it; there is no response
+ *  FIFO to wait for.
  */
 LAD_Status LAD_connect(LAD_ClientHandle * handle)
 {
-    Char responseFIFOName[LAD_MAXLENGTHFIFONAME];
     LAD_Status status = LAD_SUCCESS;
-    time_t currentTime;
-    time_t startTime;
-    struct stat statBuf;
-    double delta;
+    _LAD_ClientInfo * info;
+    _LAD_ClientInfo * stale;
     Int assignedId;
-    FILE * filePtr;
-    Int n;
+    ssize_t n;
     Int pid;
+    int sock;
     struct LAD_CommandObj cmd;
-    union LAD_ResponseObj rsp;
+    struct LAD_ResponseMsg msg;
 
     /* sanity check arg */
     if (handle == NULL) {
         return(LAD_INVALIDARG);
     }
 
-    /* check and initialize on first connect request */
-    if (initialized == FALSE) {
-
-        /* TODO:M does this need to be atomized? */
-        status = initWrappers();
-        if (status != LAD_SUCCESS) {
-            return(status);
-        }
-        initialized = TRUE;
-    }
-
     /* get caller's process ID */
     pid = getpid();
 
-    /* form name for dedicated response FIFO */
-    sprintf(responseFIFOName, "%s%d", LAD_RESPONSEFIFOPATH, pid);
-
-    PRINTVERBOSE2("\nLAD_connect: PID = %d, fifoName = %s\n", pid,
-        responseFIFOName)
+    PRINTVERBOSE1("\nLAD_connect: PID = %d\n", pid)
 
-    /* check if FIFO already exists; if yes, reject the request */
-    if (stat(responseFIFOName, &statBuf) == 0) {
+    /* check if already connected; if yes, reject the request */
+    if (LAD_findHandle() != LAD_MAXNUMCLIENTS) {
         PRINTVERBOSE0("\nLAD_connect: already connected; request denied!\n")
         return(LAD_ACCESSDENIED);
     }
 
+    sock = openSocket();
+    if (sock == -1) {
+        return(LAD_IOFAILURE);
+    }
+
+    memset(&cmd, 0, sizeof(cmd));
     cmd.cmd = LAD_CONNECT;
-    strcpy(cmd.args.connect.name, responseFIFOName);
     strcpy(cmd.args.connect.protocol, LAD_PROTOCOLVERSION);
     cmd.args.connect.pid = pid;
 
-    if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
-        return(status);
-    }
-
-    /* now open the dedicated response FIFO for this client */
-    startTime = time ((time_t *) 0);
-    while ((filePtr = fopen(responseFIFOName, "r")) == NULL) {
-        /* insert wait to yield, so LAD can process connect command sooner */
-        usleep(100);
-        currentTime = time ((time_t *) 0);
-        delta = difftime(currentTime, startTime);
-        if (delta > LAD_CONNECTTIMEOUT) {
-            pthread_mutex_unlock(&modGate);
-
-            return(LAD_IOFAILURE);
-        }
-    }
+    /*
+     * If LAD refused the connection, this send fails, but its reason is
+     * still waiting to be read.
+     */
+    send(sock, &cmd, LAD_COMMANDLENGTH, MSG_NOSIGNAL);
 
     /* now get LAD's response to the connection request */
-    n = fread(&rsp, LAD_RESPONSELENGTH, 1, filePtr);
-
-    /* need to unlock mutex obtained by LAD_putCommand() */
-    pthread_mutex_unlock(&modGate);
+    n = -1;
+    if (waitSocket(sock, LAD_CONNECTTIMEOUT)) {
+        n = recv(sock, &msg, LAD_RESPONSELENGTH, 0);
+    }
 
-    if (n) {
+    if (n == LAD_RESPONSELENGTH) {
         PRINTVERBOSE0("\nLAD_connect: got response\n")
 
         /* extract LAD's response code and the client ID */
-        status = rsp.connect.status;
+        status = msg.rsp.connect.status;
 
         /* if a successful connect ... */
+        if (status == LAD_SUCCESS && (info = malloc(sizeof(*info))) == NULL) {
+            PRINTVERBOSE0("\nLAD_connect: out of memory!\n")
+            status = LAD_FAILURE;
+        }
         if (status == LAD_SUCCESS) {
-            assignedId = rsp.connect.assignedId;
+            assignedId = msg.rsp.connect.assignedId;
             *handle = assignedId;
 
             /* setup client info */
-            clientInfo[assignedId].PID = pid;
-            clientInfo[assignedId].responseFIFOFilePtr = filePtr;
-            strcpy(clientInfo[assignedId].responseFIFOName, responseFIFOName);
-            clientInfo[assignedId].connectedToLAD = TRUE;
+            info->handle = assignedId;
+            info->PID = pid;
+            info->sock = sock;
+            pthread_mutex_init(&info->gate, NULL);
+            info->pending = NULL;
+            info->nextRequestId = 1;
+            info->reading = FALSE;
+            info->failed = FALSE;
+
+            pthread_mutex_lock(&modGate);
+
+            /*
+             * an entry with this handle was inherited across fork() from
+             * a parent that has since disconnected; it's no longer ours
+             */
+            if ((stale = findInfo(assignedId)) != NULL) {
+                removeInfo(stale);
+                free(stale);
+            }
+
+            info->pidNext = pidHash[pid % LAD_CLIENTHASHSIZE];
+            pidHash[pid % LAD_CLIENTHASHSIZE] = info;
+            info->handleNext = handleHash[assignedId % LAD_CLIENTHASHSIZE];
+            handleHash[assignedId % LAD_CLIENTHASHSIZE] = info;
+
+            pthread_mutex_unlock(&modGate);
 
             PRINTVERBOSE1("    status == LAD_SUCCESS, assignedId=%d\n",
                           assignedId);
@@ -207,14 +274,14 @@ LAD_Status LAD_connect(LAD_ClientHandle * handle)
     }
     else {
         PRINTVERBOSE0(
-          "\nLAD_connect: 0 bytes read when getting LAD response!\n")
+          "\nLAD_connect: no response from LAD!\n")
         status = LAD_IOFAILURE;
     }
 
-    /* if connect failed, close client side of FIFO (LAD closes its side) */
+    /* if connect failed, close client side of the socket */
     if (status != LAD_SUCCESS) {
-        PRINTVERBOSE0("\nLAD_connect failed: closing client-side of FIFO...\n")
-        fclose(filePtr);
+        PRINTVERBOSE0("\nLAD_connect failed: closing socket...\n")
+        close(sock);
     }
 
     return(status);
@@ -227,11 +294,8 @@ LAD_Status LAD_connect(LAD_ClientHandle * handle)
 LAD_Status LAD_disconnect(LAD_ClientHandle handle)
 {
     LAD_Status status = LAD_SUCCESS;
-    Bool waiting = TRUE;
-    struct stat statBuf;
-    time_t currentTime;
-    time_t startTime;
-    double delta;
+    _LAD_ClientInfo * info;
+    char c;
     struct LAD_CommandObj cmd;
 
     /* sanity check args */
@@ -239,152 +303,543 @@ LAD_Status LAD_disconnect(LAD_ClientHandle handle)
         return (LAD_INVALIDARG);
     }
 
-    /* check for initialization and connection */
-    if ((initialized == FALSE) ||
-        (clientInfo[handle].connectedToLAD == FALSE)) {
-        return (LAD_NOTCONNECTED);
-    }
-
     cmd.cmd = LAD_DISCONNECT;
     cmd.clientId = handle;
 
+    /* fails with LAD_NOTCONNECTED if there's no connection */
     if ((status = LAD_putCommand(&cmd)) != LAD_SUCCESS) {
         return(status);
     }
 
-    /* on success, close the dedicated response FIFO */
-    fclose(clientInfo[handle].responseFIFOFilePtr);
-
-    /* need to unlock mutex obtained by LAD_putCommand() */
-    pthread_mutex_unlock(&modGate);
-
-    /* now wait for LAD to close the connection ... */
-    startTime = time ((time_t *) 0);
-    while (waiting == TRUE) {
+    pthread_mutex_lock(&modGate);
 
-        /* do a minimal wait, to yield, so LAD can disconnect */
-        usleep(1);
-        currentTime = time ((time_t *) 0);
+    /* another thread may have disconnected handle since the put */
+    if ((info = findInfo(handle)) == NULL) {
+        pthread_mutex_unlock(&modGate);
+        return(LAD_INVALIDARG);
+    }
 
-        /* check to see if LAD has shutdown FIFO yet... */
-        if (stat(clientInfo[handle].responseFIFOName, &statBuf) != 0) {
-            waiting = FALSE;            /* yes, so done */
-        }
-        /* if not, check for timeout */
-        else {
-            delta = difftime(currentTime, startTime);
-            if (delta > LAD_DISCONNECTTIMEOUT) {
-                PRINTVERBOSE0("\nLAD_disconnect: timeout waiting for LAD!\n")
-                return(LAD_IOFAILURE);
-            }
-        }
+    /*
+     * LAD answers by closing the connection, so wait for that ... this
+     * assumes the caller has no other command in flight
+     */
+    if (!waitSocket(info->sock, LAD_DISCONNECTTIMEOUT) ||
+        recv(info->sock, &c, sizeof(c), 0) != 0) {
+        PRINTVERBOSE0("\nLAD_disconnect: timeout waiting for LAD!\n")
+        status = LAD_IOFAILURE;
     }
 
-    /* reset connection status flag */
-    clientInfo[handle].connectedToLAD = FALSE;
+    /* forget the connection, and close our side */
+    removeInfo(info);
+    close(info->sock);
+    pthread_mutex_destroy(&info->gate);
+    free(info);
+
+    pthread_mutex_unlock(&modGate);
 
     return(status);
 }
 
 /*
  *  ======== LAD_getResponse ========
+ *
+ *  Wait for the response to the command this thread last put with
+ *  LAD_putCommand().
  */
 LAD_Status LAD_getResponse(LAD_ClientHandle handle, union LAD_ResponseObj *rsp)
 {
-    LAD_Status status = LAD_SUCCESS;
-    Int n;
+    _LAD_ClientInfo * info;
+    _LAD_Request * req;
 
     PRINTVERBOSE1("LAD_getResponse: client = %d\n", handle)
 
-    n = fread(rsp, LAD_RESPONSELENGTH, 1,
-             clientInfo[handle].responseFIFOFilePtr);
-
+    pthread_mutex_lock(&modGate);
+    info = findInfo(handle);
     pthread_mutex_unlock(&modGate);
 
-    if (n == 0) {
-        PRINTVERBOSE0("LAD_getResponse: n = 0!\n")
-        status = LAD_IOFAILURE;
+    req = threadRequest();
+    if (info == NULL || req == NULL) {
+        return(LAD_NOTCONNECTED);
+    }
+
+    awaitRequest(info, req);
+
+    if (req->status != LAD_SUCCESS) {
+        PRINTVERBOSE1("LAD_getResponse: failed, status = %d!\n", req->status)
     }
     else {
         PRINTVERBOSE0("LAD_getResponse: got response\n")
+        memcpy(rsp, &req->rsp, sizeof(*rsp));
     }
 
-    return(status);
+    return(req->status);
 }
 
 /*
  *  ======== LAD_putCommand ========
+ *
+ *  Send cmd, to be answered by LAD_getResponse() in the same thread.
+ *  Other threads are free to put and get their own commands meanwhile.
  */
 LAD_Status LAD_putCommand(struct LAD_CommandObj *cmd)
 {
-    LAD_Status status = LAD_SUCCESS;
-    Int stat;
-    Int n;
+    LAD_Status status;
+    _LAD_ClientInfo * info;
+    _LAD_Request * req;
 
     PRINTVERBOSE1("\nLAD_putCommand: cmd = %d\n", cmd->cmd);
 
     pthread_mutex_lock(&modGate);
+    info = findInfo(cmd->clientId);
+    pthread_mutex_unlock(&modGate);
 
-    n = fwrite(cmd, LAD_COMMANDLENGTH, 1, commandFIFOFilePtr);
-
-    if (n == 0) {
-        PRINTVERBOSE0("\nLAD_putCommand: fwrite returned 0!\n")
-        status = LAD_IOFAILURE;
+    req = threadRequest();
+    if (info == NULL || req == NULL) {
+        PRINTVERBOSE0("\nLAD_putCommand: not connected!\n")
+        status = LAD_NOTCONNECTED;
     }
     else {
-        stat = fflush(commandFIFOFilePtr);
+        status = startRequest(info, req, cmd);
+    }
+
+    PRINTVERBOSE1("LAD_putCommand: status = %d\n", status)
+
+    return(status);
+}
+
+/*
+ *  ======== LAD_putCommandBatch ========
+ *
+ *  Send numCmds commands, all on the connection of cmds[0].clientId, and
+ *  wait for them to be answered, each into the same index of rsps.  Up to
+ *  LAD_BATCHWINDOW of them are in flight at once, so LAD works through
+ *  the batch without waiting out a round trip for each command.
+ */
+LAD_Status LAD_putCommandBatch(struct LAD_CommandObj *cmds,
+    union LAD_ResponseObj *rsps, UInt numCmds)
+{
+    LAD_Status status = LAD_SUCCESS;
+    _LAD_ClientInfo * info;
+    _LAD_Request reqs[LAD_BATCHWINDOW];
+    UInt sent;
+    UInt done;
+    UInt i;
+
+    if (numCmds == 0) {
+        return(LAD_SUCCESS);
+    }
+    if (cmds == NULL || rsps == NULL) {
+        return(LAD_INVALIDARG);
+    }
+
+    pthread_mutex_lock(&modGate);
+    info = findInfo(cmds[0].clientId);
+    pthread_mutex_unlock(&modGate);
+
+    if (info == NULL) {
+        return(LAD_NOTCONNECTED);
+    }
+
+    for (i = 0; i < LAD_BATCHWINDOW; i++) {
+        pthread_cond_init(&reqs[i].cond, NULL);
+        reqs[i].waiting = FALSE;
+    }
 
-        if (stat == (Int) EOF) {
-            PRINTVERBOSE0("\nLAD_putCommand: stat for fflush = EOF!\n")
-            status = LAD_IOFAILURE;
+    /*
+     * command i uses reqs[i % LAD_BATCHWINDOW], once the command that
+     * used it before is answered
+     */
+    for (sent = 0, done = 0; done < sent || sent < numCmds; ) {
+        if (sent < numCmds && status == LAD_SUCCESS &&
+            sent - done < LAD_BATCHWINDOW) {
+            cmds[sent].clientId = info->handle;
+            status = startRequest(info, &reqs[sent % LAD_BATCHWINDOW],
+                &cmds[sent]);
+            if (status == LAD_SUCCESS) {
+                sent++;
+            }
+            continue;
+        }
+
+        /* no more to send, or no room to: collect the oldest */
+        if (done == sent) {
+            break;
+        }
+        awaitRequest(info, &reqs[done % LAD_BATCHWINDOW]);
+        if (reqs[done % LAD_BATCHWINDOW].status == LAD_SUCCESS) {
+            memcpy(&rsps[done], &reqs[done % LAD_BATCHWINDOW].rsp,
+                sizeof(rsps[done]));
+        }
+        else {
+            status = reqs[done % LAD_BATCHWINDOW].status;
         }
+        done++;
     }
 
-    if (status != LAD_SUCCESS) {
-        pthread_mutex_unlock(&modGate);
+    for (i = 0; i < LAD_BATCHWINDOW; i++) {
+        pthread_cond_destroy(&reqs[i].cond);
     }
 
-    PRINTVERBOSE1("LAD_putCommand: status = %d\n", status)
+    PRINTVERBOSE2("LAD_putCommandBatch: %d of %d answered\n", done, numCmds)
 
     return(status);
 }
 
 
 /*
- *  ======== initWrappers ========
+ *  ======== findInfo ========
+ *
+ *  Return the info of connection handle, or NULL.  Call with modGate held.
  */
-static LAD_Status initWrappers(Void)
+static _LAD_ClientInfo * findInfo(LAD_ClientHandle handle)
 {
-    Int i;
+    _LAD_ClientInfo * info;
 
-    /* initialize the client info structures */
-    for (i = 0; i < LAD_MAXNUMCLIENTS; i++) {
-        clientInfo[i].connectedToLAD = FALSE;
-        clientInfo[i].responseFIFOFilePtr = NULL;
+    if ((UInt)handle >= LAD_MAXNUMCLIENTS) {
+        return(NULL);
+    }
+
+    for (info = handleHash[handle % LAD_CLIENTHASHSIZE]; info != NULL;
+         info = info->handleNext) {
+        if (info->handle == handle) {
+            break;
+        }
     }
 
-    /* now open LAD's command FIFO */
-    if (openCommandFIFO() == FALSE) {
+    return(info);
+}
+
+
+/*
+ *  ======== removeInfo ========
+ *
+ *  Take info out of both hashes.  Call with modGate held.
+ */
+static Void removeInfo(_LAD_ClientInfo * info)
+{
+    _LAD_ClientInfo ** link;
+
+    for (link = &pidHash[info->PID % LAD_CLIENTHASHSIZE]; *link != NULL;
+         link = &(*link)->pidNext) {
+        if (*link == info) {
+            *link = info->pidNext;
+            break;
+        }
+    }
+
+    for (link = &handleHash[info->handle % LAD_CLIENTHASHSIZE]; *link != NULL;
+         link = &(*link)->handleNext) {
+        if (*link == info) {
+            *link = info->handleNext;
+            break;
+        }
+    }
+}
+
+
+/*
+ *  ======== threadRequest ========
+ *
+ *  Return the calling thread's request, creating it on first use.
+ */
+static _LAD_Request * threadRequest(Void)
+{
+    _LAD_Request * req;
+
+    pthread_once(&requestOnce, createRequestKey);
+
+    req = pthread_getspecific(requestKey);
+    if (req == NULL) {
+        req = calloc(1, sizeof(_LAD_Request));
+        if (req == NULL) {
+            return(NULL);
+        }
+        pthread_cond_init(&req->cond, NULL);
+        if (pthread_setspecific(requestKey, req) != 0) {
+            pthread_cond_destroy(&req->cond);
+            free(req);
+            req = NULL;
+        }
+    }
+
+    return(req);
+}
+
+/*
+ *  ======== createRequestKey ========
+ */
+static Void createRequestKey(Void)
+{
+    pthread_key_create(&requestKey, freeRequest);
+}
+
+/*
+ *  ======== freeRequest ========
+ */
+static Void freeRequest(Void * arg)
+{
+    _LAD_Request * req = (_LAD_Request *)arg;
+
+    pthread_cond_destroy(&req->cond);
+    free(req);
+}
+
+/*
+ *  ======== startRequest ========
+ *
+ *  Give cmd a requestId, make req pending on it, and send it.
+ *
+ *  LAD stops reading a connection while it holds responses that haven't
+ *  been read, so a sender that blocked in send() while no thread reads
+ *  would never get room.  Instead, when the socket is full the sender
+ *  becomes the reader if there is none, and reads responses until there
+ *  is room; otherwise it waits for room a little at a time, in case the
+ *  reader finishes first.
+ */
+static LAD_Status startRequest(_LAD_ClientInfo * info, _LAD_Request * req,
+    struct LAD_CommandObj *cmd)
+{
+    _LAD_Request ** link;
+    struct pollfd pfd;
+    ssize_t n;
+    int ret;
+
+    pthread_mutex_lock(&info->gate);
+
+    if (info->failed) {
+        pthread_mutex_unlock(&info->gate);
         return(LAD_IOFAILURE);
     }
+
+    cmd->requestId = info->nextRequestId++;
+    req->requestId = cmd->requestId;
+    req->done = FALSE;
+    req->waiting = FALSE;
+    req->next = info->pending;
+    info->pending = req;
+
+    pthread_mutex_unlock(&info->gate);
+
+    pfd.fd = info->sock;
+
+    for (;;) {
+        /* a command is a single record, so threads can't interleave theirs */
+        n = send(info->sock, cmd, LAD_COMMANDLENGTH,
+                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n == LAD_COMMANDLENGTH) {
+            return(LAD_SUCCESS);
+        }
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n != -1 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            break;
+        }
+
+        pthread_mutex_lock(&info->gate);
+
+        /* a failed read has already failed req */
+        if (info->failed) {
+            pthread_mutex_unlock(&info->gate);
+            break;
+        }
+
+        if (info->reading) {
+            pthread_mutex_unlock(&info->gate);
+
+            pfd.events = POLLOUT;
+            poll(&pfd, 1, LAD_SENDRETRYWAIT);
+            continue;
+        }
+
+        /* no one is reading, so read here until there's room */
+        info->reading = TRUE;
+        pthread_mutex_unlock(&info->gate);
+
+        pfd.events = POLLIN | POLLOUT;
+        do {
+            ret = poll(&pfd, 1, -1);
+        } while (ret == -1 && errno == EINTR);
+
+        pthread_mutex_lock(&info->gate);
+        info->reading = FALSE;
+        if (ret > 0 && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            readResponse(info);
+        }
+        wakeReader(info);
+        pthread_mutex_unlock(&info->gate);
+    }
+
+    PRINTVERBOSE1("\nLAD_putCommand: send failed, errno = %d\n", errno)
+
+    /* not sent, so no longer pending, unless a failed read took it */
+    pthread_mutex_lock(&info->gate);
+    for (link = &info->pending; *link != NULL; link = &(*link)->next) {
+        if (*link == req) {
+            *link = req->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&info->gate);
+
+    return(LAD_IOFAILURE);
+}
+
+/*
+ *  ======== awaitRequest ========
+ */
+static Void awaitRequest(_LAD_ClientInfo * info, _LAD_Request * req)
+{
+    pthread_mutex_lock(&info->gate);
+
+    while (!req->done) {
+        if (info->reading) {
+            req->waiting = TRUE;
+            pthread_cond_wait(&req->cond, &info->gate);
+            req->waiting = FALSE;
+        }
+        else {
+            readResponse(info);
+        }
+    }
+
+    /* if this thread was reading, leave it to one still waiting */
+    wakeReader(info);
+
+    pthread_mutex_unlock(&info->gate);
+}
+
+/*
+ *  ======== readResponse ========
+ *
+ *  Called with info->gate held, no thread reading, and some request
+ *  pending.  Read one response, complete its request, and wake the
+ *  thread waiting on it.
+ */
+static Void readResponse(_LAD_ClientInfo * info)
+{
+    struct LAD_ResponseMsg msg;
+    _LAD_Request ** link;
+    _LAD_Request * req;
+    ssize_t n;
+
+    info->reading = TRUE;
+    pthread_mutex_unlock(&info->gate);
+
+    do {
+        n = recv(info->sock, &msg, LAD_RESPONSELENGTH, 0);
+    } while (n == -1 && errno == EINTR);
+
+    pthread_mutex_lock(&info->gate);
+    info->reading = FALSE;
+
+    if (n == LAD_RESPONSELENGTH) {
+        for (link = &info->pending; *link != NULL; link = &(*link)->next) {
+            if ((*link)->requestId == msg.requestId) {
+                req = *link;
+                *link = req->next;
+
+                memcpy(&req->rsp, &msg.rsp, sizeof(req->rsp));
+                req->status = LAD_SUCCESS;
+                req->done = TRUE;
+                if (req->waiting) {
+                    pthread_cond_signal(&req->cond);
+                }
+                break;
+            }
+        }
+    }
     else {
-        return(LAD_SUCCESS);
+        /* LAD is gone; fail everything that was waiting on it */
+        PRINTVERBOSE1("\nLAD client: recv failed, n = %d!\n", (Int)n)
+
+        info->failed = TRUE;
+        for (req = info->pending; req != NULL; req = req->next) {
+            req->status = LAD_IOFAILURE;
+            req->done = TRUE;
+            if (req->waiting) {
+                pthread_cond_signal(&req->cond);
+            }
+        }
+        info->pending = NULL;
+    }
+}
+
+/*
+ *  ======== wakeReader ========
+ *
+ *  If no thread is reading, wake one that is waiting, to read for the
+ *  rest.  Called with info->gate held.
+ */
+static Void wakeReader(_LAD_ClientInfo * info)
+{
+    _LAD_Request * req;
+
+    if (info->reading) {
+        return;
+    }
+
+    for (req = info->pending; req != NULL; req = req->next) {
+        if (req->waiting) {
+            pthread_cond_signal(&req->cond);
+            return;
+        }
     }
 }
 
 /*
- *  ======== openCommandFIFO ========
+ *  ======== openSocket ========
+ *
+ *  Connect to LAD's socket, retrying for up to LAD_CONNECTTIMEOUT while
+ *  LAD is still starting.
  */
-static Bool openCommandFIFO(Void)
+static int openSocket(Void)
 {
-    /* open a file for writing to FIFO */
-    commandFIFOFilePtr = fopen(commandFIFOFileName, "w");
+    struct sockaddr_un addr;
+    double waited = 0.0;
+    int sock;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        PRINTVERBOSE1("\nERROR: failed to create socket, errno = %x\n", errno)
+        return(-1);
+    }
 
-    if (commandFIFOFilePtr == NULL) {
-        PRINTVERBOSE2("\nERROR: failed to open %s, errno = %x\n",
-            commandFIFOFileName, errno)
-        return(FALSE);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, LAD_SOCKETPATH, sizeof(addr.sun_path) - 1);
+
+    while (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        if ((errno != ENOENT && errno != ECONNREFUSED && errno != EINTR) ||
+            waited > LAD_CONNECTTIMEOUT) {
+            PRINTVERBOSE2("\nERROR: failed to connect to %s, errno = %x\n",
+                LAD_SOCKETPATH, errno)
+            close(sock);
+            return(-1);
+        }
+        usleep(LAD_CONNECTRETRYWAIT);
+        waited += LAD_CONNECTRETRYWAIT / 1000000.0;
     }
 
-    return(TRUE);
+    return(sock);
+}
+
+/*
+ *  ======== waitSocket ========
+ *
+ *  Wait up to timeout seconds for the socket to become readable.
+ */
+static Bool waitSocket(int sock, double timeout)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    do {
+        ret = poll(&pfd, 1, (int)(timeout * 1000));
+    } while (ret == -1 && errno == EINTR);
+
+    return (ret > 0);
 }
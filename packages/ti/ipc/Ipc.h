@@ -130,6 +130,21 @@ extern "C" {
 #define Ipc_E_NOTREADY         (-11)
 
 
+/* =============================================================================
+ *  Structures & Enums
+ * =============================================================================
+ */
+
+/*!
+ *  @brief      Function called when a remote processor is attached late
+ *
+ *  @param      remoteProcId  remote processor's MultiProc id
+ *  @param      arg           argument given to Ipc_setAttachNotifyFxn()
+ *
+ *  @sa         Ipc_setAttachNotifyFxn()
+ */
+typedef Void (*Ipc_AttachNotifyFxn)(UInt16 remoteProcId, Ptr arg);
+
 /* =============================================================================
  *  Ipc Module-wide Functions
  * =============================================================================
@@ -246,7 +261,8 @@ Int Ipc_detach(UInt16 remoteProcId);
 /*!
  *  @brief      Query whether attached to a remote processor
  *
- *  @note       This function is currently only supported on SYS/BIOS.
+ *  @note       This function is currently only supported on SYS/BIOS and
+ *              Linux.
  *
  *  @param      remoteProcId  remote processor's MultiProc id
  *
@@ -280,6 +296,29 @@ Bool Ipc_isAttached(UInt16 remoteProcId);
  */
 Int Ipc_readConfig(UInt16 remoteProcId, UInt32 tag, Ptr cfg, SizeT size);
 
+/*!
+ *  @brief      Set the function called when a remote processor is attached
+ *              after Ipc_start()
+ *
+ *  @note       This function is currently only supported on Linux.
+ *
+ *  On Linux, Ipc_start() attaches to all the remote processors that are up
+ *  at once, and returns without waiting for the others.  Those are
+ *  attached in the background as soon as the kernel reports their rpmsg
+ *  devices, and fxn is then called, from an internal thread, with each
+ *  one's id.  MessageQs already created can be reached from a processor
+ *  once it is attached.
+ *
+ *  Only one function is kept; NULL removes it.  It may be set before or
+ *  after Ipc_start().
+ *
+ *  @param      fxn     function to call, or NULL
+ *  @param      arg     argument passed to fxn
+ *
+ *  @sa         Ipc_isAttached()
+ */
+Void Ipc_setAttachNotifyFxn(Ipc_AttachNotifyFxn fxn, Ptr arg);
+
 /*!
  *  @brief      Reserves memory, creates default GateMP and HeapMemMP
  *
@@ -596,6 +596,31 @@ Int MessageQ_delete(MessageQ_Handle *handlePtr);
  */
 Int MessageQ_open(String name, MessageQ_QueueId *queueId);
 
+/*!
+ *  @brief      Open a message queue, waiting for it to be created
+ *
+ *  Like MessageQ_open(), but if the queue doesn't exist yet, waits for it
+ *  to be created instead of returning #MessageQ_E_NOTFOUND.  This replaces
+ *  calling MessageQ_open() in a loop until it succeeds, as is typical
+ *  while a remote processor is still starting up.
+ *
+ *  On HLOS, queues created on remote processors that announce their names
+ *  are seen as soon as they are created.
+ *
+ *  @param[in]  name        Name of queue to open
+ *  @param[out] queueId     QueueId that can be used in MessageQ_put()
+ *  @param[in]  timeout     Maximum duration to wait for the queue in
+ *                          microseconds, or #MessageQ_FOREVER.
+ *
+ *  @return     MessageQ status:
+ *              - #MessageQ_S_SUCCESS: open successful
+ *              - #MessageQ_E_TIMEOUT: queue wasn't created within timeout
+ *              - #MessageQ_E_FAIL:    A general failure has occurred
+ *
+ *  @sa         MessageQ_open()
+ */
+Int MessageQ_openWait(String name, MessageQ_QueueId *queueId, UInt timeout);
+
 /*!
  *  @brief      Opens a MessageQ given the queue index and remote processor id
  *
@@ -718,10 +743,16 @@ Int MessageQ_registerHeap(Ptr heap, UInt16 heapId);
  *  allocated from this heap. If there are outstanding messages, an attempt
  *  to free the message will result in non-deterministic results.
  *
+ *  On Linux, a heap registered as a shared heap (see
+ *  MessageQ_PoolParams) is not unregistered while this process holds
+ *  messages from it, including ones received from other processes.
+ *
  *  @param[in]  heapId      Heap to unregister
  *
  *  @return     MessageQ status:
  *              - #MessageQ_S_SUCCESS: heap successfully unregistered
+ *              - #MessageQ_E_INVALIDSTATE: messages from the shared heap
+ *                are outstanding (Linux only)
  */
 Int MessageQ_unregisterHeap(UInt16 heapId);
 
@@ -849,6 +880,125 @@ Int MessageQ_get(MessageQ_Handle handle, MessageQ_Msg *msg, UInt timeout);
  */
 Int MessageQ_put(MessageQ_QueueId queueId, MessageQ_Msg msg);
 
+/*!
+ *  @brief      Place a message onto a message queue, waiting for credit
+ *
+ *  This call is MessageQ_put() with flow control.  On SYS/BIOS, when
+ *  ti.sdo.ipc.MessageQ.creditWindow is not zero, a message to a remote
+ *  queue takes one of the queue's credits.  Each remote queue starts with
+ *  creditWindow credits, and the receiving MessageQ returns them as the
+ *  messages are got.  If the queue has no credits left, MessageQ_putWait()
+ *  waits up to @c timeout for one to be returned, instead of filling the
+ *  transport and the message heap.
+ *
+ *  A local queue, or a creditWindow of zero, takes no credits.
+ *
+ *  On Linux and QNX no credits are taken.  What @c timeout bounds depends
+ *  on the transport to the queue:
+ *  - A queue of another process on the Linux host is fed through a shared
+ *    memory ring.  If the ring is full, MessageQ_putWait() waits up to
+ *    @c timeout for the receiver to make room, and then returns
+ *    #MessageQ_E_TIMEOUT.  MessageQ_put() waits at most one second.
+ *  - A queue of a remote processor is fed through rpmsg, whose driver
+ *    blocks the sender until a buffer is free.  @c timeout is ignored.
+ *  - A queue of the calling process never fills, and is put to at once.
+ *  - On QNX the call is exactly MessageQ_put(), and @c timeout is ignored.
+ *  #MessageQ_E_MEMORY is never returned on Linux or QNX.
+ *
+ *  @param[in]  queueId     Destination MessageQ
+ *  @param[in]  msg         Message to be sent.
+ *  @param[in]  timeout     Maximum duration to wait for a credit, or on
+ *                          Linux for room in the queue's ring, in
+ *                          microseconds.
+ *
+ *  @return     Status of the call.
+ *              - #MessageQ_S_SUCCESS denotes success.
+ *              - #MessageQ_E_TIMEOUT denotes no credit came back, or on
+ *                 Linux no room was made, in time.  The caller still owns
+ *                 the message.
+ *              - #MessageQ_E_MEMORY denotes the queue's credits could
+ *                 not be set up.  The caller still owns the message.
+ *                 SYS/BIOS only.
+ *              - #MessageQ_E_FAIL denotes failure, as for MessageQ_put().
+ *
+ *  @sa         MessageQ_put()
+ */
+Int MessageQ_putWait(MessageQ_QueueId queueId, MessageQ_Msg msg,
+        UInt timeout);
+
+/*!
+ *  @brief      Gets a message from a message queue without blocking
+ *
+ *  Returns a message only if one has already arrived, as
+ *  MessageQ_get() does with a timeout of zero.  This suits event loops
+ *  that wait for messages along with other events, and call
+ *  MessageQ_tryGet() until it returns #MessageQ_E_TIMEOUT once woken.
+ *
+ *  @param[in]  handle      MessageQ handle
+ *  @param[out] msg         Pointer to the message
+ *
+ *  @return     MessageQ status:
+ *              - #MessageQ_S_SUCCESS: Message successfully returned
+ *              - #MessageQ_E_TIMEOUT: No message is waiting
+ *              - #MessageQ_E_UNBLOCKED: MessageQ_get() was unblocked
+ *              - #MessageQ_E_FAIL:    A general failure has occurred
+ *
+ *  @sa         MessageQ_get()
+ */
+Int MessageQ_tryGet(MessageQ_Handle handle, MessageQ_Msg *msg);
+
+/*!
+ *  @brief      Gets a burst of messages from the message queue
+ *
+ *  This function blocks like MessageQ_get() until at least one message
+ *  is available, then returns up to @c maxMsgs messages that are ready
+ *  without blocking again.  The returned messages are owned by the
+ *  caller and are stored in msgs[0] .. msgs[n - 1].
+ *
+ *  Where the transport supports it, the burst is retrieved with a
+ *  single kernel call, so the wakeup and system call cost is shared by
+ *  all of the messages in the burst.
+ *
+ *  @param[in]  handle      MessageQ handle
+ *  @param[out] msgs        Array receiving the messages
+ *  @param[in]  maxMsgs     Number of entries in @c msgs
+ *  @param[in]  timeout     Maximum duration to wait for the first message
+ *
+ *  @return     Number of messages returned (greater than zero), or a
+ *              MessageQ status:
+ *              - #MessageQ_E_TIMEOUT: MessageQ_getMany() timed out
+ *              - #MessageQ_E_UNBLOCKED: MessageQ_getMany() was unblocked
+ *              - #MessageQ_E_FAIL:    A general failure has occurred
+ *
+ *  @sa         MessageQ_get()
+ *  @sa         MessageQ_putMany()
+ */
+Int MessageQ_getMany(MessageQ_Handle handle, MessageQ_Msg msgs[],
+        UInt maxMsgs, UInt timeout);
+
+/*!
+ *  @brief      Place a burst of messages onto a message queue
+ *
+ *  This call is equivalent to calling MessageQ_put() on each of the
+ *  messages in order, but lets the transport deliver the burst at once.
+ *
+ *  The application loses ownership of the first n messages, where n is
+ *  the return value.  If n is less than @c numMsgs, the caller still
+ *  owns msgs[n] .. msgs[numMsgs - 1].
+ *
+ *  @param[in]  queueId     Destination MessageQ
+ *  @param[in]  msgs        Messages to be sent
+ *  @param[in]  numMsgs     Number of entries in @c msgs
+ *
+ *  @return     Number of messages placed on the queue, or
+ *              #MessageQ_E_FAIL if none of the messages could be placed.
+ *
+ *  @sa         MessageQ_put()
+ *  @sa         MessageQ_getMany()
+ */
+Int MessageQ_putMany(MessageQ_QueueId queueId, MessageQ_Msg msgs[],
+        UInt numMsgs);
+
 /*!
  *  @brief      Returns the number of messages in a message queue
  *
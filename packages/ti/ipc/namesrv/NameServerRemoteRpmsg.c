@@ -55,6 +55,9 @@
 /* Storage for NameServer message replies. Protected by gateMutex: */
 static  NameServerRemote_Msg    NameServer_msg;
 
+static Void NameServerRemoteRpmsg_announce(String instanceName, String name,
+        Ptr value, UInt32 len);
+
 /*
  *************************************************************************
  *                       Instance functions
@@ -181,6 +184,7 @@ Int NameServerRemoteRpmsg_get(NameServerRemoteRpmsg_Object *obj,
     msg.request = NameServerRemoteRpmsg_REQUEST;
     msg.requestStatus = 0;
     msg.valueLen = *valueLen;
+    msg.requestId = 0;
 
     len = strlen(instanceName);
     Assert_isTrue(len < MAXNAMEINCHAR, NameServerRemoteRpmsg_A_nameIsTooLong);
@@ -323,5 +327,49 @@ void NameServerRemote_SetNameServerPort(UInt port)
 {
     Log_print1(Diags_INFO, FXNN": nsPort: %d", port);
     NameServerRemoteRpmsg_module->nsPort = port;
+
+    /* now that the host is listening, tell it as names come and go */
+    ti_sdo_utils_NameServer_setChangeHookFxn(NameServerRemoteRpmsg_announce);
+}
+#undef FXNN
+
+/*
+ *  ======== NameServerRemoteRpmsg_announce ========
+ *
+ *  NameServer's change hook.  Tells the host a name was added or removed,
+ *  so anything there waiting for the name needn't keep asking for it.
+ */
+#define FXNN "NameServerRemoteRpmsg_announce"
+static Void NameServerRemoteRpmsg_announce(String instanceName, String name,
+        Ptr value, UInt32 len)
+{
+    NameServerRemote_Msg msg;
+    UInt16 dstProc = MultiProc_getId("HOST");
+
+    if (NameServerRemoteRpmsg_module->nsPort == NAME_SERVER_PORT_INVALID ||
+        strlen(instanceName) >= MAXNAMEINCHAR ||
+        strlen(name) >= MAXNAMEINCHAR) {
+        return;
+    }
+
+    msg.request = NameServerRemoteRpmsg_ANNOUNCE;
+    msg.requestStatus = (value != NULL);
+    msg.requestId = 0;
+
+    /* only the first word of a longer value goes; it's looked up later */
+    msg.valueLen = len;
+    msg.value = 0;
+    if (value != NULL) {
+        memcpy(&msg.value, value, len < sizeof(Bits32) ? len : sizeof(Bits32));
+    }
+
+    strcpy((Char *)msg.instanceName, instanceName);
+    strcpy((Char *)msg.name, name);
+
+    Log_print3(Diags_INFO, FXNN": %s:%s %s\n", (IArg)instanceName,
+               (IArg)name, (IArg)(value != NULL ? "added" : "removed"));
+
+    RPMessage_send(dstProc, NameServerRemoteRpmsg_module->nsPort,
+               RPMSG_MESSAGEQ_PORT, (Ptr)&msg, sizeof(msg));
 }
 #undef FXNN
@@ -54,6 +54,7 @@ typedef struct NameServerRemote_Msg {
     Bits32  name[NAMEARRAYSZIE];
     Bits32  valueLen;              /* len of value                  */
     Bits32  valueBuf[MAXVALUELEN]; /* value buffer                  */
+    Bits32  requestId;          /* echoed in the reply, to match it */
 } NameServerRemote_Msg;
 
 #define NAME_SERVER_RPMSG_ADDR  0
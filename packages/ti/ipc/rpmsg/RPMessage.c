@@ -94,6 +94,7 @@
 #include <ti/ipc/MultiProc.h>
 
 #include <ti/ipc/rpmsg/RPMessage.h>
+#include <ti/ipc/rpmsg/_RPMessage.h>
 
 #include "_VirtQueue.h"
 
@@ -546,14 +547,16 @@ Int RPMessage_recv(RPMessage_Handle handle, Ptr data, UInt16 *len,
 #undef FXNN
 
 /*
- *  ======== RPMessage_send ========
+ *  ======== RPMessage_sendMsg ========
+ *  Common to RPMessage_send() and RPMessage_sendNoKick().
  */
 #define FXNN "RPMessage_send"
-Int RPMessage_send(UInt16 dstProc,
+static Int RPMessage_sendMsg(UInt16 dstProc,
                       UInt32 dstEndpt,
                       UInt32 srcEndpt,
                       Ptr    data,
-                      UInt16 len)
+                      UInt16 len,
+                      Bool   kick)
 {
     Int               status = RPMessage_S_SUCCESS;
     RPMessage_Object   *obj;
@@ -588,7 +591,9 @@ Int RPMessage_send(UInt16 dstProc,
 
             VirtQueue_addUsedBuf(transport.virtQueue_toHost, token,
                                                             RPMSG_BUF_SIZE);
-            VirtQueue_kick(transport.virtQueue_toHost);
+            if (kick) {
+                VirtQueue_kick(transport.virtQueue_toHost);
+            }
         }
         else {
             status = RPMessage_E_FAIL;
@@ -647,6 +652,40 @@ Int RPMessage_send(UInt16 dstProc,
 }
 #undef FXNN
 
+/*
+ *  ======== RPMessage_send ========
+ */
+Int RPMessage_send(UInt16 dstProc,
+                      UInt32 dstEndpt,
+                      UInt32 srcEndpt,
+                      Ptr    data,
+                      UInt16 len)
+{
+    return (RPMessage_sendMsg(dstProc, dstEndpt, srcEndpt, data, len, TRUE));
+}
+
+/*
+ *  ======== RPMessage_sendNoKick ========
+ */
+Int RPMessage_sendNoKick(UInt16 dstProc,
+                      UInt32 dstEndpt,
+                      UInt32 srcEndpt,
+                      Ptr    data,
+                      UInt16 len)
+{
+    return (RPMessage_sendMsg(dstProc, dstEndpt, srcEndpt, data, len, FALSE));
+}
+
+/*
+ *  ======== RPMessage_kick ========
+ */
+Void RPMessage_kick(UInt16 dstProc)
+{
+    if (dstProc != MultiProc_self()) {
+        VirtQueue_kick(transport.virtQueue_toHost);
+    }
+}
+
 /*
  *  ======== RPMessage_unblock ========
  */
@@ -59,6 +59,24 @@ Void RPMessage_init(UInt16 remoteProcId);
  */
 Void RPMessage_finalize();
 
+/*!
+ *  @brief      Send without interrupting the remote processor
+ *
+ *  Same as RPMessage_send(), except that the remote processor is not told
+ *  of the message until RPMessage_kick() is called, so a burst of
+ *  messages costs one interrupt.
+ */
+Int RPMessage_sendNoKick(UInt16 dstProc, UInt32 dstEndpt, UInt32 srcEndpt,
+        Ptr data, UInt16 len);
+
+/*!
+ *  @brief      Tell the remote processor of messages sent with
+ *              RPMessage_sendNoKick()
+ *
+ *  @param[in]  dstProc     Destination ProcId.
+ */
+Void RPMessage_kick(UInt16 dstProc);
+
 #if defined (__cplusplus)
 }
 #endif /* defined (__cplusplus) */
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2012-2013, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ *  ======== messageq_circ.c ========
+ *
+ *  Benchmark of the circular buffer transport and notify driver under
+ *  sustained load from CORE0 to CORE1: CORE0 puts NUMLOOPS messages
+ *  through TransportShmCirc as fast as the heap allows, then sends
+ *  NUMLOOPS Notify events through NotifyDriverCirc.  Both cores report
+ *  the cycles spent per message and per event.  Built once with the
+ *  default TransportShmCirc.suppressEvents and
+ *  NotifyDriverCirc.suppressEvents and once without, to compare the two.
+ */
+
+#include <xdc/std.h>
+
+#include <xdc/runtime/System.h>
+#include <xdc/runtime/IHeap.h>
+#include <xdc/runtime/Timestamp.h>
+#include <xdc/runtime/Types.h>
+
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/MessageQ.h>
+#include <ti/ipc/HeapBufMP.h>
+#include <ti/ipc/MultiProc.h>
+#include <ti/ipc/Notify.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/family/c66/Cache.h>
+
+#include <xdc/cfg/global.h>
+
+/* Define this to eliminate VIRTIO DEV and VRINGS from rsc_table: */
+#define  TRACE_RESOURCE_ONLY 1
+extern char * xdc_runtime_SysMin_Module_State_0_outbuf__A;
+#if defined(TCI6614)
+#include <ti/ipc/remoteproc/rsc_table_tci6614.h>
+#elif defined(TCI6614_v33)
+#include <ti/ipc/remoteproc/rsc_table_tci6614_v3.3.h>
+#elif defined(TCI6638)
+#include <ti/ipc/remoteproc/rsc_table_tci6638.h>
+#endif
+
+#define HEAP_NAME   "circHeap"
+#define HEAPID      0
+/*
+ *  Fewer than the 31 messages the TransportShmCirc ring (numMsgs of 32)
+ *  can hold, so waiting for the heap keeps MessageQ_put() from ever
+ *  finding it full.
+ */
+#define NUMBLOCKS   16
+#define NUMLOOPS    10000
+#define EVENTID     10      /* above Notify.reservedEvents */
+
+#ifdef NOSUPPRESS
+#define MODE        "every put interrupts"
+#else
+#define MODE        "suppressed events"
+#endif
+
+static Semaphore_Handle eventSem;
+static UInt32           numEvents = 0;
+static UInt32           eventStart;
+static UInt32           eventEnd;
+
+/*
+ *  ======== report ========
+ */
+static Void report(String what, UInt count, UInt32 delta)
+{
+    Types_FreqHz freq;
+
+    Timestamp_getFreq(&freq);
+    System_printf("%s: %s: %d in %d ticks of %d Hz: %d ticks each\n",
+            MODE, what, count, delta, freq.lo, delta / count);
+}
+
+/*
+ *  ======== notifyFxn ========
+ *  Count CORE0's events, checking they arrive in order.
+ */
+static Void notifyFxn(UInt16 procId, UInt16 lineId, UInt32 eventId, UArg arg,
+        UInt32 payload)
+{
+    if (payload != numEvents) {
+        System_abort("The event received is out of order!\n");
+    }
+
+    if (numEvents == 0) {
+        eventStart = Timestamp_get32();
+    }
+
+    if (++numEvents == NUMLOOPS) {
+        eventEnd = Timestamp_get32();
+        Semaphore_post(eventSem);
+    }
+}
+
+/*
+ *  ======== sender ========
+ *  CORE0: put NUMLOOPS messages to CORE1, waiting only for the heap, then
+ *  send it NUMLOOPS events.
+ */
+static Void sender(Void)
+{
+    MessageQ_QueueId queueId;
+    MessageQ_Msg     msg;
+    UInt16           remoteProcId;
+    UInt32           start;
+    Int              status;
+    UInt             i;
+
+    remoteProcId = MultiProc_getId("CORE1");
+
+    /* CORE1 registers for the events before creating its queue */
+    while (MessageQ_open("CORE1", &queueId) < 0) {
+        Task_sleep(1);
+    }
+
+    start = Timestamp_get32();
+    for (i = 0; i < NUMLOOPS; i++) {
+        /* CORE1 frees them; wait for it if the heap runs dry */
+        while ((msg = MessageQ_alloc(HEAPID, sizeof(MessageQ_MsgHeader))) ==
+                NULL) {
+        }
+        MessageQ_setMsgId(msg, i);
+
+        status = MessageQ_put(queueId, msg);
+        if (status < 0) {
+            System_abort("MessageQ_put had a failure/error\n");
+        }
+    }
+    report("messages put", NUMLOOPS, Timestamp_get32() - start);
+
+    start = Timestamp_get32();
+    for (i = 0; i < NUMLOOPS; i++) {
+        status = Notify_sendEvent(remoteProcId, 0, EVENTID, i, TRUE);
+        if (status < 0) {
+            System_abort("Notify_sendEvent had a failure/error\n");
+        }
+    }
+    report("events sent", NUMLOOPS, Timestamp_get32() - start);
+}
+
+/*
+ *  ======== receiver ========
+ *  CORE1: get CORE0's messages, checking their order, then wait for all
+ *  of its events.
+ */
+static Void receiver(Void)
+{
+    MessageQ_Handle  messageQ;
+    MessageQ_Msg     msg;
+    UInt32           start = 0;
+    Int              status;
+    UInt             i;
+
+    eventSem = Semaphore_create(0, NULL, NULL);
+    status = Notify_registerEvent(MultiProc_getId("CORE0"), 0, EVENTID,
+            (Notify_FnNotifyCbck)notifyFxn, 0);
+    if ((eventSem == NULL) || (status < 0)) {
+        System_abort("Notify_registerEvent failed\n");
+    }
+
+    messageQ = MessageQ_create("CORE1", NULL);
+    if (messageQ == NULL) {
+        System_abort("MessageQ_create failed\n");
+    }
+
+    for (i = 0; i < NUMLOOPS; i++) {
+        status = MessageQ_get(messageQ, &msg, MessageQ_FOREVER);
+        if (status < 0) {
+            System_abort("This should not happen since timeout is forever\n");
+        }
+        if (i == 0) {
+            start = Timestamp_get32();
+        }
+        if (MessageQ_getMsgId(msg) != i) {
+            System_abort("The sequence received is incorrect!\n");
+        }
+
+        MessageQ_free(msg);
+    }
+    report("messages got", NUMLOOPS - 1, Timestamp_get32() - start);
+
+    Semaphore_pend(eventSem, BIOS_WAIT_FOREVER);
+    report("events handled", NUMLOOPS - 1, eventEnd - eventStart);
+
+    MessageQ_delete(&messageQ);
+}
+
+/*
+ *  ======== tsk0_func ========
+ */
+Void tsk0_func(UArg arg0, UArg arg1)
+{
+    HeapBufMP_Handle heapHandle;
+    HeapBufMP_Params heapBufParams;
+    Int              status;
+
+    if (MultiProc_self() == 0) {
+        HeapBufMP_Params_init(&heapBufParams);
+        heapBufParams.regionId       = 0;
+        heapBufParams.name           = HEAP_NAME;
+        heapBufParams.numBlocks      = NUMBLOCKS;
+        heapBufParams.blockSize      = sizeof(MessageQ_MsgHeader);
+        heapHandle = HeapBufMP_create(&heapBufParams);
+        if (heapHandle == NULL) {
+            System_abort("HeapBufMP_create failed\n" );
+        }
+    }
+    else {
+        /* Open the heap created by the other processor. Loop until opened. */
+        do {
+            status = HeapBufMP_open(HEAP_NAME, &heapHandle);
+            if (status < 0) {
+                Task_sleep(1);
+            }
+        } while (status < 0);
+    }
+
+    /* Register this heap with MessageQ */
+    MessageQ_registerHeap((IHeap_Handle)heapHandle, HEAPID);
+
+    if (MultiProc_self() == 0) {
+        sender();
+    }
+    else if (MultiProc_self() == 1) {
+        receiver();
+    }
+
+    System_printf("The test is complete\n");
+    BIOS_exit(0);
+}
+
+#define CACHE_WB_TICK_PERIOD    5
+
+/*
+ * ======== traceBuf_cacheWb ========
+ *
+ * Used for flushing SysMin trace buffer.
+ */
+Void traceBuf_cacheWb()
+{
+    static UInt32 oldticks = 0;
+    UInt32 newticks;
+
+    newticks = Clock_getTicks();
+    if (newticks - oldticks < (UInt32)CACHE_WB_TICK_PERIOD) {
+        /* Don't keep flushing cache */
+        return;
+    }
+
+    oldticks = newticks;
+
+    Cache_wbAll();
+}
+
+/*
+ *  ======== main ========
+ *  Synchronizes all processors (in Ipc_start) and calls BIOS_start
+ */
+Int main(Int argc, Char* argv[])
+{
+    Int status;
+
+    status = Ipc_start();
+    if (status < 0) {
+        System_abort("Ipc_start failed\n");
+    }
+
+    BIOS_start();
+
+    return (0);
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2012-2013, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ *  ======== messageq_credit.c ========
+ *
+ *  Test of MessageQ_putWait() between CORE0 and CORE1, built with
+ *  MessageQ.creditWindow set.  CORE1 holds off reading until CORE0 has
+ *  spent the window and seen a putWait time out, then reads slowly while
+ *  CORE0 keeps sending.  CORE1 echoes each message with its own queue as
+ *  the reply queue, so credits come back both piggybacked and in credit
+ *  messages of their own.
+ */
+
+#include <xdc/std.h>
+
+#include <xdc/runtime/System.h>
+#include <xdc/runtime/IHeap.h>
+
+#include <ti/ipc/Ipc.h>
+#include <ti/ipc/MessageQ.h>
+#include <ti/ipc/HeapBufMP.h>
+#include <ti/ipc/MultiProc.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/family/c66/Cache.h>
+
+#include <xdc/cfg/global.h>
+
+/* Define this to eliminate VIRTIO DEV and VRINGS from rsc_table: */
+#define  TRACE_RESOURCE_ONLY 1
+extern char * xdc_runtime_SysMin_Module_State_0_outbuf__A;
+#if defined(TCI6614)
+#include <ti/ipc/remoteproc/rsc_table_tci6614.h>
+#elif defined(TCI6614_v33)
+#include <ti/ipc/remoteproc/rsc_table_tci6614_v3.3.h>
+#elif defined(TCI6638)
+#include <ti/ipc/remoteproc/rsc_table_tci6638.h>
+#endif
+
+#define HEAP_NAME   "creditHeap"
+#define HEAPID      0
+#define NUMBLOCKS   16
+#define WINDOW      4       /* MessageQ.creditWindow in the .cfg */
+#define NUMLOOPS    100
+#define TIMEOUT     10000   /* usecs a putWait waits for a credit */
+
+/*
+ *  ======== openQueue ========
+ *  Spin until the named queue exists.
+ */
+static MessageQ_QueueId openQueue(String name)
+{
+    MessageQ_QueueId queueId;
+
+    while (MessageQ_open(name, &queueId) < 0) {
+        Task_sleep(1);
+    }
+
+    return (queueId);
+}
+
+/*
+ *  ======== getEcho ========
+ *  Get the next message CORE1 echoed, and check it is in order.
+ */
+static Void getEcho(MessageQ_Handle messageQ, UInt16 *next)
+{
+    MessageQ_Msg msg;
+    Int          status;
+
+    status = MessageQ_get(messageQ, &msg, MessageQ_FOREVER);
+    if (status < 0) {
+        System_abort("This should not happen since timeout is forever\n");
+    }
+    if (MessageQ_getMsgId(msg) != *next) {
+        System_abort("The echo received is out of order!\n");
+    }
+    (*next)++;
+
+    MessageQ_free(msg);
+}
+
+/*
+ *  ======== sender ========
+ *  CORE0: put NUMLOOPS messages with MessageQ_putWait(), getting the
+ *  echoes whenever the heap runs dry, then the rest of them.
+ */
+static Void sender(Void)
+{
+    MessageQ_Handle  messageQ;
+    MessageQ_QueueId dataQueueId;
+    MessageQ_QueueId goQueueId;
+    MessageQ_Msg     msg;
+    MessageQ_Msg     go;
+    Int              status;
+    UInt16           next = 0;
+    UInt16           i;
+
+    messageQ = MessageQ_create("CORE0", NULL);
+    if (messageQ == NULL) {
+        System_abort("MessageQ_create failed\n");
+    }
+    dataQueueId = openQueue("CORE1");
+    goQueueId = openQueue("CORE1_GO");
+
+    for (i = 0; i < NUMLOOPS; i++) {
+        while ((msg = MessageQ_alloc(HEAPID, sizeof(MessageQ_MsgHeader))) ==
+                NULL) {
+            getEcho(messageQ, &next);
+        }
+        MessageQ_setMsgId(msg, i);
+
+        /* CORE1 isn't reading yet: the window is all there is */
+        if (i == WINDOW) {
+            status = MessageQ_putWait(dataQueueId, msg, TIMEOUT);
+            if (status != MessageQ_E_TIMEOUT) {
+                System_abort("MessageQ_putWait didn't wait for credit\n");
+            }
+
+            /* MessageQ_put() takes no credit */
+            go = MessageQ_alloc(HEAPID, sizeof(MessageQ_MsgHeader));
+            if (go == NULL) {
+                System_abort("MessageQ_alloc failed\n");
+            }
+            if (MessageQ_put(goQueueId, go) < 0) {
+                System_abort("MessageQ_put had a failure/error\n");
+            }
+            System_printf("Window of %d spent; CORE1 may read\n", WINDOW);
+        }
+
+        /* still ours if it timed out above */
+        status = MessageQ_putWait(dataQueueId, msg, MessageQ_FOREVER);
+        if (status < 0) {
+            System_abort("MessageQ_putWait had a failure/error\n");
+        }
+    }
+
+    while (next < NUMLOOPS) {
+        getEcho(messageQ, &next);
+    }
+
+    MessageQ_delete(&messageQ);
+}
+
+/*
+ *  ======== receiver ========
+ *  CORE1: wait for the go, then get the messages one a tick, checking
+ *  that no more than the window is ever queued, and echo them.
+ */
+static Void receiver(Void)
+{
+    MessageQ_Handle  messageQ;
+    MessageQ_Handle  goQ;
+    MessageQ_QueueId replyQueueId;
+    MessageQ_Msg     msg;
+    Int              status;
+    UInt16           i;
+
+    messageQ = MessageQ_create("CORE1", NULL);
+    goQ = MessageQ_create("CORE1_GO", NULL);
+    if ((messageQ == NULL) || (goQ == NULL)) {
+        System_abort("MessageQ_create failed\n");
+    }
+    replyQueueId = openQueue("CORE0");
+
+    status = MessageQ_get(goQ, &msg, MessageQ_FOREVER);
+    if (status < 0) {
+        System_abort("This should not happen since timeout is forever\n");
+    }
+    MessageQ_free(msg);
+
+    for (i = 0; i < NUMLOOPS; i++) {
+        if (MessageQ_count(messageQ) > WINDOW) {
+            System_abort("More messages queued than the window!\n");
+        }
+
+        status = MessageQ_get(messageQ, &msg, MessageQ_FOREVER);
+        if (status < 0) {
+            System_abort("This should not happen since timeout is forever\n");
+        }
+        if (MessageQ_getMsgId(msg) != i) {
+            System_abort("The sequence received is incorrect!\n");
+        }
+
+        /* a slow reader */
+        Task_sleep(1);
+
+        /* credits owed to CORE0 go back on the echo */
+        MessageQ_setReplyQueue(messageQ, msg);
+        status = MessageQ_put(replyQueueId, msg);
+        if (status < 0) {
+            System_abort("MessageQ_put had a failure/error\n");
+        }
+    }
+
+    MessageQ_delete(&goQ);
+    MessageQ_delete(&messageQ);
+}
+
+/*
+ *  ======== tsk0_func ========
+ */
+Void tsk0_func(UArg arg0, UArg arg1)
+{
+    HeapBufMP_Handle heapHandle;
+    HeapBufMP_Params heapBufParams;
+    Int              status;
+
+    if (MultiProc_self() == 0) {
+        HeapBufMP_Params_init(&heapBufParams);
+        heapBufParams.regionId       = 0;
+        heapBufParams.name           = HEAP_NAME;
+        heapBufParams.numBlocks      = NUMBLOCKS;
+        heapBufParams.blockSize      = sizeof(MessageQ_MsgHeader);
+        heapHandle = HeapBufMP_create(&heapBufParams);
+        if (heapHandle == NULL) {
+            System_abort("HeapBufMP_create failed\n" );
+        }
+    }
+    else {
+        /* Open the heap created by the other processor. Loop until opened. */
+        do {
+            status = HeapBufMP_open(HEAP_NAME, &heapHandle);
+            if (status < 0) {
+                Task_sleep(1);
+            }
+        } while (status < 0);
+    }
+
+    /* Register this heap with MessageQ */
+    MessageQ_registerHeap((IHeap_Handle)heapHandle, HEAPID);
+
+    if (MultiProc_self() == 0) {
+        sender();
+    }
+    else if (MultiProc_self() == 1) {
+        receiver();
+    }
+
+    System_printf("The test is complete\n");
+    BIOS_exit(0);
+}
+
+#define CACHE_WB_TICK_PERIOD    5
+
+/*
+ * ======== traceBuf_cacheWb ========
+ *
+ * Used for flushing SysMin trace buffer.
+ */
+Void traceBuf_cacheWb()
+{
+    static UInt32 oldticks = 0;
+    UInt32 newticks;
+
+    newticks = Clock_getTicks();
+    if (newticks - oldticks < (UInt32)CACHE_WB_TICK_PERIOD) {
+        /* Don't keep flushing cache */
+        return;
+    }
+
+    oldticks = newticks;
+
+    Cache_wbAll();
+}
+
+/*
+ *  ======== main ========
+ *  Synchronizes all processors (in Ipc_start) and calls BIOS_start
+ */
+Int main(Int argc, Char* argv[])
+{
+    Int status;
+
+    status = Ipc_start();
+    if (status < 0) {
+        System_abort("Ipc_start failed\n");
+    }
+
+    BIOS_start();
+
+    return (0);
+}
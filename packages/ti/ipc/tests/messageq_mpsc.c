@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2012-2013, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ *  ======== messageq_mpsc.c ========
+ *
+ *  Test for many tasks putting to one local messageq, as messageq_multi
+ *  does from the host.  Checks that each producer's messages arrive in
+ *  order, that urgent messages overtake the rest, and reports the cost
+ *  per message.  Built once with MessageQ.lockFreeQueues and once
+ *  without, to compare the two.
+ *
+ */
+
+#include <xdc/std.h>
+#include <xdc/runtime/Error.h>
+#include <xdc/runtime/Memory.h>
+#include <xdc/runtime/System.h>
+#include <xdc/runtime/Timestamp.h>
+#include <xdc/runtime/Types.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include <ti/ipc/MessageQ.h>
+#include <ti/ipc/MultiProc.h>
+
+#define HEAPID          0
+#define NUMPRODUCERS    4
+#define NUMLOOPS        1000
+#define HIGHEVERY       8       /* every Nth message is high priority */
+
+typedef struct {
+    MessageQ_MsgHeader  header;
+    UInt32              producer;
+    UInt32              seq;
+} TestMsg;
+
+static MessageQ_QueueId queueId;
+static Semaphore_Handle startSem;
+
+/*
+ *  ======== producerFxn ========
+ *  Put NUMLOOPS numbered messages to the consumer's queue.
+ *  Inputs:
+ *     - arg0: number of the producer, carried in each message.
+ */
+Void producerFxn(UArg arg0, UArg arg1)
+{
+    TestMsg *msg;
+    UInt32   seq;
+    Int      status;
+
+    Semaphore_pend(startSem, BIOS_WAIT_FOREVER);
+
+    for (seq = 0; seq < NUMLOOPS; seq++) {
+        /* the consumer frees them; wait for it if the heap runs dry */
+        while ((msg = (TestMsg *)MessageQ_alloc(HEAPID, sizeof(TestMsg))) ==
+                NULL) {
+            Task_yield();
+        }
+
+        msg->producer = arg0;
+        msg->seq = seq;
+        if ((seq % HIGHEVERY) == 0) {
+            MessageQ_setMsgPri((MessageQ_Msg)msg, MessageQ_HIGHPRI);
+        }
+
+        status = MessageQ_put(queueId, (MessageQ_Msg)msg);
+        if (status != MessageQ_S_SUCCESS) {
+           System_abort("MessageQ_put had a failure/error\n");
+        }
+    }
+}
+
+/*
+ *  ======== checkUrgent ========
+ *  Urgent messages are got before any other, the last one put first.
+ */
+static Void checkUrgent(MessageQ_Handle messageQ)
+{
+    static const UInt pri[] = {
+        MessageQ_NORMALPRI, MessageQ_HIGHPRI, MessageQ_URGENTPRI,
+        MessageQ_URGENTPRI
+    };
+    static const UInt32 expected[] = { 3, 2, 1, 0 };
+    TestMsg *msg;
+    UInt     i;
+
+    for (i = 0; i < 4; i++) {
+        msg = (TestMsg *)MessageQ_alloc(HEAPID, sizeof(TestMsg));
+        if (msg == NULL) {
+            System_abort("MessageQ_alloc failed\n");
+        }
+        msg->seq = i;
+        MessageQ_setMsgPri((MessageQ_Msg)msg, pri[i]);
+        MessageQ_put(queueId, (MessageQ_Msg)msg);
+    }
+
+    if (MessageQ_count(messageQ) != 4) {
+        System_abort("MessageQ_count is incorrect!\n");
+    }
+
+    for (i = 0; i < 4; i++) {
+        MessageQ_get(messageQ, (MessageQ_Msg *)&msg, MessageQ_FOREVER);
+        if (msg->seq != expected[i]) {
+            System_abort("The priority order received is incorrect!\n");
+        }
+        MessageQ_free((MessageQ_Msg)msg);
+    }
+}
+
+/*
+ *  ======== consumerFxn ========
+ *  Receive all the producers' messages and check their order.
+ */
+Void consumerFxn(UArg arg0, UArg arg1)
+{
+    MessageQ_Handle  messageQ;
+    TestMsg         *msg;
+    UInt32           nextNormal[NUMPRODUCERS];
+    UInt32           nextHigh[NUMPRODUCERS];
+    UInt32          *next;
+    UInt32           start;
+    UInt32           delta;
+    UInt             count;
+    Int              status;
+    Int              i;
+    Types_FreqHz     freq;
+
+    messageQ = MessageQ_create(NULL, NULL);
+    if (messageQ == NULL) {
+        System_abort("MessageQ_create failed\n");
+    }
+    queueId = MessageQ_getQueueId(messageQ);
+
+    checkUrgent(messageQ);
+
+    for (i = 0; i < NUMPRODUCERS; i++) {
+        nextNormal[i] = 1;
+        nextHigh[i] = 0;
+    }
+
+    start = Timestamp_get32();
+    for (i = 0; i < NUMPRODUCERS; i++) {
+        Semaphore_post(startSem);
+    }
+
+    for (count = 0; count < NUMPRODUCERS * NUMLOOPS; count++) {
+        status = MessageQ_get(messageQ, (MessageQ_Msg *)&msg,
+                MessageQ_FOREVER);
+        if (status != MessageQ_S_SUCCESS) {
+           System_abort("This should not happen since timeout is forever\n");
+        }
+
+        /* each producer's messages of one priority arrive in order */
+        next = (MessageQ_getMsgPri((MessageQ_Msg)msg) == MessageQ_HIGHPRI) ?
+                nextHigh : nextNormal;
+        if (msg->seq != next[msg->producer]) {
+            System_abort("The sequence received is incorrect!\n");
+        }
+        next[msg->producer] += (next == nextHigh) ? HIGHEVERY :
+                (((msg->seq + 1) % HIGHEVERY) == 0) ? 2 : 1;
+
+        MessageQ_free((MessageQ_Msg)msg);
+    }
+    delta = Timestamp_get32() - start;
+
+    Timestamp_getFreq(&freq);
+    System_printf("%s: %d msgs from %d tasks in %d ticks of %d Hz: "
+            "%d ticks/msg\n",
+#ifdef LOCKFREE
+            "lock-free queues",
+#else
+            "List queues",
+#endif
+            count, NUMPRODUCERS, delta, freq.lo, delta / count);
+
+    MessageQ_delete(&messageQ);
+
+    System_printf("Test complete!\n");
+}
+
+/*
+ *  ======== main ========
+ */
+Int main(Int argc, Char* argv[])
+{
+    Task_Params params;
+    Int i;
+
+    System_printf("%s:main: MultiProc id = %d\n", __FILE__, MultiProc_self());
+
+    startSem = Semaphore_create(0, NULL, NULL);
+
+    /* The consumer runs above the producers, as a server task would */
+    Task_Params_init(&params);
+    params.priority = 3;
+    Task_create(consumerFxn, &params, NULL);
+
+    params.priority = 2;
+    for (i = 0; i < NUMPRODUCERS; i++) {
+        params.arg0 = i;
+        Task_create(producerFxn, &params, NULL);
+    }
+
+    BIOS_start();
+
+    return (0);
+}
@@ -46,6 +46,7 @@
 #include <xdc/runtime/Log.h>
 #include <xdc/runtime/Diags.h>
 
+#include <ti/sysbios/hal/Hwi.h>
 
 #include <ti/sdo/utils/_MultiProc.h>
 #include <ti/sdo/ipc/_MessageQ.h>
@@ -72,8 +73,37 @@
 /* Name of the rpmsg socket on host: */
 #define RPMSG_SOCKET_NAME  "rpmsg-proto"
 
+/* Payload carried by each fragment of a large message: */
+#define FRAG_CHUNK (MAX_PAYLOAD - sizeof(MessageQ_MsgHeader))
+
+/* Messages from the host that can be under reassembly at once: */
+#define NUM_REASSEMBLY     (4)
+
+/* A message being put back together from its fragments */
+typedef struct Reassembly {
+    MessageQ_Msg msg;       /* message being rebuilt, NULL if slot is free */
+    UInt32       srcAddr;   /* rpmsg address of the sender                 */
+    UInt16       tag;       /* sender's tag for the message                */
+    UInt16       next;      /* index of the next fragment expected         */
+    UInt16       count;     /* number of fragments in the message          */
+    UInt32       chunk;     /* payload carried by each fragment but last   */
+    UInt32       size;      /* bytes of msg filled in so far               */
+    UInt32       age;       /* for picking the oldest slot to evict        */
+} Reassembly;
+
+/* Only touched from transportCallbackFxn(), which runs in one context */
+static Reassembly reassembly[NUM_REASSEMBLY];
+static UInt32     reassemblyAge = 0;
+
+/* Tag for the next large message sent */
+static UInt16     fragTag = 0;
+
 static Void transportCallbackFxn(RPMessage_Handle msgq, UArg arg, Ptr data,
                                       UInt16 dataLen, UInt32 srcAddr);
+static Bool putFragments(TransportRpmsg_Object *obj, MessageQ_Msg msg,
+                                      UInt16 dstAddr);
+static MessageQ_Msg reassemble(MessageQ_Msg frag, UInt16 dataLen,
+                                      UInt32 srcAddr);
 
 /*
  *************************************************************************
@@ -180,6 +210,9 @@ Void TransportRpmsg_Instance_finalize(TransportRpmsg_Object *obj, Int status)
  *  vring in order for this side to send without failing!
  *
  *  Also, this is a copy-transport, to match the Linux side rpmsg.
+ *
+ *  Messages larger than a vring buffer are sent as a train of fragments
+ *  (see putFragments()).
  */
 #define FXNN "TransportRpmsg_put"
 Bool TransportRpmsg_put(TransportRpmsg_Object *obj, Ptr msg)
@@ -189,15 +222,19 @@ Bool TransportRpmsg_put(TransportRpmsg_Object *obj, Ptr msg)
     UInt16       dstAddr;
 
     /* Send to remote processor: */
-    /* Assert msg->msgSize <= vring's max fixed buffer size */
     msgSize = MessageQ_getMsgSize(msg);
-    Assert_isTrue(msgSize <= MAX_PAYLOAD, NULL);
     dstAddr  = (((MessageQ_Msg)msg)->dstId & 0x0000FFFF);
 
     Log_print3(Diags_INFO, FXNN": sending msg from: %d, to: %d, dataLen: %d",
                   (IArg)RPMSG_MESSAGEQ_PORT, (IArg)dstAddr, (IArg)msgSize);
-    status = RPMessage_send(obj->remoteProcId, dstAddr, RPMSG_MESSAGEQ_PORT,
-                      msg, msgSize);
+    if (msgSize > MAX_PAYLOAD) {
+        status = putFragments(obj, (MessageQ_Msg)msg, dstAddr) ?
+                RPMessage_S_SUCCESS : RPMessage_E_FAIL;
+    }
+    else {
+        status = RPMessage_send(obj->remoteProcId, dstAddr,
+                RPMSG_MESSAGEQ_PORT, msg, msgSize);
+    }
 
     /* free the app's message */
     if (((MessageQ_Msg)msg)->heapId != ti_sdo_ipc_MessageQ_STATICMSG) {
@@ -208,6 +245,55 @@ Bool TransportRpmsg_put(TransportRpmsg_Object *obj, Ptr msg)
 }
 #undef FXNN
 
+/*
+ *  ======== TransportRpmsg_putMany ========
+ *  The messages are copied into vring buffers as TransportRpmsg_put()
+ *  does, and the host is kicked once for the burst.
+ */
+#define FXNN "TransportRpmsg_putMany"
+UInt TransportRpmsg_putMany(TransportRpmsg_Object *obj, Ptr *msgs,
+    UInt numMsgs)
+{
+    Int          status = RPMessage_S_SUCCESS;
+    UInt         msgSize;
+    UInt16       dstAddr;
+    UInt         i;
+
+    for (i = 0; i < numMsgs; i++) {
+        msgSize = MessageQ_getMsgSize(msgs[i]);
+        dstAddr  = (((MessageQ_Msg)msgs[i])->dstId & 0x0000FFFF);
+
+        Log_print3(Diags_INFO, FXNN": sending msg from: %d, to: %d, "
+                "dataLen: %d", (IArg)RPMSG_MESSAGEQ_PORT, (IArg)dstAddr,
+                (IArg)msgSize);
+        if (msgSize > MAX_PAYLOAD) {
+            status = putFragments(obj, (MessageQ_Msg)msgs[i], dstAddr) ?
+                    RPMessage_S_SUCCESS : RPMessage_E_FAIL;
+        }
+        else {
+            status = RPMessage_sendNoKick(obj->remoteProcId, dstAddr,
+                    RPMSG_MESSAGEQ_PORT, msgs[i], msgSize);
+        }
+
+        /* the caller keeps the message that failed, and those after it */
+        if (status != RPMessage_S_SUCCESS) {
+            break;
+        }
+
+        /* free the app's message */
+        if (((MessageQ_Msg)msgs[i])->heapId != ti_sdo_ipc_MessageQ_STATICMSG) {
+           MessageQ_free(msgs[i]);
+        }
+    }
+
+    if (i > 0) {
+        RPMessage_kick(obj->remoteProcId);
+    }
+
+    return (i);
+}
+#undef FXNN
+
 /*
  *  ======== TransportRpmsg_control ========
  */
@@ -300,6 +386,16 @@ static Void transportCallbackFxn(RPMessage_Handle msgq, UArg arg, Ptr data,
                "msg->msgSize: %d, msg->dstId: %d, msg->msgId: %d\n",
                msg->heapId, msg->msgSize, msg->dstId, msg->msgId);
 
+    /* A fragment of a large message is copied into its reassembly buffer */
+    if (msg->flags & RPMSG_MESSAGEQ_FRAGFLAG) {
+        buf = reassemble(msg, dataLen, srcAddr);
+        if ((buf != NULL) &&
+            (MessageQ_put(MessageQ_getDstQueue(buf), buf) < 0)) {
+            MessageQ_free(buf);
+        }
+        goto exit;
+    }
+
     /* Alloc a message from msg->heapId to copy the msg */
     msgSize = MessageQ_getMsgSize(msg);
     buf = MessageQ_alloc(msg->heapId, msgSize);
@@ -321,13 +417,198 @@ static Void transportCallbackFxn(RPMessage_Handle msgq, UArg arg, Ptr data,
     /* get the queue id */
     queueId = MessageQ_getDstQueue(msg);
 
-    /* Pass to desitination queue: */
-    MessageQ_put(queueId, buf);
+    /* Pass to desitination queue, unless it was deleted: */
+    if (MessageQ_put(queueId, buf) < 0) {
+        MessageQ_free(buf);
+    }
 
 exit:
     Log_print0(Diags_EXIT, "<-- "FXNN);
 }
 
+/*
+ *  ======== putFragments ========
+ *  Send a large message as a train of fragments, each a copy of the
+ *  header followed by the next FRAG_CHUNK bytes of payload.  The header
+ *  copy is written just ahead of its piece, over bytes that were already
+ *  sent, and those bytes are put back afterwards, so only the header is
+ *  copied and the message is left as it was.
+ */
+#define FXNN "putFragments"
+static Bool putFragments(TransportRpmsg_Object *obj, MessageQ_Msg msg,
+                                      UInt16 dstAddr)
+{
+    MessageQ_MsgHeader hdr;
+    MessageQ_MsgHeader save;
+    MessageQ_Msg       frag;
+    UInt32             payloadSize;
+    UInt32             len;
+    UInt               count;
+    UInt               i;
+    UInt               key;
+    UInt16             tag;
+    Int                status = RPMessage_S_SUCCESS;
+
+    payloadSize = MessageQ_getMsgSize(msg) - sizeof(MessageQ_MsgHeader);
+    count = (payloadSize + FRAG_CHUNK - 1) / FRAG_CHUNK;
+    if (count > RPMSG_MESSAGEQ_MAXFRAGS) {
+        Log_print1(Diags_USER1, FXNN": message too large: %d",
+                (IArg)MessageQ_getMsgSize(msg));
+        return (FALSE);
+    }
+
+    key = Hwi_disable();
+    tag = ++fragTag;
+    Hwi_restore(key);
+
+    hdr = *msg;
+    hdr.flags |= RPMSG_MESSAGEQ_FRAGFLAG;
+
+    for (i = 0; i < count && status == RPMessage_S_SUCCESS; i++) {
+        len = payloadSize - i * FRAG_CHUNK;
+        if (len > FRAG_CHUNK) {
+            len = FRAG_CHUNK;
+        }
+
+        frag = (MessageQ_Msg)((UInt8 *)(msg + 1) + i * FRAG_CHUNK) - 1;
+        save = *frag;
+
+        *frag = hdr;
+        frag->reserved1 = RPMSG_MESSAGEQ_FRAGHDR(tag, i, count);
+
+        status = RPMessage_send(obj->remoteProcId, dstAddr,
+                RPMSG_MESSAGEQ_PORT, frag, sizeof(MessageQ_MsgHeader) + len);
+
+        *frag = save;
+    }
+
+    return (status == RPMessage_S_SUCCESS? TRUE: FALSE);
+}
+#undef FXNN
+
+/*
+ *  ======== reassemble ========
+ *  Copy a fragment into the message it belongs to, found by its sender
+ *  and tag.  Returns the message once its last fragment is in, NULL
+ *  otherwise.  A message with a fragment missing is dropped, as is the
+ *  oldest message under reassembly when all slots are taken.
+ */
+#define FXNN "reassemble"
+static MessageQ_Msg reassemble(MessageQ_Msg frag, UInt16 dataLen,
+                                      UInt32 srcAddr)
+{
+    Reassembly * slot = NULL;
+    MessageQ_Msg msg = NULL;
+    UInt32       hdr = frag->reserved1;
+    UInt32       msgSize = MessageQ_getMsgSize(frag);
+    UInt32       len;
+    UInt16       tag = RPMSG_MESSAGEQ_FRAGTAG(hdr);
+    UInt         index = RPMSG_MESSAGEQ_FRAGINDEX(hdr);
+    UInt         count = RPMSG_MESSAGEQ_FRAGCOUNT(hdr);
+    UInt16       heapId;
+    Int          i;
+
+    if (dataLen < sizeof(MessageQ_MsgHeader)) {
+        return (NULL);
+    }
+    len = dataLen - sizeof(MessageQ_MsgHeader);
+
+    for (i = 0; i < NUM_REASSEMBLY; i++) {
+        if (reassembly[i].msg != NULL && reassembly[i].srcAddr == srcAddr &&
+                reassembly[i].tag == tag) {
+            slot = &reassembly[i];
+            break;
+        }
+    }
+
+    if (index == 0) {
+        if (slot != NULL) {
+            /* restarts a message that never completed */
+            MessageQ_free(slot->msg);
+            slot->msg = NULL;
+        }
+        else {
+            /* take a free slot, or else the oldest */
+            slot = &reassembly[0];
+            for (i = 0; i < NUM_REASSEMBLY; i++) {
+                if (reassembly[i].msg == NULL) {
+                    slot = &reassembly[i];
+                    break;
+                }
+                if (reassembly[i].age < slot->age) {
+                    slot = &reassembly[i];
+                }
+            }
+            if (slot->msg != NULL) {
+                Log_print2(Diags_USER1, FXNN": dropping message from: %d, "
+                        "tag: %d", (IArg)slot->srcAddr, (IArg)slot->tag);
+                MessageQ_free(slot->msg);
+                slot->msg = NULL;
+            }
+        }
+
+        /* every fragment but the last is full, so the sizes must agree */
+        if (len == 0 || len > FRAG_CHUNK ||
+                msgSize <= sizeof(MessageQ_MsgHeader) + (count - 1) * len ||
+                msgSize > sizeof(MessageQ_MsgHeader) + count * len) {
+            Log_print1(Diags_USER1, FXNN": bad fragment from: %d",
+                    (IArg)srcAddr);
+            return (NULL);
+        }
+
+        /* for a copy transport, a static message arrives in heap 0 */
+        heapId = frag->heapId;
+        if (heapId == ti_sdo_ipc_MessageQ_STATICMSG) {
+            heapId = 0;
+        }
+
+        slot->msg = MessageQ_alloc(heapId, msgSize);
+        if (slot->msg == NULL) {
+            Log_print1(Diags_USER1, FXNN": no memory for message from: %d",
+                    (IArg)srcAddr);
+            return (NULL);
+        }
+
+        slot->srcAddr = srcAddr;
+        slot->tag     = tag;
+        slot->next    = 0;
+        slot->count   = count;
+        slot->chunk   = len;
+        slot->size    = sizeof(MessageQ_MsgHeader);
+        slot->age     = ++reassemblyAge;
+
+        memcpy(slot->msg, frag, sizeof(MessageQ_MsgHeader));
+        slot->msg->heapId    = heapId;
+        slot->msg->flags    &= ~RPMSG_MESSAGEQ_FRAGFLAG;
+        slot->msg->reserved1 = 0;
+    }
+    else if (slot == NULL) {
+        /* the head of this message was dropped, so is the rest */
+        return (NULL);
+    }
+
+    if (index != slot->next || count != slot->count || len > slot->chunk ||
+            (index + 1 < count ? len < slot->chunk :
+             slot->size + len != MessageQ_getMsgSize(slot->msg))) {
+        Log_print2(Diags_USER1, FXNN": fragment missing from: %d, tag: %d",
+                (IArg)srcAddr, (IArg)tag);
+        MessageQ_free(slot->msg);
+        slot->msg = NULL;
+        return (NULL);
+    }
+
+    memcpy((UInt8 *)slot->msg + slot->size, frag + 1, len);
+    slot->size += len;
+
+    if (++slot->next == slot->count) {
+        msg = slot->msg;
+        slot->msg = NULL;
+    }
+
+    return (msg);
+}
+#undef FXNN
+
 /*
  *  ======== TransportRpmsg_setErrFxn ========
  */
@@ -40,6 +40,7 @@ function module$use()
 {
     xdc.useModule("ti.sdo.utils.MultiProc");
     xdc.useModule("ti.sdo.ipc.MessageQ");
+    xdc.useModule("ti.sysbios.hal.Hwi");
     xdc.useModule("ti.ipc.transports.TransportRpmsgSetup");
     xdc.loadPackage("ti.ipc.namesrv");
     xdc.loadPackage("ti.ipc.rpmsg");
@@ -40,6 +40,22 @@ extern "C" {
 /* That special per processor RPMSG channel reserved to multiplex MessageQ */
 #define RPMSG_MESSAGEQ_PORT         61
 
+/*
+ * Messages larger than one rpmsg buffer travel as a train of fragments.
+ * Each fragment is a copy of the message header, marked with FRAGFLAG,
+ * followed by the next piece of the payload.  reserved1 of the copy holds
+ * the sender's tag for the message, the fragment index and the number of
+ * fragments.  Must match linux/src/api/TransportRpmsg.c.
+ */
+#define RPMSG_MESSAGEQ_FRAGFLAG     0x0800
+#define RPMSG_MESSAGEQ_MAXFRAGS     255
+
+#define RPMSG_MESSAGEQ_FRAGHDR(tag, index, count) \
+    (((UInt32)(tag) << 16) | ((UInt32)(index) << 8) | (UInt32)(count))
+#define RPMSG_MESSAGEQ_FRAGTAG(r)   ((UInt16)((r) >> 16))
+#define RPMSG_MESSAGEQ_FRAGINDEX(r) (((r) >> 8) & 0xFF)
+#define RPMSG_MESSAGEQ_FRAGCOUNT(r) ((r) & 0xFF)
+
 #if defined (__cplusplus)
 }
 #endif /* defined (__cplusplus) */
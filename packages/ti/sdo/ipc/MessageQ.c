@@ -49,7 +49,11 @@
 #include <xdc/runtime/knl/ISync.h>
 #include <xdc/runtime/knl/GateThread.h>
 
+#include <ti/sysbios/BIOS.h>
 #include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Task.h>
 #include <ti/sysbios/syncs/SyncSem.h>
 
 #include <ti/sdo/ipc/interfaces/IMessageQTransport.h>
@@ -72,11 +76,13 @@
     #pragma FUNC_EXT_CALLED(MessageQ_create2);
     #pragma FUNC_EXT_CALLED(MessageQ_delete);
     #pragma FUNC_EXT_CALLED(MessageQ_open);
+    #pragma FUNC_EXT_CALLED(MessageQ_openWait);
     #pragma FUNC_EXT_CALLED(MessageQ_openQueueId);
     #pragma FUNC_EXT_CALLED(MessageQ_free);
     #pragma FUNC_EXT_CALLED(MessageQ_get);
     #pragma FUNC_EXT_CALLED(MessageQ_getQueueId);
     #pragma FUNC_EXT_CALLED(MessageQ_put);
+    #pragma FUNC_EXT_CALLED(MessageQ_putWait);
     #pragma FUNC_EXT_CALLED(MessageQ_registerHeap);
     #pragma FUNC_EXT_CALLED(MessageQ_setFreeHookFxn);
     #pragma FUNC_EXT_CALLED(MessageQ_setReplyQueue);
@@ -108,6 +114,431 @@ static Void MessageQ_msgInit(MessageQ_Msg msg)
     Hwi_restore(key);
 }
 
+/*
+ *  Atomic operations for MessageQ.lockFreeQueues.  Without them, a put
+ *  does the same under Hwi_disable(), so no reader ever sees it half done.
+ */
+#if defined(__GNUC__) && !defined(__TI_COMPILER_VERSION__)
+#define MessageQ_ATOMICS
+#define MessageQ_load(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#else
+#define MessageQ_load(p)        (*(p))
+#endif
+
+/*
+ *  ======== MessageQ_fifoPut ========
+ *  Any thread may put.  The message is only linked to the queue once it
+ *  is made its head, so a reader can briefly find the queue cut short;
+ *  it is signaled again once the put is done.
+ */
+static Void MessageQ_fifoPut(ti_sdo_ipc_MessageQ_Fifo *fifo, List_Elem *elem)
+{
+#ifdef MessageQ_ATOMICS
+    List_Elem *prev;
+
+    elem->next = NULL;
+    prev = __atomic_exchange_n(&fifo->head, elem, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, elem, __ATOMIC_RELEASE);
+#else
+    UInt key;
+
+    elem->next = NULL;
+    key = Hwi_disable();
+    fifo->head->next = elem;
+    fifo->head = elem;
+    Hwi_restore(key);
+#endif
+}
+
+/*
+ *  ======== MessageQ_fifoGet ========
+ *  Only the MessageQ's reader may get.
+ */
+static List_Elem *MessageQ_fifoGet(ti_sdo_ipc_MessageQ_Fifo *fifo)
+{
+    List_Elem *tail = fifo->tail;
+    List_Elem *next = MessageQ_load(&tail->next);
+
+    /* skip the stub */
+    if (tail == &fifo->stub) {
+        if (next == NULL) {
+            return (NULL);
+        }
+        fifo->tail = next;
+        tail = next;
+        next = MessageQ_load(&tail->next);
+    }
+
+    if (next != NULL) {
+        fifo->tail = next;
+        return (tail);
+    }
+
+    /* a put is half done, and will signal when it is not */
+    if (tail != MessageQ_load(&fifo->head)) {
+        return (NULL);
+    }
+
+    /* tail is the last msg; put the stub back behind it to take it */
+    MessageQ_fifoPut(fifo, &fifo->stub);
+    next = MessageQ_load(&tail->next);
+    if (next != NULL) {
+        fifo->tail = next;
+        return (tail);
+    }
+
+    return (NULL);
+}
+
+/*
+ *  ======== MessageQ_enqueue ========
+ *  Put a local message on its MessageQ by priority.  An urgent message
+ *  is received before any other, the last one first.
+ */
+static Void MessageQ_enqueue(ti_sdo_ipc_MessageQ_Object *obj,
+    MessageQ_Msg msg)
+{
+    List_Handle listHandle;
+    List_Elem  *elem = (List_Elem *)msg;
+#ifdef MessageQ_ATOMICS
+    List_Elem  *top;
+#else
+    UInt        key;
+#endif
+
+    if (!ti_sdo_ipc_MessageQ_lockFreeQueues) {
+        if ((msg->flags & MessageQ_PRIORITYMASK) == MessageQ_URGENTPRI) {
+            listHandle = ti_sdo_ipc_MessageQ_Instance_State_highList(obj);
+            List_putHead(listHandle, elem);
+        }
+        else {
+            if ((msg->flags & MessageQ_PRIORITYMASK) == MessageQ_NORMALPRI) {
+                listHandle = ti_sdo_ipc_MessageQ_Instance_State_normalList(obj);
+            }
+            else {
+                listHandle = ti_sdo_ipc_MessageQ_Instance_State_highList(obj);
+            }
+            /* put on the queue */
+            List_put(listHandle, elem);
+        }
+        return;
+    }
+
+    /*
+     * Counted before it is linked, so the reader can't get it and count it
+     * got first, and MessageQ_count() never goes below zero.
+     */
+#ifdef MessageQ_ATOMICS
+    __atomic_fetch_add(&obj->numPut, 1, __ATOMIC_RELAXED);
+#else
+    key = Hwi_disable();
+    obj->numPut++;
+    Hwi_restore(key);
+#endif
+
+    if ((msg->flags & MessageQ_PRIORITYMASK) == MessageQ_URGENTPRI) {
+#ifdef MessageQ_ATOMICS
+        top = MessageQ_load(&obj->urgent);
+        do {
+            elem->next = top;
+        } while (!__atomic_compare_exchange_n(&obj->urgent, &top, elem, TRUE,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#else
+        key = Hwi_disable();
+        elem->next = obj->urgent;
+        obj->urgent = elem;
+        Hwi_restore(key);
+#endif
+    }
+    else if ((msg->flags & MessageQ_PRIORITYMASK) == MessageQ_NORMALPRI) {
+        MessageQ_fifoPut(&obj->normalFifo, elem);
+    }
+    else {
+        MessageQ_fifoPut(&obj->highFifo, elem);
+    }
+}
+
+/*
+ *  ======== MessageQ_dequeue ========
+ *  Take the next message from a local MessageQ, NULL if there is none.
+ *  Only the MessageQ's reader may call this.
+ */
+static MessageQ_Msg MessageQ_dequeue(ti_sdo_ipc_MessageQ_Object *obj)
+{
+    List_Elem *elem;
+    List_Elem *last;
+#ifndef MessageQ_ATOMICS
+    UInt       key;
+#endif
+
+    if (!ti_sdo_ipc_MessageQ_lockFreeQueues) {
+        elem = List_get(ti_sdo_ipc_MessageQ_Instance_State_highList(obj));
+        if (elem == NULL) {
+            elem = List_get(ti_sdo_ipc_MessageQ_Instance_State_normalList(obj));
+        }
+        return ((MessageQ_Msg)elem);
+    }
+
+    /* urgent msgs put since the last get go before the older ones */
+    if (MessageQ_load(&obj->urgent) != NULL) {
+#ifdef MessageQ_ATOMICS
+        elem = __atomic_exchange_n(&obj->urgent, NULL, __ATOMIC_ACQUIRE);
+#else
+        key = Hwi_disable();
+        elem = obj->urgent;
+        obj->urgent = NULL;
+        Hwi_restore(key);
+#endif
+        for (last = elem; last->next != NULL; last = last->next) {
+        }
+        last->next = obj->urgentList;
+        obj->urgentList = elem;
+    }
+
+    elem = obj->urgentList;
+    if (elem != NULL) {
+        obj->urgentList = elem->next;
+    }
+    else {
+        elem = MessageQ_fifoGet(&obj->highFifo);
+        if (elem == NULL) {
+            elem = MessageQ_fifoGet(&obj->normalFifo);
+        }
+    }
+
+    if (elem != NULL) {
+        obj->numGot++;
+    }
+
+    return ((MessageQ_Msg)elem);
+}
+
+/*
+ *  ======== MessageQ_credit ========
+ *  The record of the credits left for a remote queue, or NULL.  If
+ *  create is TRUE, one is made with creditWindow credits the first time
+ *  MessageQ_putWait() sends to the queue.
+ */
+static ti_sdo_ipc_MessageQ_Credit *MessageQ_credit(MessageQ_QueueId queueId,
+    Bool create)
+{
+    ti_sdo_ipc_MessageQ_Credit *credit;
+    ti_sdo_ipc_MessageQ_Credit *made = NULL;
+    Error_Block eb;
+    UInt key;
+
+    for (;;) {
+        key = Hwi_disable();
+        credit = (ti_sdo_ipc_MessageQ_Credit *)MessageQ_module->credits;
+        while ((credit != NULL) && (credit->queue != queueId)) {
+            credit = (ti_sdo_ipc_MessageQ_Credit *)credit->next;
+        }
+        if ((credit == NULL) && (made != NULL)) {
+            made->next = MessageQ_module->credits;
+            MessageQ_module->credits = made;
+            credit = made;
+            made = NULL;
+        }
+        Hwi_restore(key);
+
+        if ((credit != NULL) || (create == FALSE)) {
+            break;
+        }
+
+        /* made outside the lock, then looked for again */
+        Error_init(&eb);
+        made = Memory_alloc(ti_sdo_ipc_MessageQ_Object_heap(),
+                sizeof(ti_sdo_ipc_MessageQ_Credit), 0, &eb);
+        if (made == NULL) {
+            break;
+        }
+        made->queue = queueId;
+        made->sem = Semaphore_create(ti_sdo_ipc_MessageQ_creditWindow, NULL,
+                &eb);
+        if (made->sem == NULL) {
+            Memory_free(ti_sdo_ipc_MessageQ_Object_heap(), made,
+                    sizeof(ti_sdo_ipc_MessageQ_Credit));
+            made = NULL;
+            break;
+        }
+    }
+
+    /* another task made the record first */
+    if (made != NULL) {
+        Semaphore_delete(&made->sem);
+        Memory_free(ti_sdo_ipc_MessageQ_Object_heap(), made,
+                sizeof(ti_sdo_ipc_MessageQ_Credit));
+    }
+
+    return (credit);
+}
+
+/*
+ *  ======== MessageQ_replyQueue ========
+ *  The local queue msg names as its reply queue, or NULL.
+ */
+static ti_sdo_ipc_MessageQ_Object *MessageQ_replyQueue(MessageQ_Msg msg)
+{
+    MessageQ_QueueIndex slot = msg->replyId & ti_sdo_ipc_MessageQ_SLOTMASK;
+    ti_sdo_ipc_MessageQ_Object *obj;
+
+    if ((msg->replyProc != MultiProc_self()) ||
+        (msg->replyId == (UInt16)MessageQ_INVALIDMESSAGEQ) ||
+        (slot >= MessageQ_module->numQueues)) {
+        return (NULL);
+    }
+
+    obj = MessageQ_module->queues[slot];
+    if ((obj != NULL) && (((UInt16)(obj->queue) != msg->replyId) ||
+        (obj->creditsOwed == NULL))) {
+        obj = NULL;
+    }
+
+    return (obj);
+}
+
+/*
+ *  ======== MessageQ_repay ========
+ *  Put on msg, bound for procId, the credits its reply queue owes there.
+ */
+static Void MessageQ_repay(MessageQ_Msg msg, UInt16 procId)
+{
+    ti_sdo_ipc_MessageQ_Object *obj;
+    UInt16 owed;
+    UInt key;
+
+    obj = MessageQ_replyQueue(msg);
+    if ((obj == NULL) || (obj->creditsOwed[procId] == 0)) {
+        return;
+    }
+
+    key = Hwi_disable();
+    owed = obj->creditsOwed[procId];
+    if (owed > ti_sdo_ipc_MessageQ_WINDOWMASK) {
+        owed = ti_sdo_ipc_MessageQ_WINDOWMASK;
+    }
+    obj->creditsOwed[procId] -= owed;
+    Hwi_restore(key);
+
+    if (owed > 0) {
+        msg->flags |= ti_sdo_ipc_MessageQ_CREDITSFLAG;
+        msg->reserved = (msg->reserved & ti_sdo_ipc_MessageQ_WINDOWMASK) |
+                (owed << ti_sdo_ipc_MessageQ_CREDITSSHIFT);
+    }
+}
+
+/*
+ *  ======== MessageQ_unpay ========
+ *  msg could not be sent to procId, so its reply queue owes the credits
+ *  on it again.
+ */
+static Void MessageQ_unpay(MessageQ_Msg msg, UInt16 procId)
+{
+    ti_sdo_ipc_MessageQ_Object *obj;
+    UInt key;
+
+    msg->flags &= ~ti_sdo_ipc_MessageQ_CREDITSFLAG;
+
+    obj = MessageQ_replyQueue(msg);
+    if (obj != NULL) {
+        key = Hwi_disable();
+        obj->creditsOwed[procId] +=
+                msg->reserved >> ti_sdo_ipc_MessageQ_CREDITSSHIFT;
+        Hwi_restore(key);
+    }
+}
+
+/*
+ *  ======== MessageQ_owe ========
+ *  The reader got msg, sent by MessageQ_putWait(), so its sender is owed
+ *  a credit.  Credits go back on the messages to the sender's processor
+ *  that name this queue as the reply queue.  Once half the sender's
+ *  window is owed, they go back in a message of their own.
+ */
+static Void MessageQ_owe(ti_sdo_ipc_MessageQ_Object *obj, MessageQ_Msg msg)
+{
+    UInt16 procId = msg->srcProc;
+    UInt16 heapId = msg->heapId;
+    UInt16 owed;
+    UInt key;
+    MessageQ_Msg credits;
+
+    /* msg may be passed on, and must not be counted twice */
+    msg->flags &= ~ti_sdo_ipc_MessageQ_CREDITFLAG;
+
+    if ((procId >= ti_sdo_utils_MultiProc_numProcessors) ||
+        (procId == MultiProc_self())) {
+        return;
+    }
+
+    /* with no creditWindow here, each credit goes back on its own */
+    if (obj->creditsOwed != NULL) {
+        key = Hwi_disable();
+        owed = ++obj->creditsOwed[procId];
+        Hwi_restore(key);
+
+        if (owed < (msg->reserved & ti_sdo_ipc_MessageQ_WINDOWMASK) / 2) {
+            return;
+        }
+    }
+
+    if ((heapId >= MessageQ_module->numHeaps) ||
+        (MessageQ_module->heaps[heapId] == NULL)) {
+        return;
+    }
+
+    /* if this fails, the next get tries again; a lone credit is lost */
+    credits = MessageQ_alloc(heapId, sizeof(MessageQ_MsgHeader));
+    if (credits == NULL) {
+        return;
+    }
+
+    MessageQ_setReplyQueue((MessageQ_Handle)obj, credits);
+    if (obj->creditsOwed != NULL) {
+        MessageQ_repay(credits, procId);
+    }
+    else {
+        credits->flags |= ti_sdo_ipc_MessageQ_CREDITSFLAG;
+        credits->reserved = 1 << ti_sdo_ipc_MessageQ_CREDITSSHIFT;
+    }
+
+    /* no destination queue: the receiving MessageQ frees it */
+    if (((credits->flags & ti_sdo_ipc_MessageQ_CREDITSFLAG) == 0) ||
+        (MessageQ_put(MessageQ_openQueueId(
+            (UInt16)MessageQ_INVALIDMESSAGEQ, procId), credits) < 0)) {
+        MessageQ_free(credits);
+    }
+}
+
+/*
+ *  ======== MessageQ_takeCredits ========
+ *  Give MessageQ_putWait() the credits msg returns for its reply queue.
+ *  FALSE if msg only returned credits, and has been freed.
+ */
+static Bool MessageQ_takeCredits(MessageQ_Msg msg)
+{
+    ti_sdo_ipc_MessageQ_Credit *credit;
+    UInt n;
+
+    msg->flags &= ~ti_sdo_ipc_MessageQ_CREDITSFLAG;
+
+    credit = MessageQ_credit(((MessageQ_QueueId)(msg->replyProc) << 16) |
+            msg->replyId, FALSE);
+    if (credit != NULL) {
+        for (n = msg->reserved >> ti_sdo_ipc_MessageQ_CREDITSSHIFT; n > 0;
+                n--) {
+            Semaphore_post(credit->sem);
+        }
+    }
+
+    if (msg->dstId == (UInt16)MessageQ_INVALIDMESSAGEQ) {
+        MessageQ_free(msg);
+        return (FALSE);
+    }
+
+    return (TRUE);
+}
+
 /*
  *************************************************************************
  *                       Common Header Functions
@@ -180,6 +611,12 @@ Int MessageQ_count(MessageQ_Handle handle)
     List_Handle      listHandle;
     ti_sdo_ipc_MessageQ_Object *obj = (ti_sdo_ipc_MessageQ_Object *)handle;
 
+    if (ti_sdo_ipc_MessageQ_lockFreeQueues) {
+        /* a task other than the reader may see numGot ahead of numPut */
+        count = (Int)(MessageQ_load(&obj->numPut) - obj->numGot);
+        return (count < 0 ? 0 : count);
+    }
+
     /* lock */
     key = Hwi_disable();
 
@@ -325,35 +762,57 @@ Int MessageQ_free(MessageQ_Msg msg)
 Int MessageQ_get(MessageQ_Handle handle, MessageQ_Msg *msg, UInt timeout)
 {
     Int status;
-    List_Handle highList;
-    List_Handle normalList;
     ti_sdo_ipc_MessageQ_Object *obj = (ti_sdo_ipc_MessageQ_Object *)handle;
 
-    /* Get the list */
-    normalList = ti_sdo_ipc_MessageQ_Instance_State_normalList(obj);
-    highList   = ti_sdo_ipc_MessageQ_Instance_State_highList(obj);
-
     /* Keep looping while there are no elements on either list */
-    *msg = (MessageQ_Msg)List_get(highList);
+    *msg = MessageQ_dequeue(obj);
     while (*msg == NULL) {
-        *msg = (MessageQ_Msg)List_get(normalList);
-        if (*msg == NULL) {
-            /*  Block until notified. */
-            status = ISync_wait(obj->synchronizer, timeout, NULL);
-            if (status == ISync_WaitStatus_TIMEOUT) {
-                return (MessageQ_E_TIMEOUT);
-            }
-            else if (status < 0) {
-                return (MessageQ_E_FAIL);
-            }
-
-            if (obj->unblocked) {
-                /* *(msg) may be NULL */
-                return (MessageQ_E_UNBLOCKED);
-            }
+        /*  Block until notified. */
+        status = ISync_wait(obj->synchronizer, timeout, NULL);
+        if (status == ISync_WaitStatus_TIMEOUT) {
+            return (MessageQ_E_TIMEOUT);
+        }
+        else if (status < 0) {
+            return (MessageQ_E_FAIL);
+        }
 
-            *msg = (MessageQ_Msg)List_get(highList);
+        if (obj->unblocked) {
+            /* *(msg) may be NULL */
+            return (MessageQ_E_UNBLOCKED);
         }
+
+        *msg = MessageQ_dequeue(obj);
+    }
+
+    if (((*msg)->flags & ti_sdo_ipc_MessageQ_CREDITFLAG) != 0) {
+        MessageQ_owe(obj, *msg);
+    }
+
+    if ((ti_sdo_ipc_MessageQ_traceFlag == TRUE) ||
+        (((*msg)->flags & ti_sdo_ipc_MessageQ_TRACEMASK) != 0)) {
+        Log_write4(ti_sdo_ipc_MessageQ_LM_get, (UArg)(*msg),
+            (UArg)((*msg)->seqNum), (UArg)((*msg)->srcProc), (UArg)(obj));
+    }
+
+    return (MessageQ_S_SUCCESS);
+}
+
+/*
+ *  ======== MessageQ_tryGet ========
+ *  Takes a message only if one is already queued, without waiting on the
+ *  synchronizer.
+ */
+Int MessageQ_tryGet(MessageQ_Handle handle, MessageQ_Msg *msg)
+{
+    ti_sdo_ipc_MessageQ_Object *obj = (ti_sdo_ipc_MessageQ_Object *)handle;
+
+    *msg = MessageQ_dequeue(obj);
+    if (*msg == NULL) {
+        return (obj->unblocked ? MessageQ_E_UNBLOCKED : MessageQ_E_TIMEOUT);
+    }
+
+    if (((*msg)->flags & ti_sdo_ipc_MessageQ_CREDITFLAG) != 0) {
+        MessageQ_owe(obj, *msg);
     }
 
     if ((ti_sdo_ipc_MessageQ_traceFlag == TRUE) ||
@@ -365,6 +824,46 @@ Int MessageQ_get(MessageQ_Handle handle, MessageQ_Msg *msg, UInt timeout)
     return (MessageQ_S_SUCCESS);
 }
 
+/*
+ *  ======== MessageQ_getMany ========
+ *  Blocks in MessageQ_get() for the first message, then takes whatever
+ *  else is already queued without waiting on the synchronizer again.
+ */
+Int MessageQ_getMany(MessageQ_Handle handle, MessageQ_Msg msgs[],
+    UInt maxMsgs, UInt timeout)
+{
+    Int status;
+    UInt count;
+    ti_sdo_ipc_MessageQ_Object *obj = (ti_sdo_ipc_MessageQ_Object *)handle;
+
+    Assert_isTrue((maxMsgs > 0), ti_sdo_ipc_MessageQ_A_invalidParam);
+
+    status = MessageQ_get(handle, &msgs[0], timeout);
+    if (status < 0) {
+        return (status);
+    }
+
+    for (count = 1; count < maxMsgs; count++) {
+        msgs[count] = MessageQ_dequeue(obj);
+        if (msgs[count] == NULL) {
+            break;
+        }
+
+        if ((msgs[count]->flags & ti_sdo_ipc_MessageQ_CREDITFLAG) != 0) {
+            MessageQ_owe(obj, msgs[count]);
+        }
+
+        if ((ti_sdo_ipc_MessageQ_traceFlag == TRUE) ||
+            ((msgs[count]->flags & ti_sdo_ipc_MessageQ_TRACEMASK) != 0)) {
+            Log_write4(ti_sdo_ipc_MessageQ_LM_get, (UArg)(msgs[count]),
+                (UArg)(msgs[count]->seqNum), (UArg)(msgs[count]->srcProc),
+                (UArg)(obj));
+        }
+    }
+
+    return ((Int)count);
+}
+
 /*
  *  ======== MessageQ_getQueueId ========
  */
@@ -404,6 +903,79 @@ Int MessageQ_open(String name, MessageQ_QueueId *queueId)
     }
 }
 
+/*
+ *  ======== MessageQ_openWait ========
+ *  Remote drivers don't say when a name is added, so look once a tick.
+ */
+Int MessageQ_openWait(String name, MessageQ_QueueId *queueId, UInt timeout)
+{
+    Int    status;
+    UInt32 start = Clock_getTicks();
+
+    while ((status = MessageQ_open(name, queueId)) == MessageQ_E_NOTFOUND) {
+        if (timeout != MessageQ_FOREVER &&
+            (Clock_getTicks() - start) * Clock_tickPeriod >= timeout) {
+            return (MessageQ_E_TIMEOUT);
+        }
+
+        Task_sleep(1);
+    }
+
+    return (status);
+}
+
+/*
+ *  ======== MessageQ_transport ========
+ *  The transport a message to a remote processor goes through: the one
+ *  for its priority, else the other one.
+ */
+static IMessageQTransport_Handle MessageQ_transport(UInt16 dstProcId,
+    MessageQ_Msg msg)
+{
+    IMessageQTransport_Handle transport;
+    UInt priority;
+
+    /* Put the high and urgent messages to the high priority transport */
+    priority = (UInt)((msg->flags) &
+        ti_sdo_ipc_MessageQ_TRANSPORTPRIORITYMASK);
+
+    /* Call the transport associated with this message queue */
+    transport = MessageQ_module->transports[dstProcId][priority];
+    if (transport == NULL) {
+        /* Try the other transport */
+        priority = !priority;
+        transport = MessageQ_module->transports[dstProcId][priority];
+    }
+
+    return (transport);
+}
+
+/*
+ *  ======== MessageQ_lookup ========
+ *  Find the local queue a queueId refers to.  NULL if there is none, or
+ *  it was deleted, even when its slot now holds another queue.  A stale
+ *  queueId isn't asserted on: it can come in from a remote processor at
+ *  any time, and the callers report it as MessageQ_E_FAIL, which the
+ *  transports rely on to free the message.
+ */
+static ti_sdo_ipc_MessageQ_Object *MessageQ_lookup(MessageQ_QueueId queueId)
+{
+    MessageQ_QueueIndex slot;
+    ti_sdo_ipc_MessageQ_Object *obj;
+
+    slot = (MessageQ_QueueIndex)queueId & ti_sdo_ipc_MessageQ_SLOTMASK;
+    if (slot >= MessageQ_module->numQueues) {
+        return (NULL);
+    }
+
+    obj = MessageQ_module->queues[slot];
+    if ((obj != NULL) && ((UInt16)(obj->queue) != (UInt16)(queueId))) {
+        obj = NULL;
+    }
+
+    return (obj);
+}
+
 /*
  *  ======== MessageQ_openQueueId ========
  */
@@ -423,9 +995,7 @@ Int MessageQ_put(MessageQ_QueueId queueId, MessageQ_Msg msg)
 {
     IMessageQTransport_Handle transport;
     MessageQ_QueueIndex dstProcId = (MessageQ_QueueIndex)(queueId >> 16);
-    List_Handle       listHandle;
     Int               status;
-    UInt              priority;
 #ifndef xdc_runtime_Log_DISABLE_ALL
     UInt16            flags;
     UInt16            seqNum;
@@ -443,22 +1013,17 @@ Int MessageQ_put(MessageQ_QueueId queueId, MessageQ_Msg msg)
         Assert_isTrue(dstProcId < ti_sdo_utils_MultiProc_numProcessors,
                       ti_sdo_ipc_MessageQ_A_procIdInvalid);
 
-        /* Put the high and urgent messages to the high priority transport */
-        priority = (UInt)((msg->flags) &
-            ti_sdo_ipc_MessageQ_TRANSPORTPRIORITYMASK);
-
-        /* Call the transport associated with this message queue */
-        transport = MessageQ_module->transports[dstProcId][priority];
-        if (transport == NULL) {
-            /* Try the other transport */
-            priority = !priority;
-            transport = MessageQ_module->transports[dstProcId][priority];
-        }
+        transport = MessageQ_transport(dstProcId, msg);
 
         /* assert transport is not null */
         Assert_isTrue(transport != NULL,
             ti_sdo_ipc_MessageQ_A_unregisteredTransport);
 
+        /* credits the reply queue owes dstProcId go along */
+        if ((msg->flags & ti_sdo_ipc_MessageQ_CREDITSFLAG) == 0) {
+            MessageQ_repay(msg, dstProcId);
+        }
+
 #ifndef xdc_runtime_Log_DISABLE_ALL
         /* use local vars so msg does not get cached after put */
         flags = msg->flags;
@@ -486,47 +1051,188 @@ Int MessageQ_put(MessageQ_QueueId queueId, MessageQ_Msg msg)
 #endif
         }
         else {
+            if ((msg->flags & ti_sdo_ipc_MessageQ_CREDITSFLAG) != 0) {
+                MessageQ_unpay(msg, dstProcId);
+            }
             status = MessageQ_E_FAIL;
         }
     }
     else {
-        /* Assert queueId is valid */
-        Assert_isTrue((UInt16)queueId < MessageQ_module->numQueues,
-                      ti_sdo_ipc_MessageQ_A_invalidQueueId);
+        /* Returned credits are taken even if the queue is gone */
+        if (((msg->flags & ti_sdo_ipc_MessageQ_CREDITSFLAG) != 0) &&
+            (MessageQ_takeCredits(msg) == FALSE)) {
+            return (MessageQ_S_SUCCESS);
+        }
 
         /* It is a local MessageQ */
-        obj = MessageQ_module->queues[(UInt16)(queueId)];
-
-        /* Assert object is not NULL */
-        Assert_isTrue(obj != NULL, ti_sdo_ipc_MessageQ_A_invalidObj);
+        obj = MessageQ_lookup(queueId);
+        if (obj == NULL) {
+            /* deleted, and maybe its slot reused: don't deliver */
+            return (MessageQ_E_FAIL);
+        }
 
-        if ((msg->flags & MessageQ_PRIORITYMASK) == MessageQ_URGENTPRI) {
-            listHandle = ti_sdo_ipc_MessageQ_Instance_State_highList(obj);
-            List_putHead(listHandle, (List_Elem *)msg);
+        /* trace first: the reader may take msg as soon as it is queued */
+        if ((ti_sdo_ipc_MessageQ_traceFlag) ||
+            (msg->flags & ti_sdo_ipc_MessageQ_TRACEMASK) != 0) {
+            Log_write4(ti_sdo_ipc_MessageQ_LM_putLocal, (UArg)(msg),
+                       (UArg)(msg->seqNum), (UArg)(msg->srcProc), (UArg)(obj));
         }
-        else {
-            if ((msg->flags & MessageQ_PRIORITYMASK) == MessageQ_NORMALPRI) {
-                listHandle = ti_sdo_ipc_MessageQ_Instance_State_normalList(obj);
+
+        MessageQ_enqueue(obj, msg);
+
+        ISync_signal(obj->synchronizer);
+
+        status = MessageQ_S_SUCCESS;
+    }
+
+    return (status);
+}
+
+/*
+ *  ======== MessageQ_putWait ========
+ *  A message to a remote queue first takes one of the queue's credits,
+ *  waiting for the receiver to return one if none are left.
+ */
+Int MessageQ_putWait(MessageQ_QueueId queueId, MessageQ_Msg msg, UInt timeout)
+{
+    ti_sdo_ipc_MessageQ_Credit *credit;
+    UInt32 ticks;
+    Int    status;
+
+    if ((ti_sdo_ipc_MessageQ_creditWindow == 0) ||
+        ((UInt16)(queueId >> 16) == MultiProc_self())) {
+        return (MessageQ_put(queueId, msg));
+    }
+
+    credit = MessageQ_credit(queueId, TRUE);
+    if (credit == NULL) {
+        return (MessageQ_E_MEMORY);
+    }
+
+    /* timeout is in microseconds, rounded up to ticks */
+    if (timeout == MessageQ_FOREVER) {
+        ticks = BIOS_WAIT_FOREVER;
+    }
+    else {
+        ticks = (timeout / Clock_tickPeriod) +
+                ((timeout % Clock_tickPeriod) != 0);
+    }
+
+    if (!Semaphore_pend(credit->sem, ticks)) {
+        return (MessageQ_E_TIMEOUT);
+    }
+
+    msg->flags |= ti_sdo_ipc_MessageQ_CREDITFLAG;
+    msg->reserved = ti_sdo_ipc_MessageQ_creditWindow;
+
+    status = MessageQ_put(queueId, msg);
+    if (status < 0) {
+        /* the caller keeps msg, and the credit wasn't used */
+        msg->flags &= ~ti_sdo_ipc_MessageQ_CREDITFLAG;
+        Semaphore_post(credit->sem);
+    }
+
+    return (status);
+}
+
+/*
+ *  ======== MessageQ_putMany ========
+ *  Local bursts are queued under one pass and the synchronizer is
+ *  signaled once.  Remote bursts are handed to the transport's putMany,
+ *  one run of messages bound for the same transport at a time, and stop
+ *  at the first message a transport doesn't accept.
+ */
+Int MessageQ_putMany(MessageQ_QueueId queueId, MessageQ_Msg msgs[],
+    UInt numMsgs)
+{
+    MessageQ_QueueIndex dstProcId = (MessageQ_QueueIndex)(queueId >> 16);
+    IMessageQTransport_Handle transport;
+    MessageQ_Msg      msg;
+    UInt              i;
+    UInt              run;
+    UInt              done;
+    ti_sdo_ipc_MessageQ_Object   *obj;
+
+    Assert_isTrue((msgs != NULL), ti_sdo_ipc_MessageQ_A_invalidMsg);
+
+    if (dstProcId != MultiProc_self()) {
+        /* assert that dstProcId is valid */
+        Assert_isTrue(dstProcId < ti_sdo_utils_MultiProc_numProcessors,
+                      ti_sdo_ipc_MessageQ_A_procIdInvalid);
+
+        i = 0;
+        while (i < numMsgs) {
+            /* find the run of msgs using the same transport as msgs[i] */
+            transport = MessageQ_transport(dstProcId, msgs[i]);
+            for (run = i; run < numMsgs; run++) {
+                msg = msgs[run];
+
+                Assert_isTrue((msg != NULL), ti_sdo_ipc_MessageQ_A_invalidMsg);
+
+                if ((run > i) &&
+                    (MessageQ_transport(dstProcId, msg) != transport)) {
+                    break;
+                }
+
+                msg->dstId   = (UInt16)(queueId);
+                msg->dstProc = (UInt16)(queueId >> 16);
+
+                /*
+                 *  Traced before the put, since the transport may free
+                 *  msg; one not accepted is traced too.
+                 */
+                if ((ti_sdo_ipc_MessageQ_traceFlag) ||
+                    (msg->flags & ti_sdo_ipc_MessageQ_TRACEMASK) != 0) {
+                    Log_write4(ti_sdo_ipc_MessageQ_LM_putRemote, (UArg)(msg),
+                              (UArg)(msg->seqNum), (UArg)(msg->srcProc),
+                              (UArg)(dstProcId));
+                }
             }
-            else {
-                listHandle = ti_sdo_ipc_MessageQ_Instance_State_highList(obj);
+            run -= i;
+
+            /* assert transport is not null */
+            Assert_isTrue(transport != NULL,
+                ti_sdo_ipc_MessageQ_A_unregisteredTransport);
+
+            done = IMessageQTransport_putMany(transport, (Ptr *)&msgs[i], run);
+            i += done;
+            if (done < run) {
+                break;
             }
-            /* put on the queue */
-            List_put(listHandle, (List_Elem *)msg);
         }
 
-        ISync_signal(obj->synchronizer);
+        return ((i == 0 && numMsgs > 0) ? MessageQ_E_FAIL : (Int)i);
+    }
 
-        status = MessageQ_S_SUCCESS;
+    /* It is a local MessageQ */
+    obj = MessageQ_lookup(queueId);
+    if (obj == NULL) {
+        return (MessageQ_E_FAIL);
+    }
+
+    for (i = 0; i < numMsgs; i++) {
+        msg = msgs[i];
+
+        Assert_isTrue((msg != NULL), ti_sdo_ipc_MessageQ_A_invalidMsg);
+
+        msg->dstId   = (UInt16)(queueId);
+        msg->dstProc = (UInt16)(queueId >> 16);
 
         if ((ti_sdo_ipc_MessageQ_traceFlag) ||
             (msg->flags & ti_sdo_ipc_MessageQ_TRACEMASK) != 0) {
             Log_write4(ti_sdo_ipc_MessageQ_LM_putLocal, (UArg)(msg),
                        (UArg)(msg->seqNum), (UArg)(msg->srcProc), (UArg)(obj));
         }
+
+        /* Same queue selection as MessageQ_put() */
+        MessageQ_enqueue(obj, msg);
     }
 
-    return (status);
+    if (numMsgs > 0) {
+        ISync_signal(obj->synchronizer);
+    }
+
+    return ((Int)numMsgs);
 }
 
 /*
@@ -752,14 +1458,15 @@ Void ti_sdo_ipc_MessageQ_unregisterTransport(UInt16 procId, UInt priority)
 Int ti_sdo_ipc_MessageQ_Instance_init(ti_sdo_ipc_MessageQ_Object *obj, String name,
         const ti_sdo_ipc_MessageQ_Params *params, Error_Block *eb)
 {
-    Int              i;
-    UInt16           start;
-    UInt16           count;
     UInt             key;
     Bool             found = FALSE;
     List_Handle      listHandle;
     SyncSem_Handle   syncSemHandle;
     MessageQ_QueueIndex queueIndex;
+    Error_Block      memEb;
+
+    obj->creditsOwed = NULL;
+    obj->nsKey = NULL;
 
     /* lock */
     key = IGateProvider_enter(MessageQ_module->gate);
@@ -777,19 +1484,19 @@ Int ti_sdo_ipc_MessageQ_Instance_init(ti_sdo_ipc_MessageQ_Object *obj, String na
         MessageQ_module->queues[queueIndex] = obj;
         found = TRUE;
     }
-    else {
-
-        start = ti_sdo_ipc_MessageQ_numReservedEntries;
-        count = MessageQ_module->numQueues;
-
-        /* Search the dynamic array for any holes */
-        for (i = start; (i < count) && (found == FALSE); i++) {
-            if (MessageQ_module->queues[i] == NULL) {
-                MessageQ_module->queues[i] = obj;
-                queueIndex = i;
-                found = TRUE;
-            }
-        }
+    else if (MessageQ_module->numFreeQueues > 0) {
+        /* Reuse the slot of the last queue deleted */
+        queueIndex = MessageQ_module->freeQueues[
+                --MessageQ_module->numFreeQueues];
+        MessageQ_module->queues[queueIndex & ti_sdo_ipc_MessageQ_SLOTMASK] =
+                obj;
+        found = TRUE;
+    }
+    else if (MessageQ_module->nextQueue < MessageQ_module->numQueues) {
+        /* Take a slot never used */
+        queueIndex = MessageQ_module->nextQueue++;
+        MessageQ_module->queues[queueIndex] = obj;
+        found = TRUE;
     }
 
     /*
@@ -816,6 +1523,8 @@ Int ti_sdo_ipc_MessageQ_Instance_init(ti_sdo_ipc_MessageQ_Object *obj, String na
         }
     }
 
+    obj->queue = ((MessageQ_QueueId)(MultiProc_self()) << 16) | queueIndex;
+
     /* create default sync if not specified */
     if (params->synchronizer == NULL) {
         /* Create a SyncSem as the synchronizer */
@@ -848,10 +1557,36 @@ Int ti_sdo_ipc_MessageQ_Instance_init(ti_sdo_ipc_MessageQ_Object *obj, String na
     listHandle = ti_sdo_ipc_MessageQ_Instance_State_highList(obj);
     List_construct(List_struct(listHandle), NULL);
 
-    obj->queue = ((MessageQ_QueueId)(MultiProc_self()) << 16) | queueIndex;
+    /* Empty lock-free queues, each holding just its stub */
+    obj->normalFifo.stub.next = NULL;
+    obj->normalFifo.head = &obj->normalFifo.stub;
+    obj->normalFifo.tail = &obj->normalFifo.stub;
+    obj->highFifo.stub.next = NULL;
+    obj->highFifo.head = &obj->highFifo.stub;
+    obj->highFifo.tail = &obj->highFifo.stub;
+    obj->urgent = NULL;
+    obj->urgentList = NULL;
+    obj->numPut = 0;
+    obj->numGot = 0;
 
     obj->unblocked = FALSE;
 
+    /*
+     *  Credits owed to each processor's MessageQ_putWait(), kept to batch
+     *  them only when this processor uses credits itself
+     */
+    if (ti_sdo_ipc_MessageQ_creditWindow != 0) {
+        Error_init(&memEb);
+        obj->creditsOwed = Memory_calloc(ti_sdo_ipc_MessageQ_Object_heap(),
+                ti_sdo_utils_MultiProc_numProcessors * sizeof(UInt16), 0,
+                &memEb);
+        if (obj->creditsOwed == NULL) {
+            Error_raise(eb, ti_sdo_ipc_MessageQ_E_creditsFailed,
+                obj->queue, 0);
+            return (6);
+        }
+    }
+
     /* Add into NameServer */
     if (name != NULL) {
         obj->nsKey = NameServer_addUInt32(
@@ -875,10 +1610,16 @@ Void ti_sdo_ipc_MessageQ_Instance_finalize(
 {
     UInt key;
     MessageQ_QueueIndex index = (MessageQ_QueueIndex)(obj->queue);
+    MessageQ_QueueIndex slot = index & ti_sdo_ipc_MessageQ_SLOTMASK;
+    MessageQ_QueueIndex gen;
     List_Handle listHandle;
+    ti_sdo_ipc_MessageQ_Credit *credit;
+    ti_sdo_ipc_MessageQ_Credit *next;
+    UInt hwiKey;
+    UInt i;
 
-    /* Requested queueId was not available. Nothing was done in the init */
-    if (status == 5) {
+    /* No queue index was available. Nothing was done in the init */
+    if ((status == 5) || (status == 1) || (status == 2)) {
         return;
     }
 
@@ -900,11 +1641,51 @@ Void ti_sdo_ipc_MessageQ_Instance_finalize(
     key = IGateProvider_enter(MessageQ_module->gate);
 
     /* Null out entry in the array. */
-    MessageQ_module->queues[index] = NULL;
+    MessageQ_module->queues[slot] = NULL;
+
+    /*
+     *  Dynamic slots go on the free stack, with the index the next queue
+     *  in them gets.  Reserved ones are only ever asked for by index.
+     */
+    if (slot >= ti_sdo_ipc_MessageQ_numReservedEntries) {
+        gen = ((index >> ti_sdo_ipc_MessageQ_GENSHIFT) + 1) &
+                ((1 << (16 - ti_sdo_ipc_MessageQ_GENSHIFT)) - 1);
+        MessageQ_module->freeQueues[MessageQ_module->numFreeQueues++] =
+                (MessageQ_QueueIndex)(gen << ti_sdo_ipc_MessageQ_GENSHIFT) |
+                slot;
+    }
+
+    /* the last queue deleted takes the credit records with it */
+    for (i = 0; i < MessageQ_module->numQueues; i++) {
+        if (MessageQ_module->queues[i] != NULL) {
+            break;
+        }
+    }
+    credit = NULL;
+    if (i == MessageQ_module->numQueues) {
+        hwiKey = Hwi_disable();
+        credit = (ti_sdo_ipc_MessageQ_Credit *)MessageQ_module->credits;
+        MessageQ_module->credits = NULL;
+        Hwi_restore(hwiKey);
+    }
 
     /* unlock scheduler */
     IGateProvider_leave(MessageQ_module->gate, key);
 
+    while (credit != NULL) {
+        next = (ti_sdo_ipc_MessageQ_Credit *)credit->next;
+        Semaphore_delete(&credit->sem);
+        Memory_free(ti_sdo_ipc_MessageQ_Object_heap(), credit,
+                sizeof(ti_sdo_ipc_MessageQ_Credit));
+        credit = next;
+    }
+
+    /* only once no put can find the queue to repay from it */
+    if (obj->creditsOwed != NULL) {
+        Memory_free(ti_sdo_ipc_MessageQ_Object_heap(), obj->creditsOwed,
+                ti_sdo_utils_MultiProc_numProcessors * sizeof(UInt16));
+    }
+
     if (obj->nsKey != NULL) {
         NameServer_removeEntry((NameServer_Handle)MessageQ_module->nameServer,
             obj->nsKey);
@@ -919,35 +1700,60 @@ Void ti_sdo_ipc_MessageQ_Instance_finalize(
 
 /*
  *  ======== ti_sdo_ipc_MessageQ_grow ========
+ *  Called when every slot is in use.  The queues table is doubled, and
+ *  the free stack, which never holds more than the table, is allocated
+ *  along with it.
  */
 UInt16 ti_sdo_ipc_MessageQ_grow(ti_sdo_ipc_MessageQ_Object *obj,
         Error_Block *eb)
 {
-    UInt16 oldSize;
+    SizeT  oldSize;
+    SizeT  newSize;
+    UInt16 numQueues;
     UInt16 queueIndex = MessageQ_module->numQueues;
     ti_sdo_ipc_MessageQ_Handle *queues;
     ti_sdo_ipc_MessageQ_Handle *oldQueues;
-    oldSize = (MessageQ_module->numQueues) * sizeof(MessageQ_Handle);
 
+    if (MessageQ_module->numQueues >= ti_sdo_ipc_MessageQ_MAXSLOTS) {
+        Error_raise(eb, ti_sdo_ipc_MessageQ_E_maxReached,
+            ti_sdo_ipc_MessageQ_MAXSLOTS, 0);
+        return (MessageQ_INVALIDMESSAGEQ);
+    }
+
+    numQueues = MessageQ_module->numQueues * 2;
+    if (numQueues < ti_sdo_ipc_MessageQ_MINGROWSLOTS) {
+        numQueues = ti_sdo_ipc_MessageQ_MINGROWSLOTS;
+    }
+    if (numQueues > ti_sdo_ipc_MessageQ_MAXSLOTS) {
+        numQueues = ti_sdo_ipc_MessageQ_MAXSLOTS;
+    }
+
+    oldSize = MessageQ_module->numQueues *
+              (sizeof(MessageQ_Handle) + sizeof(UInt16));
+    newSize = numQueues * (sizeof(MessageQ_Handle) + sizeof(UInt16));
 
     /* Allocate larger table */
-    queues = Memory_alloc(ti_sdo_ipc_MessageQ_Object_heap(),
-                          oldSize + sizeof(MessageQ_Handle), 0, eb);
+    queues = Memory_alloc(ti_sdo_ipc_MessageQ_Object_heap(), newSize, 0, eb);
 
     if (queues == NULL) {
         return (MessageQ_INVALIDMESSAGEQ);
     }
 
-    /* Copy contents into new table */
-    memcpy(queues, MessageQ_module->queues, oldSize);
+    /* Copy contents into new table, and clear the new slots */
+    memcpy(queues, MessageQ_module->queues,
+           MessageQ_module->numQueues * sizeof(MessageQ_Handle));
+    memset(&queues[queueIndex], 0,
+           (numQueues - queueIndex) * sizeof(MessageQ_Handle));
 
     /* Fill in the new entry */
     queues[queueIndex] = obj;
 
-    /* Hook-up new table */
+    /* Hook-up new table; the free stack is empty, so needs no copy */
     oldQueues = MessageQ_module->queues;
     MessageQ_module->queues = queues;
-    MessageQ_module->numQueues++;
+    MessageQ_module->freeQueues = (UInt16 *)&queues[numQueues];
+    MessageQ_module->numQueues = numQueues;
+    MessageQ_module->nextQueue = queueIndex + 1;
 
     /* Delete old table if not statically defined */
     if (MessageQ_module->canFreeQueues == TRUE) {
@@ -40,6 +40,9 @@ var MessageQ   = null;
 var GateThread = null;
 var Settings   = null;
 var SyncSem    = null;
+var Task       = null;
+var Clock      = null;
+var Semaphore  = null;
 
 var instCount = 0;  /* use to determine if processing last instance */
 var sharedCreateId = new Array();
@@ -75,6 +78,9 @@ function module$use()
     NameServer = xdc.useModule('ti.sdo.utils.NameServer');
     GateThread = xdc.useModule("xdc.runtime.knl.GateThread");
     SyncSem    = xdc.useModule("ti.sysbios.syncs.SyncSem");
+    Task       = xdc.useModule("ti.sysbios.knl.Task");
+    Clock      = xdc.useModule("ti.sysbios.knl.Clock");
+    Semaphore  = xdc.useModule("ti.sysbios.knl.Semaphore");
 
     /* Plug the SetupTransportProxy for the MessageQ transport */
     if (MessageQ.SetupTransportProxy == null) {
@@ -131,7 +137,12 @@ function module$static$init(mod, params)
     }
 
     mod.queues.length = mod.numQueues;
+    mod.freeQueues.length = mod.numQueues;
+    mod.numFreeQueues = 0;
+    mod.nextQueue = Math.max(this.$instances.length,
+                             params.numReservedEntries);
     mod.canFreeQueues = false;
+    mod.credits = null;
     mod.freeHookFxn   = params.freeHookFxn;
 
     if (params.nameTableGate == null) {
@@ -279,6 +290,16 @@ function viewInitMessages(view, obj)
         return;
     }
 
+    /* With lock-free queues, the messages are in the order they're got */
+    if (Program.getModuleConfig(MessageQ.$name).lockFreeQueues) {
+        addMsgsFromChain(view, obj.urgent, 0);
+        addMsgsFromChain(view, obj.urgentList, 0);
+        addMsgsFromChain(view, obj.highFifo.tail, obj.highFifo.stub.$addr);
+        addMsgsFromChain(view, obj.normalFifo.tail,
+            obj.normalFifo.stub.$addr);
+        return;
+    }
+
     /* Retrieve the ROV view for the embedded high priority message list. */
     addMsgsFromList(view, obj.highList);
 
@@ -286,6 +307,40 @@ function viewInitMessages(view, obj)
     addMsgsFromList(view, obj.normalList);
 }
 
+/*
+ *  ======== addMsgsFromChain ========
+ *  Adds the messages linked from addr to the view, skipping a lock-free
+ *  queue's stub.
+ */
+function addMsgsFromChain(view, addr, stubAddr)
+{
+    var Program = xdc.useModule('xdc.rov.Program');
+    var List = xdc.useModule('ti.sdo.utils.List');
+    var addrs = {};
+
+    try {
+        while (Number(addr) != 0) {
+            /* verify we're not in a loop */
+            if (addr in addrs) {
+                throw ("Queue contains loop at 0x" +
+                    Number(addr).toString(16));
+            }
+            addrs[addr] = true;
+
+            if (Number(addr) != Number(stubAddr)) {
+                view.elements.$add(getMsgView(Number(addr)));
+            }
+
+            addr = Program.fetchStruct(List.Elem$fetchDesc, addr).next;
+        }
+    }
+    catch (e) {
+        var msgView = Program.newViewStruct('ti.sdo.ipc.MessageQ', 'Messages');
+        Program.displayError(msgView, 'seqNum', String(e));
+        view.elements.$add(msgView);
+    }
+}
+
 /*
  *  ======== addMsgsFromList ========
  *  Scans the provided list object and adds the messages on it to the view.
@@ -507,4 +562,19 @@ function module$validate()
             "it cannot be less than MessageQ.numReservedEntries.",
             MessageQ);
     }
+
+    var numQueues = MessageQ.$instances.length +
+        ((MessageQ.maxRuntimeEntries != NameServer.ALLOWGROWTH) ?
+        MessageQ.maxRuntimeEntries : MessageQ.numReservedEntries);
+    if (numQueues > MessageQ.MAXSLOTS) {
+        MessageQ.$logFatal(
+            "At most " + MessageQ.MAXSLOTS + " MessageQs can exist, " +
+            "static ones and MessageQ.maxRuntimeEntries included.",
+            MessageQ);
+    }
+
+    if (MessageQ.creditWindow > 255) {
+        MessageQ.$logFatal(
+            "MessageQ.creditWindow cannot be more than 255.", MessageQ);
+    }
 }
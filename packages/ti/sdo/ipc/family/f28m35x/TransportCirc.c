@@ -241,6 +241,87 @@ Bool TransportCirc_put(TransportCirc_Object *obj, Ptr msg)
     return (TRUE);
 }
 
+/*
+ *  ======== TransportCirc_putMany ========
+ *  Like TransportCirc_put(), waits for a free slot, then copies as many
+ *  of the messages as there are free slots and notifies the remote
+ *  processor once.
+ */
+UInt TransportCirc_putMany(TransportCirc_Object *obj, Ptr *msgs, UInt numMsgs)
+{
+    UInt msgSize;
+    UInt hwiKey;
+    UInt i;
+    UInt numFree;
+    Ptr writeAddr;
+    UInt writeIndex, readIndex;
+
+    if (numMsgs == 0) {
+        return (0);
+    }
+
+    do {
+        /* disable interrupts */
+        hwiKey = Hwi_disable();
+
+        /* get the writeIndex and readIndex */
+        readIndex  = obj->putReadIndex[0];
+        writeIndex = obj->putWriteIndex[0];
+
+        /* if slots available 'break' out of loop */
+        numFree = (readIndex - writeIndex - 1) & TransportCirc_maxIndex;
+        if (numFree != 0) {
+            break;
+        }
+
+        /* restore interrupts */
+        Hwi_restore(hwiKey);
+
+    } while (1);
+
+    /* interrupts are disabled at this point */
+
+    if (numMsgs > numFree) {
+        numMsgs = numFree;
+    }
+
+    /* copy the messages into the free buffers */
+    for (i = 0; i < numMsgs; i++) {
+        writeAddr = (Ptr)((UInt32)obj->putBuffer +
+                (((writeIndex + i) & TransportCirc_maxIndex) *
+                TransportCirc_msgSize));
+
+        msgSize = MessageQ_getMsgSize(msgs[i]);
+
+        Assert_isTrue(msgSize <= TransportCirc_msgSize, IpcMgr_A_internal);
+
+        memcpy(writeAddr, msgs[i], msgSize);
+    }
+
+    /* update the writeIndex */
+    obj->putWriteIndex[0] = (writeIndex + numMsgs) & TransportCirc_maxIndex;
+
+    /* restore interrupts */
+    Hwi_restore(hwiKey);
+
+    /* free the app's messages */
+    for (i = 0; i < numMsgs; i++) {
+        if (((MessageQ_Msg)msgs[i])->heapId != ti_sdo_ipc_MessageQ_STATICMSG) {
+            MessageQ_free(msgs[i]);
+        }
+    }
+
+    /*
+     *  Notify the remote processor, once for the burst.  The messages were
+     *  copied and freed, so they are accepted even if this fails; they are
+     *  seen on the next event.
+     */
+    Notify_sendEvent(obj->remoteProcId, 0, TransportCirc_notifyEventId,
+        (UInt32)NULL, FALSE);
+
+    return (numMsgs);
+}
+
 /*
  *  ======== TransportCirc_control ========
  */
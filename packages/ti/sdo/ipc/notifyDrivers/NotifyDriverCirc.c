@@ -55,6 +55,27 @@
 #define CLEAR_BIT(num,pos)          ((num) &= ~(1u << (pos)))
 #define TEST_BIT(num,pos)           ((num) & (1u << (pos)))
 
+static Bool NotifyDriverCirc_needInterrupt(NotifyDriverCirc_Object *obj,
+    UInt32 oldIndex, UInt32 newIndex);
+
+/*
+ *  Full memory barrier for suppressEvents.  Each side stores its own
+ *  index and then loads the other side's, which without a barrier can
+ *  both see stale values and skip the interrupt, whether or not
+ *  the memory is cached.  Where no barrier is known, suppressEvents has
+ *  no effect.
+ */
+#if defined(__GNUC__) && !defined(__TI_COMPILER_VERSION__)
+#define NotifyDriverCirc_mfence()     __sync_synchronize()
+#define NotifyDriverCirc_SUPPRESS     NotifyDriverCirc_suppressEvents
+#elif defined(__TI_COMPILER_VERSION__) && defined(_TMS320C6600)
+#define NotifyDriverCirc_mfence()     _mfence()
+#define NotifyDriverCirc_SUPPRESS     NotifyDriverCirc_suppressEvents
+#else
+#define NotifyDriverCirc_mfence()
+#define NotifyDriverCirc_SUPPRESS     FALSE
+#endif
+
 
 /*
  **************************************************************
@@ -151,7 +172,7 @@ Void NotifyDriverCirc_Instance_init(NotifyDriverCirc_Object *obj,
     ctrlSize = _Ipc_roundup(sizeof(Bits32), minAlign);
 
     /* calculate the total size one-way */
-    totalSelfSize =  circBufSize + (2 * ctrlSize);
+    totalSelfSize =  circBufSize + (3 * ctrlSize);
 
     /*
      *  Init put/get buffer and index pointers.
@@ -164,6 +185,8 @@ Void NotifyDriverCirc_Instance_init(NotifyDriverCirc_Object *obj,
 
     obj->putReadIndex = (Bits32 *)((UInt32)obj->putWriteIndex + ctrlSize);
 
+    obj->putEventIndex = (Bits32 *)((UInt32)obj->putReadIndex + ctrlSize);
+
     obj->getBuffer = (NotifyDriverCirc_EventEntry *)
         ((UInt32)params->sharedAddr + (remoteIndex * totalSelfSize));
 
@@ -171,6 +194,8 @@ Void NotifyDriverCirc_Instance_init(NotifyDriverCirc_Object *obj,
 
     obj->getReadIndex = (Bits32 *)((UInt32)obj->getWriteIndex + ctrlSize);
 
+    obj->getEventIndex = (Bits32 *)((UInt32)obj->getReadIndex + ctrlSize);
+
     /*
      *  Calculate the size for cache wb/inv in sendEvent and isr.
      *  This size is the circular buffer + putWriteIndex.
@@ -179,11 +204,15 @@ Void NotifyDriverCirc_Instance_init(NotifyDriverCirc_Object *obj,
      */
     obj->opCacheSize = ((UInt32)obj->putReadIndex - (UInt32)obj->putBuffer);
 
-    /* init the putWrite and putRead Index to 0 */
+    /*
+     *  Init the putWrite and putRead Index to 0.  Every sendEvent
+     *  interrupts until the remote processor publishes a putEventIndex.
+     */
     obj->putWriteIndex[0] = 0;
     obj->putReadIndex[0] = 0;
+    obj->putEventIndex[0] = NotifyDriverCirc_ALWAYSNOTIFY;
 
-    /* cache wb the putWrite/Read Index but no need to inv them */
+    /* cache wb the putWrite/Read/Event Index but no need to inv them */
     if (obj->cacheEnabled) {
         Cache_wb(obj->putWriteIndex,
                  sizeof(Bits32),
@@ -193,6 +222,10 @@ Void NotifyDriverCirc_Instance_init(NotifyDriverCirc_Object *obj,
                  sizeof(Bits32),
                  Cache_Type_ALL, TRUE);
 
+        Cache_wb(obj->putEventIndex,
+                 sizeof(Bits32),
+                 Cache_Type_ALL, TRUE);
+
         /* invalidate any stale data of the get buffer and indexes */
         Cache_inv(obj->getBuffer,
                   totalSelfSize,
@@ -397,9 +430,12 @@ Int NotifyDriverCirc_sendEvent(NotifyDriverCirc_Object *obj,
                  TRUE);
     }
 
-    /* Send an interrupt to the Remote Processor */
-    NotifyDriverCirc_InterruptProxy_intSend(obj->remoteProcId, &(obj->intInfo),
-                                            eventId);
+    /* Send an interrupt to the Remote Processor, unless its isr is running */
+    if (NotifyDriverCirc_needInterrupt(obj, writeIndex,
+            (writeIndex + 1) & NotifyDriverCirc_maxIndex)) {
+        NotifyDriverCirc_InterruptProxy_intSend(obj->remoteProcId,
+                                                &(obj->intInfo), eventId);
+    }
 
     return (Notify_S_SUCCESS);
 }
@@ -484,19 +520,21 @@ SizeT NotifyDriverCirc_sharedMemReq(const NotifyDriverCirc_Params *params)
      *  1 putBuffer with numMsgs (rounded to CLS) +
      *  1 putWriteIndex ptr (rounded to CLS) +
      *  1 putReadIndex put (rounded to CLS) +
+     *  1 putEventIndex (rounded to CLS) +
      *  1 getBuffer with numMsgs (rounded to CLS) +
      *  1 getWriteIndex ptr (rounded to CLS) +
      *  1 getReadIndex put (rounded to CLS) +
+     *  1 getEventIndex (rounded to CLS)
      *
      *  For CLS of 128b it is:
-     *      256b + 128b + 128b + 256b+ 128b + 128b = 1KB
+     *      256b + 128b + 128b + 128b + 256b + 128b + 128b + 128b = 1.25KB
      *
      *  Note: CLS means Cache Line Size
      */
     memReq = 2 *
         ((_Ipc_roundup(sizeof(NotifyDriverCirc_EventEntry) *
                        NotifyDriverCirc_numMsgs, minAlign))
-        + ( 2 * _Ipc_roundup(sizeof(Bits32), minAlign)));
+        + ( 3 * _Ipc_roundup(sizeof(Bits32), minAlign)));
 
     return (memReq);
 }
@@ -541,52 +579,111 @@ Void NotifyDriverCirc_isr(UArg arg)
         Cache_wait();
     }
 
-    /* get the writeIndex and readIndex */
-    writeIndex = obj->getWriteIndex[0];
+    /* get the readIndex */
     readIndex = obj->getReadIndex[0];
 
-    /* get the event */
-    eventEntry = &(obj->getBuffer[readIndex]);
+    do {
+        /* get the writeIndex */
+        writeIndex = obj->getWriteIndex[0];
 
-    /* if writeIndex != readIndex then there is an event to process */
-    while (writeIndex != readIndex) {
-        /*
-         *  Check to make sure event is registered. If the event
-         *  is not registered, the event is not processed and is lost.
-         */
-        if (TEST_BIT(obj->evtRegMask, eventEntry->eventid)) {
-            /* Execute the callback function */
-            ti_sdo_ipc_Notify_exec(obj->notifyHandle,
-                                   eventEntry->eventid,
-                                   eventEntry->payload);
-        }
+        /* get the event */
+        eventEntry = &(obj->getBuffer[readIndex]);
+
+        /* if writeIndex != readIndex then there is an event to process */
+        while (writeIndex != readIndex) {
+            /*
+             *  Check to make sure event is registered. If the event
+             *  is not registered, the event is not processed and is lost.
+             */
+            if (TEST_BIT(obj->evtRegMask, eventEntry->eventid)) {
+                /* Execute the callback function */
+                ti_sdo_ipc_Notify_exec(obj->notifyHandle,
+                                       eventEntry->eventid,
+                                       eventEntry->payload);
+            }
+
+            /* update the readIndex. */
+            readIndex = ((readIndex + 1) & NotifyDriverCirc_maxIndex);
+
+            /* set the getReadIndex */
+            obj->getReadIndex[0] = readIndex;
+
+            /*
+             *  Write back the getReadIndex once every N / 4 messages.
+             *  No need to invalidate since only one processor ever
+             *  writes this. No need to wait for operation to complete
+             *  since remote core updates its readIndex at least once
+             *  every N messages and the remote core will not use a slot
+             *  until it sees that the event has been processed with this
+             *  cache wb.
+             */
+            if ((obj->cacheEnabled) &&
+                ((readIndex % NotifyDriverCirc_modIndex) == 0)) {
+                Cache_wb(obj->getReadIndex,
+                         sizeof(Bits32),
+                         Cache_Type_ALL,
+                         FALSE);
+            }
 
-        /* update the readIndex. */
-        readIndex = ((readIndex + 1) & NotifyDriverCirc_maxIndex);
+            /* get the next event */
+            eventEntry = &(obj->getBuffer[readIndex]);
+        }
 
-        /* set the getReadIndex */
-        obj->getReadIndex[0] = readIndex;
+        if (!NotifyDriverCirc_SUPPRESS) {
+            break;
+        }
 
         /*
-         *  Write back the getReadIndex once every N / 4 messages.
-         *  No need to invalidate since only one processor ever
-         *  writes this. No need to wait for operation to complete
-         *  since remote core updates its readIndex at least once
-         *  every N messages and the remote core will not use a slot
-         *  until it sees that the event has been processed with this
-         *  cache wb.
+         *  The buffer is empty: ask for an interrupt when the next slot
+         *  is filled, then look again in case it was filled before the
+         *  remote processor could see the request.
          */
-        if ((obj->cacheEnabled) &&
-            ((readIndex % NotifyDriverCirc_modIndex) == 0)) {
-            Cache_wb(obj->getReadIndex,
+        obj->getEventIndex[0] = readIndex;
+        if (obj->cacheEnabled) {
+            Cache_wb(obj->getEventIndex,
                      sizeof(Bits32),
                      Cache_Type_ALL,
-                     FALSE);
+                     TRUE);
         }
+        NotifyDriverCirc_mfence();
+        if (obj->cacheEnabled) {
+            Cache_inv(obj->getBuffer,
+                      obj->opCacheSize,
+                      Cache_Type_ALL,
+                      TRUE);
+        }
+    } while (obj->getWriteIndex[0] != readIndex);
+}
 
-        /* get the next event */
-        eventEntry = &(obj->getBuffer[readIndex]);
+/*
+ *  ======== NotifyDriverCirc_needInterrupt ========
+ *  Whether moving the putWriteIndex from oldIndex to newIndex filled the
+ *  slot the remote processor asked to be interrupted at, as virtio's
+ *  vring_need_event().  The putWriteIndex must already be written back.
+ */
+static Bool NotifyDriverCirc_needInterrupt(NotifyDriverCirc_Object *obj,
+    UInt32 oldIndex, UInt32 newIndex)
+{
+    UInt32 eventIndex;
+
+    if (!NotifyDriverCirc_SUPPRESS) {
+        return (TRUE);
+    }
+
+    /* order the putWriteIndex store before the putEventIndex load */
+    NotifyDriverCirc_mfence();
+    if (obj->cacheEnabled) {
+        Cache_inv(obj->putEventIndex, sizeof(Bits32), Cache_Type_ALL, TRUE);
     }
+    eventIndex = obj->putEventIndex[0];
+
+    if (eventIndex > NotifyDriverCirc_maxIndex) {
+        /* the remote processor has not asked yet */
+        return (TRUE);
+    }
+
+    return (((newIndex - eventIndex - 1) & NotifyDriverCirc_maxIndex) <
+            ((newIndex - oldIndex) & NotifyDriverCirc_maxIndex));
 }
 
 /*
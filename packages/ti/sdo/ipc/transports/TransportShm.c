@@ -101,8 +101,10 @@ Void TransportShm_swiFxn(UArg arg)
         /* Get the destination message queue Id */
         queueId = MessageQ_getDstQueue(msg);
 
-        /* put the message to the destination queue */
-        MessageQ_put(queueId, msg);
+        /* put the message to the destination queue, if it still exists */
+        if (MessageQ_put(queueId, msg) < 0) {
+            MessageQ_free(msg);
+        }
 
         /* check to see if there are more messages */
         msg = (MessageQ_Msg)ListMP_getHead((ListMP_Handle)obj->localList);
@@ -417,6 +419,69 @@ Bool TransportShm_put(TransportShm_Object *obj, Ptr msg)
     return (retval);
 }
 
+/*
+ *  ======== TransportShm_putMany ========
+ *  The burst goes on the remoteList under one gate entry and the remote
+ *  processor is notified once.  All or none of the messages are accepted.
+ */
+UInt TransportShm_putMany(TransportShm_Object *obj, Ptr *msgs, UInt numMsgs)
+{
+    Int32 status;
+    IArg key;
+    UInt i;
+    UInt16 id;
+    Bool wait = FALSE;
+
+    if (numMsgs == 0) {
+        return (0);
+    }
+
+    /* writeback invalidate the messages, waiting once for them all */
+    for (i = 0; i < numMsgs; i++) {
+        id = SharedRegion_getId(msgs[i]);
+
+        /* This transport only deals with messages allocated from SR's */
+        Assert_isTrue(id != SharedRegion_INVALIDREGIONID,
+                ti_sdo_ipc_SharedRegion_A_regionInvalid);
+
+        if (SharedRegion_isCacheEnabled(id)) {
+            Cache_wbInv(msgs[i], ((MessageQ_Msg)(msgs[i]))->msgSize,
+                Cache_Type_ALL, FALSE);
+            wait = TRUE;
+        }
+    }
+    if (wait) {
+        Cache_wait();
+    }
+
+    /* make sure ListMP_put and sendEvent are done before remote executes */
+    key = GateMP_enter((GateMP_Handle)obj->gate);
+
+    /* Put the messages on the remoteList */
+    for (i = 0; i < numMsgs; i++) {
+        ListMP_putTail((ListMP_Handle)obj->remoteList, (ListMP_Elem *)msgs[i]);
+    }
+
+    /* Notify the remote processor */
+    status = Notify_sendEvent(obj->remoteProcId, 0, TransportShm_notifyEventId,
+        0, FALSE);
+
+    /* check the status of the sendEvent */
+    if (status < 0) {
+        /* remove the messages from the List and accept none */
+        for (i = 0; i < numMsgs; i++) {
+            ListMP_remove((ListMP_Handle)obj->remoteList,
+                (ListMP_Elem *)msgs[i]);
+        }
+        numMsgs = 0;
+    }
+
+    /* leave the gate */
+    GateMP_leave((GateMP_Handle)obj->gate, key);
+
+    return (numMsgs);
+}
+
 /*
  *  ======== TransportShm_control ========
  */
@@ -64,6 +64,27 @@
         ti_sdo_ipc_transports_TransportShmCirc_notifyEventId + \
                     (UInt32)((UInt32)Notify_SYSTEMKEY << 16)
 
+static Bool TransportShmCirc_needEvent(TransportShmCirc_Object *obj,
+    UInt32 oldIndex, UInt32 newIndex);
+
+/*
+ *  Full memory barrier for suppressEvents.  Each side stores its own
+ *  index and then loads the other side's, which without a barrier can
+ *  both see stale values and skip the event, whether or not
+ *  the memory is cached.  Where no barrier is known, suppressEvents has
+ *  no effect.
+ */
+#if defined(__GNUC__) && !defined(__TI_COMPILER_VERSION__)
+#define TransportShmCirc_mfence()     __sync_synchronize()
+#define TransportShmCirc_SUPPRESS     TransportShmCirc_suppressEvents
+#elif defined(__TI_COMPILER_VERSION__) && defined(_TMS320C6600)
+#define TransportShmCirc_mfence()     _mfence()
+#define TransportShmCirc_SUPPRESS     TransportShmCirc_suppressEvents
+#else
+#define TransportShmCirc_mfence()
+#define TransportShmCirc_SUPPRESS     FALSE
+#endif
+
 /*
  *************************************************************************
  *                       Instance functions
@@ -120,6 +141,7 @@ Int TransportShmCirc_Instance_init(TransportShmCirc_Object *obj,
     obj->objType      = ti_sdo_ipc_Ipc_ObjType_CREATEDYNAMIC;
     obj->priority     = params->priority;
     obj->remoteProcId = remoteProcId;
+    obj->eventPending = FALSE;
 
     /* calculate the circular buffer size one-way */
     circBufSize =
@@ -129,7 +151,7 @@ Int TransportShmCirc_Instance_init(TransportShmCirc_Object *obj,
     ctrlSize = _Ipc_roundup(sizeof(Bits32), minAlign);
 
     /* calculate the total size one-way */
-    totalSelfSize =  circBufSize + (2 * ctrlSize);
+    totalSelfSize =  circBufSize + (3 * ctrlSize);
 
     /*
      *  Init put/get buffer and index pointers.
@@ -142,6 +164,8 @@ Int TransportShmCirc_Instance_init(TransportShmCirc_Object *obj,
 
     obj->putReadIndex = (Bits32 *)((UInt32)obj->putWriteIndex + ctrlSize);
 
+    obj->putEventIndex = (Bits32 *)((UInt32)obj->putReadIndex + ctrlSize);
+
     obj->getBuffer =
         (Ptr)((UInt32)params->sharedAddr + (remoteIndex * totalSelfSize));
 
@@ -149,6 +173,8 @@ Int TransportShmCirc_Instance_init(TransportShmCirc_Object *obj,
 
     obj->getReadIndex = (Bits32 *)((UInt32)obj->getWriteIndex + ctrlSize);
 
+    obj->getEventIndex = (Bits32 *)((UInt32)obj->getReadIndex + ctrlSize);
+
     /*
      *  Calculate the size for cache inv in isr.
      *  This size is the circular buffer + putWriteIndex.
@@ -186,11 +212,15 @@ Int TransportShmCirc_Instance_init(TransportShmCirc_Object *obj,
         return (2);
     }
 
-    /* init the putWrite and putRead Index to 0 */
+    /*
+     *  Init the putWrite and putRead Index to 0.  Every put sends an
+     *  event until the remote processor publishes a putEventIndex.
+     */
     obj->putWriteIndex[0] = 0;
     obj->putReadIndex[0] = 0;
+    obj->putEventIndex[0] = TransportShmCirc_ALWAYSNOTIFY;
 
-    /* cache wb the putWrite/Read Index but no need to inv them */
+    /* cache wb the putWrite/Read/Event Index but no need to inv them */
     if (obj->cacheEnabled) {
         Cache_wb(obj->putWriteIndex,
                  sizeof(Bits32),
@@ -199,6 +229,10 @@ Int TransportShmCirc_Instance_init(TransportShmCirc_Object *obj,
         Cache_wb(obj->putReadIndex,
                  sizeof(Bits32),
                  Cache_Type_ALL, TRUE);
+
+        Cache_wb(obj->putEventIndex,
+                 sizeof(Bits32),
+                 Cache_Type_ALL, TRUE);
     }
 
     return (0);
@@ -343,21 +377,148 @@ Bool TransportShmCirc_put(TransportShmCirc_Object *obj, Ptr msg)
                  TRUE);
     }
 
-    /* Notify the remote processor */
-    status = Notify_sendEvent(
-                 obj->remoteProcId,
-                 0,
-                 TransportShmCirc_notifyEventId,
-                 0,
-                 FALSE);
+    /* Notify the remote processor, unless its Swi will see the message */
+    if (TransportShmCirc_needEvent(obj, writeIndex,
+            (writeIndex + 1) & TransportShmCirc_maxIndex)) {
+        status = Notify_sendEvent(
+                     obj->remoteProcId,
+                     0,
+                     TransportShmCirc_notifyEventId,
+                     0,
+                     FALSE);
 
-    if (status < 0) {
-        return (FALSE);
+        /* make sure the next put tries again */
+        obj->eventPending = (status < 0);
+
+        if (status < 0) {
+            return (FALSE);
+        }
     }
 
     return (TRUE);
 }
 
+/*
+ *  ======== TransportShmCirc_putMany ========
+ *  As many of the messages as there are free slots for go in the ring
+ *  under one interrupt lock, the slots are written back together, and
+ *  the remote processor is interrupted once.
+ */
+UInt TransportShmCirc_putMany(TransportShmCirc_Object *obj, Ptr *msgs,
+    UInt numMsgs)
+{
+    UInt hwiKey;
+    UInt i;
+    UInt numFree;
+    UInt32 *eventEntry;
+    UInt32 writeIndex, readIndex;
+    UInt16 regionId;
+
+    if (numMsgs == 0) {
+        return (0);
+    }
+
+    /* writeback invalidate the messages; waited for below */
+    for (i = 0; i < numMsgs; i++) {
+        if (ti_sdo_ipc_SharedRegion_translate ||
+            !TransportShmCirc_alwaysWriteBackMsg) {
+            regionId = SharedRegion_getId(msgs[i]);
+            if (SharedRegion_isCacheEnabled(regionId)) {
+                Cache_wbInv(msgs[i], ((MessageQ_Msg)(msgs[i]))->msgSize,
+                            Cache_Type_ALL, FALSE);
+            }
+        }
+        else {
+            Cache_wbInv(msgs[i], ((MessageQ_Msg)(msgs[i]))->msgSize,
+                        Cache_Type_ALL, FALSE);
+        }
+    }
+
+    /* Only re-read the putReadIndex if the cached one leaves too little */
+    readIndex = obj->putReadIndex[0];
+    writeIndex = obj->putWriteIndex[0];
+    numFree = (readIndex - writeIndex - 1) & TransportShmCirc_maxIndex;
+    if ((numFree < numMsgs) && obj->cacheEnabled) {
+        Cache_inv(obj->putReadIndex, sizeof(Bits32), Cache_Type_ALL, TRUE);
+        readIndex = obj->putReadIndex[0];
+    }
+
+    /* disable interrupts */
+    hwiKey = Hwi_disable();
+
+    /* retrieve the put index */
+    writeIndex = obj->putWriteIndex[0];
+
+    numFree = (readIndex - writeIndex - 1) & TransportShmCirc_maxIndex;
+    if (numMsgs > numFree) {
+        numMsgs = numFree;
+    }
+
+    if (numMsgs == 0) {
+        /* if no slot available */
+        Hwi_restore(hwiKey);
+        return (0);
+    }
+
+    /* Set the payload of each entry */
+    for (i = 0; i < numMsgs; i++) {
+        eventEntry = (UInt32 *)((UInt32)obj->putBuffer +
+            (((writeIndex + i) & TransportShmCirc_maxIndex) * sizeof(Ptr)));
+        eventEntry[0] = SharedRegion_getSRPtr(msgs[i],
+            ti_sdo_ipc_SharedRegion_translate ? SharedRegion_getId(msgs[i]) :
+            SharedRegion_INVALIDREGIONID);
+    }
+
+    /*
+     *  Writeback the entries, in two pieces if they wrap.  No need to
+     *  wait since another cache operation is done below.
+     */
+    if (obj->cacheEnabled) {
+        i = TransportShmCirc_maxIndex + 1 - writeIndex;
+        if (i > numMsgs) {
+            i = numMsgs;
+        }
+        Cache_wb((Ptr)((UInt32)obj->putBuffer + (writeIndex * sizeof(Ptr))),
+                 i * sizeof(Ptr), Cache_Type_ALL, FALSE);
+        if (i < numMsgs) {
+            Cache_wb(obj->putBuffer, (numMsgs - i) * sizeof(Ptr),
+                     Cache_Type_ALL, FALSE);
+        }
+    }
+
+    /* update the putWriteIndex */
+    obj->putWriteIndex[0] = (writeIndex + numMsgs) &
+        TransportShmCirc_maxIndex;
+
+    /* restore interrupts */
+    Hwi_restore(hwiKey);
+
+    /*
+     *  Writeback the putWriteIndex, waiting for the messages and entries
+     *  too.  No need to invalidate since only one processor ever writes
+     *  here.
+     */
+    if (obj->cacheEnabled) {
+        Cache_wb(obj->putWriteIndex, sizeof(Bits32), Cache_Type_ALL, TRUE);
+    }
+    else {
+        Cache_wait();
+    }
+
+    /*
+     *  Notify the remote processor, once for the burst.  The messages are
+     *  in the ring, so they are accepted even if this fails; they are
+     *  seen on the next event.
+     */
+    if (TransportShmCirc_needEvent(obj, writeIndex,
+            (writeIndex + numMsgs) & TransportShmCirc_maxIndex)) {
+        obj->eventPending = (Notify_sendEvent(obj->remoteProcId, 0,
+            TransportShmCirc_notifyEventId, 0, FALSE) < 0);
+    }
+
+    return (numMsgs);
+}
+
 /*
  *  ======== TransportShmCirc_control ========
  */
@@ -415,60 +576,120 @@ Void TransportShmCirc_swiFxn(UArg arg)
     /* Make sure the TransportShmCirc_Object is not NULL */
     Assert_isTrue(obj != NULL, ti_sdo_ipc_Ipc_A_internal);
 
-    /*
-     *  Invalidate both getBuffer and getWriteIndex from cache.
-     */
-    if (obj->cacheEnabled) {
-        Cache_inv(obj->getBuffer,
-                  obj->opCacheSize,
-                  Cache_Type_ALL,
-                  TRUE);
-    }
-
-    /* get the writeIndex and readIndex */
-    writeIndex = obj->getWriteIndex[0];
-    readIndex = obj->getReadIndex[0];
-
-    /* get the next entry to be processed */
-    eventEntry = (UInt32 *)&(obj->getBuffer[readIndex]);
-
-    while (writeIndex != readIndex) {
-        /* get the msg (convert SRPtr to Ptr) */
-        msg = SharedRegion_getPtr((SharedRegion_SRPtr)eventEntry[0]);
+    do {
+        /*
+         *  Invalidate both getBuffer and getWriteIndex from cache.
+         */
+        if (obj->cacheEnabled) {
+            Cache_inv(obj->getBuffer,
+                      obj->opCacheSize,
+                      Cache_Type_ALL,
+                      TRUE);
+        }
 
-        /* get the queue id */
-        queueId = MessageQ_getDstQueue(msg);
+        /* get the writeIndex and readIndex */
+        writeIndex = obj->getWriteIndex[0];
+        readIndex = obj->getReadIndex[0];
 
-        /* put message on local queue */
-        MessageQ_put(queueId, msg);
+        /* get the next entry to be processed */
+        eventEntry = (UInt32 *)&(obj->getBuffer[readIndex]);
 
-        /* update the local readIndex. */
-        readIndex = ((readIndex + 1) & TransportShmCirc_maxIndex);
+        while (writeIndex != readIndex) {
+            /* get the msg (convert SRPtr to Ptr) */
+            msg = SharedRegion_getPtr((SharedRegion_SRPtr)eventEntry[0]);
+
+            /* get the queue id */
+            queueId = MessageQ_getDstQueue(msg);
+
+            /* put message on local queue, if it still exists */
+            if (MessageQ_put(queueId, msg) < 0) {
+                MessageQ_free(msg);
+            }
+
+            /* update the local readIndex. */
+            readIndex = ((readIndex + 1) & TransportShmCirc_maxIndex);
+
+            /* set the getReadIndex */
+            obj->getReadIndex[0] = readIndex;
+
+            /*
+             *  Write back the getReadIndex once every N / 4 messages.
+             *  No need to invalidate since only one processor ever
+             *  writes this . No need to wait for operation to complete
+             *  since remote core updates its readIndex at least once
+             *  every N messages and the remote core will not use a slot
+             *  until it sees that the event has been processed with this
+             *  cache wb. Chances are small that the remote core needs
+             *  to spin due to this since we are doing a wb N / 4.
+             */
+            if ((obj->cacheEnabled) &&
+                ((readIndex % TransportShmCirc_modIndex) == 0)) {
+                Cache_wb(obj->getReadIndex,
+                         sizeof(Bits32),
+                         Cache_Type_ALL,
+                         FALSE);
+            }
+
+            /* get the next entry */
+            eventEntry = (UInt32 *)&(obj->getBuffer[readIndex]);
+        }
 
-        /* set the getReadIndex */
-        obj->getReadIndex[0] = readIndex;
+        if (!TransportShmCirc_SUPPRESS) {
+            break;
+        }
 
         /*
-         *  Write back the getReadIndex once every N / 4 messages.
-         *  No need to invalidate since only one processor ever
-         *  writes this . No need to wait for operation to complete
-         *  since remote core updates its readIndex at least once
-         *  every N messages and the remote core will not use a slot
-         *  until it sees that the event has been processed with this
-         *  cache wb. Chances are small that the remote core needs
-         *  to spin due to this since we are doing a wb N / 4.
+         *  The buffer is empty: ask for an event when the next slot is
+         *  filled, then look again in case it was filled before the
+         *  remote processor could see the request.
          */
-        if ((obj->cacheEnabled) &&
-            ((readIndex % TransportShmCirc_modIndex) == 0)) {
-            Cache_wb(obj->getReadIndex,
+        obj->getEventIndex[0] = readIndex;
+        if (obj->cacheEnabled) {
+            Cache_wb(obj->getEventIndex,
                      sizeof(Bits32),
                      Cache_Type_ALL,
-                     FALSE);
+                     TRUE);
+        }
+        TransportShmCirc_mfence();
+        if (obj->cacheEnabled) {
+            Cache_inv(obj->getWriteIndex,
+                      sizeof(Bits32),
+                      Cache_Type_ALL,
+                      TRUE);
         }
+    } while (obj->getWriteIndex[0] != readIndex);
+}
 
-        /* get the next entry */
-        eventEntry = (UInt32 *)&(obj->getBuffer[readIndex]);
+/*
+ *  ======== TransportShmCirc_needEvent ========
+ *  Whether moving the putWriteIndex from oldIndex to newIndex filled the
+ *  slot the remote processor asked for an event at, as virtio's
+ *  vring_need_event(), or whether the last event could not be sent.  The
+ *  putWriteIndex must already be written back.
+ */
+static Bool TransportShmCirc_needEvent(TransportShmCirc_Object *obj,
+    UInt32 oldIndex, UInt32 newIndex)
+{
+    UInt32 eventIndex;
+
+    if (!TransportShmCirc_SUPPRESS || obj->eventPending) {
+        return (TRUE);
     }
+
+    /* order the putWriteIndex store before the putEventIndex load */
+    TransportShmCirc_mfence();
+    if (obj->cacheEnabled) {
+        Cache_inv(obj->putEventIndex, sizeof(Bits32), Cache_Type_ALL, TRUE);
+    }
+    eventIndex = obj->putEventIndex[0];
+
+    if (eventIndex > TransportShmCirc_maxIndex) {
+        /* the remote processor has not asked yet */
+        return (TRUE);
+    }
+
+    return (((newIndex - eventIndex - 1) & TransportShmCirc_maxIndex) <
+            ((newIndex - oldIndex) & TransportShmCirc_maxIndex));
 }
 
 /*
@@ -494,18 +715,20 @@ SizeT TransportShmCirc_sharedMemReq(const TransportShmCirc_Params *params)
      *  1 putBuffer with numMsgs (rounded to CLS) +
      *  1 putWriteIndex ptr (rounded to CLS) +
      *  1 putReadIndex put (rounded to CLS) +
+     *  1 putEventIndex (rounded to CLS) +
      *  1 getBuffer with numMsgs (rounded to CLS) +
      *  1 getWriteIndex ptr (rounded to CLS) +
      *  1 getReadIndex put (rounded to CLS) +
+     *  1 getEventIndex (rounded to CLS)
      *
      *  For CLS of 128b it is:
-     *      128b + 128b + 128b + 128b+ 128b + 128b = 768b
+     *      128b + 128b + 128b + 128b + 128b + 128b + 128b + 128b = 1024b
      *
      *  Note: CLS means Cache Line Size
      */
     memReq = 2 * (
         (_Ipc_roundup(sizeof(Ptr) * TransportShmCirc_numMsgs, minAlign)) +
-        ( 2 * _Ipc_roundup(sizeof(Bits32), minAlign)));
+        ( 3 * _Ipc_roundup(sizeof(Bits32), minAlign)));
 
     return (memReq);
 }
@@ -75,7 +75,10 @@ Void TransportShmNotify_notifyFxn(UInt16 procId,
 
     queueId = MessageQ_getDstQueue(msg);
 
-    MessageQ_put(queueId, msg);
+    /* the queue may have been deleted since the msg was sent */
+    if (MessageQ_put(queueId, msg) < 0) {
+        MessageQ_free(msg);
+    }
 }
 
 /*
@@ -188,6 +191,57 @@ Bool TransportShmNotify_put(TransportShmNotify_Object *obj, Ptr msg)
     return (TRUE);
 }
 
+/*
+ *  ======== TransportShmNotify_putMany ========
+ *  Each message still needs an event of its own, since the event payload
+ *  is the message, but the cache maintenance is done in one pass.
+ */
+UInt TransportShmNotify_putMany(TransportShmNotify_Object *obj, Ptr *msgs,
+    UInt numMsgs)
+{
+    UInt16 regionId = SharedRegion_INVALIDREGIONID;
+    SharedRegion_SRPtr msgSRPtr;
+    Int status;
+    UInt i;
+
+    if (numMsgs == 0) {
+        return (0);
+    }
+
+    /* writeback invalidate the messages, waiting once for them all */
+    for (i = 0; i < numMsgs; i++) {
+        if (ti_sdo_ipc_SharedRegion_translate ||
+                !TransportShmNotify_alwaysWriteBackMsg ) {
+            regionId = SharedRegion_getId(msgs[i]);
+            if (SharedRegion_isCacheEnabled(regionId)) {
+                Cache_wbInv(msgs[i], ((MessageQ_Msg)(msgs[i]))->msgSize,
+                        Cache_Type_ALL, FALSE);
+            }
+        }
+        else {
+            Cache_wbInv(msgs[i], ((MessageQ_Msg)(msgs[i]))->msgSize,
+                    Cache_Type_ALL, FALSE);
+        }
+    }
+    Cache_wait();
+
+    for (i = 0; i < numMsgs; i++) {
+        if (ti_sdo_ipc_SharedRegion_translate) {
+            regionId = SharedRegion_getId(msgs[i]);
+        }
+        msgSRPtr = SharedRegion_getSRPtr(msgs[i], regionId);
+
+        /* use waitClear = TRUE to make sure prior message was received */
+        status = Notify_sendEvent(obj->remoteProcId, 0,
+            TransportShmNotify_notifyEventId, (UInt32)msgSRPtr, TRUE);
+        if (status < 0) {
+            break;
+        }
+    }
+
+    return (i);
+}
+
 /*
  *  ======== TransportShmNotify_control ========
  */
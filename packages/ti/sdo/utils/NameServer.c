@@ -254,6 +254,10 @@ Ptr NameServer_add(NameServer_Handle handle, String name, Ptr value,
     /* Add to the nameList */
     List_put(nameList, (List_Elem *)tableEntry);
 
+    if (NameServer_module->changeHookFxn != NULL) {
+        NameServer_module->changeHookFxn(obj->name, name, value, len);
+    }
+
     return (tableEntry);
 }
 
@@ -599,6 +603,11 @@ Int NameServer_remove(NameServer_Handle handle, String name)
     /* Leave the gate */
     GateSwi_leave(NameServer_module->gate, key);
 
+    if (status == NameServer_S_SUCCESS &&
+        NameServer_module->changeHookFxn != NULL) {
+        NameServer_module->changeHookFxn(obj->name, name, NULL, 0);
+    }
+
     return (status);
 }
 
@@ -610,6 +619,12 @@ Int NameServer_removeEntry(NameServer_Handle handle, Ptr entry)
     ti_sdo_utils_NameServer_Object *obj =
             (ti_sdo_utils_NameServer_Object *)handle;
 
+    /* the entry's name may be freed with it, so call the hook first */
+    if (NameServer_module->changeHookFxn != NULL) {
+        NameServer_module->changeHookFxn(obj->name,
+            ((ti_sdo_utils_NameServer_TableEntry *)entry)->name, NULL, 0);
+    }
+
     NameServer_removeLocal(obj, (ti_sdo_utils_NameServer_TableEntry *)entry);
 
     return (NameServer_S_SUCCESS);
@@ -910,6 +925,15 @@ Void ti_sdo_utils_NameServer_unregisterRemoteDriver(UInt16 procId)
     Hwi_restore(key);
 }
 
+/*
+ *  ======== ti_sdo_utils_NameServer_setChangeHookFxn ========
+ */
+Void ti_sdo_utils_NameServer_setChangeHookFxn(
+        ti_sdo_utils_NameServer_ChangeHookFxn changeHookFxn)
+{
+    NameServer_module->changeHookFxn = changeHookFxn;
+}
+
 /*
  *************************************************************************
  *                       Internal functions
@@ -92,6 +92,8 @@ function module$static$init(mod, params)
 
     /* Gate for all NameServer critical regions */
     mod.gate = GateSwi.create();
+
+    mod.changeHookFxn = params.changeHookFxn;
 }
 
 /*
@@ -174,6 +174,9 @@
 #define TRACESHIFT    12
 #define TRACEMASK     0x1000
 
+/* Usecs MessageQ_openWait() waits between looking for a queue */
+#define MessageQ_OPENWAITPOLL  10000
+
 /* =============================================================================
  * Structures & Enums
  * =============================================================================
@@ -469,6 +472,40 @@ Int MessageQ_open (String name, MessageQ_QueueId * queueId)
     return (status);
 }
 
+/*
+ * Opens an instance of MessageQ, waiting for it to be created.  The
+ * resource manager has no way to say when a name is added, so this looks
+ * every MessageQ_OPENWAITPOLL usecs.
+ */
+Int MessageQ_openWait (String name, MessageQ_QueueId * queueId, UInt timeout)
+{
+    Int status;
+    struct timeval start;
+    struct timeval now;
+    UInt32 waited;
+
+    gettimeofday(&start, NULL);
+
+    while (1) {
+        status = MessageQ_open(name, queueId);
+        if (status != MessageQ_E_NOTFOUND && status != MessageQ_E_TIMEOUT) {
+            break;
+        }
+
+        gettimeofday(&now, NULL);
+        waited = (now.tv_sec - start.tv_sec) * 1000000 +
+                 (now.tv_usec - start.tv_usec);
+        if (timeout != MessageQ_FOREVER && waited >= timeout) {
+            status = MessageQ_E_TIMEOUT;
+            break;
+        }
+
+        usleep(MessageQ_OPENWAITPOLL);
+    }
+
+    return (status);
+}
+
 /* Closes previously opened instance of MessageQ module. */
 Int MessageQ_close (MessageQ_QueueId * queueId)
 {
@@ -502,6 +539,18 @@ Int MessageQ_put (MessageQ_QueueId queueId, MessageQ_Msg msg)
     return (status);
 }
 
+/*
+ * Place a message onto a message queue, waiting for credit.
+ *
+ * The tiipc write already blocks until the remote processor has room, so
+ * no credits are taken here.  The message is put as by MessageQ_put().
+ */
+Int MessageQ_putWait (MessageQ_QueueId queueId, MessageQ_Msg msg,
+                      UInt timeout)
+{
+    return (MessageQ_put(queueId, msg));
+}
+
 /*
  * Gets a message for a message queue and blocks if the queue is empty.
  * If a message is present, it returns it.  Otherwise it blocks
@@ -582,6 +631,83 @@ Int MessageQ_get (MessageQ_Handle handle, MessageQ_Msg * msg ,UInt timeout)
     return (status);
 }
 
+/*
+ * Gets a message only if one is already waiting.
+ *
+ * The select() in MessageQ_get() polls when given a zero timeout.
+ */
+Int MessageQ_tryGet (MessageQ_Handle handle, MessageQ_Msg * msg)
+{
+    return (MessageQ_get(handle, msg, 0));
+}
+
+/*
+ * Place a burst of messages onto a message queue.
+ *
+ * The tiipc device has no vectored write, so each message is written on
+ * its own; the first failure stops the burst and leaves the remaining
+ * messages with the caller.
+ */
+Int MessageQ_putMany (MessageQ_QueueId queueId, MessageQ_Msg msgs[],
+                      UInt numMsgs)
+{
+    UInt     i;
+    int      ipcFd;
+    int      err;
+    UInt16   dstProcId  = (UInt16)(queueId >> 16);
+    UInt16   queueIndex = (MessageQ_QueueIndex)(queueId & 0x0000ffff);
+
+    ipcFd = MessageQ_module->ipcFd[dstProcId];
+
+    for (i = 0; i < numMsgs; i++) {
+        msgs[i]->dstId   = queueIndex;
+        msgs[i]->dstProc = dstProcId;
+
+        err = write(ipcFd, msgs[i], msgs[i]->msgSize);
+        if (err < 0) {
+            printf ("MessageQ_putMany: write failed: %d, %s\n",
+                      errno, strerror(errno));
+            break;
+        }
+
+        /* Copy transport: the message is ours to free once written */
+        MessageQ_free(msgs[i]);
+    }
+
+    return ((i == 0 && numMsgs > 0) ? MessageQ_E_FAIL : (Int)i);
+}
+
+/*
+ * Gets a burst of messages for a message queue.
+ *
+ * Blocks in MessageQ_get() for the first message, then polls for more
+ * with a zero timeout, so a burst that has already arrived is returned
+ * from one call.
+ */
+Int MessageQ_getMany (MessageQ_Handle handle, MessageQ_Msg msgs[],
+                      UInt maxMsgs, UInt timeout)
+{
+    Int     status;
+    UInt    count;
+
+    if (maxMsgs == 0) {
+        return (MessageQ_E_FAIL);
+    }
+
+    status = MessageQ_get(handle, &msgs[0], timeout);
+    if (status < 0) {
+        return (status);
+    }
+
+    for (count = 1; count < maxMsgs; count++) {
+        if (MessageQ_get(handle, &msgs[count], 0) != MessageQ_S_SUCCESS) {
+            break;
+        }
+    }
+
+    return ((Int)count);
+}
+
 /*
  * Return a count of the number of messages in the queue
  *
@@ -690,6 +816,20 @@ MessageQ_QueueId MessageQ_getQueueId (MessageQ_Handle handle)
     return queueId;
 }
 
+/*
+ * Returns a fd that polls readable while messages are waiting.
+ *
+ * This is the queue's tiipc endpoint, which supports select() and
+ * ionotify() through the resource manager.  MessageQ_unblock() doesn't
+ * make it readable; it signals a separate pipe.
+ */
+Int MessageQ_getFd (MessageQ_Handle handle)
+{
+    MessageQ_Object * obj = (MessageQ_Object *) handle;
+
+    return (obj->ipcFd);
+}
+
 /* Sets the tracing of a message */
 Void MessageQ_setMsgTrace (MessageQ_Msg msg, Bool traceFlag)
 {
@@ -292,6 +292,11 @@ static void NameServerRemote_processMessage(NameServerMsg * msg, UInt16 procId)
             LOG0("NameServer: MessageQCopy_send failed\n")
         }
     }
+    else if (msg->request == NAMESERVER_ANNOUNCE) {
+        /* nothing here waits for names, so announcements aren't needed */
+        LOG2("NameServer Announce: instanceName: %s, name: %s ignored\n",
+             (String)msg->instanceName, (String)msg->name)
+    }
     else {
         LOG2("NameServer Reply: instanceName: %s, name: %s",
              (String)msg->instanceName, (String)msg->name)